@@ -103,9 +103,9 @@ constexpr uint64_t ExitSequenceSize<AArch64>() {
 }  // namespace
 
 template <typename Arch>
-absl::StatusOr<Snapshot> InstructionsToSnapshot(
-    absl::string_view code, const UContext<Arch>& uctx,
-    const FuzzingConfig<Arch>& config) {
+absl::Status CheckInstructionsForSnapshot(absl::string_view code,
+                                          const UContext<Arch>& uctx,
+                                          const FuzzingConfig<Arch>& config) {
   if (!StaticInstructionFilter<Arch>(code, config.instruction_filter)) {
     return absl::InvalidArgumentError(
         "code snippet contains problematic instructions.");
@@ -117,7 +117,6 @@ absl::StatusOr<Snapshot> InstructionsToSnapshot(
   }
 
   const uint64_t code_start_addr = uctx.gregs.GetInstructionPointer();
-  const uint64_t code_end_addr = code_start_addr + code.size();
   if (!IsPageAligned(code_start_addr)) {
     return absl::InvalidArgumentError(
         "initial instruction point is not page aligned.");
@@ -126,6 +125,32 @@ absl::StatusOr<Snapshot> InstructionsToSnapshot(
     return absl::InvalidArgumentError(
         "derived code address collides with exit sequence address.");
   }
+  RETURN_IF_NOT_OK(MemoryMapping::CanMakeSized(code_start_addr, kPageSize));
+
+  const uint64_t stack_pointer = uctx.gregs.GetStackPointer();
+  if (!IsPageAligned(stack_pointer)) {
+    return absl::InvalidArgumentError("stack pointer is not page aligned.");
+  }
+  const uint64_t stack_size = StackSize(config);
+  return MemoryMapping::CanMakeSized(stack_pointer - stack_size, stack_size);
+}
+
+// Instantiate
+template absl::Status CheckInstructionsForSnapshot(
+    absl::string_view code, const UContext<X86_64>& uctx,
+    const FuzzingConfig<X86_64>& config);
+template absl::Status CheckInstructionsForSnapshot(
+    absl::string_view code, const UContext<AArch64>& uctx,
+    const FuzzingConfig<AArch64>& config);
+
+template <typename Arch>
+absl::StatusOr<Snapshot> InstructionsToSnapshot(
+    absl::string_view code, const UContext<Arch>& uctx,
+    const FuzzingConfig<Arch>& config) {
+  RETURN_IF_NOT_OK(CheckInstructionsForSnapshot(code, uctx, config));
+
+  const uint64_t code_start_addr = uctx.gregs.GetInstructionPointer();
+  const uint64_t code_end_addr = code_start_addr + code.size();
 
   Snapshot snapshot(Snapshot::ArchitectureTypeToEnum<Arch>());
 
@@ -140,7 +165,6 @@ absl::StatusOr<Snapshot> InstructionsToSnapshot(
   // https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/commit/?id=24cecc37746393432d994c0dbc251fb9ac7c5d72
   // https://blog.siguza.net/PAN/
   // So we can't actually use execute-only pages.
-  RETURN_IF_NOT_OK(MemoryMapping::CanMakeSized(code_start_addr, kPageSize));
   MemoryMapping code_page_mapping = Snapshot::MemoryMapping::MakeSized(
       code_start_addr, kPageSize, MemoryPerms::XR());
   snapshot.add_memory_mapping(code_page_mapping);
@@ -155,13 +179,8 @@ absl::StatusOr<Snapshot> InstructionsToSnapshot(
       Snapshot::MemoryBytes(code_start_addr, code_with_traps));
 
   // Add the stack below the stack pointer.
-  uint64_t stack_pointer = uctx.gregs.GetStackPointer();
-  if (!IsPageAligned(stack_pointer)) {
-    return absl::InvalidArgumentError("stack pointer is not page aligned.");
-  }
   uint64_t stack_size = StackSize(config);
-  uint64_t stack_start = stack_pointer - stack_size;
-  RETURN_IF_NOT_OK(MemoryMapping::CanMakeSized(stack_start, stack_size));
+  uint64_t stack_start = uctx.gregs.GetStackPointer() - stack_size;
   MemoryMapping data_page_mapping = Snapshot::MemoryMapping::MakeSized(
       stack_start, stack_size, MemoryPerms::RW());
   snapshot.add_memory_mapping(data_page_mapping);
@@ -17,6 +17,7 @@
 
 #include <string>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "./common/proxy_config.h"
@@ -52,6 +53,14 @@ UContext<Arch> GenerateUContextForInstructions(
     absl::string_view code,
     const FuzzingConfig<Arch>& config = DEFAULT_FUZZING_CONFIG<Arch>);
 
+// Checks that InstructionsToSnapshot() would accept `code` with `uctx` and
+// `config`, without building the Snapshot. Returns the same error
+// InstructionsToSnapshot() would.
+template <typename Arch>
+absl::Status CheckInstructionsForSnapshot(
+    absl::string_view code, const UContext<Arch>& uctx,
+    const FuzzingConfig<Arch>& config = DEFAULT_FUZZING_CONFIG<Arch>);
+
 // Take a caller-specified UContext rather than generating it.
 // The location of the code and the stack will be inferred from the UContext
 // rather than using the FuzzingConfig.
@@ -222,5 +222,24 @@ TEST(RawInsnsUtil, InstructionsToSnapshot_AArch64_Filter) {
               StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
+TEST(RawInsnsUtil, CheckInstructionsForSnapshot) {
+  auto config = DEFAULT_FUZZING_CONFIG<X86_64>;
+  // nop
+  std::string nop({0x90});
+  UContext<X86_64> uctx = GenerateUContextForInstructions(nop, config);
+  EXPECT_OK(CheckInstructionsForSnapshot(nop, uctx, config));
+
+  // Too large to fit in the code page with the exit sequence.
+  std::string too_large(kPageSize, 0x90);
+  EXPECT_THAT(CheckInstructionsForSnapshot(too_large, uctx, config),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  uctx.gregs.rsp += 8;
+  EXPECT_THAT(CheckInstructionsForSnapshot(nop, uctx, config),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(InstructionsToSnapshot(nop, uctx, config),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace
 }  // namespace silifuzz
@@ -0,0 +1,180 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark of random instruction generation for the mutator.
+//
+// To run:
+//
+// bazel run -c opt third_party/silifuzz/fuzzer:instruction_generator_benchmark
+//
+// For each architecture, this reports how long building the encoding template
+// table takes, and then how many instructions per second are generated and
+// which instruction forms (iforms on x86_64, Capstone instruction IDs on
+// aarch64) they have, both for GenerateRandomInstruction() and for plain
+// rejection sampling of random bytes.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "./fuzzer/instruction_template.h"
+#include "./fuzzer/program.h"
+#include "./fuzzer/program_arch.h"
+#include "./fuzzer/program_mutation_ops.h"
+#include "./instruction/capstone_disassembler.h"
+#include "./instruction/xed_util.h"
+#include "./util/arch.h"
+#include "./util/checks.h"
+
+extern "C" {
+#include "third_party/libxed/xed-interface.h"
+}
+
+namespace silifuzz {
+namespace {
+
+// Number of most common forms to report.
+constexpr size_t kNumTopForms = 10;
+
+// Returns the form of an instruction and its name.
+template <typename Arch>
+class FormClassifier;
+
+template <>
+class FormClassifier<X86_64> {
+ public:
+  FormClassifier() { InitXedIfNeeded(); }
+
+  uint32_t Classify(const Instruction<X86_64>& instruction) {
+    xed_decoded_inst_t xedd;
+    xed_decoded_inst_zero(&xedd);
+    xed_decoded_inst_set_mode(&xedd, XED_MACHINE_MODE_LONG_64,
+                              XED_ADDRESS_WIDTH_64b);
+    CHECK_EQ(xed_decode(&xedd, instruction.encoded.data(),
+                        instruction.encoded.size()),
+             XED_ERROR_NONE);
+    return xed_decoded_inst_get_iform_enum(&xedd);
+  }
+
+  std::string Name(uint32_t form) {
+    return xed_iform_enum_t2str(static_cast<xed_iform_enum_t>(form));
+  }
+};
+
+template <>
+class FormClassifier<AArch64> {
+ public:
+  uint32_t Classify(const Instruction<AArch64>& instruction) {
+    CHECK(disassembler_.Disassemble(0x0, instruction.encoded.data(),
+                                    instruction.encoded.size()));
+    return disassembler_.InstructionID();
+  }
+
+  std::string Name(uint32_t form) {
+    return disassembler_.InstructionIDName(form);
+  }
+
+ private:
+  CapstoneDisassembler<AArch64> disassembler_;
+};
+
+// The generator the mutator used before encoding templates: draw random bytes
+// until one decodes to an accepted instruction.
+template <typename Arch>
+bool GenerateByRejectionSampling(MutatorRng& rng,
+                                 Instruction<Arch>& instruction) {
+  InstructionByteBuffer<Arch> bytes;
+  for (size_t i = 0; i < 64; ++i) {
+    for (uint8_t& byte : bytes) byte = rng();
+    if (InstructionFromBytes(bytes, sizeof(bytes), instruction)) return true;
+  }
+  return false;
+}
+
+template <typename Arch>
+void BenchmarkGenerator(const char* name,
+                        bool (*generate)(MutatorRng&, Instruction<Arch>&)) {
+  MutatorRng rng(0);
+  size_t num_generated = 0;
+  size_t num_failures = 0;
+  const absl::Duration kBenchmarkDuration = absl::Seconds(2);
+  const absl::Time start = absl::Now();
+  absl::Duration elapsed;
+  do {
+    for (size_t i = 0; i < 1000; ++i) {
+      Instruction<Arch> instruction;
+      if (generate(rng, instruction)) {
+        ++num_generated;
+      } else {
+        ++num_failures;
+      }
+    }
+    elapsed = absl::Now() - start;
+  } while (elapsed < kBenchmarkDuration);
+  LOG_INFO("  ", name, ": ",
+           static_cast<int64_t>(num_generated / absl::ToDoubleSeconds(elapsed)),
+           " instructions/sec, ", num_failures, " failures");
+
+  // Classify a fixed number of instructions outside of the timed loop.
+  constexpr size_t kNumClassified = 100000;
+  FormClassifier<Arch> classifier;
+  absl::flat_hash_map<uint32_t, size_t> form_counts;
+  for (size_t i = 0; i < kNumClassified; ++i) {
+    Instruction<Arch> instruction;
+    if (generate(rng, instruction)) {
+      ++form_counts[classifier.Classify(instruction)];
+    }
+  }
+  std::vector<std::pair<size_t, uint32_t>> forms;
+  for (const auto& [form, count] : form_counts) {
+    forms.emplace_back(count, form);
+  }
+  std::sort(forms.rbegin(), forms.rend());
+  LOG_INFO("    ", forms.size(), " distinct forms, most common:");
+  for (size_t i = 0; i < std::min(kNumTopForms, forms.size()); ++i) {
+    LOG_INFO("    ", classifier.Name(forms[i].second), ": ",
+             100.0 * forms[i].first / kNumClassified, "%");
+  }
+}
+
+template <typename Arch>
+void RunBenchmark() {
+  LOG_INFO("Benchmarking ", Arch::arch_name);
+  const absl::Time start = absl::Now();
+  const InstructionTemplateTable<Arch>& templates =
+      GetInstructionTemplates<Arch>();
+  LOG_INFO("  built ", templates.NumTemplates(), " templates for ",
+           templates.NumKeys(), " keys in ",
+           absl::FormatDuration(absl::Now() - start));
+  BenchmarkGenerator<Arch>("templates", GenerateRandomInstruction<Arch>);
+  BenchmarkGenerator<Arch>("rejection sampling",
+                           GenerateByRejectionSampling<Arch>);
+}
+
+int BenchmarkMain() {
+  RunBenchmark<X86_64>();
+  RunBenchmark<AArch64>();
+  return 0;
+}
+
+}  // namespace
+}  // namespace silifuzz
+
+int main() { return silifuzz::BenchmarkMain(); }
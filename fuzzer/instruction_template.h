@@ -0,0 +1,91 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_FUZZER_INSTRUCTION_TEMPLATE_H_
+#define THIRD_PARTY_SILIFUZZ_FUZZER_INSTRUCTION_TEMPLATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "./fuzzer/program.h"
+
+namespace silifuzz {
+
+// A pattern of instruction encodings. The bits set in `mask` are fixed to the
+// corresponding bits of `bits`, all other bits are free.
+template <typename Arch>
+struct InstructionTemplate {
+  InstructionByteBuffer<Arch> bits;
+  InstructionByteBuffer<Arch> mask;
+
+  // Overwrites the fixed bits of `bytes`, leaving the free bits as they are.
+  void Apply(InstructionByteBuffer<Arch>& bytes) const {
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+      bytes[i] = (bytes[i] & ~mask[i]) | (bits[i] & mask[i]);
+    }
+  }
+};
+
+// A table of instruction templates grouped by an arch-specific key, such as
+// the form of the instructions a template encodes.
+// Select() picks a key uniformly and then one of its templates uniformly, so
+// the number of templates that encode a form does not bias how often it is
+// generated.
+template <typename Arch>
+class InstructionTemplateTable {
+ public:
+  InstructionTemplateTable() = default;
+
+  // Copyable and movable.
+  InstructionTemplateTable(const InstructionTemplateTable&) = default;
+  InstructionTemplateTable(InstructionTemplateTable&&) = default;
+  InstructionTemplateTable& operator=(const InstructionTemplateTable&) =
+      default;
+  InstructionTemplateTable& operator=(InstructionTemplateTable&&) = default;
+
+  // Adds `instruction_template` to the templates for `key`.
+  void Add(uint32_t key,
+           const InstructionTemplate<Arch>& instruction_template) {
+    auto [it, inserted] = key_index_.try_emplace(key, templates_.size());
+    if (inserted) templates_.emplace_back();
+    templates_[it->second].push_back(instruction_template);
+    ++num_templates_;
+  }
+
+  bool empty() const { return templates_.empty(); }
+  size_t NumKeys() const { return templates_.size(); }
+  size_t NumTemplates() const { return num_templates_; }
+
+  // Returns a random template. The table must not be empty.
+  const InstructionTemplate<Arch>& Select(MutatorRng& rng) const {
+    const std::vector<InstructionTemplate<Arch>>& group =
+        templates_[RandomIndex(rng, templates_.size())];
+    return group[RandomIndex(rng, group.size())];
+  }
+
+ private:
+  // Maps a key to its index in `templates_`.
+  absl::flat_hash_map<uint32_t, size_t> key_index_;
+
+  // Templates grouped by key. No group is empty.
+  std::vector<std::vector<InstructionTemplate<Arch>>> templates_;
+
+  size_t num_templates_ = 0;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_FUZZER_INSTRUCTION_TEMPLATE_H_
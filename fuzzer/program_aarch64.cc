@@ -14,9 +14,11 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
+#include "./fuzzer/instruction_template.h"
 #include "./fuzzer/program.h"
 #include "./fuzzer/program_arch.h"  // IWYU pragma: keep
 #include "./instruction/capstone_disassembler.h"
@@ -129,6 +131,49 @@ InstructionDisplacementInfo GetDirectBranchInfo(uint32_t insn) {
   return {};
 }
 
+// Templates fix this many of the most significant bits of an instruction.
+constexpr int kTemplatePrefixBits = 11;
+
+// Number of random completions tried per prefix when building templates.
+constexpr int kTemplateSamplesPerPrefix = 16;
+
+// Returns true if we accept the instruction `insn`. This performs the same
+// checks as InstructionFromBytes() with a reusable disassembler.
+bool InstructionAccepted(CapstoneDisassembler<AArch64>& disassembler,
+                         uint32_t insn) {
+  uint8_t bytes[sizeof(insn)];
+  memcpy(bytes, &insn, sizeof(insn));
+  return disassembler.Disassemble(0x0, bytes, sizeof(bytes)) &&
+         StaticInstructionFilter<AArch64>(absl::string_view(
+             reinterpret_cast<const char*>(bytes), sizeof(bytes)));
+}
+
+// Enumerates the instruction prefixes of kTemplatePrefixBits bits and keeps
+// those with an accepted random completion, keyed by prefix. Generating from
+// these templates has the same distribution as random instruction words minus
+// the parts of the encoding space that are unallocated or that we reject
+// outright, such as SVE or system instructions.
+InstructionTemplateTable<AArch64> BuildInstructionTemplates() {
+  InstructionTemplateTable<AArch64> table;
+  CapstoneDisassembler<AArch64> disassembler;
+  // A fixed seed makes every process build the same table.
+  MutatorRng rng(0);
+  const uint32_t mask = ~uint32_t{0} << (32 - kTemplatePrefixBits);
+  for (uint32_t prefix = 0; prefix < (1U << kTemplatePrefixBits); ++prefix) {
+    const uint32_t bits = prefix << (32 - kTemplatePrefixBits);
+    for (int i = 0; i < kTemplateSamplesPerPrefix; ++i) {
+      if (InstructionAccepted(disassembler, bits | (rng() & ~mask))) {
+        InstructionTemplate<AArch64> instruction_template;
+        memcpy(instruction_template.bits, &bits, sizeof(bits));
+        memcpy(instruction_template.mask, &mask, sizeof(mask));
+        table.Add(bits, instruction_template);
+        break;
+      }
+    }
+  }
+  return table;
+}
+
 }  // namespace
 
 template <>
@@ -191,4 +236,11 @@ bool TryToReencodeInstructionDisplacements(Instruction<AArch64>& insn) {
   CHECK(false) << "Instruction was not a branch.";
 }
 
+template <>
+const InstructionTemplateTable<AArch64>& GetInstructionTemplates() {
+  static const InstructionTemplateTable<AArch64>* const table =
+      new InstructionTemplateTable<AArch64>(BuildInstructionTemplates());
+  return *table;
+}
+
 }  // namespace silifuzz
@@ -18,6 +18,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "./fuzzer/instruction_template.h"
 #include "./fuzzer/program.h"
 
 namespace silifuzz {
@@ -47,6 +48,11 @@ bool InstructionFromBytes(const uint8_t* bytes, size_t num_bytes,
 template <typename Arch>
 bool TryToReencodeInstructionDisplacements(Instruction<Arch>& insn);
 
+// Returns templates of encodings InstructionFromBytes() is likely to accept.
+// The table is built from the decoder on first use, which takes a moment.
+template <typename Arch>
+const InstructionTemplateTable<Arch>& GetInstructionTemplates();
+
 }  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_FUZZER_PROGRAM_ARCH_H_
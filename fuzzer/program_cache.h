@@ -0,0 +1,106 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_FUZZER_PROGRAM_CACHE_H_
+#define THIRD_PARTY_SILIFUZZ_FUZZER_PROGRAM_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "./fuzzer/program.h"
+
+namespace silifuzz {
+
+// A bounded cache of programs parsed from fuzzer inputs, keyed by the input
+// bytes. The fuzzing engine hands the same corpus elements to the mutator over
+// and over, and parsing an input decodes every instruction.
+//
+// Cached programs are immutable and shared with the callers. A caller that
+// wants to modify a program copies it first.
+// When the cache is full, the least recently used program is evicted.
+//
+// This class is thread-compatible.
+template <typename Arch>
+class ProgramCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  // Creates a cache for at most `capacity` programs. A cache with zero
+  // capacity parses every input.
+  explicit ProgramCache(size_t capacity) : capacity_(capacity) {}
+
+  // Not copyable or movable, `index_` points into `entries_`.
+  ProgramCache(const ProgramCache&) = delete;
+  ProgramCache& operator=(const ProgramCache&) = delete;
+
+  // Returns the program parsed from `input`.
+  std::shared_ptr<const Program<Arch>> Get(const std::vector<uint8_t>& input) {
+    const absl::string_view key(reinterpret_cast<const char*>(input.data()),
+                                input.size());
+    if (auto it = index_.find(key); it != index_.end()) {
+      ++stats_.hits;
+      // Move to the front of the LRU list.
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->program;
+    }
+
+    ++stats_.misses;
+    auto program = std::make_shared<const Program<Arch>>(input);
+    if (capacity_ == 0) return program;
+    if (entries_.size() == capacity_) {
+      index_.erase(entries_.back().bytes);
+      entries_.pop_back();
+      ++stats_.evictions;
+    }
+    entries_.push_front(Entry{std::string(key), program});
+    index_.emplace(entries_.front().bytes, entries_.begin());
+    return program;
+  }
+
+  size_t size() const { return entries_.size(); }
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    std::string bytes;
+    std::shared_ptr<const Program<Arch>> program;
+  };
+
+  size_t capacity_;
+
+  // Most recently used entry first.
+  std::list<Entry> entries_;
+
+  // Maps the bytes of each entry to the entry.
+  absl::flat_hash_map<absl::string_view, typename std::list<Entry>::iterator>
+      index_;
+
+  Stats stats_;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_FUZZER_PROGRAM_CACHE_H_
@@ -0,0 +1,95 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./fuzzer/program_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "./fuzzer/program.h"
+#include "./fuzzer/program_mutator.h"
+#include "./util/arch.h"
+
+namespace silifuzz {
+namespace {
+
+// nop
+const std::vector<uint8_t> kNop = {0x90};
+
+// nop; nop
+const std::vector<uint8_t> kTwoNops = {0x90, 0x90};
+
+// nop; nop; nop
+const std::vector<uint8_t> kThreeNops = {0x90, 0x90, 0x90};
+
+TEST(ProgramCache, Hit) {
+  ProgramCache<X86_64> cache(2);
+  std::shared_ptr<const Program<X86_64>> first = cache.Get(kTwoNops);
+  EXPECT_EQ(first->NumInstructions(), 2);
+  // An equal input in a different buffer.
+  std::shared_ptr<const Program<X86_64>> second =
+      cache.Get(std::vector<uint8_t>(kTwoNops));
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(cache.stats().hits, 1);
+  EXPECT_EQ(cache.stats().misses, 1);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(ProgramCache, EvictsLeastRecentlyUsed) {
+  ProgramCache<X86_64> cache(2);
+  std::shared_ptr<const Program<X86_64>> nop = cache.Get(kNop);
+  cache.Get(kTwoNops);
+  // Make kNop the most recently used input.
+  cache.Get(kNop);
+  cache.Get(kThreeNops);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_EQ(cache.size(), 2);
+
+  EXPECT_EQ(cache.Get(kNop), nop);
+  EXPECT_EQ(cache.stats().hits, 2);
+  cache.Get(kTwoNops);
+  EXPECT_EQ(cache.stats().misses, 4);
+}
+
+TEST(ProgramCache, ZeroCapacity) {
+  ProgramCache<X86_64> cache(0);
+  EXPECT_EQ(cache.Get(kNop)->NumInstructions(), 1);
+  EXPECT_EQ(cache.Get(kNop)->NumInstructions(), 1);
+  EXPECT_EQ(cache.stats().hits, 0);
+  EXPECT_EQ(cache.stats().misses, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(ProgramMutator, CacheDoesNotChangeMutants) {
+  const std::vector<const std::vector<uint8_t>*> inputs = {&kNop, &kTwoNops,
+                                                           &kThreeNops};
+  ProgramMutator<X86_64> cached(0);
+  ProgramMutator<X86_64> uncached(0, std::numeric_limits<size_t>::max(), 0);
+  for (int i = 0; i < 10; ++i) {
+    std::vector<std::vector<uint8_t>> cached_mutants(20);
+    std::vector<std::vector<uint8_t>> uncached_mutants(20);
+    cached.Mutate(inputs, cached_mutants.size(), cached_mutants);
+    uncached.Mutate(inputs, uncached_mutants.size(), uncached_mutants);
+    EXPECT_EQ(cached_mutants, uncached_mutants);
+  }
+  EXPECT_GT(cached.cache_stats().hits, 0);
+  EXPECT_EQ(cached.cache_stats().misses, inputs.size());
+}
+
+}  // namespace
+}  // namespace silifuzz
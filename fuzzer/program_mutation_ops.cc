@@ -22,6 +22,7 @@
 #include <random>
 
 #include "absl/log/check.h"
+#include "./fuzzer/instruction_template.h"
 #include "./fuzzer/program.h"
 #include "./fuzzer/program_arch.h"
 #include "./util/arch.h"  // IWYU pragma: keep
@@ -162,17 +163,29 @@ bool MutateInstruction(MutatorRng& rng, const Instruction<Arch>& original,
 template <typename Arch>
 bool GenerateRandomInstruction(MutatorRng& rng,
                                Instruction<Arch>& instruction) {
+  const InstructionTemplateTable<Arch>& templates =
+      GetInstructionTemplates<Arch>();
   InstructionByteBuffer<Arch> bytes;
-  // It may take us a few tries to find a random set of bytes that decompile.
+  // Candidates drawn from a template are almost always accepted. A few are
+  // unconstrained random bytes to keep encodings the templates do not cover
+  // reachable.
   // In theory this could be an infinite loop, but it's implemented as a finite
   // loop to limit the worst case behavior.
   for (size_t i = 0; i < 64; ++i) {
     RandomizeBuffer(rng, bytes);
+    if (!templates.empty() && RandomIndex(rng, 16) != 0) {
+      templates.Select(rng).Apply(bytes);
+    }
     if (InstructionFromBytes(bytes, sizeof(bytes), instruction)) return true;
   }
   return false;
 }
 
+template bool GenerateRandomInstruction(MutatorRng& rng,
+                                        Instruction<X86_64>& instruction);
+template bool GenerateRandomInstruction(MutatorRng& rng,
+                                        Instruction<AArch64>& instruction);
+
 template <typename Arch>
 bool InsertRandomInstruction(MutatorRng& rng, Program<Arch>& program) {
   Instruction<Arch> insn;
@@ -19,6 +19,11 @@
 
 namespace silifuzz {
 
+// Generate a random instruction that InstructionFromBytes() accepts.
+// Returns `false` if the random number generator was deeply unlucky.
+template <typename Arch>
+bool GenerateRandomInstruction(MutatorRng& rng, Instruction<Arch>& instruction);
+
 // Insert a randomly generated instruction at a random boundary in the program.
 // Returns `true` if successful, returns `false` if the the random number
 // generator was deeply unlucky.
@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -128,19 +129,16 @@ template <typename Arch>
 void ProgramMutator<Arch>::Mutate(
     const std::vector<const std::vector<uint8_t>*>& inputs, size_t num_mutants,
     std::vector<std::vector<uint8_t>>& mutants) {
-  // Extract the programs from the inputs.
+  // Extract the programs from the inputs as they are picked.
   // Copying a program should be cheaper that re-parsing each instruction for
-  // each mutant.
-  std::vector<Program<Arch>> programs;
-  programs.reserve(inputs.size());
-  for (const std::vector<uint8_t>* input : inputs) {
-    programs.push_back(Program<Arch>(*input));
-  }
+  // each mutant, and the same inputs come back in later calls.
+  std::vector<std::shared_ptr<const Program<Arch>>> programs(inputs.size());
 
   // Generate the requested mutants.
   for (size_t i = 0; i < num_mutants; ++i) {
     size_t base = RandomIndex(rng_, inputs.size());
-    GenerateSingleOutput(programs[base], mutants[i]);
+    if (programs[base] == nullptr) programs[base] = cache_.Get(*inputs[base]);
+    GenerateSingleOutput(*programs[base], mutants[i]);
   }
 }
 
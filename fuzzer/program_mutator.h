@@ -16,30 +16,41 @@
 #define THIRD_PARTY_SILIFUZZ_FUZZER_PROGRAM_MUTATOR_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <random>
 #include <vector>
 
 #include "./fuzzer/program.h"
+#include "./fuzzer/program_cache.h"
 
 namespace silifuzz {
 
 template <typename Arch>
 class ProgramMutator {
  public:
+  // Number of parsed inputs kept by default. See ProgramCache.
+  static constexpr size_t kDefaultCacheCapacity = 4096;
+
   ProgramMutator(uint64_t seed,
-                 size_t max_len = std::numeric_limits<size_t>::max())
-      : rng_(seed), max_len_(max_len) {}
+                 size_t max_len = std::numeric_limits<size_t>::max(),
+                 size_t cache_capacity = kDefaultCacheCapacity)
+      : rng_(seed), max_len_(max_len), cache_(cache_capacity) {}
 
   void Mutate(const std::vector<const std::vector<uint8_t> *> &inputs,
               size_t num_mutants, std::vector<std::vector<uint8_t>> &mutants);
 
+  const typename ProgramCache<Arch>::Stats &cache_stats() const {
+    return cache_.stats();
+  }
+
  private:
   void GenerateSingleOutput(const Program<Arch> &input,
                             std::vector<uint8_t> &output);
 
   MutatorRng rng_;
   size_t max_len_;
+  ProgramCache<Arch> cache_;
 };
 
 }  // namespace silifuzz
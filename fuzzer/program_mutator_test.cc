@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "./fuzzer/instruction_template.h"
 #include "./fuzzer/program.h"
 #include "./fuzzer/program_arch.h"
 #include "./fuzzer/program_mutation_ops.h"
@@ -463,6 +464,58 @@ TEST(InstructionFromBytes_AArch64, TNBZ) {
                                  32 * 1024 - 4);
 }
 
+template <typename Arch>
+void CheckInstructionTemplates() {
+  const InstructionTemplateTable<Arch>& templates =
+      GetInstructionTemplates<Arch>();
+  ASSERT_FALSE(templates.empty());
+  EXPECT_LE(templates.NumKeys(), templates.NumTemplates());
+
+  // Fixed seed for deterministic test.
+  MutatorRng rng(0);
+  constexpr size_t kNumCandidates = 10000;
+  size_t num_accepted = 0;
+  for (size_t i = 0; i < kNumCandidates; ++i) {
+    InstructionByteBuffer<Arch> bytes;
+    for (uint8_t& byte : bytes) byte = rng();
+    templates.Select(rng).Apply(bytes);
+    Instruction<Arch> instruction;
+    num_accepted += InstructionFromBytes(bytes, sizeof(bytes), instruction);
+  }
+  // Most candidates should be accepted.
+  EXPECT_GE(num_accepted, kNumCandidates / 2);
+}
+
+template <typename Arch>
+void CheckGenerateRandomInstruction() {
+  // Fixed seed for deterministic test.
+  MutatorRng rng(0);
+  for (size_t i = 0; i < 10000; ++i) {
+    Instruction<Arch> instruction;
+    ASSERT_TRUE(GenerateRandomInstruction(rng, instruction));
+    Instruction<Arch> decoded;
+    EXPECT_TRUE(InstructionFromBytes(instruction.encoded.data(),
+                                     instruction.encoded.size(), decoded,
+                                     true));
+  }
+}
+
+TEST(InstructionTemplates_X86_64, MostlyAccepted) {
+  CheckInstructionTemplates<X86_64>();
+}
+
+TEST(InstructionTemplates_AArch64, MostlyAccepted) {
+  CheckInstructionTemplates<AArch64>();
+}
+
+TEST(GenerateRandomInstruction_X86_64, Accepted) {
+  CheckGenerateRandomInstruction<X86_64>();
+}
+
+TEST(GenerateRandomInstruction_AArch64, Accepted) {
+  CheckGenerateRandomInstruction<AArch64>();
+}
+
 template <typename Arch>
 std::vector<uint8_t> ToBytes(Program<Arch>& program) {
   MutatorRng rng;
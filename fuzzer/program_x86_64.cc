@@ -16,6 +16,7 @@
 #include <cstdint>
 
 #include "absl/log/check.h"
+#include "./fuzzer/instruction_template.h"
 #include "./fuzzer/program.h"
 #include "./fuzzer/program_arch.h"  // IWYU pragma: keep
 #include "./instruction/xed_util.h"
@@ -95,6 +96,160 @@ void ReencodeInternal(const xed_state_t& dstate, Instruction<X86_64>& insn) {
   // this point.
 }
 
+// Decodes `bytes` and returns true if we accept the instruction.
+bool DecodeAccepted(const InstructionByteBuffer<X86_64>& bytes,
+                    xed_decoded_inst_t& xedd) {
+  xed_decoded_inst_zero(&xedd);
+  xed_decoded_inst_set_mode(&xedd, XED_MACHINE_MODE_LONG_64,
+                            XED_ADDRESS_WIDTH_64b);
+  return xed_decode(&xedd, bytes, sizeof(bytes)) == XED_ERROR_NONE &&
+         AcceptInstruction(xedd);
+}
+
+// The fixed leading bytes of an encoding template.
+struct EncodingPattern {
+  InstructionTemplate<X86_64> instruction_template = {};
+  size_t size = 0;
+
+  void Append(uint8_t bits, uint8_t mask = 0xff) {
+    instruction_template.bits[size] = bits & mask;
+    instruction_template.mask[size] = mask;
+    ++size;
+  }
+};
+
+// Adds `pattern` to `table`, keyed by iform, if its representative encoding is
+// accepted. The representative has all the free bits cleared.
+bool AddIfAccepted(const EncodingPattern& pattern,
+                   InstructionTemplateTable<X86_64>& table) {
+  xed_decoded_inst_t xedd;
+  if (!DecodeAccepted(pattern.instruction_template.bits, xedd)) return false;
+  table.Add(xed_decoded_inst_get_iform_enum(&xedd),
+            pattern.instruction_template);
+  return true;
+}
+
+// Adds templates for the opcode that ends `opcode`. If the opcode takes a
+// ModRM byte, adds one template per ModRM.reg value for register operands
+// (mod = 3) and for memory operands (mod = 0 or 1, i.e. with or without an
+// 8-bit displacement) since those often select different instructions.
+// Returns true if any template was added.
+bool AddOpcodeTemplates(const EncodingPattern& opcode,
+                        InstructionTemplateTable<X86_64>& table) {
+  // Find any ModRM byte the opcode decodes with to learn if it takes one.
+  xed_decoded_inst_t xedd;
+  bool decodes = false;
+  for (int modrm = 0; modrm < 256 && !decodes; modrm += 8) {
+    EncodingPattern probe = opcode;
+    probe.Append(modrm);
+    xed_decoded_inst_zero(&xedd);
+    xed_decoded_inst_set_mode(&xedd, XED_MACHINE_MODE_LONG_64,
+                              XED_ADDRESS_WIDTH_64b);
+    decodes = xed_decode(&xedd, probe.instruction_template.bits,
+                         sizeof(probe.instruction_template.bits)) ==
+              XED_ERROR_NONE;
+  }
+  if (!decodes) return false;
+  if (!xed_operand_values_has_modrm_byte(
+          xed_decoded_inst_operands_const(&xedd))) {
+    return AddIfAccepted(opcode, table);
+  }
+
+  bool added = false;
+  for (uint8_t reg = 0; reg < 8; ++reg) {
+    EncodingPattern register_form = opcode;
+    register_form.Append(0b11'000'000 | reg << 3, 0b11'111'000);
+    added |= AddIfAccepted(register_form, table);
+    EncodingPattern memory_form = opcode;
+    memory_form.Append(reg << 3, 0b10'111'000);
+    added |= AddIfAccepted(memory_form, table);
+  }
+  return added;
+}
+
+// Returns true if `byte` is a prefix or escape rather than an opcode in the
+// one-byte opcode map.
+bool IsPrefixOrEscape(uint8_t byte) {
+  switch (byte) {
+    case 0x0f:  // Two-byte escape.
+    case 0x26:  // Segment overrides.
+    case 0x2e:
+    case 0x36:
+    case 0x3e:
+    case 0x64:
+    case 0x65:
+    case 0x62:  // EVEX.
+    case 0x66:  // Operand and address size overrides.
+    case 0x67:
+    case 0xc4:  // VEX.
+    case 0xc5:
+    case 0xf0:  // LOCK.
+    case 0xf2:  // REPNE and REP.
+    case 0xf3:
+      return true;
+    default:
+      // REX.
+      return (byte & 0xf0) == 0x40;
+  }
+}
+
+// Enumerates the legacy and VEX opcode maps. Free bits cover the operands:
+// register numbers, the ModRM.rm field, REX.WRXB, VEX.RXB, VEX.W, VEX.vvvv
+// where the instruction allows it, displacements and immediates.
+// EVEX encodings and multiple legacy prefixes are not covered.
+InstructionTemplateTable<X86_64> BuildInstructionTemplates() {
+  InstructionTemplateTable<X86_64> table;
+
+  // Legacy encodings: [mandatory prefix] [REX] [escape] opcode [ModRM]
+  constexpr uint8_t kNoPrefix = 0;
+  constexpr uint8_t kMandatoryPrefixes[] = {kNoPrefix, 0x66, 0xf2, 0xf3};
+  constexpr struct {
+    uint8_t size;
+    uint8_t bytes[2];
+  } kEscapes[] = {{0, {}}, {1, {0x0f}}, {2, {0x0f, 0x38}}, {2, {0x0f, 0x3a}}};
+  for (uint8_t prefix : kMandatoryPrefixes) {
+    for (bool rex : {false, true}) {
+      for (const auto& escape : kEscapes) {
+        for (int opcode = 0; opcode < 256; ++opcode) {
+          if (escape.size == 0 && IsPrefixOrEscape(opcode)) continue;
+          if (escape.size == 1 && (opcode == 0x38 || opcode == 0x3a)) continue;
+          EncodingPattern pattern;
+          if (prefix != kNoPrefix) pattern.Append(prefix);
+          if (rex) pattern.Append(0x40, 0xf0);
+          for (size_t i = 0; i < escape.size; ++i) {
+            pattern.Append(escape.bytes[i]);
+          }
+          pattern.Append(opcode);
+          AddOpcodeTemplates(pattern, table);
+        }
+      }
+    }
+  }
+
+  // VEX encodings: C4 RXBmmmmm WvvvvLpp opcode [ModRM]
+  for (uint8_t map = 1; map <= 3; ++map) {
+    for (uint8_t pp = 0; pp < 4; ++pp) {
+      for (uint8_t l = 0; l < 2; ++l) {
+        for (int opcode = 0; opcode < 256; ++opcode) {
+          EncodingPattern pattern;
+          pattern.Append(0xc4);
+          pattern.Append(map, 0b000'11111);
+          EncodingPattern free_vvvv = pattern;
+          free_vvvv.Append(l << 2 | pp, 0b0'0000'111);
+          free_vvvv.Append(opcode);
+          if (AddOpcodeTemplates(free_vvvv, table)) continue;
+          // Many instructions do not use VEX.vvvv and require it to be 1111.
+          EncodingPattern unused_vvvv = pattern;
+          unused_vvvv.Append(0b0'1111'000 | l << 2 | pp, 0b0'1111'111);
+          unused_vvvv.Append(opcode);
+          AddOpcodeTemplates(unused_vvvv, table);
+        }
+      }
+    }
+  }
+  return table;
+}
+
 }  // namespace
 
 template <>
@@ -180,4 +335,13 @@ bool TryToReencodeInstructionDisplacements(Instruction<X86_64>& insn) {
   return true;
 }
 
+template <>
+const InstructionTemplateTable<X86_64>& GetInstructionTemplates() {
+  static const InstructionTemplateTable<X86_64>* const table = [] {
+    InitXedIfNeeded();
+    return new InstructionTemplateTable<X86_64>(BuildInstructionTemplates());
+  }();
+  return *table;
+}
+
 }  // namespace silifuzz
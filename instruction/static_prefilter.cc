@@ -0,0 +1,124 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./instruction/static_prefilter.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+#include "absl/strings/string_view.h"
+#include "./instruction/static_insn_filter.h"
+#include "./instruction/xed_util.h"
+#include "./util/arch.h"
+#include "./util/itoa.h"
+
+extern "C" {
+#include "third_party/libxed/xed-interface.h"
+}
+
+namespace silifuzz {
+
+template <>
+ABSL_CONST_INIT const char* EnumNameMap<StaticPrefilterVerdict>[6] = {
+    "accept",
+    "problematic-instruction",
+    "syscall",
+    "io-instruction",
+    "privileged-instruction",
+    "non-deterministic-instruction",
+};
+
+namespace {
+
+StaticPrefilterVerdict CheckInstruction(const xed_decoded_inst_t& xedd) {
+  const xed_category_enum_t category = xed_decoded_inst_get_category(&xedd);
+  if (category == XED_CATEGORY_SYSCALL ||
+      xed_decoded_inst_get_iclass(&xedd) == XED_ICLASS_INT) {
+    return StaticPrefilterVerdict::kSyscall;
+  }
+  if (InstructionRequiresIOPrivileges(xedd)) {
+    return StaticPrefilterVerdict::kIOInstruction;
+  }
+  if (!InstructionCanRunInUserSpace(xedd)) {
+    return StaticPrefilterVerdict::kPrivilegedInstruction;
+  }
+  if (!InstructionIsDeterministicInRunner(xedd)) {
+    return StaticPrefilterVerdict::kNonDeterministicInstruction;
+  }
+  return StaticPrefilterVerdict::kAccept;
+}
+
+// Returns true if the instruction may continue execution somewhere other than
+// the next instruction.
+bool IsControlTransfer(const xed_decoded_inst_t& xedd) {
+  switch (xed_decoded_inst_get_category(&xedd)) {
+    case XED_CATEGORY_COND_BR:
+    case XED_CATEGORY_UNCOND_BR:
+    case XED_CATEGORY_CALL:
+    case XED_CATEGORY_RET:
+    case XED_CATEGORY_INTERRUPT:
+    case XED_CATEGORY_SYSCALL:
+    case XED_CATEGORY_SYSRET:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+template <>
+StaticPrefilterVerdict StaticPrefilter<X86_64>(
+    absl::string_view code, const InstructionFilterConfig<X86_64>& config) {
+  if (!StaticInstructionFilter<X86_64>(code, config)) {
+    return StaticPrefilterVerdict::kProblematicInstruction;
+  }
+  InitXedIfNeeded();
+
+  // Decode the straight-line prefix of `code`. Every instruction in it runs
+  // unless an earlier one ends the snapshot, which fails making too. Stop at
+  // the first undecodable instruction: XED may not know about all
+  // instructions the CPU supports.
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(code.data());
+  size_t offset = 0;
+  while (offset < code.size()) {
+    xed_decoded_inst_t xedd;
+    xed_decoded_inst_zero(&xedd);
+    xed_decoded_inst_set_mode(&xedd, XED_MACHINE_MODE_LONG_64,
+                              XED_ADDRESS_WIDTH_64b);
+    if (xed_decode(&xedd, bytes + offset, code.size() - offset) !=
+        XED_ERROR_NONE) {
+      break;
+    }
+    const StaticPrefilterVerdict verdict = CheckInstruction(xedd);
+    if (verdict != StaticPrefilterVerdict::kAccept) return verdict;
+    if (IsControlTransfer(xedd)) break;
+    offset += xed_decoded_inst_get_length(&xedd);
+  }
+  return StaticPrefilterVerdict::kAccept;
+}
+
+// StaticInstructionFilter() already rejects every aarch64 instruction that is
+// known to fail making, wherever it is in `code`.
+template <>
+StaticPrefilterVerdict StaticPrefilter<AArch64>(
+    absl::string_view code, const InstructionFilterConfig<AArch64>& config) {
+  if (!StaticInstructionFilter<AArch64>(code, config)) {
+    return StaticPrefilterVerdict::kProblematicInstruction;
+  }
+  return StaticPrefilterVerdict::kAccept;
+}
+
+}  // namespace silifuzz
@@ -0,0 +1,59 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_INSTRUCTION_STATIC_PREFILTER_H_
+#define THIRD_PARTY_SILIFUZZ_INSTRUCTION_STATIC_PREFILTER_H_
+
+#include "absl/strings/string_view.h"
+#include "./instruction/static_insn_filter.h"
+#include "./util/itoa.h"
+
+namespace silifuzz {
+
+// Verdict of StaticPrefilter().
+enum class StaticPrefilterVerdict {
+  kAccept = 0,
+  // Rejected by StaticInstructionFilter().
+  kProblematicInstruction,
+  // Makes a system call.
+  kSyscall,
+  // Needs I/O privileges the runner does not have.
+  kIOInstruction,
+  // Can only run in kernel mode.
+  kPrivilegedInstruction,
+  // Not deterministic in the runner. See InstructionIsDeterministicInRunner().
+  kNonDeterministicInstruction,
+};
+
+// EnumStr() works for StaticPrefilterVerdict. The names are suitable for use
+// in counter names.
+template <>
+extern const char* EnumNameMap<StaticPrefilterVerdict>[6];
+
+// Decides if the instruction sequence `code` cannot possibly be made into a
+// snapshot without running it. This is meant to be run ahead of the making
+// pipeline to save runner invocations for sequences that would be rejected
+// anyway.
+//
+// Unlike StaticInstructionFilter(), which it applies first, this function only
+// rejects `code` if it is certain to fail making with the default making
+// config: on x86_64, only the instructions up to the first control transfer
+// are inspected as those are certain to run.
+template <typename Arch>
+StaticPrefilterVerdict StaticPrefilter(
+    absl::string_view code, const InstructionFilterConfig<Arch>& config = {});
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_INSTRUCTION_STATIC_PREFILTER_H_
@@ -0,0 +1,104 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./instruction/static_prefilter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "./util/arch.h"
+#include "./util/itoa.h"
+
+namespace silifuzz {
+
+namespace {
+
+std::string FromBytes(std::vector<uint8_t>&& data) {
+  return std::string(data.begin(), data.end());
+}
+
+std::string FromInts(std::vector<uint32_t>&& data) {
+  return std::string(reinterpret_cast<char*>(&*data.begin()),
+                     reinterpret_cast<char*>(&*data.end()));
+}
+
+#define EXPECT_X86_64_PREFILTER(insn, verdict) \
+  EXPECT_EQ(StaticPrefilter<X86_64>(insn), verdict)
+
+#define EXPECT_AARCH64_PREFILTER(insn, verdict) \
+  EXPECT_EQ(StaticPrefilter<AArch64>(insn), verdict)
+
+TEST(StaticPrefilter, X86_64Accept) {
+  // nop
+  EXPECT_X86_64_PREFILTER(FromBytes({0x90}), StaticPrefilterVerdict::kAccept);
+  // Empty.
+  EXPECT_X86_64_PREFILTER(std::string(), StaticPrefilterVerdict::kAccept);
+  // Truncated instruction.
+  EXPECT_X86_64_PREFILTER(FromBytes({0x0f}), StaticPrefilterVerdict::kAccept);
+}
+
+TEST(StaticPrefilter, X86_64Reject) {
+  // syscall
+  EXPECT_X86_64_PREFILTER(FromBytes({0x0f, 0x05}),
+                          StaticPrefilterVerdict::kSyscall);
+  // int 0x80
+  EXPECT_X86_64_PREFILTER(FromBytes({0xcd, 0x80}),
+                          StaticPrefilterVerdict::kSyscall);
+  // in al, dx
+  EXPECT_X86_64_PREFILTER(FromBytes({0xec}),
+                          StaticPrefilterVerdict::kIOInstruction);
+  // hlt
+  EXPECT_X86_64_PREFILTER(FromBytes({0xf4}),
+                          StaticPrefilterVerdict::kPrivilegedInstruction);
+  // rdtsc
+  EXPECT_X86_64_PREFILTER(FromBytes({0x0f, 0x31}),
+                          StaticPrefilterVerdict::kNonDeterministicInstruction);
+  // nop; cpuid
+  EXPECT_X86_64_PREFILTER(FromBytes({0x90, 0x0f, 0xa2}),
+                          StaticPrefilterVerdict::kNonDeterministicInstruction);
+}
+
+TEST(StaticPrefilter, X86_64StopsAtControlTransfer) {
+  // je .+2; rdtsc
+  EXPECT_X86_64_PREFILTER(FromBytes({0x74, 0x02, 0x0f, 0x31}),
+                          StaticPrefilterVerdict::kAccept);
+  // Undecodable bytes are not skipped over.
+  // push es (invalid in 64-bit mode); rdtsc
+  EXPECT_X86_64_PREFILTER(FromBytes({0x06, 0x0f, 0x31}),
+                          StaticPrefilterVerdict::kAccept);
+}
+
+TEST(StaticPrefilter, AArch64) {
+  // nop
+  EXPECT_AARCH64_PREFILTER(FromInts({0xd503201f}),
+                           StaticPrefilterVerdict::kAccept);
+  // mrs x0, tpidr_el1
+  EXPECT_AARCH64_PREFILTER(FromInts({0xd538d080}),
+                           StaticPrefilterVerdict::kProblematicInstruction);
+  // Not a whole number of instructions.
+  EXPECT_AARCH64_PREFILTER("abc",
+                           StaticPrefilterVerdict::kProblematicInstruction);
+}
+
+TEST(StaticPrefilter, EnumStr) {
+  EXPECT_STREQ(EnumStr(StaticPrefilterVerdict::kAccept), "accept");
+  EXPECT_STREQ(EnumStr(StaticPrefilterVerdict::kNonDeterministicInstruction),
+               "non-deterministic-instruction");
+}
+
+}  // namespace
+
+}  // namespace silifuzz
@@ -73,6 +73,12 @@ class XedDisassembler : public Disassembler {
   // A human-readable name for the instruction ID.
   [[nodiscard]] std::string InstructionIDName(uint32_t id) const override;
 
+  // The XED decoding of the last instruction that was disassembled. Only
+  // meaningful if the last call to Disassemble succeeded.
+  [[nodiscard]] const xed_decoded_inst_t& DecodedInstruction() const {
+    return xedd_;
+  }
+
  private:
   xed_decoded_inst_t xedd_;
   uint64_t address_;
@@ -23,6 +23,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
 #include <utility>
@@ -35,6 +36,7 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "third_party/liblzma/lzma.h"
 #include "./snap/snap.h"
@@ -50,6 +52,8 @@ namespace silifuzz {
 
 namespace {
 
+constexpr size_t kChunkSize = 1 << 20;  // 1MB
+
 // Writes data in `cord` to file with descriptor `fd` and returns status.
 absl::Status WriteCord(const absl::Cord& cord, int fd) {
   for (const auto& chunk : cord.Chunks()) {
@@ -61,26 +65,54 @@ absl::Status WriteCord(const absl::Cord& cord, int fd) {
   return absl::OkStatus();
 }
 
-// Returns contents for file with descriptor `fd` as a Cord or a status.
+// Passes contents of file with descriptor `fd` to `consume` in chunks.
 // This reads starting from the current file offset.
-absl::StatusOr<absl::Cord> ReadCord(int fd) {
-  constexpr size_t kChunkSize = 1 << 20;  // 1MB
+absl::Status ReadChunks(int fd, ChunkConsumer consume) {
   std::string buffer(kChunkSize, 0);
   ssize_t bytes_read;
-  absl::Cord cord;
   while ((bytes_read = Read(fd, buffer.data(), buffer.size())) > 0) {
-    cord.Append(absl::string_view(buffer.data(), bytes_read));
+    RETURN_IF_NOT_OK(consume(absl::string_view(buffer.data(), bytes_read)));
   }
   if (bytes_read < 0) {
     // If Read() returns a negative number, there is an error.
     return absl::ErrnoToStatus(errno, "read()");
   }
-  return cord;
+  return absl::OkStatus();
+}
+
+// Creates an empty mem file that can be sealed.
+absl::StatusOr<OwnedFileDescriptor> CreateSharedMemoryFile(
+    absl::string_view name) {
+  int memfd = memfd_create(std::string(name).c_str(),
+                           O_RDWR | MFD_ALLOW_SEALING | MFD_CLOEXEC);
+  if (memfd == -1) {
+    return absl::ErrnoToStatus(errno, "memfd_create()");
+  }
+  return OwnedFileDescriptor(memfd);
+}
+
+// Seals mem file `fd` to protect it from modification and rewinds it.
+absl::Status SealSharedMemoryFile(int fd, absl::string_view name) {
+  // Seal file after write to prevent modification of its contents and seals.
+  // There appears to be a kernel bug that happens with large enough number of
+  // concurrent threads calling fcntl(2). The bug manifests as fcntl returning
+  // errno=EBUSY when passed F_SEAL_WRITE.
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW) != 0) {
+    return absl::ErrnoToStatus(errno,
+                               absl::StrCat("fcntl(F_ADD_SEALS): ", name));
+  }
+
+  // Move file descriptor to beginning of file.
+  if (lseek(fd, 0, SEEK_SET) != 0) {
+    return absl::ErrnoToStatus(errno, "lseek()");
+  }
+  return absl::OkStatus();
 }
 
 }  // namespace
 
-absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
+absl::Status DecompressXzipFile(const std::string& path,
+                                ChunkConsumer consume) {
   lzma_stream decompressed_stream = LZMA_STREAM_INIT;
   lzma_ret ret = lzma_stream_decoder(
       &decompressed_stream, lzma_easy_decoder_memusage(9 /* level */), 0);
@@ -89,11 +121,8 @@ absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
         absl::StrCat("Failed to initialize decoder, return code =", ret));
   }
 
-  constexpr size_t kInputChunkSize = 1 << 20;
-  std::vector<uint8_t> input_buffer(kInputChunkSize);
-
-  constexpr size_t kOutputChunkSize = 1 << 20;
-  std::vector<uint8_t> output_buffer(kOutputChunkSize);
+  std::vector<uint8_t> input_buffer(kChunkSize);
+  std::vector<uint8_t> output_buffer(kChunkSize);
   decompressed_stream.avail_out = output_buffer.size();
   decompressed_stream.next_out = output_buffer.data();
 
@@ -110,7 +139,6 @@ absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
         absl::StrCat("Failed to open compressed file ", path));
   }
 
-  absl::Cord decompressed_data;
   bool input_eof_seen = false;
   do {
     // Refill input buffer if empty.
@@ -133,13 +161,12 @@ absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
     ret = lzma_code(&decompressed_stream,
                     input_eof_seen ? LZMA_FINISH : LZMA_RUN);
 
-    // Append data to cord if output buffer is full or if decompressed stream
-    // ends.
+    // Pass data on if output buffer is full or if decompressed stream ends.
     if (decompressed_stream.avail_out == 0 || ret == LZMA_STREAM_END) {
       absl::string_view chunk(
           reinterpret_cast<char*>(output_buffer.data()),
           output_buffer.size() - decompressed_stream.avail_out);
-      decompressed_data.Append(chunk);
+      RETURN_IF_NOT_OK(consume(chunk));
       decompressed_stream.avail_out = output_buffer.size();
       decompressed_stream.next_out = output_buffer.data();
     }
@@ -173,34 +200,25 @@ absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
   }
 
   // Data looks OK.
+  return absl::OkStatus();
+}
+
+absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path) {
+  absl::Cord decompressed_data;
+  RETURN_IF_NOT_OK(
+      DecompressXzipFile(path, [&decompressed_data](absl::string_view chunk) {
+        decompressed_data.Append(chunk);
+        return absl::OkStatus();
+      }));
   return decompressed_data;
 }
 
 absl::StatusOr<OwnedFileDescriptor> WriteSharedMemoryFile(
     const absl::Cord& contents, absl::string_view name) {
-  int memfd = memfd_create(std::string(name).c_str(),
-                           O_RDWR | MFD_ALLOW_SEALING | MFD_CLOEXEC);
-  if (memfd == -1) {
-    return absl::ErrnoToStatus(errno, "memfd_create()");
-  }
-  OwnedFileDescriptor owned_fd(memfd);
-  int fd = owned_fd.borrow();
-  RETURN_IF_NOT_OK(WriteCord(contents, fd));
-
-  // Seal file after write to prevent modification of its contents and seals.
-  // There appears to be a kernel bug that happens with large enough number of
-  // concurrent threads calling fcntl(2). The bug manifests as fcntl returning
-  // errno=EBUSY when passed F_SEAL_WRITE.
-  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW) != 0) {
-    return absl::ErrnoToStatus(errno,
-                               absl::StrCat("fcntl(F_ADD_SEALS): ", name));
-  }
-
-  // Move file descriptor to beginning of file.
-  if (lseek(fd, 0, SEEK_SET) != 0) {
-    return absl::ErrnoToStatus(errno, "lseek()");
-  }
-
+  ASSIGN_OR_RETURN_IF_NOT_OK(OwnedFileDescriptor owned_fd,
+                             CreateSharedMemoryFile(name));
+  RETURN_IF_NOT_OK(WriteCord(contents, owned_fd.borrow()));
+  RETURN_IF_NOT_OK(SealSharedMemoryFile(owned_fd.borrow(), name));
   return owned_fd;
 }
 
@@ -212,12 +230,42 @@ constexpr const absl::string_view kXzExtension = ".xz";
 
 absl::StatusOr<InMemoryShard> LoadCorpus(const std::string& path) {
   std::string name = absl::StrCat(Basename(path));
-
-  absl::Cord contents;
-  if (absl::EndsWith(path, kXzExtension)) {
+  const bool compressed = absl::EndsWith(path, kXzExtension);
+  if (compressed) {
     // Clip .xz the extension from the file name.
     name = name.substr(0, name.size() - kXzExtension.size());
-    ASSIGN_OR_RETURN_IF_NOT_OK(contents, ReadXzipFile(path));
+  }
+
+  // Set linked name in /proc/self/fd/ for ease of debugging.
+  ASSIGN_OR_RETURN_IF_NOT_OK(OwnedFileDescriptor owned_fd,
+                             CreateSharedMemoryFile(name));
+
+  // Contents are written to the mem file as they are read so that the whole
+  // shard is never held in a buffer. The header and checksum are computed on
+  // the way.
+  std::string header_bytes;
+  CorpusChecksumCalculator checksum;
+  uint64_t file_size = 0;
+  auto consume = [&](absl::string_view chunk) -> absl::Status {
+    if (header_bytes.size() < sizeof(SnapCorpusHeader)) {
+      // Will be truncated if the contents are too short.
+      const size_t header_remaining =
+          sizeof(SnapCorpusHeader) - header_bytes.size();
+      header_bytes.append(chunk.data(),
+                          std::min(chunk.size(), header_remaining));
+    }
+    checksum.AddData(chunk);
+    file_size += chunk.size();
+    if (Write(owned_fd.borrow(), chunk.data(), chunk.size()) !=
+        static_cast<ssize_t>(chunk.size())) {
+      // Write() handles EINTR, so it is an error if it cannot complete.
+      return absl::ErrnoToStatus(errno, "write()");
+    }
+    return absl::OkStatus();
+  };
+
+  if (compressed) {
+    RETURN_IF_NOT_OK(DecompressXzipFile(path, consume));
   } else {
     // Assume this is an uncompressed corpus.
     int fd = open(path.c_str(), O_RDONLY);
@@ -225,21 +273,9 @@ absl::StatusOr<InMemoryShard> LoadCorpus(const std::string& path) {
       return absl::ErrnoToStatus(errno, absl::StrCat("open(): ", path));
     }
     absl::Cleanup file_closer = absl::MakeCleanup([fd] { close(fd); });
-    ASSIGN_OR_RETURN_IF_NOT_OK(contents, ReadCord(fd));
+    RETURN_IF_NOT_OK(ReadChunks(fd, consume));
   }
-
-  // Will be truncated if the contents are too short.
-  std::string header_bytes(contents.Subcord(0, sizeof(SnapCorpusHeader)));
-
-  // Calculate checksum.
-  CorpusChecksumCalculator checksum;
-  for (absl::string_view chunk : contents.Chunks()) {
-    checksum.AddData(chunk);
-  }
-
-  // Set linked name in /proc/self/fd/ for ease of debugging.
-  ASSIGN_OR_RETURN_IF_NOT_OK(OwnedFileDescriptor owned_fd,
-                             WriteSharedMemoryFile(contents, name));
+  RETURN_IF_NOT_OK(SealSharedMemoryFile(owned_fd.borrow(), name));
 
   std::string file_path = FilePathForFD(owned_fd);
 
@@ -248,7 +284,7 @@ absl::StatusOr<InMemoryShard> LoadCorpus(const std::string& path) {
       .file_path = std::move(file_path),
       .name = std::move(name),
       .header_bytes = std::move(header_bytes),
-      .file_size = contents.size(),
+      .file_size = file_size,
       .checksum = checksum.Checksum(),
   };
 }
@@ -358,4 +394,114 @@ absl::Status ValidateCorpus(const InMemoryCorpora& corpora) {
   return absl::OkStatus();
 }
 
+ShardCache::ShardCache(std::vector<std::string> corpus_paths,
+                       size_t max_resident_shards)
+    : corpus_paths_(std::move(corpus_paths)),
+      max_resident_shards_(max_resident_shards),
+      entries_(corpus_paths_.size()) {}
+
+absl::StatusOr<std::shared_ptr<const InMemoryShard>> ShardCache::Get(
+    size_t index) {
+  CHECK_LT(index, corpus_paths_.size());
+  mu_.Lock();
+  Entry* entry = &entries_[index];
+  while (true) {
+    if (entry->shard != nullptr) {
+      std::shared_ptr<const InMemoryShard> shard = Acquire(*entry);
+      mu_.Unlock();
+      return shard;
+    }
+    if (!entry->loading && MakeRoom()) break;
+    changed_.Wait(&mu_);
+  }
+  entry->loading = true;
+  // Count the shard as resident while it is loading, it takes up memory.
+  ++num_resident_;
+  mu_.Unlock();
+
+  // Load outside of the lock so that other shards can be loaded and used in
+  // the meantime.
+  absl::StatusOr<InMemoryShard> loaded = LoadCorpus(corpus_paths_[index]);
+  absl::Status status = loaded.status();
+  if (status.ok()) {
+    status = ValidateShard(*loaded);
+  }
+
+  absl::MutexLock l(&mu_);
+  entry->loading = false;
+  changed_.SignalAll();
+  if (!status.ok()) {
+    --num_resident_;
+    if (status_.ok()) status_ = status;
+    return status;
+  }
+  ++num_loads_;
+  if (entry->loaded_before) {
+    ++num_reloads_;
+    VLOG_INFO(1, "Reloaded corpus ", loaded->name, " as ", loaded->file_path);
+  } else {
+    VLOG_INFO(1, "Loaded corpus ", loaded->name, " as ", loaded->file_path);
+  }
+  entry->loaded_before = true;
+  entry->shard = std::make_shared<const InMemoryShard>(*std::move(loaded));
+  return Acquire(*entry);
+}
+
+bool ShardCache::MakeRoom() {
+  if (max_resident_shards_ == 0) return true;
+  while (num_resident_ >= max_resident_shards_) {
+    Entry* victim = nullptr;
+    for (Entry& entry : entries_) {
+      if (entry.shard != nullptr && entry.num_users == 0 &&
+          (victim == nullptr || entry.last_used < victim->last_used)) {
+        victim = &entry;
+      }
+    }
+    if (victim == nullptr) return false;
+    VLOG_INFO(1, "Dropping corpus ", victim->shard->name);
+    victim->shard.reset();
+    --num_resident_;
+  }
+  return true;
+}
+
+std::shared_ptr<const InMemoryShard> ShardCache::Acquire(Entry& entry) {
+  entry.last_used = ++clock_;
+  ++entry.num_users;
+  // The deleter keeps its own reference so that the shard outlives the
+  // returned pointer even if `entry` changes.
+  std::shared_ptr<const InMemoryShard> shard = entry.shard;
+  return std::shared_ptr<const InMemoryShard>(
+      shard.get(), [this, &entry, shard](const InMemoryShard*) mutable {
+        shard.reset();
+        Release(entry);
+      });
+}
+
+void ShardCache::Release(Entry& entry) {
+  absl::MutexLock l(&mu_);
+  --entry.num_users;
+  changed_.SignalAll();
+}
+
+absl::Status ShardCache::status() const {
+  absl::MutexLock l(&mu_);
+  return status_;
+}
+
+size_t ShardCache::num_loads() const {
+  absl::MutexLock l(&mu_);
+  return num_loads_;
+}
+
+size_t ShardCache::num_reloads() const {
+  absl::MutexLock l(&mu_);
+  return num_reloads_;
+}
+
+size_t ShardCache::num_resident() const {
+  absl::MutexLock l(&mu_);
+  return num_resident_;
+}
+
 }  // namespace silifuzz
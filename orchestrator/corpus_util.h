@@ -14,15 +14,21 @@
 
 #ifndef THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_CORPUS_UTIL_H_
 #define THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_CORPUS_UTIL_H_
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 // Utility functions for the orchestrator to load corpora in shared memory.
 
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "./util/owned_file_descriptor.h"
 
 namespace silifuzz {
@@ -63,6 +69,15 @@ absl::Status ValidateCorpus(const InMemoryCorpora& corpora);
 // Exposed for testing.
 absl::Status ValidateShard(const InMemoryShard& shard);
 
+// Receives a chunk of a file's contents. Returns an error to stop reading.
+using ChunkConsumer = absl::FunctionRef<absl::Status(absl::string_view)>;
+
+// Decompresses an lzma compressed file and passes the decompressed contents
+// to `consume` in order, one chunk at a time. Returns an error status if the
+// file cannot be read or decompressed or if `consume` fails.
+absl::Status DecompressXzipFile(const std::string& path,
+                                ChunkConsumer consume);
+
 // Reads an lzma compressed file into memory.  Returns its contents in a cord or
 // an error status.
 absl::StatusOr<absl::Cord> ReadXzipFile(const std::string& path);
@@ -83,6 +98,8 @@ absl::StatusOr<OwnedFileDescriptor> WriteSharedMemoryFile(
 // file descriptor of a temp file containing uncompressed corpus contents in
 // RAM. LoadCorpus determines the decompression algorithm to use based on
 // suffix of `path`. Currently only .xz is recognized.
+// Contents are decompressed straight into the temp file, so loading needs
+// little memory beyond the uncompressed shard itself.
 absl::StatusOr<InMemoryShard> LoadCorpus(const std::string& path);
 
 // Reads and decompresses gzipped relocatable Snap corpora whose paths are in
@@ -96,6 +113,103 @@ absl::StatusOr<InMemoryShard> LoadCorpus(const std::string& path);
 absl::StatusOr<InMemoryCorpora> LoadCorpora(
     const std::vector<std::string>& corpus_paths);
 
+// Loads corpus shards on demand and keeps a bounded number of them in RAM.
+//
+// Get() loads a shard the first time it is requested, so runners can start on
+// the first shards while others are still being loaded. At most
+// `max_resident_shards` shards are loaded or being loaded at any time. To load
+// another one, the least recently used shard that is not in use is dropped
+// and will be loaded, i.e. decompressed, again if it is requested later.
+// Shards in use are never dropped. If all resident shards are in use, Get()
+// waits until one is released.
+//
+// Every shard is validated with ValidateShard() when it is loaded.
+//
+// This class is thread-safe.
+class ShardCache {
+ public:
+  // Constructs a cache for the shards at `corpus_paths`. A
+  // `max_resident_shards` of 0 means no limit.
+  ShardCache(std::vector<std::string> corpus_paths, size_t max_resident_shards);
+
+  // Not copyable or moveable.
+  ShardCache(const ShardCache&) = delete;
+  ShardCache& operator=(const ShardCache&) = delete;
+
+  // Number of shards.
+  size_t size() const { return corpus_paths_.size(); }
+
+  // Returns shard `index`, loading it if it is not in RAM. If another thread
+  // is loading the shard or there is no room for it, waits. The shard stays
+  // valid and in use as long as the caller holds the returned pointer.
+  //
+  // REQUIRES: index < size(). The caller must not hold another shard from
+  // this cache if that could leave no room for shard `index`.
+  absl::StatusOr<std::shared_ptr<const InMemoryShard>> Get(size_t index)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the error of the first failed load or OK if there was none.
+  absl::Status status() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of shards loaded so far, counting reloads.
+  size_t num_loads() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of loads of shards that had been loaded and dropped
+  // before.
+  size_t num_reloads() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of shards currently held or being loaded by the cache.
+  size_t num_resident() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Entry {
+    // The loaded shard or nullptr if it is not resident.
+    std::shared_ptr<const InMemoryShard> shard;
+
+    // True while a thread is loading this shard.
+    bool loading = false;
+
+    // Value of `clock_` when the shard was last returned by Get().
+    uint64_t last_used = 0;
+
+    // Number of pointers returned by Get() that are still held.
+    size_t num_users = 0;
+
+    // True iff the shard has been loaded before.
+    bool loaded_before = false;
+  };
+
+  // Drops least recently used shards that are not in use until there is room
+  // to load another one. Returns true iff there is room.
+  bool MakeRoom() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns a pointer to the resident shard of `entry` that releases it when
+  // the last copy is destroyed.
+  std::shared_ptr<const InMemoryShard> Acquire(Entry& entry)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Called when the last copy of a pointer returned by Acquire() is destroyed.
+  void Release(Entry& entry) ABSL_LOCKS_EXCLUDED(mu_);
+
+  const std::vector<std::string> corpus_paths_;
+  const size_t max_resident_shards_;
+
+  mutable absl::Mutex mu_;
+
+  // Signalled when a shard finishes loading or is released.
+  absl::CondVar changed_ ABSL_GUARDED_BY(mu_);
+
+  // Parallel to `corpus_paths_`. Never resized, Acquire() keeps references.
+  std::vector<Entry> entries_ ABSL_GUARDED_BY(mu_);
+
+  // Shards that are loaded or being loaded.
+  size_t num_resident_ ABSL_GUARDED_BY(mu_) = 0;
+  size_t num_loads_ ABSL_GUARDED_BY(mu_) = 0;
+  size_t num_reloads_ ABSL_GUARDED_BY(mu_) = 0;
+  uint64_t clock_ ABSL_GUARDED_BY(mu_) = 0;
+  absl::Status status_ ABSL_GUARDED_BY(mu_);
+};
+
 }  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_CORPUS_UTIL_H_
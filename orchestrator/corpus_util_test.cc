@@ -26,6 +26,8 @@
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -35,8 +37,13 @@
 #include "absl/strings/cord.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "./snap/snap.h"
+#include "./snap/snap_checksum.h"
 #include "./util/byte_io.h"
+#include "./util/checks.h"
 #include "./util/owned_file_descriptor.h"
 #include "./util/testing/status_macros.h"
 #include "./util/testing/status_matchers.h"
@@ -257,6 +264,113 @@ TEST(CorpusUtil, LoadCorporaUncompressed) {
   }
 }
 
+// Writes an uncompressed corpus that passes ValidateShard() to a temp file
+// named `name` and returns its path.
+std::string WriteValidCorpus(absl::string_view name) {
+  SnapCorpusHeader header{
+      .magic = kSnapCorpusMagic,
+      .header_size = sizeof(SnapCorpusHeader),
+      .num_bytes = sizeof(SnapCorpusHeader),
+  };
+  CorpusChecksumCalculator checksum;
+  checksum.AddData(&header, sizeof(header));
+  header.checksum = checksum.Checksum();
+
+  const std::string path = absl::StrCat(TempDir(), "/", name);
+  const int fd =
+      open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+  CHECK_NE(fd, -1);
+  CHECK_EQ(Write(fd, &header, sizeof(header)), sizeof(header));
+  CHECK_EQ(close(fd), 0);
+  return path;
+}
+
+TEST(ShardCache, LoadsOnDemand) {
+  ShardCache cache({WriteValidCorpus("LoadsOnDemand_0"),
+                    WriteValidCorpus("LoadsOnDemand_1")},
+                   0);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.num_loads(), 0);
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const InMemoryShard> shard,
+                       cache.Get(1));
+  EXPECT_EQ(shard->name, "LoadsOnDemand_1");
+  EXPECT_EQ(shard->file_size, sizeof(SnapCorpusHeader));
+  EXPECT_EQ(cache.num_loads(), 1);
+
+  // Already loaded.
+  EXPECT_THAT(cache.Get(1), IsOkAndHolds(shard));
+  EXPECT_EQ(cache.num_loads(), 1);
+  EXPECT_EQ(cache.num_resident(), 1);
+  EXPECT_OK(cache.status());
+}
+
+TEST(ShardCache, DropsLeastRecentlyUsed) {
+  ShardCache cache(
+      {WriteValidCorpus("DropsLRU_0"), WriteValidCorpus("DropsLRU_1"),
+       WriteValidCorpus("DropsLRU_2")},
+      2);
+  ASSERT_OK(cache.Get(0).status());
+  ASSERT_OK(cache.Get(1).status());
+  // Make shard 1 the least recently used one.
+  ASSERT_OK(cache.Get(0).status());
+  ASSERT_OK(cache.Get(2).status());
+  EXPECT_EQ(cache.num_loads(), 3);
+  EXPECT_EQ(cache.num_resident(), 2);
+
+  // Shard 0 is still resident, shard 1 is not.
+  ASSERT_OK(cache.Get(0).status());
+  EXPECT_EQ(cache.num_loads(), 3);
+  EXPECT_EQ(cache.num_reloads(), 0);
+  ASSERT_OK(cache.Get(1).status());
+  EXPECT_EQ(cache.num_loads(), 4);
+  EXPECT_EQ(cache.num_reloads(), 1);
+  EXPECT_EQ(cache.num_resident(), 2);
+}
+
+TEST(ShardCache, KeepsShardsInUse) {
+  ShardCache cache(
+      {WriteValidCorpus("KeepsInUse_0"), WriteValidCorpus("KeepsInUse_1")},
+      1);
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const InMemoryShard> shard0,
+                       cache.Get(0));
+  EXPECT_OK(CheckFileContents(
+      shard0->file_descriptor.borrow(),
+      std::string(shard0->header_bytes.data(), shard0->header_bytes.size())));
+
+  // The cache is full and shard 0 is in use, so this waits until shard 0 is
+  // released.
+  std::shared_ptr<const InMemoryShard> shard1;
+  std::thread getter([&cache, &shard1] {
+    absl::StatusOr<std::shared_ptr<const InMemoryShard>> shard = cache.Get(1);
+    CHECK_STATUS(shard.status());
+    shard1 = *std::move(shard);
+  });
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_EQ(cache.num_loads(), 1);
+  EXPECT_EQ(cache.num_resident(), 1);
+
+  shard0.reset();
+  getter.join();
+  EXPECT_EQ(shard1->name, "KeepsInUse_1");
+  EXPECT_EQ(cache.num_loads(), 2);
+  EXPECT_EQ(cache.num_resident(), 1);
+}
+
+TEST(ShardCache, InvalidShard) {
+  const std::string path = absl::StrCat(TempDir(), "/InvalidShard");
+  const int fd =
+      open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(Write(fd, "one\n", 4), 4);
+  ASSERT_EQ(close(fd), 0);
+
+  ShardCache cache({path}, 0);
+  EXPECT_THAT(cache.Get(0), StatusIs(absl::StatusCode::kOutOfRange));
+  EXPECT_THAT(cache.status(), StatusIs(absl::StatusCode::kOutOfRange));
+  EXPECT_EQ(cache.num_resident(), 0);
+}
+
 class ValidateShardTest : public ::testing::Test {
  protected:
   void SetUp() override {
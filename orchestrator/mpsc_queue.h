@@ -0,0 +1,127 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_MPSC_QUEUE_H_
+#define THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace silifuzz {
+
+// A bounded lock-free queue with any number of producers and a single
+// consumer.
+//
+// Each slot carries a sequence number that tells producers and the consumer
+// whose turn it is to use the slot, so neither side ever takes a lock.
+// Producers claim a slot by advancing the shared enqueue position with a
+// compare-and-swap. See Dmitry Vyukov's bounded MPMC queue, of which this is
+// the single consumer special case.
+//
+// TryPush() is thread-safe. TryPop() and size() must only be called by one
+// thread at a time.
+template <typename T>
+class MpscQueue {
+ public:
+  // Constructs a queue that holds at least `min_capacity` elements.
+  // The actual capacity is the next power of two.
+  explicit MpscQueue(size_t min_capacity)
+      : capacity_(RoundUpCapacity(min_capacity)),
+        slots_(new Slot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Not copyable or moveable.
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  size_t capacity() const { return capacity_; }
+
+  // Appends `value` to the queue. Returns false and leaves `value` alone if
+  // the queue is full.
+  bool TryPush(T &&value) {
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots_[pos & (capacity_ - 1)];
+      const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const int64_t diff =
+          static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+      if (diff == 0) {
+        // The slot is free. Claim it unless another producer was faster.
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          slot.value.emplace(std::move(value));
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+        // `pos` was reloaded by the failed compare-and-swap.
+      } else if (diff < 0) {
+        // The consumer has not freed the slot yet.
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Removes and returns the oldest element or std::nullopt if the queue is
+  // empty.
+  std::optional<T> TryPop() {
+    Slot &slot = slots_[dequeue_pos_ & (capacity_ - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      return std::nullopt;
+    }
+    std::optional<T> value = std::move(slot.value);
+    slot.value.reset();
+    // Hand the slot back to producers for the next round.
+    slot.sequence.store(dequeue_pos_ + capacity_, std::memory_order_release);
+    ++dequeue_pos_;
+    return value;
+  }
+
+  // Returns the number of elements claimed by producers but not yet popped.
+  // This includes elements still being written.
+  size_t size() const {
+    return enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos_;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence;
+    std::optional<T> value;
+  };
+
+  static size_t RoundUpCapacity(size_t min_capacity) {
+    size_t capacity = 1;
+    while (capacity < min_capacity) capacity <<= 1;
+    return capacity;
+  }
+
+  const size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+
+  // Keep the producer and consumer positions in separate cache lines.
+  alignas(64) std::atomic<uint64_t> enqueue_pos_ = 0;
+  alignas(64) uint64_t dequeue_pos_ = 0;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_MPSC_QUEUE_H_
@@ -0,0 +1,89 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./orchestrator/mpsc_queue.h"
+
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace silifuzz {
+namespace {
+
+using testing::Optional;
+using testing::Pointee;
+
+TEST(MpscQueue, Simple) {
+  MpscQueue<std::unique_ptr<int>> queue(3);
+  EXPECT_EQ(queue.capacity(), 4);
+  EXPECT_EQ(queue.TryPop(), std::nullopt);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.TryPush(std::make_unique<int>(i)));
+  }
+  auto value = std::make_unique<int>(4);
+  EXPECT_FALSE(queue.TryPush(std::move(value)));
+  // A failed push leaves the value alone.
+  EXPECT_THAT(value, Pointee(4));
+  EXPECT_EQ(queue.size(), 4);
+
+  EXPECT_THAT(queue.TryPop(), Optional(Pointee(0)));
+  EXPECT_TRUE(queue.TryPush(std::move(value)));
+  for (int i = 1; i <= 4; ++i) {
+    EXPECT_THAT(queue.TryPop(), Optional(Pointee(i)));
+  }
+  EXPECT_EQ(queue.TryPop(), std::nullopt);
+  EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(MpscQueue, Multithreaded) {
+  constexpr int kNumProducers = 8;
+  constexpr int kNumValuesPerProducer = 1000;
+  MpscQueue<int> queue(16);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kNumValuesPerProducer; ++i) {
+        int value = p * kNumValuesPerProducer + i;
+        while (!queue.TryPush(std::move(value))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Every value arrives exactly once and in order per producer.
+  std::vector<int> next(kNumProducers, 0);
+  for (int n = 0; n < kNumProducers * kNumValuesPerProducer;) {
+    std::optional<int> value = queue.TryPop();
+    if (!value.has_value()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const int p = *value / kNumValuesPerProducer;
+    ASSERT_EQ(*value % kNumValuesPerProducer, next[p]);
+    ++next[p];
+    ++n;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(queue.TryPop(), std::nullopt);
+}
+
+}  // namespace
+}  // namespace silifuzz
@@ -27,7 +27,6 @@
 #include <system_error>  // NOLINT
 #include <vector>
 
-#include "absl/random/random.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/match.h"
@@ -140,7 +139,7 @@ absl::StatusOr<uint64_t> AvailableMemoryMb() {
   return absl::NotFoundError("No MemAvailable entry in /proc/meminfo");
 }
 
-absl::StatusOr<std::vector<std::string>> CapShardsToMemLimit(
+absl::StatusOr<size_t> MaxResidentShardsForMemLimit(
     const std::vector<std::string> &shards, int64_t memory_usage_limit_mb,
     uint64_t max_cpus) {
   // How much memory a single runner uses. 512Mb works the current corpus but
@@ -186,10 +185,7 @@ absl::StatusOr<std::vector<std::string>> CapShardsToMemLimit(
   memory_budget_mb -= top_shard_size_mb * max_shards;
   VLOG_INFO(0, "Total expected memory usage of SiliFuzz is ",
             memory_usage_limit_mb - memory_budget_mb, "MB");
-  std::vector<std::string> rv = shards;
-  std::shuffle(rv.begin(), rv.end(), absl::BitGen());
-  rv.resize(max_shards);
-  return rv;
+  return max_shards;
 }
 
 }  // namespace silifuzz
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -51,13 +52,13 @@ std::vector<pid_t> ListChildrenPids(pid_t pid);
 // containerized. Any cgroup limits won't be reflected in the result.
 absl::StatusOr<uint64_t> AvailableMemoryMb();
 
-// Caps the number of `shards` such that the entire process fits in the
-// supplied `memory_usage_limit_mb`. `max_cpus` is the number of runner
-// processes that will be run in parallel.
+// Returns how many of `shards` can be held in RAM at the same time such that
+// the entire process fits in the supplied `memory_usage_limit_mb`. `max_cpus`
+// is the number of runner processes that will be run in parallel.
 // NOTE: This function relies on the shard size and a guessestimate of how much
 // memory (max) a runner can use. The caller may want to apply a fudge factor of
 // 0.8 to the limit value to reduce memory pressure.
-absl::StatusOr<std::vector<std::string>> CapShardsToMemLimit(
+absl::StatusOr<size_t> MaxResidentShardsForMemLimit(
     const std::vector<std::string> &shards, int64_t memory_usage_limit_mb,
     uint64_t max_cpus);
 
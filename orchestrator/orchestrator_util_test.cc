@@ -37,7 +37,6 @@ using ::silifuzz::testing::StatusIs;
 using ::testing::ElementsAre;
 using ::testing::Gt;
 using ::testing::IsEmpty;
-using ::testing::SizeIs;
 
 TEST(OrchestratorUtil, ListChildrenPids) {
   EXPECT_THAT(ListChildrenPids(getpid()), IsEmpty());
@@ -79,28 +78,31 @@ TEST(OrchestratorUtil, AvailableMemoryMb) {
   EXPECT_THAT(AvailableMemoryMb(), IsOkAndHolds(Gt(0)));
 }
 
-TEST(OrchestratorUtil, CapShardsToMemLimit) {
+TEST(OrchestratorUtil, MaxResidentShardsForMemLimit) {
   std::string shard =
       GetDataDependencyFilepath("orchestrator/testdata/one_mb_of_zeros.xz");
   std::vector<std::string> shards{1, shard};
-  absl::StatusOr<std::vector<std::string>> capped_shards =
-      CapShardsToMemLimit(shards, /* runner size */ 512 + /* extra */ 10, 1);
-  EXPECT_THAT(capped_shards, IsOkAndHolds(shards));
+  EXPECT_THAT(MaxResidentShardsForMemLimit(
+                  shards, /* runner size */ 512 + /* extra */ 10, 1),
+              IsOkAndHolds(1));
 
   shards.resize(10, shard);
-  capped_shards =
-      CapShardsToMemLimit(shards, /* runner size */ 512 + /* extra */ 10, 1);
-  EXPECT_THAT(capped_shards, IsOkAndHolds(shards));
+  EXPECT_THAT(MaxResidentShardsForMemLimit(
+                  shards, /* runner size */ 512 + /* extra */ 10, 1),
+              IsOkAndHolds(10));
 
   shards.resize(100, shard);
-  capped_shards =
-      CapShardsToMemLimit(shards, /* runner size */ 512 + /* extra */ 10, 1);
-  EXPECT_THAT(capped_shards, IsOkAndHolds(SizeIs(10)));
+  EXPECT_THAT(MaxResidentShardsForMemLimit(
+                  shards, /* runner size */ 512 + /* extra */ 10, 1),
+              IsOkAndHolds(10));
+  EXPECT_THAT(MaxResidentShardsForMemLimit(
+                  shards, /* runner size */ 2 * 512 + /* extra */ 10, 2),
+              IsOkAndHolds(10));
 
   shards.resize(1, shard);
-  capped_shards =
-      CapShardsToMemLimit(shards, /* runner size */ 512 + /* extra */ 0, 1);
-  EXPECT_THAT(capped_shards, StatusIs(absl::StatusCode::kResourceExhausted));
+  EXPECT_THAT(MaxResidentShardsForMemLimit(
+                  shards, /* runner size */ 512 + /* extra */ 0, 1),
+              StatusIs(absl::StatusCode::kResourceExhausted));
 }
 
 }  // namespace
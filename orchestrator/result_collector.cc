@@ -24,6 +24,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "google/protobuf/duration.pb.h"
 #include "google/protobuf/timestamp.pb.h"
@@ -37,6 +38,7 @@
 #include "./common/snapshot_enums.h"
 #include "./orchestrator/binary_log_channel.h"
 #include "./orchestrator/orchestrator_util.h"
+#include "./orchestrator/shard_scheduler.h"
 #include "./player/player_result_proto.h"
 #include "./proto/binary_log_entry.pb.h"
 #include "./proto/corpus_metadata.pb.h"
@@ -223,7 +225,8 @@ void ResultCollector::LogSummary(bool always) {
 
 absl::Status ResultCollector::LogSessionSummary(
     const proto::CorpusMetadata &corpus_metadata,
-    absl::string_view orchestrator_version) {
+    absl::string_view orchestrator_version,
+    const std::vector<ShardStats> &shard_stats) {
   if (binary_log_producer_ == nullptr) {
     return absl::OkStatus();
   }
@@ -259,6 +262,18 @@ absl::Status ResultCollector::LogSessionSummary(
 
   *entry.mutable_session_summary()->mutable_corpus_metadata() = corpus_metadata;
 
+  for (const ShardStats &stats : shard_stats) {
+    if (stats.play_count == 0) continue;
+    auto shard_summary = entry.mutable_session_summary()->add_shard_summary();
+    shard_summary->set_name(stats.name);
+    shard_summary->set_play_count(stats.play_count);
+    shard_summary->set_num_errors(stats.num_errors);
+    shard_summary->set_num_failures(stats.num_failures);
+    *shard_summary->mutable_run_time() = DurationToProto(stats.run_time);
+    *shard_summary->mutable_startup_time() =
+        DurationToProto(stats.startup_time);
+  }
+
   return binary_log_producer_->Send(entry);
 }
 
@@ -20,11 +20,13 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "./orchestrator/binary_log_channel.h"
+#include "./orchestrator/shard_scheduler.h"
 #include "./proto/corpus_metadata.pb.h"
 #include "./runner/driver/runner_driver.h"
 
@@ -72,9 +74,12 @@ class ResultCollector {
   // disables time-based throttling.
   void LogSummary(bool always = false);
 
-  // Logs session summary to binary_log_channel (if any).
-  absl::Status LogSessionSummary(const proto::CorpusMetadata &corpus_metadata,
-                                 absl::string_view orchestrator_version);
+  // Logs session summary to binary_log_channel (if any). `shard_stats` are
+  // the stats of all shards, of which those that were run are logged.
+  absl::Status LogSessionSummary(
+      const proto::CorpusMetadata &corpus_metadata,
+      absl::string_view orchestrator_version,
+      const std::vector<ShardStats> &shard_stats = {});
 
  private:
   std::unique_ptr<BinaryLogProducer> binary_log_producer_;
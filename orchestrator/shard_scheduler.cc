@@ -0,0 +1,114 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./orchestrator/shard_scheduler.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "./runner/driver/runner_driver.h"
+
+namespace silifuzz {
+
+ShardScheduler::ShardScheduler(int num_shards, double fairness_floor)
+    : fairness_floor_(fairness_floor),
+      stats_(num_shards),
+      weights_(num_shards, 1.0),
+      total_weight_(num_shards) {
+  CHECK_GT(num_shards, 0);
+  CHECK_GE(fairness_floor, 0.0);
+  CHECK_LE(fairness_floor, 1.0);
+}
+
+int ShardScheduler::Next(std::mt19937_64 &random) {
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const bool pick_uniformly = uniform(random) < fairness_floor_;
+
+  absl::MutexLock l(&mu_);
+  const int num_shards = weights_.size();
+  if (pick_uniformly || total_weight_ <= 0.0) {
+    return std::uniform_int_distribution<int>(0, num_shards - 1)(random);
+  }
+  double x = uniform(random) * total_weight_;
+  int last_candidate = 0;
+  for (int i = 0; i < num_shards; ++i) {
+    if (weights_[i] <= 0.0) continue;
+    if (x < weights_[i]) return i;
+    x -= weights_[i];
+    last_candidate = i;
+  }
+  // Only reached due to rounding errors in `total_weight_`.
+  return last_candidate;
+}
+
+void ShardScheduler::RecordRun(
+    int shard_idx, absl::string_view name, absl::Duration startup_time,
+    absl::Duration run_time,
+    const absl::StatusOr<RunnerDriver::RunResult> &run_result) {
+  absl::MutexLock l(&mu_);
+  ShardStats &stats = stats_[shard_idx];
+  if (stats.name.empty()) {
+    stats.name = std::string(name);
+  }
+  ++stats.play_count;
+  if (!run_result.ok()) {
+    ++stats.num_errors;
+  } else if (!run_result->success()) {
+    ++stats.num_failures;
+  }
+  // Loading and mapping the corpus in the runner is overhead just like
+  // getting the shard ready, and for a resident shard it is all of it.
+  if (run_result.ok() && run_result->startup_time().has_value()) {
+    const absl::Duration runner_startup_time =
+        std::min(*run_result->startup_time(), run_time);
+    startup_time += runner_startup_time;
+    run_time -= runner_startup_time;
+  }
+  stats.startup_time += startup_time;
+  stats.run_time += run_time;
+  UpdateWeight(shard_idx);
+}
+
+double ShardScheduler::Weight(int shard_idx) const {
+  absl::MutexLock l(&mu_);
+  return weights_[shard_idx];
+}
+
+std::vector<ShardStats> ShardScheduler::stats() const {
+  absl::MutexLock l(&mu_);
+  return stats_;
+}
+
+void ShardScheduler::UpdateWeight(int shard_idx) {
+  const ShardStats &stats = stats_[shard_idx];
+  double weight = 1.0;
+  const absl::Duration total_time = stats.run_time + stats.startup_time;
+  if (total_time > absl::ZeroDuration()) {
+    weight *= absl::FDivDuration(stats.run_time, total_time);
+  }
+  if (stats.play_count > 0) {
+    weight *= 1.0 - static_cast<double>(stats.num_errors) / stats.play_count;
+  }
+  total_weight_ += weight - weights_[shard_idx];
+  weights_[shard_idx] = weight;
+}
+
+}  // namespace silifuzz
@@ -0,0 +1,123 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_SHARD_SCHEDULER_H_
+#define THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_SHARD_SCHEDULER_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "./runner/driver/runner_driver.h"
+
+namespace silifuzz {
+
+// Observed cost of running a single corpus shard.
+struct ShardStats {
+  // Printable name of the shard or "" if it has not been run yet.
+  std::string name;
+
+  // How many times a runner binary was executed with the shard.
+  uint64_t play_count = 0;
+
+  // Number of runner executions that did not produce a result, e.g. because
+  // the runner crashed or could not map the corpus.
+  uint64_t num_errors = 0;
+
+  // Number of runner executions that reported a snapshot failure.
+  uint64_t num_failures = 0;
+
+  // Total wall time of runner executions, excluding the runner's startup.
+  absl::Duration run_time = absl::ZeroDuration();
+
+  // Total time spent getting the shard ready for a runner, i.e. loading and
+  // decompressing it if it is not in memory plus the time the runner took to
+  // load and map the corpus, as reported by the runner.
+  absl::Duration startup_time = absl::ZeroDuration();
+};
+
+// Picks the shard for the next runner execution.
+//
+// Shards are picked at random with a probability proportional to their
+// weight, which estimates how much useful work a CPU-second spent on the
+// shard yields:
+//
+//   weight = run_time / (run_time + startup_time) * (1 - error_rate)
+//
+// Shards that are slow to load or whose runners keep failing to produce a
+// result are therefore picked less often. Snapshot failures are what the
+// orchestrator is looking for and do not lower the weight. Shards that have
+// not been run yet get the maximum weight of 1.
+//
+// With probability `fairness_floor` the shard is instead picked uniformly at
+// random so that every shard is picked with a probability of at least
+// fairness_floor / num_shards and no shard starves.
+//
+// This class is thread-safe.
+class ShardScheduler {
+ public:
+  static constexpr double kDefaultFairnessFloor = 0.1;
+
+  // REQUIRES: num_shards > 0 and 0 <= fairness_floor <= 1.
+  explicit ShardScheduler(int num_shards,
+                          double fairness_floor = kDefaultFairnessFloor);
+
+  // Not copyable or moveable.
+  ShardScheduler(const ShardScheduler &) = delete;
+  ShardScheduler &operator=(const ShardScheduler &) = delete;
+
+  // Returns the index of the next shard to run using randomness from `random`.
+  int Next(std::mt19937_64 &random) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Records the outcome of a runner execution with shard `shard_idx` named
+  // `name`. Getting the shard ready took `startup_time` and running the
+  // runner took `run_time`. If the runner reported its own startup time, see
+  // RunnerOptions::set_report_startup_time(), that part of `run_time` counts
+  // as startup time.
+  void RecordRun(int shard_idx, absl::string_view name,
+                 absl::Duration startup_time, absl::Duration run_time,
+                 const absl::StatusOr<RunnerDriver::RunResult> &run_result)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the current weight of shard `shard_idx`. See class comment.
+  double Weight(int shard_idx) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the stats of all shards indexed by shard.
+  std::vector<ShardStats> stats() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Recomputes weights_[shard_idx] from stats_[shard_idx].
+  void UpdateWeight(int shard_idx) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const double fairness_floor_;
+
+  mutable absl::Mutex mu_;
+
+  // Both indexed by shard.
+  std::vector<ShardStats> stats_ ABSL_GUARDED_BY(mu_);
+  std::vector<double> weights_ ABSL_GUARDED_BY(mu_);
+
+  // Sum of `weights_`.
+  double total_weight_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_SHARD_SCHEDULER_H_
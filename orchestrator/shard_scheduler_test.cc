@@ -0,0 +1,141 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./orchestrator/shard_scheduler.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "./common/snapshot_enums.h"
+#include "./runner/driver/runner_driver.h"
+
+namespace silifuzz {
+namespace {
+
+using snapshot_types::PlaybackOutcome;
+
+// Returns how many times each shard was picked in `n` calls to Next().
+std::vector<int> CountPicks(ShardScheduler &scheduler, int num_shards, int n) {
+  std::mt19937_64 random(0);
+  std::vector<int> counts(num_shards);
+  for (int i = 0; i < n; ++i) {
+    int idx = scheduler.Next(random);
+    EXPECT_GE(idx, 0);
+    EXPECT_LT(idx, num_shards);
+    ++counts[idx];
+  }
+  return counts;
+}
+
+TEST(ShardScheduler, Uniform) {
+  ShardScheduler scheduler(3);
+  for (int count : CountPicks(scheduler, 3, 3000)) {
+    EXPECT_GT(count, 800);
+    EXPECT_LT(count, 1200);
+  }
+}
+
+TEST(ShardScheduler, Stats) {
+  ShardScheduler scheduler(2);
+  scheduler.RecordRun(1, "shard1", absl::Seconds(1), absl::Seconds(3),
+                      RunnerDriver::RunResult::Successful());
+  scheduler.RecordRun(1, "shard1", absl::ZeroDuration(), absl::Seconds(4),
+                      absl::InternalError("runner crashed"));
+  std::vector<ShardStats> stats = scheduler.stats();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].play_count, 0);
+  EXPECT_EQ(stats[1].name, "shard1");
+  EXPECT_EQ(stats[1].play_count, 2);
+  EXPECT_EQ(stats[1].num_errors, 1);
+  EXPECT_EQ(stats[1].num_failures, 0);
+  EXPECT_EQ(stats[1].startup_time, absl::Seconds(1));
+  EXPECT_EQ(stats[1].run_time, absl::Seconds(7));
+
+  EXPECT_DOUBLE_EQ(scheduler.Weight(0), 1.0);
+  EXPECT_DOUBLE_EQ(scheduler.Weight(1), 7.0 / 8.0 * 0.5);
+}
+
+TEST(ShardScheduler, PrefersCheapShards) {
+  ShardScheduler scheduler(2, /*fairness_floor=*/0.0);
+  scheduler.RecordRun(0, "fast", absl::ZeroDuration(), absl::Seconds(10),
+                      RunnerDriver::RunResult::Successful());
+  scheduler.RecordRun(1, "slow", absl::Seconds(30), absl::Seconds(10),
+                      RunnerDriver::RunResult::Successful());
+  std::vector<int> counts = CountPicks(scheduler, 2, 1000);
+  // The expected ratio is 4:1.
+  EXPECT_GT(counts[0], 3 * counts[1]);
+  EXPECT_GT(counts[1], 0);
+}
+
+TEST(ShardScheduler, RunnerStartupTime) {
+  ShardScheduler scheduler(2, /*fairness_floor=*/0.0);
+  // Both shards are resident and the runners run for the same time, but the
+  // runner with shard 1 spends most of it mapping the corpus.
+  RunnerDriver::RunResult fast_startup = RunnerDriver::RunResult::Successful();
+  fast_startup.set_startup_time(absl::Seconds(1));
+  RunnerDriver::RunResult slow_startup = RunnerDriver::RunResult::Successful();
+  slow_startup.set_startup_time(absl::Seconds(8));
+  scheduler.RecordRun(0, "fast", absl::ZeroDuration(), absl::Seconds(10),
+                      fast_startup);
+  scheduler.RecordRun(1, "slow", absl::ZeroDuration(), absl::Seconds(10),
+                      slow_startup);
+
+  std::vector<ShardStats> stats = scheduler.stats();
+  EXPECT_EQ(stats[1].startup_time, absl::Seconds(8));
+  EXPECT_EQ(stats[1].run_time, absl::Seconds(2));
+  EXPECT_DOUBLE_EQ(scheduler.Weight(0), 0.9);
+  EXPECT_DOUBLE_EQ(scheduler.Weight(1), 0.2);
+  std::vector<int> counts = CountPicks(scheduler, 2, 1100);
+  // The expected ratio is 9:2.
+  EXPECT_GT(counts[0], 3 * counts[1]);
+  EXPECT_GT(counts[1], 0);
+}
+
+TEST(ShardScheduler, SnapFailuresAreNotPenalized) {
+  ShardScheduler scheduler(1);
+  RunnerDriver::PlayerResult result = {
+      .outcome = PlaybackOutcome::kExecutionMisbehave};
+  scheduler.RecordRun(0, "shard", absl::ZeroDuration(), absl::Seconds(1),
+                      RunnerDriver::RunResult(result, "snap_id"));
+  EXPECT_EQ(scheduler.stats()[0].num_failures, 1);
+  EXPECT_DOUBLE_EQ(scheduler.Weight(0), 1.0);
+}
+
+TEST(ShardScheduler, FairnessFloor) {
+  ShardScheduler scheduler(2, /*fairness_floor=*/0.2);
+  scheduler.RecordRun(1, "broken", absl::ZeroDuration(), absl::Seconds(1),
+                      absl::InternalError("runner crashed"));
+  EXPECT_DOUBLE_EQ(scheduler.Weight(1), 0.0);
+  std::vector<int> counts = CountPicks(scheduler, 2, 10000);
+  // Shard 1 only gets picked through the floor, i.e. 10% of the time.
+  EXPECT_GT(counts[1], 800);
+  EXPECT_LT(counts[1], 1200);
+}
+
+TEST(ShardScheduler, AllShardsBroken) {
+  ShardScheduler scheduler(2, /*fairness_floor=*/0.0);
+  for (int i = 0; i < 2; ++i) {
+    scheduler.RecordRun(i, "broken", absl::ZeroDuration(), absl::Seconds(1),
+                        absl::InternalError("runner crashed"));
+  }
+  for (int count : CountPicks(scheduler, 2, 100)) {
+    EXPECT_GT(count, 0);
+  }
+}
+
+}  // namespace
+}  // namespace silifuzz
@@ -14,7 +14,12 @@
 
 #include "./orchestrator/silifuzz_orchestrator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <utility>
@@ -30,6 +35,7 @@
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "./orchestrator/corpus_util.h"
+#include "./orchestrator/shard_scheduler.h"
 #include "./runner/driver/runner_driver.h"
 #include "./util/checks.h"
 
@@ -53,7 +59,7 @@ std::string RunResultToDebugString(
 
 ExecutionContext::~ExecutionContext() {
   absl::MutexLock l(&mu_);
-  if (!invocation_results_.empty()) {
+  if (queue_.size() != 0 || !overflow_results_.empty()) {
     absl::string_view error =
         "The result queue is not empty. Did you call ProcessResultQueue()?";
     if (DEBUG_MODE) {
@@ -64,43 +70,68 @@ ExecutionContext::~ExecutionContext() {
   }
 }
 
-// Attempts to post RunResult on the result queue. Returns true if the element
-// was added, false otherwise.
-bool ExecutionContext::OfferRunResult(
+void ExecutionContext::OfferRunResult(
     absl::StatusOr<RunnerDriver::RunResult> &&result) {
-  absl::MutexLock l(&mu_);
   if (!result.ok()) {
-    // Currently, no-Ok() results are not reported to the result queue. It is
-    // important however this code executed with mu_ held b/c this allows
-    // EventLoop() to wake up and catch deadline events sooner.
-    return true;
+    // Currently, no-Ok() results are not reported to the result queue.
+    return;
+  }
+  if (!queue_.TryPush(std::move(*result))) {
+    // Apply backpressure: a dropped result could be a missed failure report.
+    constexpr absl::Duration kBackoff = absl::Microseconds(100);
+    const absl::Time stall_start = absl::Now();
+    bool pushed = false;
+    while (!pushed) {
+      WakeUpEventLoop();
+      if (ShouldStop()) {
+        // The event loop may be gone. Leave the result for
+        // ProcessResultQueue().
+        absl::MutexLock l(&mu_);
+        overflow_results_.emplace_back(std::move(*result));
+        break;
+      }
+      absl::SleepFor(kBackoff);
+      pushed = queue_.TryPush(std::move(*result));
+    }
+    num_stalls_.fetch_add(1, std::memory_order_relaxed);
+    stall_time_ns_.fetch_add(
+        absl::ToInt64Nanoseconds(absl::Now() - stall_start),
+        std::memory_order_relaxed);
+    if (!pushed) return;
+  }
+  WakeUpEventLoop();
+}
+
+void ExecutionContext::WakeUpEventLoop() {
+  // Pairs with the fence in WaitForResults(): either the event loop sees the
+  // new result or we see that it is waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (event_loop_waiting_.load(std::memory_order_relaxed)) {
+    absl::MutexLock l(&mu_);
+    wake_up_.Signal();
   }
+}
 
-  // Allow at most 1 result slot per thread.
-  if (invocation_results_.size() >= num_threads_) {
-    return false;
+void ExecutionContext::WaitForResults(absl::Time deadline) {
+  absl::MutexLock l(&mu_);
+  event_loop_waiting_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (queue_.size() == 0 && !ShouldStop()) {
+    wake_up_.WaitWithDeadline(&mu_, deadline);
   }
-  invocation_results_.emplace_back(*result);
-  return true;
+  event_loop_waiting_.store(false, std::memory_order_relaxed);
 }
 
 // Runs the orchestrator event loop.
 // NOTE: This method is not reentrant. Must be called by the main thread.
 void ExecutionContext::EventLoop() {
-  constexpr absl::Duration kTimeout = absl::Seconds(10);
+  // Stop() must stay async-signal-safe and so cannot wake the loop up. Poll
+  // often enough to notice it soon.
+  constexpr absl::Duration kTimeout = absl::Seconds(1);
   while (!ShouldStop()) {
-    std::vector<RunnerDriver::RunResult> current_results;
-    current_results.reserve(num_threads_);
-    {
-      bool timed_out = mu_.LockWhenWithTimeout(
-          absl::Condition(this, &ExecutionContext::ShouldWakeUp), kTimeout);
-      VLOG_INFO(2, "Result processor woke up, queue size = ",
-                invocation_results_.size(), " due to timeout? = ", timed_out);
-      invocation_results_.swap(current_results);
-      mu_.Unlock();
-    }
-
-    ProcessResultQueueImpl(current_results);
+    WaitForResults(std::min(absl::Now() + kTimeout, deadline_));
+    VLOG_INFO(2, "Result processor woke up, queue size = ", queue_.size());
+    DrainResultQueue();
   }
 }
 
@@ -108,15 +139,35 @@ void ExecutionContext::EventLoop() {
 // This method needs to be called to process any late-arriving events after
 // all worker thread have been joined.
 void ExecutionContext::ProcessResultQueue() {
-  absl::MutexLock l(&mu_);
-  ProcessResultQueueImpl(invocation_results_);
-  invocation_results_.clear();
+  DrainResultQueue();
+  std::vector<RunnerDriver::RunResult> overflow_results;
+  {
+    absl::MutexLock l(&mu_);
+    overflow_results.swap(overflow_results_);
+  }
+  for (const auto &result : overflow_results) {
+    if (result_cb_(result)) {
+      Stop();
+    }
+  }
 }
 
-void ExecutionContext::ProcessResultQueueImpl(
-    const std::vector<RunnerDriver::RunResult> &results) {
-  for (const auto &result : results) {
-    if (result_cb_(result)) {
+ExecutionContext::QueueStats ExecutionContext::queue_stats() const {
+  return {
+      .max_depth = max_depth_.load(std::memory_order_relaxed),
+      .num_stalls = num_stalls_.load(std::memory_order_relaxed),
+      .stall_time = absl::Nanoseconds(
+          stall_time_ns_.load(std::memory_order_relaxed)),
+  };
+}
+
+void ExecutionContext::DrainResultQueue() {
+  const size_t depth = queue_.size();
+  if (depth > max_depth_.load(std::memory_order_relaxed)) {
+    max_depth_.store(depth, std::memory_order_relaxed);
+  }
+  while (std::optional<RunnerDriver::RunResult> result = queue_.TryPop()) {
+    if (result_cb_(*result)) {
       Stop();
     }
   }
@@ -147,9 +198,12 @@ int NextCorpusGenerator::operator()() {
 // loop until it is told to stop.
 void RunnerThread(ExecutionContext *ctx, const RunnerThreadArgs &args) {
   VLOG_INFO(0, "T", args.thread_idx, " started");
-  NextCorpusGenerator next_corpus_generator(
-      args.corpora->shards.size(), args.runner_options.sequential_mode(),
-      args.thread_idx);
+  const bool sequential_mode = args.runner_options.sequential_mode();
+  CHECK(sequential_mode || args.scheduler != nullptr)
+      << "T" << args.thread_idx << " has no shard scheduler";
+  NextCorpusGenerator next_corpus_generator(args.corpora->size(),
+                                            sequential_mode, args.thread_idx);
+  std::mt19937_64 random(args.thread_idx);
 
   while (!ctx->ShouldStop()) {
     absl::Time start_time = absl::Now();
@@ -159,9 +213,13 @@ void RunnerThread(ExecutionContext *ctx, const RunnerThreadArgs &args) {
     }
     RunnerOptions runner_options = args.runner_options;
     runner_options.set_wall_time_budget(time_budget);
+    // The scheduler counts the time the runner takes to load and map the
+    // shard as startup time. See ShardScheduler::RecordRun().
+    runner_options.set_report_startup_time(args.scheduler != nullptr);
     VLOG_INFO(1, "T", args.thread_idx, " time budget ",
               absl::FormatDuration(time_budget));
-    int shard_idx = next_corpus_generator();
+    int shard_idx = sequential_mode ? next_corpus_generator()
+                                    : args.scheduler->Next(random);
 
     if (shard_idx == NextCorpusGenerator::kEndOfStream) {
       VLOG_INFO(0, "T", args.thread_idx,
@@ -169,13 +227,28 @@ void RunnerThread(ExecutionContext *ctx, const RunnerThreadArgs &args) {
       break;
     }
 
-    const InMemoryShard &shard = args.corpora->shards[shard_idx];
+    // Holding the shard keeps it in RAM until the runner is done with it.
+    absl::StatusOr<std::shared_ptr<const InMemoryShard>> shard_or =
+        args.corpora->Get(shard_idx);
+    if (!shard_or.ok()) {
+      LOG_ERROR("T", args.thread_idx,
+                " Cannot load corpus: ", shard_or.status().message());
+      break;
+    }
+    const InMemoryShard &shard = **shard_or;
+    const absl::Time run_start_time = absl::Now();
     RunnerDriver driver =
         RunnerDriver::ReadingRunner(args.runner, shard.file_path, shard.name);
     absl::StatusOr<RunnerDriver::RunResult> run_result_or =
         driver.Run(runner_options);
 
-    absl::Duration elapsed_time = absl::Now() - start_time;
+    const absl::Time end_time = absl::Now();
+    absl::Duration elapsed_time = end_time - start_time;
+    if (args.scheduler != nullptr) {
+      args.scheduler->RecordRun(shard_idx, shard.name,
+                                run_start_time - start_time,
+                                end_time - run_start_time, run_result_or);
+    }
 
     std::string log_msg = absl::StrCat(
         "T", args.thread_idx, " cpu: ", args.runner_options.cpu(),
@@ -187,11 +260,7 @@ void RunnerThread(ExecutionContext *ctx, const RunnerThreadArgs &args) {
       VLOG_INFO(0, log_msg);
     }
 
-    if (!ctx->OfferRunResult(std::move(run_result_or))) {
-      LOG_ERROR(
-          "T", args.thread_idx,
-          " Result processing queue is stuck, some results won't be logged");
-    }
+    ctx->OfferRunResult(std::move(run_result_or));
   }
 
   ctx->Stop();
@@ -15,7 +15,10 @@
 #ifndef THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_SILIFUZZ_ORCHESTRATOR_H_
 #define THIRD_PARTY_SILIFUZZ_ORCHESTRATOR_SILIFUZZ_ORCHESTRATOR_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <random>
 #include <string>
@@ -27,6 +30,8 @@
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "./orchestrator/corpus_util.h"
+#include "./orchestrator/mpsc_queue.h"
+#include "./orchestrator/shard_scheduler.h"
 #include "./runner/driver/runner_driver.h"
 #include "./runner/driver/runner_options.h"
 
@@ -41,7 +46,11 @@ struct RunnerThreadArgs {
   std::string runner = "";
 
   // All available corpora.
-  const InMemoryCorpora *corpora = nullptr;
+  ShardCache *corpora = nullptr;
+
+  // Picks shards in random mode. Must have as many shards as `corpora`.
+  // Required unless in sequential mode, where it may be nullptr.
+  ShardScheduler *scheduler = nullptr;
 
   // Additional parameters passed to each runner binary.
   RunnerOptions runner_options = RunnerOptions::Default();
@@ -53,6 +62,10 @@ struct RunnerThreadArgs {
 // execution results). Worker threads publish their results via OfferRunResult()
 // in a while (!ShouldStop()) {} loop.
 //
+// Results travel through a bounded lock-free queue so that worker threads do
+// not contend on a lock. When the queue is full, workers wait for the event
+// loop to make room rather than drop results.
+//
 // This class is thread-safe.
 class ExecutionContext {
  public:
@@ -62,6 +75,17 @@ class ExecutionContext {
   // stop.
   using ResultCallback = std::function<bool(const RunnerDriver::RunResult &)>;
 
+  // Statistics of the result queue.
+  struct QueueStats {
+    // Largest number of results seen waiting in the queue.
+    size_t max_depth = 0;
+
+    // Number of times a worker thread found the queue full and the total time
+    // worker threads spent waiting for room.
+    uint64_t num_stalls = 0;
+    absl::Duration stall_time = absl::ZeroDuration();
+  };
+
   // Constructs an ExecutionContext with the given deadline. Once the deadline
   // is reached ShouldStop() will return true.
   // num_threads is a hint used to size internal data structures.
@@ -70,13 +94,9 @@ class ExecutionContext {
   ExecutionContext(absl::Time deadline, int num_threads,
                    const ResultCallback &result_cb)
       : deadline_(deadline),
-        num_threads_(num_threads),
         result_cb_(result_cb),
-        mu_(),
         stop_execution_(false),
-        invocation_results_() {
-    invocation_results_.reserve(num_threads);
-  }
+        queue_(std::max(kMinQueueCapacity, 2 * num_threads)) {}
 
   // Not copyable or moveable -- not just a data holder.
   ExecutionContext(const ExecutionContext &) = delete;
@@ -86,9 +106,10 @@ class ExecutionContext {
 
   ~ExecutionContext();
 
-  // Attempts to post RunResult on the result queue. Returns true if the element
-  // was added, false otherwise.
-  bool OfferRunResult(absl::StatusOr<RunnerDriver::RunResult> &&result);
+  // Posts RunResult on the result queue. Non-OK results are not reported.
+  // Blocks while the queue is full unless the execution should stop, in which
+  // case the result is set aside for ProcessResultQueue().
+  void OfferRunResult(absl::StatusOr<RunnerDriver::RunResult> &&result);
 
   // Returns true if the execution should stop.
   bool ShouldStop() const { return stop_execution_ || absl::Now() > deadline_; }
@@ -108,28 +129,48 @@ class ExecutionContext {
 
   absl::Time deadline() const { return deadline_; }
 
+  // Returns the current result queue statistics.
+  QueueStats queue_stats() const;
+
  private:
-  void ProcessResultQueueImpl(
-      const std::vector<RunnerDriver::RunResult> &results);
+  static constexpr int kMinQueueCapacity = 16;
+
+  // Invokes `result_cb_` for all queued results.
+  // Must only be called by one thread at a time.
+  void DrainResultQueue();
 
-  // EventLoop() helper. Returns true iif the EventLoop() should wake up.
-  bool ShouldWakeUp() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    return !invocation_results_.empty() || ShouldStop();
-  }
+  // Waits until the queue is not empty, ShouldStop() or `deadline`.
+  void WaitForResults(absl::Time deadline) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Wakes up WaitForResults() if it is waiting.
+  void WakeUpEventLoop() ABSL_LOCKS_EXCLUDED(mu_);
 
   // C-tor parameters.
   const absl::Time deadline_;
-  const int num_threads_;
   ResultCallback result_cb_;
 
-  // Mutex guarding all mutable state of this class.
-  mutable absl::Mutex mu_;
-
   // Global atomic flag to indicate that the orchestrator should stop.
   std::atomic<bool> stop_execution_;
 
   // A queue of execution results.
-  std::vector<RunnerDriver::RunResult> invocation_results_ ABSL_GUARDED_BY(mu_);
+  MpscQueue<RunnerDriver::RunResult> queue_;
+
+  // True while the event loop is waiting or about to wait on `wake_up_`.
+  std::atomic<bool> event_loop_waiting_ = false;
+
+  // Queue statistics. Depth is only updated by the consumer.
+  std::atomic<size_t> max_depth_ = 0;
+  std::atomic<uint64_t> num_stalls_ = 0;
+  std::atomic<int64_t> stall_time_ns_ = 0;
+
+  // Protects `overflow_results_` and is used with `wake_up_` to put the event
+  // loop to sleep. Worker threads only take it to wake the loop up.
+  mutable absl::Mutex mu_;
+  absl::CondVar wake_up_;
+
+  // Results offered while the queue was full after the execution was told to
+  // stop.
+  std::vector<RunnerDriver::RunResult> overflow_results_ ABSL_GUARDED_BY(mu_);
 };
 
 // Helper class to generate the next corpus file name.
@@ -73,6 +73,7 @@
 #include "./orchestrator/corpus_util.h"
 #include "./orchestrator/orchestrator_util.h"
 #include "./orchestrator/result_collector.h"
+#include "./orchestrator/shard_scheduler.h"
 #include "./orchestrator/silifuzz_orchestrator.h"
 #include "./proto/corpus_metadata.pb.h"
 #include "./runner/driver/runner_options.h"
@@ -118,9 +119,20 @@ ABSL_FLAG(
     std::string, limit_memory_usage_mb, "unlimited",
     "How much memory (in Mb) can the scanning process use. The default is "
     "unlimited. When set, the orchestrator will _try to_ limit the memory "
-    "usage of itself + all the runner processes by loading just a random "
-    "fraction of the shards. A special value `auto` can be used to "
+    "usage of itself + all the runner processes by keeping just a fraction "
+    "of the shards in memory at a time. A special value `auto` can be used to "
     "automatically determine the amount of free memory from /proc/meminfo");
+ABSL_FLAG(size_t, max_resident_shards, 0,
+          "Maximum number of decompressed corpus shards to keep in memory. "
+          "Shards are loaded when a runner first needs them and the least "
+          "recently used ones are dropped to stay under this limit. Runners "
+          "wait while all resident shards are in use. 0 means no limit. "
+          "--limit_memory_usage_mb can lower the limit further.");
+ABSL_FLAG(double, shard_fairness_floor,
+          silifuzz::ShardScheduler::kDefaultFairnessFloor,
+          "Fraction of runner executions whose shard is picked uniformly at "
+          "random. The rest favor shards that are cheap to start and whose "
+          "runners do not fail. Must be in [0, 1].");
 // TODO(b/233457080): [bug] Investigate the cause of EXECUTION_RUNAWAY errors.
 ABSL_FLAG(bool, report_runaways_as_errors, false,
           "Whether runaway snapshot should be reported as errors");
@@ -190,38 +202,30 @@ absl::Status ReadProtoFromTextFile(absl::string_view filename,
   return absl::OkStatus();
 }
 
-absl::Status LogSessionSummary(ResultCollector &result_collector) {
+absl::Status LogSessionSummary(ResultCollector &result_collector,
+                               const ShardScheduler &scheduler) {
   VLOG_INFO(0, "Logging session summary");
   std::string corpus_metadata_file = absl::GetFlag(FLAGS_corpus_metadata_file);
   proto::CorpusMetadata metadata;
   RETURN_IF_NOT_OK(ReadProtoFromTextFile(corpus_metadata_file, &metadata));
   std::string version = absl::GetFlag(FLAGS_orchestrator_version);
-  return result_collector.LogSessionSummary(metadata, version);
+  return result_collector.LogSessionSummary(metadata, version,
+                                           scheduler.stats());
 }
 
 int OrchestratorMain(const std::vector<std::string> &corpora,
-                     const std::string &runner,
+                     size_t max_resident_shards, const std::string &runner,
                      const std::vector<std::string> &runner_extra_argv) {
   LOG_INFO("SiliFuzz Orchestrator started");
 
   const absl::Time start_time = absl::Now();
   absl::Time deadline = start_time + absl::GetFlag(FLAGS_duration);
 
-  // Load corpora and exit if there is any error.
-  // File descriptors of the uncompressed corpora are kept open
-  // until this struct goes out of scope.
-  const absl::StatusOr<InMemoryCorpora> in_memory_corpora =
-      LoadCorpora(corpora);
-  if (!in_memory_corpora.ok()) {
-    LOG_ERROR("Cannot load corpora: ", in_memory_corpora.status().message());
-    return EXIT_FAILURE;
-  }
-
-  absl::Status validation_status = ValidateCorpus(*in_memory_corpora);
-  if (!validation_status.ok()) {
-    LOG_ERROR(validation_status.message());
-    return EXIT_FAILURE;
-  }
+  // Corpora are loaded and validated by the worker threads as they need them.
+  // The orchestrator stops if there is any error.
+  ShardCache shard_cache(corpora, max_resident_shards);
+  ShardScheduler scheduler(corpora.size(),
+                           absl::GetFlag(FLAGS_shard_fairness_floor));
 
   size_t num_threads = absl::GetFlag(FLAGS_max_cpus);
   const absl::Duration runner_cpu_time_budget =
@@ -242,7 +246,8 @@ int OrchestratorMain(const std::vector<std::string> &corpora,
           .set_extra_argv(runner_extra_argv);
       thread_args.push_back({.thread_idx = cpu,
                              .runner = runner,
-                             .corpora = &*in_memory_corpora,
+                             .corpora = &shard_cache,
+                             .scheduler = &scheduler,
                              .runner_options = runner_options});
     }
   } else {
@@ -253,7 +258,8 @@ int OrchestratorMain(const std::vector<std::string> &corpora,
           .set_extra_argv(runner_extra_argv);
       thread_args.push_back({.thread_idx = thread_idx,
                              .runner = runner,
-                             .corpora = &*in_memory_corpora,
+                             .corpora = &shard_cache,
+                             .scheduler = &scheduler,
                              .runner_options = runner_options});
     }
   }
@@ -289,6 +295,16 @@ int OrchestratorMain(const std::vector<std::string> &corpora,
     }
   }
   ctx->ProcessResultQueue();
+  ExecutionContext::QueueStats queue_stats = ctx->queue_stats();
+  VLOG_INFO(0, "Result queue max depth: ", queue_stats.max_depth,
+            " stalls: ", queue_stats.num_stalls,
+            " stall time: ", absl::FormatDuration(queue_stats.stall_time));
+  if (absl::Status s = shard_cache.status(); !s.ok()) {
+    LOG_ERROR("Cannot load corpora: ", s.message());
+    return EXIT_FAILURE;
+  }
+  VLOG_INFO(0, "Loaded ", shard_cache.num_loads(), " shards, ",
+            shard_cache.num_reloads(), " of them reloads");
   result_collector.LogSummary(true);
   Summary summary = result_collector.summary();
   double log_session_summary_probability =
@@ -296,7 +312,7 @@ int OrchestratorMain(const std::vector<std::string> &corpora,
   absl::BitGen bitgen;
   if (absl::Uniform(bitgen, 0, 1.0) <= log_session_summary_probability ||
       summary.num_failed_snapshots > 0) {
-    absl::Status s = LogSessionSummary(result_collector);
+    absl::Status s = LogSessionSummary(result_collector, scheduler);
     if (!s.ok()) {
       LOG_ERROR(s.message());
     }
@@ -357,8 +373,13 @@ int main(int argc, char **argv) {
         << '\n';
     return EXIT_FAILURE;
   }
-  const int total_shards = shards.size();
+  const double shard_fairness_floor = absl::GetFlag(FLAGS_shard_fairness_floor);
+  if (shard_fairness_floor < 0 || shard_fairness_floor > 1) {
+    std::cerr << "--shard_fairness_floor must be in [0, 1]" << '\n';
+    return EXIT_FAILURE;
+  }
 
+  size_t max_resident_shards = absl::GetFlag(FLAGS_max_resident_shards);
   std::string limit_memory_usage_mb =
       absl::GetFlag(FLAGS_limit_memory_usage_mb);
   if (limit_memory_usage_mb != "unlimited") {
@@ -381,14 +402,16 @@ int main(int argc, char **argv) {
     if (max_cpus == 0) {
       max_cpus = silifuzz::AvailableCpus().size();
     }
-    absl::StatusOr<std::vector<std::string>> capped_shards =
-        silifuzz::CapShardsToMemLimit(shards, limit_memory_usage_mb_as_int,
-                                      max_cpus);
-    if (!capped_shards.ok()) {
-      LOG_ERROR(capped_shards.status().message());
+    absl::StatusOr<size_t> max_shards =
+        silifuzz::MaxResidentShardsForMemLimit(
+            shards, limit_memory_usage_mb_as_int, max_cpus);
+    if (!max_shards.ok()) {
+      LOG_ERROR(max_shards.status().message());
       return EXIT_FAILURE;
     }
-    shards = std::move(*capped_shards);
+    if (max_resident_shards == 0 || *max_shards < max_resident_shards) {
+      max_resident_shards = *max_shards;
+    }
   }
 
   std::vector<std::string> runner_extra_argv;
@@ -400,8 +423,10 @@ int main(int argc, char **argv) {
   }
 
   LOG_INFO("AVAIL MEM: ", silifuzz::AvailableMemoryMb().value_or(0),
-           " LOADABLE SHARDS: ", shards.size(), " TOTAL SHARDS: ", total_shards,
+           " TOTAL SHARDS: ", shards.size(),
+           " MAX RESIDENT SHARDS: ", max_resident_shards,
            " CPUS: ", silifuzz::AvailableCpus().size());
 
-  return silifuzz::OrchestratorMain(shards, runner, runner_extra_argv);
+  return silifuzz::OrchestratorMain(shards, max_resident_shards, runner,
+                                    runner_extra_argv);
 }
@@ -36,7 +36,7 @@ TEST(ExecutionContext, Simple) {
                          results_processed++;
                          return false;
                        });
-  ASSERT_TRUE(ctx.OfferRunResult(RunnerDriver::RunResult::Successful()));
+  ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
   ASSERT_FALSE(ctx.ShouldStop());
   EXPECT_EQ(results_processed, 0);
   ctx.ProcessResultQueue();
@@ -53,17 +53,52 @@ TEST(ExecutionContext, StopFast) {
   ExecutionContext ctx(absl::InfiniteFuture(), 1,
                        [](const RunnerDriver::RunResult& r) { return true; });
   ASSERT_FALSE(ctx.ShouldStop());
-  ASSERT_TRUE(ctx.OfferRunResult(RunnerDriver::RunResult::Successful()));
+  ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
   ctx.ProcessResultQueue();
   ASSERT_TRUE(ctx.ShouldStop());
 }
 
-TEST(ExecutionContext, QueueSizeLimit) {
+TEST(ExecutionContext, Backpressure) {
+  int results_processed = 0;
   ExecutionContext ctx(absl::InfiniteFuture(), 1,
-                       [](const RunnerDriver::RunResult& r) { return false; });
-  ASSERT_TRUE(ctx.OfferRunResult(RunnerDriver::RunResult::Successful()));
-  ASSERT_FALSE(ctx.OfferRunResult(RunnerDriver::RunResult::Successful()));
+                       [&results_processed](const RunnerDriver::RunResult& r) {
+                         results_processed++;
+                         return false;
+                       });
+  // Fill the queue. The next result has to wait for room.
+  constexpr int kCapacity = 16;
+  for (int i = 0; i < kCapacity; ++i) {
+    ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
+  }
+  std::thread worker([&ctx]() {
+    ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
+  });
+  absl::SleepFor(absl::Milliseconds(100));
+  ctx.ProcessResultQueue();
+  worker.join();
+  ctx.ProcessResultQueue();
+  EXPECT_EQ(results_processed, kCapacity + 1);
+  ExecutionContext::QueueStats stats = ctx.queue_stats();
+  EXPECT_EQ(stats.max_depth, kCapacity);
+  EXPECT_EQ(stats.num_stalls, 1);
+  EXPECT_GT(stats.stall_time, absl::ZeroDuration());
+}
+
+TEST(ExecutionContext, FullQueueAfterStop) {
+  int results_processed = 0;
+  ExecutionContext ctx(absl::InfiniteFuture(), 1,
+                       [&results_processed](const RunnerDriver::RunResult& r) {
+                         results_processed++;
+                         return false;
+                       });
+  for (int i = 0; i < 16; ++i) {
+    ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
+  }
+  ctx.Stop();
+  // Must neither block nor drop the result.
+  ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
   ctx.ProcessResultQueue();
+  EXPECT_EQ(results_processed, 17);
 }
 
 TEST(ExecutionContext, Multithreaded) {
@@ -76,9 +111,8 @@ TEST(ExecutionContext, Multithreaded) {
                        });
   std::thread worker([&ctx, &posted]() {
     while (!ctx.ShouldStop()) {
-      if (ctx.OfferRunResult(RunnerDriver::RunResult::Successful())) {
-        posted++;
-      }
+      ctx.OfferRunResult(RunnerDriver::RunResult::Successful());
+      posted++;
       absl::SleepFor(absl::Milliseconds(100));
     }
   });
@@ -15,12 +15,18 @@
 #ifndef THIRD_PARTY_SILIFUZZ_PROXIES_ARCH_FEATURE_GENERATOR_H_
 #define THIRD_PARTY_SILIFUZZ_PROXIES_ARCH_FEATURE_GENERATOR_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <memory>
 #include <type_traits>
 
 #include "./proxies/user_features.h"
 #include "./util/bitops.h"
 #include "./util/checks.h"
+#include "./util/simd_bitops.h"
 #include "./util/ucontext/ucontext_types.h"
 
 namespace silifuzz {
@@ -36,6 +42,18 @@ EmitSetBitFeatures(uint64_t domain, uint64_t base, const T &bitmap,
   return base + NumBits<T>();
 }
 
+// Same as above, but uses `kernels` to skip the zero words of the bitmap.
+template <typename T>
+inline std::enable_if_t<!std::is_pointer<T>::value, uint64_t>
+EmitSetBitFeatures(const BitOpsKernels &kernels, uint64_t domain,
+                   uint64_t base, const T &bitmap,
+                   UserFeatures &user_features) {
+  ForEachSetBit(kernels, bitmap, [&](size_t index) {
+    user_features.EmitFeature(domain, base + index);
+  });
+  return base + NumBits<T>();
+}
+
 // Emit a feature if a^b == 1 for each bit.
 template <typename T>
 inline std::enable_if_t<!std::is_pointer<T>::value, uint64_t>
@@ -97,9 +115,7 @@ class ArchFeatureGenerator {
   };
 
  public:
-  ArchFeatureGenerator() : num_instruction_ids_(0), op_info_(nullptr) {}
-
-  ~ArchFeatureGenerator() { delete[] op_info_; }
+  ArchFeatureGenerator() : num_instruction_ids_(0), num_touched_ids_(0) {}
 
   // Disallow copy and move.
   ArchFeatureGenerator(const ArchFeatureGenerator &) = delete;
@@ -116,9 +132,12 @@ class ArchFeatureGenerator {
   // should differentiate between different instructions, but it may
   // differentiate between different instruction encodings.
   void BeforeBatch(uint32_t num_instruction_ids) {
-    CHECK_EQ(op_info_, nullptr);
+    CHECK(op_info_ == nullptr);
     num_instruction_ids_ = num_instruction_ids;
-    op_info_ = new OpInfo[num_instruction_ids_];
+    // Zero-initialized here, and only touched entries are cleared afterwards.
+    op_info_ = std::make_unique<OpInfo[]>(num_instruction_ids_);
+    touched_ids_ = std::make_unique<uint32_t[]>(num_instruction_ids_);
+    num_touched_ids_ = 0;
   }
 
   // Called before processing each input.
@@ -138,7 +157,13 @@ class ArchFeatureGenerator {
     prev_registers_ = current_registers;
     ClearBits(zero_one_);
     ClearBits(one_zero_);
-    memset(op_info_, 0, sizeof(OpInfo) * num_instruction_ids_);
+    // A snippet typically executes a handful of distinct instructions while
+    // the disassembler may have thousands of IDs. Only reset the ones the
+    // previous input used.
+    for (size_t i = 0; i < num_touched_ids_; ++i) {
+      memset(&op_info_[touched_ids_[i]], 0, sizeof(OpInfo));
+    }
+    num_touched_ids_ = 0;
   }
 
   // Called after each instruction has been executed.
@@ -149,13 +174,16 @@ class ArchFeatureGenerator {
                         UContext<Arch> &current_registers) {
     if (instruction_id != kInvalidInstructionId) {
       CHECK_LT(instruction_id, num_instruction_ids_);
-      op_info_[instruction_id].count++;
+      if (op_info_[instruction_id].count++ == 0) {
+        touched_ids_[num_touched_ids_++] = instruction_id;
+      }
 
       // Defer (instruction X toggle) features because they can be fairly high
       // volume unless deduped.
-      AccumulateToggle(prev_registers_, current_registers,
-                       op_info_[instruction_id].zero_one,
-                       op_info_[instruction_id].one_zero);
+      OpInfo &op_info = op_info_[instruction_id];
+      kernels_->accumulate_toggle(&prev_registers_, &current_registers,
+                                  &op_info.zero_one, &op_info.one_zero,
+                                  sizeof(UContext<Arch>));
 
       if (prev_instruction_id_ != kInvalidInstructionId) {
         // Emit (instrution X instruction) feature eagerly because it's sparse
@@ -168,7 +196,8 @@ class ArchFeatureGenerator {
 
     // Defer emitting the simple toggle coverage.
     // The can ~halve the number of features we emit by eliminating redundancy.
-    AccumulateToggle(prev_registers_, current_registers, zero_one_, one_zero_);
+    kernels_->accumulate_toggle(&prev_registers_, &current_registers,
+                                &zero_one_, &one_zero_, sizeof(UContext<Arch>));
 
     // Prepare for the next instruction.
     prev_instruction_id_ = instruction_id;
@@ -180,27 +209,30 @@ class ArchFeatureGenerator {
   // execution.
   void AfterExecution() {
     // Did the register bit toggle at any point during the execution?
-    EmitSetBitFeatures(kRegToggleZeroOneDomain, 0, zero_one_, user_features_);
-    EmitSetBitFeatures(kRegToggleOneZeroDomain, 0, one_zero_, user_features_);
+    EmitSetBitFeatures(*kernels_, kRegToggleZeroOneDomain, 0, zero_one_,
+                       user_features_);
+    EmitSetBitFeatures(*kernels_, kRegToggleOneZeroDomain, 0, one_zero_,
+                       user_features_);
 
     // Is the final register bit different from the initial register bit?
     EmitDiffBitFeatures(kRegDifferenceDomain, 0, initial_registers_,
                         prev_registers_, user_features_);
 
-    // Emit per-op features.
-    for (size_t instruction_id = 0; instruction_id < num_instruction_ids_;
-         ++instruction_id) {
-      if (op_info_[instruction_id].count > 0) {
-        user_features_.EmitFeature(kOpDomain, instruction_id);
-        EmitSetBitFeatures(
-            kOpRegToggleZeroOneDomain,
-            instruction_id * NumBits(op_info_[instruction_id].zero_one),
-            op_info_[instruction_id].zero_one, user_features_);
-        EmitSetBitFeatures(
-            kOpRegToggleOneZeroDomain,
-            instruction_id * NumBits(op_info_[instruction_id].one_zero),
-            op_info_[instruction_id].one_zero, user_features_);
-      }
+    // Emit per-op features for the instructions that were executed. Sorting
+    // keeps the order the features are emitted in independent of execution
+    // order.
+    std::sort(touched_ids_.get(), touched_ids_.get() + num_touched_ids_);
+    for (size_t i = 0; i < num_touched_ids_; ++i) {
+      const uint32_t instruction_id = touched_ids_[i];
+      user_features_.EmitFeature(kOpDomain, instruction_id);
+      EmitSetBitFeatures(
+          *kernels_, kOpRegToggleZeroOneDomain,
+          instruction_id * NumBits(op_info_[instruction_id].zero_one),
+          op_info_[instruction_id].zero_one, user_features_);
+      EmitSetBitFeatures(
+          *kernels_, kOpRegToggleOneZeroDomain,
+          instruction_id * NumBits(op_info_[instruction_id].one_zero),
+          op_info_[instruction_id].one_zero, user_features_);
     }
   }
 
@@ -213,17 +245,30 @@ class ArchFeatureGenerator {
   // TODO(ncbray): make this a hashed domain with a specified address.
   template <size_t N>
   void FinalMemory(uint8_t (&page)[N]) {
-    current_memory_feature_ = EmitSetBitFeatures(
-        kMemDifferenceDomain, current_memory_feature_, page, user_features_);
+    current_memory_feature_ =
+        EmitSetBitFeatures(*kernels_, kMemDifferenceDomain,
+                           current_memory_feature_, page, user_features_);
   }
 
  private:
+  // The vectorized kernels require a whole number of 64-bit words.
+  static_assert(sizeof(UContext<Arch>) % sizeof(uint64_t) == 0);
+
+  // Bit operation kernels for the current CPU.
+  const BitOpsKernels *kernels_ = &GetBitOpsKernels();
+
   // Raw user features.
   UserFeatures user_features_;
 
   // Per-instruction-ID information.
   uint32_t num_instruction_ids_;
-  OpInfo *op_info_;
+  std::unique_ptr<OpInfo[]> op_info_;
+
+  // IDs with a non-zero count in `op_info_`. In order of first execution
+  // until AfterExecution() sorts them.
+  // Has room for every ID, so it can never overflow.
+  std::unique_ptr<uint32_t[]> touched_ids_;
+  size_t num_touched_ids_;
 
   // Initial register state.
   UContext<Arch> initial_registers_;
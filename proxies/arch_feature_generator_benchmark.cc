@@ -0,0 +1,116 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark of the per-input bookkeeping cost of ArchFeatureGenerator.
+//
+// To run:
+//
+// bazel run -c opt third_party/silifuzz/proxies:arch_feature_generator_benchmark
+//
+// Simulates inputs that execute a few hundred instructions drawn from a small
+// set of distinct instruction IDs, which is typical for fuzzing inputs, using
+// the instruction ID spaces of the disassemblers the proxies use. The per-input
+// cost should not depend on the size of the ID space.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "./instruction/capstone_disassembler.h"
+#include "./instruction/xed_disassembler.h"
+#include "./proxies/arch_feature_generator.h"
+#include "./proxies/user_features.h"
+#include "./util/arch.h"
+#include "./util/checks.h"
+#include "./util/ucontext/ucontext_types.h"
+
+namespace silifuzz {
+namespace {
+
+user_feature_t features[100000];
+
+constexpr size_t kInstructionsPerInput = 200;
+
+template <typename Arch>
+void BenchmarkIdSpace(const char* name, uint32_t num_instruction_ids,
+                      size_t num_distinct_ids) {
+  ArchFeatureGenerator<Arch> feature_gen;
+  feature_gen.BeforeBatch(num_instruction_ids);
+
+  // Pre-generate the executed instructions and register states so that only
+  // the feature generator is measured.
+  std::mt19937_64 rng(0);
+  std::vector<uint32_t> distinct_ids(num_distinct_ids);
+  for (uint32_t& id : distinct_ids) {
+    id = rng() % num_instruction_ids;
+  }
+  std::vector<uint32_t> ids(kInstructionsPerInput);
+  std::vector<UContext<Arch>> registers(kInstructionsPerInput + 1);
+  for (size_t i = 0; i < kInstructionsPerInput; ++i) {
+    ids[i] = distinct_ids[rng() % num_distinct_ids];
+  }
+  for (UContext<Arch>& ucontext : registers) {
+    memset(&ucontext, 0, sizeof(ucontext));
+    // Toggle a few register bits per instruction.
+    uint64_t* words = reinterpret_cast<uint64_t*>(&ucontext);
+    for (size_t i = 0; i < 4; ++i) {
+      words[rng() % (sizeof(ucontext) / sizeof(uint64_t))] = rng();
+    }
+  }
+
+  const absl::Duration kBenchmarkDuration = absl::Seconds(1);
+  size_t num_inputs = 0;
+  const absl::Time start = absl::Now();
+  absl::Duration elapsed;
+  do {
+    feature_gen.BeforeInput(features);
+    feature_gen.BeforeExecution(registers[0]);
+    for (size_t i = 0; i < kInstructionsPerInput; ++i) {
+      feature_gen.AfterInstruction(ids[i], registers[i + 1]);
+    }
+    feature_gen.AfterExecution();
+    ++num_inputs;
+    elapsed = absl::Now() - start;
+  } while (elapsed < kBenchmarkDuration);
+
+  LOG_INFO(name, " (", num_instruction_ids, " IDs, ", num_distinct_ids,
+           " distinct per input): ",
+           static_cast<int64_t>(num_inputs / absl::ToDoubleSeconds(elapsed)),
+           " inputs/sec");
+}
+
+int BenchmarkMain() {
+  const uint32_t xed_ids = XedDisassembler().NumInstructionIDs();
+  const uint32_t capstone_x86_64_ids =
+      CapstoneDisassembler<X86_64>().NumInstructionIDs();
+  const uint32_t capstone_aarch64_ids =
+      CapstoneDisassembler<AArch64>().NumInstructionIDs();
+  for (size_t num_distinct_ids : {4, 32}) {
+    BenchmarkIdSpace<X86_64>("XED", xed_ids, num_distinct_ids);
+    BenchmarkIdSpace<X86_64>("Capstone x86_64", capstone_x86_64_ids,
+                             num_distinct_ids);
+    BenchmarkIdSpace<AArch64>("Capstone aarch64", capstone_aarch64_ids,
+                              num_distinct_ids);
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace silifuzz
+
+int main() { return silifuzz::BenchmarkMain(); }
@@ -0,0 +1,114 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark of the per-input cost of loading a snippet into the Unicorn
+// proxies' tracer, without executing it.
+//
+// To run:
+//
+// bazel run -c opt third_party/silifuzz/proxies:snippet_setup_benchmark
+//
+// For each architecture, this reports how many inputs per second
+// UnicornTracer::ResetSnippet() loads into a reused engine, and how many
+// inputs per second are converted into a Snapshot and back into registers,
+// which is what loading an input used to involve on top of the engine setup.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "./common/proxy_config.h"
+#include "./common/raw_insns_util.h"
+#include "./common/snapshot.h"
+#include "./common/snapshot_test_config.h"
+#include "./common/snapshot_test_enum.h"
+#include "./common/snapshot_util.h"
+#include "./tracing/unicorn_tracer.h"
+#include "./util/arch.h"
+#include "./util/checks.h"
+#include "./util/ucontext/ucontext_types.h"
+
+namespace silifuzz {
+namespace {
+
+constexpr TestSnapshot kSnippets[] = {
+    TestSnapshot::kEndsAsExpected,
+    TestSnapshot::kSetThreeRegisters,
+    TestSnapshot::kSigSegvWrite,
+    TestSnapshot::kRunaway,
+};
+
+// Returns the number of times `load` ran per second when loading all of
+// `snippets` over and over.
+template <typename F>
+double MeasureLoadsPerSecond(const std::vector<std::string>& snippets,
+                             F&& load) {
+  const absl::Duration kBenchmarkDuration = absl::Seconds(2);
+  size_t num_loads = 0;
+  const absl::Time start = absl::Now();
+  absl::Duration elapsed;
+  do {
+    for (const std::string& instructions : snippets) {
+      load(instructions);
+      ++num_loads;
+    }
+    elapsed = absl::Now() - start;
+  } while (elapsed < kBenchmarkDuration);
+  return num_loads / absl::ToDoubleSeconds(elapsed);
+}
+
+template <typename Arch>
+void RunBenchmark() {
+  std::vector<std::string> snippets;
+  for (TestSnapshot test : kSnippets) {
+    snippets.push_back(GetTestSnippet<Arch>(test));
+  }
+  LOG_INFO("Benchmarking ", Arch::arch_name);
+
+  UnicornTracer<Arch> tracer;
+  const double reset =
+      MeasureLoadsPerSecond(snippets, [&](const std::string& instructions) {
+        CHECK_STATUS(tracer.ResetSnippet(instructions));
+      });
+  LOG_INFO("  ResetSnippet: ", static_cast<int64_t>(reset), " inputs/sec");
+
+  const double snapshot =
+      MeasureLoadsPerSecond(snippets, [](const std::string& instructions) {
+        absl::StatusOr<Snapshot> snapshot = InstructionsToSnapshot<Arch>(
+            instructions, DEFAULT_FUZZING_CONFIG<Arch>);
+        CHECK_STATUS(snapshot.status());
+        UContext<Arch> ucontext;
+        CHECK_STATUS(ConvertRegsFromSnapshot(snapshot->registers(),
+                                             &ucontext.gregs,
+                                             &ucontext.fpregs));
+      });
+  LOG_INFO("  Snapshot round trip: ", static_cast<int64_t>(snapshot),
+           " inputs/sec");
+}
+
+int BenchmarkMain() {
+  RunBenchmark<X86_64>();
+  RunBenchmark<AArch64>();
+  return 0;
+}
+
+}  // namespace
+}  // namespace silifuzz
+
+int main() { return silifuzz::BenchmarkMain(); }
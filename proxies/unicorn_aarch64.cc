@@ -51,6 +51,10 @@ class BatchState {
 
   DefaultDisassembler<AArch64> disasm;
   ArchFeatureGenerator<AArch64> feature_gen;
+
+  // Reused for every input in the batch. Creating a new Unicorn engine per
+  // input costs more than emulating a typical input.
+  UnicornTracer<AArch64> tracer;
 };
 
 BatchState *batch;
@@ -76,9 +80,9 @@ absl::Status RunAArch64Instructions(
   ArchFeatureGenerator<AArch64> &feature_gen = batch->feature_gen;
 
   UnicornTracerConfig<AArch64> tracer_config{.force_a72 = true};
-  UnicornTracer<AArch64> tracer;
+  UnicornTracer<AArch64> &tracer = batch->tracer;
   RETURN_IF_NOT_OK(
-      tracer.InitSnippet(instructions, tracer_config, fuzzing_config));
+      tracer.ResetSnippet(instructions, tracer_config, fuzzing_config));
 
   feature_gen.BeforeInput(features);
 
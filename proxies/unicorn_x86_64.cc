@@ -23,6 +23,7 @@
 #include "./proxies/arch_feature_generator.h"
 #include "./proxies/user_features.h"
 #include "./tracing/unicorn_tracer.h"
+#include "./tracing/x86_64_written_registers.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
 #include "./util/ucontext/ucontext_types.h"
@@ -51,6 +52,10 @@ class BatchState {
 
   DefaultDisassembler<X86_64> disasm;
   ArchFeatureGenerator<X86_64> feature_gen;
+
+  // Reused for every input in the batch. Creating a new Unicorn engine per
+  // input costs more than emulating a typical input.
+  UnicornTracer<X86_64> tracer;
 };
 
 BatchState *batch;
@@ -67,9 +72,9 @@ absl::Status RunInstructions(absl::string_view instructions,
   ArchFeatureGenerator<X86_64> &feature_gen = batch->feature_gen;
 
   UnicornTracerConfig<X86_64> tracer_config{};
-  UnicornTracer<X86_64> tracer;
+  UnicornTracer<X86_64> &tracer = batch->tracer;
   RETURN_IF_NOT_OK(
-      tracer.InitSnippet(instructions, tracer_config, fuzzing_config));
+      tracer.ResetSnippet(instructions, tracer_config, fuzzing_config));
 
   feature_gen.BeforeInput(features);
 
@@ -82,10 +87,14 @@ absl::Status RunInstructions(absl::string_view instructions,
   // instruction.
   uint32_t instruction_id = kInvalidInstructionId;
   bool instruction_pending = false;
+  // The registers the pending instruction can write. Only these need to be
+  // read back after it executes, the rest of `registers` is still current.
+  UnicornTracer<X86_64>::RegisterMask written_registers =
+      UnicornTracer<X86_64>::kAllRegisters;
 
   auto after_instruction = [&]() {
     if (instruction_pending) {
-      tracer.GetRegisters(registers);
+      tracer.GetRegisters(registers, written_registers);
       feature_gen.AfterInstruction(instruction_id, registers);
       instruction_pending = false;
     }
@@ -119,8 +128,10 @@ absl::Status RunInstructions(absl::string_view instructions,
           // case because it can make the snippet hard to disassemble.
           instructions_are_in_range &=
               tracer->InstructionIsInRange(address, disasm.InstructionSize());
+          written_registers = WrittenRegisterMask(disasm.DecodedInstruction());
         } else {
           instruction_id = kInvalidInstructionId;
+          written_registers = UnicornTracer<X86_64>::kAllRegisters;
         }
 
         instruction_pending = true;
@@ -66,7 +66,8 @@ std::optional<Endpoint> EndSpotToEndpoint(const EndSpot& actual_endspot) {
       return Endpoint(Endpoint::kSigBus, actual_endspot.sig_address, pc);
     }
     case SIGXCPU:
-    case SIGALRM: {
+    case SIGALRM:
+    case SIGPROF: {
       // a runaway; endpoint is where it got stopped
       return Endpoint(pc);
     }
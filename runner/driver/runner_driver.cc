@@ -22,6 +22,7 @@
 #include <unistd.h>
 
 #include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 #include <optional>
@@ -33,12 +34,15 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "google/protobuf/text_format.h"
 #include "./common/harness_tracer.h"
 #include "./common/snapshot.h"
 #include "./player/player_result_proto.h"
 #include "./proto/snapshot_execution_result.pb.h"
 #include "./runner/driver/runner_options.h"
+#include "./runner/driver/runner_server_client.h"
+#include "./runner/runner_result_format.h"
 #include "./snap/gen/relocatable_snap_generator.h"
 #include "./util/arch.h"
 #include "./util/byte_io.h"
@@ -71,6 +75,15 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::TraceOne(
                  cb);
 }
 
+absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::TraceAndVerifyOne(
+    absl::string_view snap_id, HarnessTracer::Callback cb,
+    size_t num_iterations) const {
+  CHECK(!snap_id.empty());
+  RunnerOptions opts = RunnerOptions::TraceOptions(snap_id, num_iterations);
+  opts.set_disable_aslr(false);
+  return RunImpl(opts, snap_id, cb);
+}
+
 absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::VerifyOneRepeatedly(
     absl::string_view snap_id, int num_attempts) const {
   CHECK(!snap_id.empty());
@@ -112,6 +125,9 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::RunImpl(
   if (runner_options.sequential_mode()) {
     argv.push_back("--sequential_mode");
   }
+  if (runner_options.report_startup_time()) {
+    argv.push_back("--report_startup_time");
+  }
   // Pass-thru VLOG levels to the runner.
   if (VLOG_IS_ON(1)) {
     argv.push_back("--v=1");
@@ -129,6 +145,16 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::RunImpl(
     argv.push_back(corpus_path_);
   }
 
+  if (server_ != nullptr && !trace_cb.has_value() &&
+      RunnerServerClient::CanServe(runner_options)) {
+    std::string runner_stdout;
+    int exit_status = 0;
+    RETURN_IF_NOT_OK(server_->Run(runner_options,
+                                  absl::MakeConstSpan(argv).subspan(1),
+                                  &runner_stdout, &exit_status));
+    return HandleRunnerOutput(runner_stdout, exit_status, snap_id);
+  }
+
   if (runner_options.map_stderr_to_dev_null()) {
     options.MapStderr(Subprocess::kMapToDevNull);
   }
@@ -160,6 +186,24 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::RunImpl(
 absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::HandleRunnerOutput(
     absl::string_view runner_stdout, int exit_status,
     absl::string_view snapshot_id) const {
+  std::optional<absl::Duration> startup_time;
+  uint64_t startup_time_usec;
+  if (ParseRunnerStartupTimeRecord(runner_stdout.data(), runner_stdout.size(),
+                                   &startup_time_usec)) {
+    startup_time = absl::Microseconds(startup_time_usec);
+    runner_stdout.remove_prefix(kRunnerStartupTimeRecordSize);
+  }
+  absl::StatusOr<RunResult> result =
+      HandleRunnerResult(runner_stdout, exit_status, snapshot_id);
+  if (result.ok()) {
+    result->set_startup_time(startup_time);
+  }
+  return result;
+}
+
+absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::HandleRunnerResult(
+    absl::string_view runner_stdout, int exit_status,
+    absl::string_view snapshot_id) const {
   VLOG_INFO(3, absl::StrCat("Snapshot [", snapshot_id,
                             "] runner exit status = ", HexStr(exit_status)));
   if (WIFSIGNALED(exit_status)) {
@@ -194,14 +238,30 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::HandleRunnerOutput(
       VLOG_INFO(1, "Runner process timed out");
       return RunResult::Successful();
     }
-    google::protobuf::TextFormat::Parser parser;
     proto::SnapshotExecutionResult exec_result_proto;
-    if (!parser.ParseFromString(std::string(runner_stdout),
-                                &exec_result_proto)) {
-      return absl::InternalError(
-          absl::StrCat("couldn't parse [", runner_stdout,
-                       "] as proto::SnapshotExecutionResult. Exit status = ",
-                       HexStr(exit_status)));
+    uint64_t payload_size;
+    if (ParseBinaryRunnerResultHeader(runner_stdout.data(),
+                                      runner_stdout.size(), &payload_size)) {
+      absl::string_view payload =
+          runner_stdout.substr(kBinaryRunnerResultHeaderSize);
+      if (payload.size() != payload_size ||
+          !exec_result_proto.ParseFromArray(payload.data(), payload.size())) {
+        return absl::InternalError(absl::StrCat(
+            "couldn't parse ", runner_stdout.size(),
+            " bytes of binary runner output as "
+            "proto::SnapshotExecutionResult. Exit status = ",
+            HexStr(exit_status)));
+      }
+    } else {
+      // Runners started with --text_result write text protos.
+      google::protobuf::TextFormat::Parser parser;
+      if (!parser.ParseFromString(std::string(runner_stdout),
+                                  &exec_result_proto)) {
+        return absl::InternalError(
+            absl::StrCat("couldn't parse [", runner_stdout,
+                         "] as proto::SnapshotExecutionResult. Exit status = ",
+                         HexStr(exit_status)));
+      }
     }
     if (!snapshot_id.empty() &&
         exec_result_proto.snapshot_id() != snapshot_id) {
@@ -225,7 +285,8 @@ absl::StatusOr<RunnerDriver::RunResult> RunnerDriver::HandleRunnerOutput(
 }
 
 absl::StatusOr<RunnerDriver> RunnerDriverFromSnapshot(
-    const Snapshot& snapshot, absl::string_view runner_path) {
+    const Snapshot& snapshot, absl::string_view runner_path,
+    RunnerServerClient* server) {
   std::vector<Snapshot> corpus;
   corpus.push_back(snapshot.Copy());
 
@@ -273,8 +334,10 @@ absl::StatusOr<RunnerDriver> RunnerDriverFromSnapshot(
   // Synthesize a fake corpus name.
   std::string corpus_name = "snapshot_" + snapshot.id();
 
-  return RunnerDriver::ReadingRunner(runner_path, corpus_path, corpus_name,
-                                     [memfd] { close(memfd); });
+  RunnerDriver driver = RunnerDriver::ReadingRunner(
+      runner_path, corpus_path, corpus_name, [memfd] { close(memfd); });
+  driver.UseServer(server);
+  return driver;
 }
 
 }  // namespace silifuzz
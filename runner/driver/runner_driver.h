@@ -24,10 +24,12 @@
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "./common/harness_tracer.h"
 #include "./common/snapshot.h"
 #include "./common/snapshot_enums.h"
 #include "./runner/driver/runner_options.h"
+#include "./runner/driver/runner_server_client.h"
 #include "./util/checks.h"
 
 namespace silifuzz {
@@ -91,6 +93,14 @@ class RunnerDriver {
       return *player_result_;
     }
 
+    // Wall time the runner spent loading and mapping the corpus before
+    // executing any snap. Only available if the runner was asked to report it
+    // with RunnerOptions::set_report_startup_time().
+    std::optional<absl::Duration> startup_time() const { return startup_time_; }
+    void set_startup_time(std::optional<absl::Duration> startup_time) {
+      startup_time_ = startup_time;
+    }
+
    private:
     // Constructs a new RunResult with the given success status and no
     // associated `player_result`.
@@ -105,6 +115,9 @@ class RunnerDriver {
 
     // Snapshot id (if any).
     std::string snapshot_id_;
+
+    // See startup_time().
+    std::optional<absl::Duration> startup_time_;
   };
 
   // Creates a RunnerDriver for a binary with baked-in corpus.
@@ -152,6 +165,13 @@ class RunnerDriver {
                                      HarnessTracer::Callback cb,
                                      size_t num_iterations = 1) const;
 
+  // Like TraceOne() but with ASLR enabled like VerifyOneRepeatedly(). The
+  // runner checks the end state of every iteration, so iterations the
+  // callback does not single-step verify `snap_id` replays deterministically.
+  absl::StatusOr<RunResult> TraceAndVerifyOne(absl::string_view snap_id,
+                                              HarnessTracer::Callback cb,
+                                              size_t num_iterations) const;
+
   // Ensures that `snap_id` replays deterministically.
   // REQUIRES snap_id is not empty.
   absl::StatusOr<RunResult> VerifyOneRepeatedly(absl::string_view snap_id,
@@ -163,6 +183,17 @@ class RunnerDriver {
   // calling the binary that is intended for screening.
   absl::StatusOr<RunResult> Run(const RunnerOptions& runner_options) const;
 
+  // Dispatches subsequent invocations to the long-lived runner server(s)
+  // managed by `server` instead of spawning a new runner process every time.
+  // Invocations that cannot be served (tracing, wall time budgets, ASLR
+  // enabled) still spawn a new process. See RunnerServerClient for other
+  // limitations. Passing nullptr restores the default behavior. `server` must
+  // outlive this object and wrap the same runner binary.
+  void UseServer(RunnerServerClient* server) {
+    CHECK(server == nullptr || server->binary_path() == binary_path_);
+    server_ = server;
+  }
+
  private:
   // Wraps the binary at `binary_path`. When `corpus_path` not empty, it will
   // be passed as the last argument to the binary.
@@ -204,11 +235,19 @@ class RunnerDriver {
       absl::string_view runner_stdout, int exit_status,
       absl::string_view snapshot_id = "") const;
 
+  // Like HandleRunnerOutput() but `runner_stdout` has no startup time record.
+  absl::StatusOr<RunResult> HandleRunnerResult(
+      absl::string_view runner_stdout, int exit_status,
+      absl::string_view snapshot_id) const;
+
   // C-tor parameters.
   std::string binary_path_;
   std::string corpus_path_;
   std::string corpus_name_;
 
+  // Optional runner server. See UseServer().
+  RunnerServerClient* server_ = nullptr;
+
   // Cleanup callback handle. Wraps the user-provided `cleanup` std::function in
   // a container with "at most once" cleanup semantics. When an instance of this
   // class is moved, the handle is moved with it and the moved-from
@@ -219,9 +258,12 @@ class RunnerDriver {
 };
 
 // Compiles `snapshot` into a runner binary containing exactly one snap.
+// If `server` is not null, the resulting RunnerDriver dispatches invocations
+// to it (see RunnerDriver::UseServer()).
 // RETURNS RunnerDriver wrapping the runner executable file or a status.
 absl::StatusOr<RunnerDriver> RunnerDriverFromSnapshot(
-    const Snapshot& snapshot, absl::string_view runner_path);
+    const Snapshot& snapshot, absl::string_view runner_path,
+    RunnerServerClient* server = nullptr);
 
 }  // namespace silifuzz
 
@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <filesystem>  // NOLINT
+#include <string>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -28,6 +29,8 @@
 #include "./common/snapshot.h"
 #include "./common/snapshot_enums.h"
 #include "./common/snapshot_test_enum.h"
+#include "./runner/driver/runner_options.h"
+#include "./runner/driver/runner_server_client.h"
 #include "./runner/runner_provider.h"
 #include "./snap/testing/snap_test_snapshots.h"
 #include "./util/arch.h"
@@ -115,6 +118,44 @@ TEST(RunnerDriver, MaxPageToAddOption) {
   EXPECT_TRUE(found_new_memory_bytes);
 }
 
+TEST(RunnerDriver, TextResult) {
+  RunnerDriver driver = HelperDriver();
+  const std::string snap_id = EnumStr(TestSnapshot::kSigSegvReadFixable);
+  ASSERT_OK_AND_ASSIGN(RunnerDriver::RunResult binary_result,
+                       driver.MakeOne(snap_id, /*max_pages_to_add=*/1));
+  RunnerOptions text_options =
+      RunnerOptions::MakeOptions(snap_id, /*max_pages_to_add=*/1);
+  // Same as MakeOptions() plus --text_result.
+  text_options.set_extra_argv({"--snap_id", snap_id, "--num_iterations", "1",
+                               "--make", "--max_pages_to_add", "1",
+                               "--text_result"});
+  ASSERT_OK_AND_ASSIGN(RunnerDriver::RunResult text_result,
+                       driver.Run(text_options));
+
+  // Both formats should describe the same result. The text format splits
+  // memory into pages, so only compare the memory contents.
+  EXPECT_EQ(text_result.snapshot_id(), binary_result.snapshot_id());
+  EXPECT_EQ(text_result.player_result().outcome,
+            binary_result.player_result().outcome);
+  ASSERT_TRUE(text_result.player_result().actual_end_state.has_value());
+  ASSERT_TRUE(binary_result.player_result().actual_end_state.has_value());
+  const Snapshot::EndState& text_end_state =
+      *text_result.player_result().actual_end_state;
+  const Snapshot::EndState& binary_end_state =
+      *binary_result.player_result().actual_end_state;
+  EXPECT_EQ(text_end_state.endpoint(), binary_end_state.endpoint());
+  EXPECT_EQ(text_end_state.registers(), binary_end_state.registers());
+  auto concatenated_memory = [](const Snapshot::EndState& end_state) {
+    std::string bytes;
+    for (const auto& memory_bytes : end_state.memory_bytes()) {
+      bytes.append(memory_bytes.byte_values());
+    }
+    return bytes;
+  };
+  EXPECT_EQ(concatenated_memory(text_end_state),
+            concatenated_memory(binary_end_state));
+}
+
 TEST(RunnerDriver, BasicTrace) {
   RunnerDriver driver = HelperDriver();
   Snapshot endAsExpectedSnap =
@@ -139,6 +180,63 @@ TEST(RunnerDriver, BasicTrace) {
   ASSERT_TRUE(hit_initial_snap_rip);
 }
 
+TEST(RunnerDriver, ServerMode) {
+  RunnerServerClient server(RunnerLocation());
+  RunnerDriver driver = HelperDriver();
+  driver.UseServer(&server);
+
+  auto run_result_or = driver.PlayOne(EnumStr(TestSnapshot::kEndsAsExpected));
+  ASSERT_OK(run_result_or);
+  ASSERT_TRUE(run_result_or->success());
+
+  // A snap killed by seccomp must not take down the server.
+  run_result_or = driver.PlayOne(EnumStr(TestSnapshot::kSyscall));
+  ASSERT_THAT(run_result_or,
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("syscall")));
+
+  auto make_result_or = driver.MakeOne(EnumStr(TestSnapshot::kSigSegvRead));
+  ASSERT_OK(make_result_or);
+  ASSERT_FALSE(make_result_or->success());
+  ASSERT_EQ(make_result_or->player_result().outcome,
+            PlaybackOutcome::kExecutionMisbehave);
+  ASSERT_EQ(make_result_or->snapshot_id(), EnumStr(TestSnapshot::kSigSegvRead));
+
+  EXPECT_EQ(server.num_requests(), 3);
+  // Play and make use different stderr mappings and thus different servers.
+  EXPECT_EQ(server.num_server_starts(), 2);
+
+  // Verification runs with ASLR and needs a fresh process every time.
+  auto verify_result_or =
+      driver.VerifyOneRepeatedly(EnumStr(TestSnapshot::kEndsAsExpected), 2);
+  ASSERT_OK(verify_result_or);
+  ASSERT_TRUE(verify_result_or->success());
+  EXPECT_EQ(server.num_requests(), 3);
+}
+
+TEST(RunnerDriver, ReportStartupTime) {
+  RunnerServerClient server(RunnerLocation());
+  RunnerDriver driver = HelperDriver();
+  const std::string snap_id = EnumStr(TestSnapshot::kSigSegvRead);
+  RunnerOptions options = RunnerOptions::MakeOptions(snap_id);
+  auto run_result_or = driver.Run(options);
+  ASSERT_OK(run_result_or);
+  EXPECT_FALSE(run_result_or->startup_time().has_value());
+
+  // The result is still parsed after the startup time record, with and
+  // without a server.
+  options.set_report_startup_time(true);
+  for (bool use_server : {false, true}) {
+    if (use_server) driver.UseServer(&server);
+    run_result_or = driver.Run(options);
+    ASSERT_OK(run_result_or);
+    ASSERT_FALSE(run_result_or->success());
+    EXPECT_EQ(run_result_or->snapshot_id(), snap_id);
+    ASSERT_TRUE(run_result_or->startup_time().has_value());
+    EXPECT_GT(*run_result_or->startup_time(), absl::ZeroDuration());
+  }
+  EXPECT_EQ(server.num_requests(), 1);
+}
+
 TEST(RunnerDriver, Cleanup) {
   auto tmp_binary = CreateTempFile("binary");
   ASSERT_OK(tmp_binary);
@@ -65,6 +65,11 @@ class RunnerOptions {
     return *this;
   }
 
+  RunnerOptions& set_report_startup_time(bool report_startup_time) {
+    this->report_startup_time_ = report_startup_time;
+    return *this;
+  }
+
   int cpu() const { return cpu_; }
   absl::Duration cpu_time_budget() const { return cpu_time_budget_; }
   absl::Duration wall_time_budget() const { return wall_time_budget_; }
@@ -73,6 +78,7 @@ class RunnerOptions {
   bool disable_aslr() const { return disable_aslr_; }
   bool sequential_mode() const { return sequential_mode_; }
   bool map_stderr_to_dev_null() const { return map_stderr_to_dev_null_; }
+  bool report_startup_time() const { return report_startup_time_; }
 
   RunnerOptions(const RunnerOptions&) = default;
   RunnerOptions(RunnerOptions&&) = default;
@@ -120,6 +126,10 @@ class RunnerOptions {
 
   // If true, map runner's stderr to /dev/null.
   bool map_stderr_to_dev_null_ = false;
+
+  // If true, the runner reports how long it took to get the corpus ready. See
+  // RunnerDriver::RunResult::startup_time().
+  bool report_startup_time_ = false;
 };
 
 }  // namespace silifuzz
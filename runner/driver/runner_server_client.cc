@@ -0,0 +1,204 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./runner/driver/runner_server_client.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "./runner/driver/runner_options.h"
+#include "./runner/runner_result_format.h"
+#include "./runner/runner_server_protocol.h"
+#include "./util/byte_io.h"
+#include "./util/checks.h"
+#include "./util/subprocess.h"
+
+namespace silifuzz {
+
+RunnerServerClient::~RunnerServerClient() {
+  while (!servers_.empty()) {
+    StopServer(servers_.begin()->first);
+  }
+}
+
+// static
+RunnerServerClient& RunnerServerClient::ForCurrentThread(
+    absl::string_view binary_path) {
+  thread_local std::unique_ptr<RunnerServerClient> client;
+  if (client == nullptr || client->binary_path() != binary_path) {
+    client = std::make_unique<RunnerServerClient>(binary_path);
+  }
+  return *client;
+}
+
+// static
+bool RunnerServerClient::CanServe(const RunnerOptions& runner_options) {
+  return runner_options.disable_aslr() &&
+         runner_options.wall_time_budget() == absl::InfiniteDuration();
+}
+
+absl::StatusOr<Subprocess*> RunnerServerClient::GetServer(
+    const RunnerOptions& runner_options) {
+  const ServerKey key = runner_options.map_stderr_to_dev_null();
+  auto it = servers_.find(key);
+  if (it != servers_.end()) {
+    return it->second.get();
+  }
+
+  Subprocess::Options options = Subprocess::Options::Default();
+  options.DisableAslr(true)
+      .SetParentDeathSignal(SIGKILL)
+      .PipeStdin(true);
+  if (runner_options.map_stderr_to_dev_null()) {
+    options.MapStderr(Subprocess::kMapToDevNull);
+  }
+  auto server = std::make_unique<Subprocess>(options);
+  RETURN_IF_NOT_OK(server->Start({binary_path_, "--server"}));
+  ++num_server_starts_;
+  VLOG_INFO(1, "Started runner server ", server->pid(), " for ",
+            binary_path_);
+  Subprocess* result = server.get();
+  servers_.emplace(key, std::move(server));
+  return result;
+}
+
+void RunnerServerClient::StopServer(const ServerKey& key) {
+  auto it = servers_.find(key);
+  if (it == servers_.end()) return;
+  Subprocess* server = it->second.get();
+  if (server->pid() != -1) {
+    // A server that is healthy exits once its stdin is closed. Kill it anyway
+    // so that a misbehaving server cannot block us.
+    kill(server->pid(), SIGKILL);
+    std::string unused_output;
+    server->Communicate(&unused_output);
+  }
+  servers_.erase(it);
+}
+
+absl::Status RunnerServerClient::Run(const RunnerOptions& runner_options,
+                                     absl::Span<const std::string> args,
+                                     std::string* stdout_output,
+                                     int* exit_status) {
+  CHECK(CanServe(runner_options));
+  int64_t cpu_time_budget_sec = 0;
+  if (runner_options.cpu_time_budget() != absl::InfiniteDuration()) {
+    cpu_time_budget_sec =
+        absl::ToInt64Seconds(runner_options.cpu_time_budget());
+  }
+  std::string request = absl::StrCat(cpu_time_budget_sec);
+  for (const std::string& arg : args) {
+    if (arg.find(kRunnerServerFieldSeparator) != std::string::npos ||
+        arg.find('\n') != std::string::npos) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Cannot pass [", arg, "] to runner server"));
+    }
+    request.push_back(kRunnerServerFieldSeparator);
+    request.append(arg);
+  }
+  request.push_back('\n');
+  if (request.size() > kRunnerServerMaxRequestSize ||
+      args.size() + 1 > kRunnerServerMaxRequestArgs) {
+    return absl::InvalidArgumentError("Runner server request too large");
+  }
+
+  const ServerKey key = runner_options.map_stderr_to_dev_null();
+  ASSIGN_OR_RETURN_IF_NOT_OK(Subprocess * server, GetServer(runner_options));
+  ++num_requests_;
+  if (Write(server->child_stdin(), request.data(), request.size()) !=
+      static_cast<ssize_t>(request.size())) {
+    StopServer(key);
+    return absl::InternalError("Cannot send request to runner server");
+  }
+
+  // Read until we see the complete trailer i.e. "\n<trailer><status>\n".
+  const std::string trailer_prefix =
+      absl::StrCat("\n", kRunnerServerReplyTrailer);
+  std::string reply;
+  size_t scan_from = 0;
+  while (true) {
+    char buffer[4096];
+    ssize_t n = read(server->child_stdout(), buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      StopServer(key);
+      return absl::InternalError(
+          absl::StrCat("Runner server died while serving request: ", request));
+    }
+    reply.append(buffer, n);
+    // A binary runner result can contain any bytes, including the trailer.
+    // Do not look for the trailer inside it once it is complete. The result
+    // follows the startup time record if the runner wrote one.
+    size_t result_start = 0;
+    uint64_t startup_time_usec;
+    if (ParseRunnerStartupTimeRecord(reply.data(), reply.size(),
+                                     &startup_time_usec)) {
+      result_start = kRunnerStartupTimeRecordSize;
+      scan_from = std::max(scan_from, result_start);
+    }
+    uint64_t payload_size;
+    if (ParseBinaryRunnerResultHeader(reply.data() + result_start,
+                                      reply.size() - result_start,
+                                      &payload_size)) {
+      const size_t result_end =
+          result_start + kBinaryRunnerResultHeaderSize + payload_size;
+      if (reply.size() >= result_end) {
+        scan_from = std::max(scan_from, result_end);
+      }
+    }
+    size_t trailer_pos = reply.find(trailer_prefix, scan_from);
+    if (trailer_pos == std::string::npos) {
+      // The trailer may straddle two reads.
+      scan_from = reply.size() > trailer_prefix.size()
+                      ? reply.size() - trailer_prefix.size()
+                      : 0;
+      continue;
+    }
+    scan_from = trailer_pos;
+    size_t status_pos = trailer_pos + trailer_prefix.size();
+    size_t eol_pos = reply.find('\n', status_pos);
+    if (eol_pos == std::string::npos) continue;
+    if (eol_pos + 1 != reply.size()) {
+      StopServer(key);
+      return absl::InternalError("Unexpected output after server reply");
+    }
+    absl::string_view status_str(reply.data() + status_pos,
+                                 eol_pos - status_pos);
+    if (!absl::SimpleAtoi(status_str, exit_status)) {
+      StopServer(key);
+      return absl::InternalError(
+          absl::StrCat("Bad runner server status [", status_str, "]"));
+    }
+    reply.resize(trailer_pos);
+    *stdout_output = std::move(reply);
+    return absl::OkStatus();
+  }
+}
+
+}  // namespace silifuzz
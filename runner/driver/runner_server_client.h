@@ -0,0 +1,122 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_RUNNER_DRIVER_RUNNER_SERVER_CLIENT_H_
+#define THIRD_PARTY_SILIFUZZ_RUNNER_DRIVER_RUNNER_SERVER_CLIENT_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "./runner/driver/runner_options.h"
+#include "./util/subprocess.h"
+
+namespace silifuzz {
+
+// RunnerServerClient keeps long-lived runner processes started with --server
+// (see runner/runner_server_protocol.h) and dispatches runner invocations to
+// them instead of spawning a new runner process for every invocation.
+//
+// A server is started lazily for every distinct process-level stderr mapping
+// because that cannot be changed after the server has started. A server that
+// dies is restarted on the next request. Snap failures, including crashes and
+// seccomp violations, only terminate the per-request child and never the
+// server itself.
+//
+// Limitations:
+//  * Only runs with ASLR disabled are served, see CanServe(). Verification,
+//    e.g. SnapMaker::VerifyPlaysDeterministically(), runs with ASLR enabled
+//    and always spawns a fresh runner process. A server with ASLR enabled
+//    would not help: its children all inherit the server's layout.
+//  * A server only saves the runner process startup. Callers that build a
+//    corpus per snapshot, e.g. RunnerDriverFromSnapshot(), still generate and
+//    seal a new memfd corpus for every call.
+//
+// This class is thread-compatible. Use one instance per worker thread, e.g.
+// via ForCurrentThread().
+class RunnerServerClient {
+ public:
+  explicit RunnerServerClient(absl::string_view binary_path)
+      : binary_path_(binary_path) {}
+
+  // Not movable or copyable. Owns child processes.
+  RunnerServerClient(const RunnerServerClient&) = delete;
+  RunnerServerClient& operator=(const RunnerServerClient&) = delete;
+  RunnerServerClient(RunnerServerClient&&) = delete;
+  RunnerServerClient& operator=(RunnerServerClient&&) = delete;
+
+  // Shuts down all servers.
+  ~RunnerServerClient();
+
+  // Returns the instance owned by the calling thread for `binary_path`. The
+  // instance is destroyed when the thread exits. If the calling thread last
+  // used a different binary, the old instance is replaced.
+  static RunnerServerClient& ForCurrentThread(absl::string_view binary_path);
+
+  // Tests if an invocation with `runner_options` can be served. Invocations
+  // with a wall time budget cannot: the server only enforces CPU time.
+  // Invocations with ASLR enabled cannot either: all children of a server
+  // share its address space layout, which would defeat the layout variation
+  // that ASLR-enabled verification relies on.
+  static bool CanServe(const RunnerOptions& runner_options);
+
+  // Runs the runner with the command line arguments `args` (excluding argv[0])
+  // in a server child process. Stores the child's stdout in `stdout_output`
+  // and its wait status as returned by waitpid(2) in `exit_status`.
+  //
+  // Returns an error if the request could not be delivered or the server died
+  // while processing it. The server will be restarted on the next call.
+  // REQUIRES: CanServe(runner_options)
+  absl::Status Run(const RunnerOptions& runner_options,
+                   absl::Span<const std::string> args,
+                   std::string* stdout_output, int* exit_status);
+
+  const std::string& binary_path() const { return binary_path_; }
+
+  // Number of requests served so far.
+  size_t num_requests() const { return num_requests_; }
+
+  // Number of times a server process had to be (re)started.
+  size_t num_server_starts() const { return num_server_starts_; }
+
+ private:
+  // Process-level options a server is started with. Servers always run with
+  // ASLR disabled, see CanServe().
+  using ServerKey = bool /* map_stderr_to_dev_null */;
+
+  // Returns a running server for `runner_options`, starting one if needed.
+  absl::StatusOr<Subprocess*> GetServer(const RunnerOptions& runner_options);
+
+  // Terminates and reaps the server for `key`.
+  void StopServer(const ServerKey& key);
+
+  // C-tor parameter.
+  std::string binary_path_;
+
+  // Running servers.
+  std::map<ServerKey, std::unique_ptr<Subprocess>> servers_;
+
+  // Stats.
+  size_t num_requests_ = 0;
+  size_t num_server_starts_ = 0;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_RUNNER_DRIVER_RUNNER_SERVER_CLIENT_H_
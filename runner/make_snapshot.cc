@@ -23,6 +23,7 @@
 #include "./common/snapshot.h"
 #include "./common/snapshot_enums.h"
 #include "./player/trace_options.h"
+#include "./runner/driver/runner_server_client.h"
 #include "./runner/runner_provider.h"
 #include "./runner/snap_maker.h"
 #include "./util/arch.h"
@@ -31,6 +32,28 @@
 
 namespace silifuzz {
 
+namespace {
+
+// Runs the make and record stages of MakeSnapshot() with `maker`.
+absl::StatusOr<Snapshot> RunMakeAndRecordStages(SnapMaker& maker,
+                                                const Snapshot& snapshot,
+                                                bool fused) {
+  if (fused) {
+    ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(Snapshot recorded_snapshot,
+                                    maker.MakeAndRecord(snapshot),
+                                    "Could not make snapshot: ");
+    return recorded_snapshot;
+  }
+  ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(Snapshot made_snapshot, maker.Make(snapshot),
+                                  "Could not make snapshot: ");
+  ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(Snapshot recorded_snapshot,
+                                  maker.RecordEndState(made_snapshot),
+                                  "Could not record snapshot: ");
+  return recorded_snapshot;
+}
+
+}  // namespace
+
 MakingConfig MakingConfig::Default() {
   return {
       .runner_path = RunnerLocation(),
@@ -50,13 +73,15 @@ absl::StatusOr<Snapshot> MakeSnapshot(const Snapshot& snapshot,
   opts.runner_path = making_config.runner_path;
   opts.max_pages_to_add = making_config.max_pages_to_add;
   opts.num_verify_attempts = making_config.num_verify_attempts;
+  if (making_config.reuse_runner) {
+    opts.runner_server =
+        &RunnerServerClient::ForCurrentThread(making_config.runner_path);
+  }
   SnapMaker maker(opts);
 
-  ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(Snapshot made_snapshot, maker.Make(snapshot),
-                                  "Could not make snapshot: ");
-  ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(Snapshot recorded_snapshot,
-                                  maker.RecordEndState(made_snapshot),
-                                  "Could not record snapshot: ");
+  ASSIGN_OR_RETURN_IF_NOT_OK(
+      Snapshot recorded_snapshot,
+      RunMakeAndRecordStages(maker, snapshot, making_config.fused_pipeline));
 
   DCHECK_EQ(recorded_snapshot.expected_end_states().size(), 1);
   const Snapshot::Endpoint& ep =
@@ -65,6 +90,9 @@ absl::StatusOr<Snapshot> MakeSnapshot(const Snapshot& snapshot,
     return absl::InternalError(absl::StrCat(
         "Cannot fix ", EnumStr(ep.sig_cause()), "/", EnumStr(ep.sig_num())));
   }
+  if (making_config.fused_pipeline) {
+    return maker.VerifyAndCheckTrace(recorded_snapshot, making_config.trace);
+  }
   RETURN_IF_NOT_OK(maker.VerifyPlaysDeterministically(recorded_snapshot));
   return maker.CheckTrace(recorded_snapshot, making_config.trace);
 }
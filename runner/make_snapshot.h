@@ -41,6 +41,18 @@ struct MakingConfig {
 
   TraceOptions trace;
 
+  // If true, runner invocations are served by a long-lived runner server owned
+  // by the calling thread (see RunnerServerClient) instead of spawning a new
+  // runner process for each invocation. Tracing always spawns a new process.
+  bool reuse_runner = false;
+
+  // If true, the end state reached while making is recorded instead of
+  // running the made snapshot again, and verification and tracing share one
+  // traced runner process. See SnapMaker::MakeAndRecord() and
+  // SnapMaker::VerifyAndCheckTrace(). This needs two runner invocations
+  // instead of four or more but verifies with one address space layout only.
+  bool fused_pipeline = false;
+
   // Config for when we are making a real Snapshot that we want to persist.
   static MakingConfig Default();
 
@@ -0,0 +1,71 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./runner/page_owner_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "./util/checks.h"
+#include "./util/page_util.h"
+
+namespace silifuzz {
+
+static_assert((PageOwnerTable::kNumSlots & (PageOwnerTable::kNumSlots - 1)) ==
+              0);
+
+size_t PageOwnerTable::FindSlot(uint64_t page_address) const {
+  DCHECK_NE(page_address, 0);
+  // Fibonacci hashing of the page number.
+  size_t slot = ((page_address / kPageSize) * 0x9e3779b97f4a7c15ULL) >>
+                (64 - __builtin_ctzll(kNumSlots));
+  // The table is never full, so this terminates.
+  while (slots_[slot].page_address != page_address &&
+         slots_[slot].page_address != 0) {
+    slot = (slot + 1) & (kNumSlots - 1);
+  }
+  return slot;
+}
+
+bool PageOwnerTable::IsOwnedBy(uint64_t page_address,
+                               const void* owner) const {
+  const Slot& slot = slots_[FindSlot(page_address)];
+  return slot.page_address == page_address && slot.owner == owner;
+}
+
+void PageOwnerTable::SetOwner(uint64_t page_address, const void* owner) {
+  Slot& slot = slots_[FindSlot(page_address)];
+  if (slot.page_address == 0) {
+    if (size_ >= kMaxPages) return;
+    slot.page_address = page_address;
+    ++size_;
+  }
+  slot.owner = owner;
+}
+
+void PageOwnerTable::ClearOwner(uint64_t page_address) {
+  Slot& slot = slots_[FindSlot(page_address)];
+  // Keep the slot occupied, removing it would break probe sequences.
+  if (slot.page_address == page_address) {
+    slot.owner = nullptr;
+  }
+}
+
+void PageOwnerTable::Clear() {
+  memset(slots_, 0, sizeof(slots_));
+  size_ = 0;
+}
+
+}  // namespace silifuzz
@@ -0,0 +1,78 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_RUNNER_PAGE_OWNER_TABLE_H_
+#define THIRD_PARTY_SILIFUZZ_RUNNER_PAGE_OWNER_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace silifuzz {
+
+// Records, for each writable page, whose initial memory contents the page is
+// known to hold. The runner uses this to skip restoring pages that still hold
+// the initial contents of the snap about to run.
+//
+// An owner is an opaque pointer, typically a Snap. A page with no owner holds
+// unknown contents.
+//
+// This is a fixed-size open-addressing hash table so it can be used in the
+// nolibc runner without dynamic allocation. It is zero-initialized, so it can
+// be a global without a static initializer. Pages that do not fit in the table
+// never have an owner. Page address 0 cannot be tracked.
+//
+// This class is not thread-safe.
+class PageOwnerTable {
+ public:
+  // Number of hash table slots. Must be a power of 2.
+  static constexpr size_t kNumSlots = 1 << 16;
+
+  // Maximum number of pages tracked. The table is kept at most half full to
+  // keep probe sequences short.
+  static constexpr size_t kMaxPages = kNumSlots / 2;
+
+  // Returns true iff `page_address` is known to hold the initial contents of
+  // `owner`.
+  bool IsOwnedBy(uint64_t page_address, const void* owner) const;
+
+  // Records that `page_address` holds the initial contents of `owner`.
+  // Does nothing if the table is full.
+  void SetOwner(uint64_t page_address, const void* owner);
+
+  // Records that the contents of `page_address` are unknown.
+  void ClearOwner(uint64_t page_address);
+
+  // Forgets all pages.
+  void Clear();
+
+  // Returns the number of pages tracked.
+  size_t size() const { return size_; }
+
+ private:
+  struct Slot {
+    uint64_t page_address;  // 0 if the slot is empty.
+    const void* owner;
+  };
+
+  // Returns the slot of `page_address` or the empty slot where it would be
+  // inserted.
+  size_t FindSlot(uint64_t page_address) const;
+
+  Slot slots_[kNumSlots];
+  size_t size_;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_RUNNER_PAGE_OWNER_TABLE_H_
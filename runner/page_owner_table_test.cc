@@ -0,0 +1,77 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./runner/page_owner_table.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "./util/page_util.h"
+
+namespace silifuzz {
+namespace {
+
+// The table is large, keep it off the stack.
+std::unique_ptr<PageOwnerTable> MakeTable() {
+  auto table = std::make_unique<PageOwnerTable>();
+  table->Clear();
+  return table;
+}
+
+TEST(PageOwnerTable, SetAndClearOwner) {
+  auto table = MakeTable();
+  const int owner1 = 0, owner2 = 0;
+  constexpr uint64_t kPage = 0x12345000;
+
+  EXPECT_FALSE(table->IsOwnedBy(kPage, &owner1));
+  table->SetOwner(kPage, &owner1);
+  EXPECT_TRUE(table->IsOwnedBy(kPage, &owner1));
+  EXPECT_FALSE(table->IsOwnedBy(kPage, &owner2));
+  EXPECT_FALSE(table->IsOwnedBy(kPage + kPageSize, &owner1));
+
+  table->SetOwner(kPage, &owner2);
+  EXPECT_FALSE(table->IsOwnedBy(kPage, &owner1));
+  EXPECT_TRUE(table->IsOwnedBy(kPage, &owner2));
+
+  table->ClearOwner(kPage);
+  EXPECT_FALSE(table->IsOwnedBy(kPage, &owner2));
+
+  // Clearing an unknown page is harmless.
+  table->ClearOwner(kPage + kPageSize);
+  EXPECT_EQ(table->size(), 1);
+
+  table->Clear();
+  EXPECT_EQ(table->size(), 0);
+}
+
+TEST(PageOwnerTable, Full) {
+  auto table = MakeTable();
+  const int owner = 0;
+  // Use a stride that collides in the low bits of the page number.
+  constexpr uint64_t kStride = kPageSize << 20;
+  for (uint64_t i = 1; i <= PageOwnerTable::kMaxPages + 10; ++i) {
+    table->SetOwner(i * kStride, &owner);
+  }
+  EXPECT_EQ(table->size(), PageOwnerTable::kMaxPages);
+  for (uint64_t i = 1; i <= PageOwnerTable::kMaxPages; ++i) {
+    ASSERT_TRUE(table->IsOwnedBy(i * kStride, &owner)) << i;
+  }
+  // Pages that did not fit are never owned.
+  EXPECT_FALSE(
+      table->IsOwnedBy((PageOwnerTable::kMaxPages + 1) * kStride, &owner));
+}
+
+}  // namespace
+}  // namespace silifuzz
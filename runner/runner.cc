@@ -16,28 +16,35 @@
 
 #include <signal.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
+#include <sys/wait.h>
 #include <ucontext.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <new>
 #include <optional>
 #include <random>
 
 #include "third_party/lss/lss/linux_syscall_support.h"
 #include "./common/snapshot_enums.h"
 #include "./runner/endspot.h"
+#include "./runner/page_owner_table.h"
 #include "./runner/runner_main_options.h"
+#include "./runner/runner_result_format.h"
 #include "./runner/runner_util.h"
 #include "./runner/snap_runner_util.h"
 #include "./snap/exit_sequence.h"
 #include "./snap/snap.h"
 #include "./snap/snap_checksum.h"
 #include "./util/arch.h"
+#include "./util/byte_io.h"
 #include "./util/checks.h"
 #include "./util/cpu_id.h"
 #include "./util/itoa.h"
@@ -46,6 +53,7 @@
 #include "./util/misc_util.h"
 #include "./util/page_util.h"
 #include "./util/proc_maps_parser.h"
+#include "./util/proto_wire_writer.h"
 #include "./util/reg_checksum.h"
 #include "./util/reg_group_io.h"
 #include "./util/reg_group_set.h"
@@ -87,6 +95,11 @@
 //             The process will exit immediately with exit code 2 when this
 //             signal is received.
 //
+//    SIGPROF: a tick of the per-snap CPU time budget timer. Only used when
+//             --run_time_budget_ms is set. If two consecutive ticks land in
+//             the same snap execution, that snap is reported as a runaway.
+//             Otherwise the tick is ignored.
+//
 // This process can terminate with the following signals:
 //    SIGKILL: the process was limited by setrlimit(2) and exceeded its
 //             hard CPU bugdet or another process or the operating system
@@ -130,6 +143,46 @@ uint64_t added_page_addresses[kMaxAddedPageAddresses];
 
 constexpr int kInitialMappingProtection = PROT_READ | PROT_WRITE;
 
+// Whose initial memory contents each writable page holds. Only maintained
+// when RunnerMainOptions::track_dirty_pages is set.
+PageOwnerTable page_owners;
+
+// Number of snap executions with dirty page tracking. Used to schedule full
+// memory checks.
+size_t num_tracked_executions = 0;
+
+// Per-snap CPU time budget. An ITIMER_PROF timer ticks with SIGPROF every
+// RunnerMainOptions::run_time_budget_ms of CPU time. A snap execution that
+// spans a whole tick interval, i.e. sees two ticks, has used up its budget.
+// This detects snaps running for more than twice the budget and never
+// those running for less than the budget without any syscalls per snap.
+//
+// Sequence number of the current or last snap execution. Starts at 1.
+volatile uint64_t snap_execution_seq = 0;
+
+// Value of `snap_execution_seq` at the last SIGPROF tick if the tick landed
+// inside a snap or 0 otherwise. Only accessed by SigAction().
+uint64_t snap_execution_seq_at_last_tick = 0;
+
+// Returns true iff a per-snap CPU time budget is set.
+bool HasSnapTimeBudget(const RunnerMainOptions& options) {
+  return options.run_time_budget_ms != static_cast<uint64_t>(-1);
+}
+
+// Handles a SIGPROF tick of the per-snap budget timer. Returns true iff the
+// snap being executed, if any, should continue.
+bool HandleSnapTimeBudgetTick() {
+  if (!IsInsideSnap()) {
+    snap_execution_seq_at_last_tick = 0;
+    return true;
+  }
+  if (snap_execution_seq_at_last_tick == snap_execution_seq) {
+    return false;
+  }
+  snap_execution_seq_at_last_tick = snap_execution_seq;
+  return true;
+}
+
 // Attempts to recover from a SEGV fault due to missing mapping.
 // Returns true iff the fault is recoverable by adding a new mapping.
 bool TryToRecoverFromSignal(int signal, const siginfo_t* siginfo) {
@@ -175,6 +228,9 @@ void SigAction(int signal, siginfo_t* siginfo, void* uc) {
   if (signal == SIGALRM) {
     _exit(2);
   }
+  if (signal == SIGPROF && HandleSnapTimeBudgetTick()) {
+    return;
+  }
   if (IsInsideSnap()) {
     // If the signal is due to an unmapped page and we are allowed to map
     // pages, try resuming from the signal. This happens during snap making.
@@ -212,6 +268,32 @@ bool VerifyMemoryBytes(const SnapMemoryBytes& memory_bytes) {
              : MemEq(address, memory_bytes.data.byte_values.elements, size);
 }
 
+// Sets [`start`, `limit`) to the part of `memory_bytes` in the page at
+// `page_address`. Returns false if they do not overlap.
+bool ClipToPage(const SnapMemoryBytes& memory_bytes, uint64_t page_address,
+                uint64_t& start, uint64_t& limit) {
+  start = std::max(memory_bytes.start_address, page_address);
+  limit = std::min(memory_bytes.start_address + memory_bytes.size(),
+                   page_address + kPageSize);
+  return start < limit;
+}
+
+// Like VerifyMemoryBytes() but only checks the bytes in the page at
+// `page_address`.
+bool VerifyMemoryBytesInPage(const SnapMemoryBytes& memory_bytes,
+                             uint64_t page_address) {
+  uint64_t start, limit;
+  if (!ClipToPage(memory_bytes, page_address, start, limit)) return true;
+  const void* address = AsPtr(start);
+  const size_t size = limit - start;
+  return memory_bytes.repeating()
+             ? MemAllEqualTo(address, memory_bytes.data.byte_run.value, size)
+             : MemEq(address,
+                     memory_bytes.data.byte_values.elements +
+                         (start - memory_bytes.start_address),
+                     size);
+}
+
 // Copies memory bytes from Snap to runtime address.
 void SetupMemoryBytes(const SnapMemoryBytes& memory_bytes) {
   void* target_address = AsPtr(memory_bytes.start_address);
@@ -224,6 +306,23 @@ void SetupMemoryBytes(const SnapMemoryBytes& memory_bytes) {
   }
 }
 
+// Like SetupMemoryBytes() but only copies the bytes in the page at
+// `page_address`.
+void SetupMemoryBytesInPage(const SnapMemoryBytes& memory_bytes,
+                            uint64_t page_address) {
+  uint64_t start, limit;
+  if (!ClipToPage(memory_bytes, page_address, start, limit)) return;
+  void* target_address = AsPtr(start);
+  if (memory_bytes.repeating()) {
+    MemSet(target_address, memory_bytes.data.byte_run.value, limit - start);
+  } else {
+    MemCopy(target_address,
+            memory_bytes.data.byte_values.elements +
+                (start - memory_bytes.start_address),
+            limit - start);
+  }
+}
+
 void CheckFixedMmapOK(void* mapped_address, void* target_address) {
   if (mapped_address == MAP_FAILED) {
     LOG_FATAL("mmap(", HexStr(AsInt(target_address)),
@@ -268,9 +367,28 @@ SeccompOptions SeccompOptionsFromRunnerMainOptions(
     seccomp_options.allow_mmap = true;
     seccomp_options.allow_rt_sigreturn = true;
   }
+  // Ignored SIGPROF ticks return from the signal handler.
+  if (HasSnapTimeBudget(options)) {
+    seccomp_options.allow_rt_sigreturn = true;
+  }
   return seccomp_options;
 }
 
+// Starts the per-snap CPU time budget timer if a budget is set.
+void StartSnapTimeBudgetTimer(const RunnerMainOptions& options) {
+  if (!HasSnapTimeBudget(options)) return;
+  const uint64_t budget_usec = options.run_time_budget_ms * 1000;
+  struct kernel_timeval interval = {
+      .tv_sec = static_cast<long>(budget_usec / 1000000),   // NOLINT
+      .tv_usec = static_cast<long>(budget_usec % 1000000),  // NOLINT
+  };
+  struct kernel_itimerval timer = {.it_interval = interval,
+                                   .it_value = interval};
+  CHECK_EQ(sys_setitimer(ITIMER_PROF, &timer, nullptr), 0);
+  VLOG_INFO(1, "Per-snap CPU time budget is ",
+            IntStr(options.run_time_budget_ms), " ms");
+}
+
 }  // namespace
 
 void InstallSigHandler() {
@@ -289,7 +407,7 @@ void InstallSigHandler() {
   // Consequentially, we should not continue snapshot execution after the first
   // runaway is detected. See also SA_NODEFER below.
   // See also "Signal handling" file-level comment.
-  for (const auto masked_signal : {SIGXCPU, SIGALRM}) {
+  for (const auto masked_signal : {SIGXCPU, SIGALRM, SIGPROF}) {
     if (sys_sigaddset(&action.sa_mask, masked_signal) != 0) {
       LOG_FATAL("sigaddset() failed: ", ErrnoStr(errno));
     }
@@ -380,6 +498,187 @@ void MapSnap(const Snap<Host>& snap, int corpus_fd,
   }
 }
 
+// A memory mapping of a snap in the corpus, as seen by the mapping planner in
+// MapCorpus().
+struct PlannedMapping {
+  uint64_t start_address;
+  uint64_t limit_address;
+  int perms;
+  // Offset of the contents in the corpus file or -1 if the mapping is
+  // anonymous.
+  off_t file_offset;
+  const SnapMemoryMapping* memory_mapping;
+  // Position of the mapping in the corpus. Breaks ties when sorting so that
+  // the order is deterministic.
+  size_t index;
+};
+
+// Returns the end of the run of sorted `plan` entries starting at
+// plan[begin] that can be established with a single mmap(). The limit
+// address of the run is returned in `run_limit`. Sets `conflict` if the
+// entry following the run overlaps it in a way that a single mmap() cannot
+// express. Overlapping is only allowed between anonymous writable mappings
+// with identical permissions, e.g. stacks shared by many snaps. Their initial
+// contents are set up before every execution.
+size_t FindMappingRunEnd(const PlannedMapping plan[], size_t begin,
+                         size_t num_planned, uint64_t& run_limit,
+                         bool& conflict) {
+  const PlannedMapping& first = plan[begin];
+  const bool anonymous = first.file_offset == -1;
+  const bool writable = (first.perms & PROT_WRITE) != 0;
+  run_limit = first.limit_address;
+  conflict = false;
+  size_t end = begin + 1;
+  for (; end < num_planned; ++end) {
+    const PlannedMapping& next = plan[end];
+    const bool same_kind =
+        next.perms == first.perms && (next.file_offset == -1) == anonymous;
+    if (next.start_address < run_limit) {
+      if (!same_kind || !anonymous || !writable) {
+        conflict = true;
+        break;
+      }
+    } else if (next.start_address != run_limit || !same_kind) {
+      break;
+    } else if (!anonymous &&
+               next.file_offset !=
+                   plan[end - 1].file_offset +
+                       static_cast<off_t>(
+                           plan[end - 1].memory_mapping->num_bytes)) {
+      // Direct mappings must also be adjacent in the corpus file.
+      break;
+    }
+    run_limit = std::max(run_limit, next.limit_address);
+  }
+  return end;
+}
+
+// Establishes the run of memory mappings plan[begin, end) covering
+// [plan[begin].start_address, run_limit) with a single mmap() and at most one
+// mprotect().
+void CreateMemoryMappingRun(const PlannedMapping plan[], size_t begin,
+                            size_t end, uint64_t run_limit, int corpus_fd) {
+  const PlannedMapping& first = plan[begin];
+  const uint64_t start_address = first.start_address;
+  const size_t num_bytes = run_limit - start_address;
+  VLOG_INFO(2, "Mapping ", HexStr(start_address), "-", HexStr(run_limit));
+
+  void* target_address = AsPtr(start_address);
+  if (first.file_offset != -1) {
+    void* mapped_address = mmap(target_address, num_bytes, first.perms,
+                                MAP_SHARED | MAP_FIXED, corpus_fd,
+                                first.file_offset);
+    CheckFixedMmapOK(mapped_address, target_address);
+    return;
+  }
+
+  void* mapped_address =
+      mmap(target_address, num_bytes, kInitialMappingProtection,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  CheckFixedMmapOK(mapped_address, target_address);
+
+  // Like CreateMemoryMapping(), only read-only mappings are initialized here.
+  if ((first.perms & PROT_WRITE) == 0) {
+    for (size_t i = begin; i < end; ++i) {
+      for (const auto& memory_bytes : plan[i].memory_mapping->memory_bytes) {
+        SetupMemoryBytes(memory_bytes);
+      }
+    }
+  }
+
+  if (first.perms != kInitialMappingProtection) {
+    VLOG_INFO(2, "mprotect mapping ", HexStr(start_address));
+    int mprotect_result = mprotect(target_address, num_bytes, first.perms);
+    if (mprotect_result != 0) {
+      LOG_FATAL("mprotect(", HexStr(AsInt(target_address)),
+                ") failed: ", ErrnoStr(errno));
+    }
+  }
+}
+
+// Establishes memory mappings for all snaps in `corpus` using as few mmap()
+// calls as possible. Address-adjacent mappings with identical permissions
+// and backing are coalesced into a single mapping. This reduces both startup
+// time and the number of VMAs for large corpora.
+//
+// Returns the number of mmap() calls made or 0 if the mappings cannot be
+// coalesced. In the latter case, nothing has been mapped and the caller
+// should fall back to MapSnap().
+size_t MapCorpusCoalesced(const SnapCorpus<Host>& corpus, int corpus_fd,
+                          const void* corpus_mapping) {
+  size_t num_planned = 0;
+  for (const auto& snap : corpus.snaps) {
+    num_planned += snap->memory_mappings.size;
+  }
+  if (num_planned == 0) return 0;
+
+  // The runner has no heap. Use a scratch mapping for the plan.
+  const size_t plan_size =
+      RoundUpToPageAlignment(num_planned * sizeof(PlannedMapping));
+  void* plan_mapping = mmap(nullptr, plan_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (plan_mapping == MAP_FAILED) {
+    LOG_FATAL("mmap() failed: ", ErrnoStr(errno));
+  }
+  PlannedMapping* plan = reinterpret_cast<PlannedMapping*>(plan_mapping);
+
+  size_t index = 0;
+  for (const auto& snap : corpus.snaps) {
+    for (const auto& memory_mapping : snap->memory_mappings) {
+      PlannedMapping& entry = plan[index];
+      entry.start_address = memory_mapping.start_address;
+      entry.limit_address =
+          memory_mapping.start_address + memory_mapping.num_bytes;
+      entry.perms = memory_mapping.perms;
+      entry.file_offset = -1;
+      if (corpus_fd != -1 && CanDirectMap(memory_mapping)) {
+        entry.file_offset = static_cast<off_t>(
+            AsInt(memory_mapping.memory_bytes[0].data.byte_values.elements) -
+            AsInt(corpus_mapping));
+        CHECK(IsPageAligned(entry.file_offset));
+      }
+      entry.memory_mapping = &memory_mapping;
+      entry.index = index;
+      ++index;
+    }
+  }
+  std::sort(plan, plan + num_planned,
+            [](const PlannedMapping& a, const PlannedMapping& b) {
+              return a.start_address != b.start_address
+                         ? a.start_address < b.start_address
+                         : a.index < b.index;
+            });
+
+  // Check the whole plan before mapping anything. Mapping over the plan
+  // itself is also a conflict.
+  const uint64_t plan_start = AsInt(plan_mapping);
+  const uint64_t plan_limit = plan_start + plan_size;
+  bool conflict = false;
+  uint64_t run_limit;
+  for (size_t begin = 0; begin < num_planned && !conflict;) {
+    const size_t end =
+        FindMappingRunEnd(plan, begin, num_planned, run_limit, conflict);
+    if (plan[begin].start_address < plan_limit && plan_start < run_limit) {
+      conflict = true;
+    }
+    begin = end;
+  }
+
+  size_t num_runs = 0;
+  if (!conflict) {
+    for (size_t begin = 0; begin < num_planned;) {
+      const size_t end =
+          FindMappingRunEnd(plan, begin, num_planned, run_limit, conflict);
+      CreateMemoryMappingRun(plan, begin, end, run_limit, corpus_fd);
+      ++num_runs;
+      begin = end;
+    }
+  }
+
+  CHECK_EQ(munmap(plan_mapping, plan_size), 0);
+  return num_runs;
+}
+
 // ApplyProcMapsFixups manipulates this process' memory mappings. Resizes the
 // [stack] mapping to occupy the maximum allowed stack size. Unmaps [vdso] and
 // [vvar] mappings.
@@ -434,6 +733,9 @@ void MapCorpus(const SnapCorpus<Host>& corpus, int corpus_fd,
   ApplyProcMapsFixups(proc_maps_entries, num_proc_maps_entries);
 
   VLOG_INFO(1, "Creating memory mappings");
+  struct kernel_timeval start_time;
+  CHECK_EQ(sys_gettimeofday(&start_time, nullptr), 0);
+  size_t num_mappings = 0;
   for (const auto& snap : corpus.snaps) {
     // TODO(dougkwan): [impl] Make this fail more gracefully. We can skip
     // conflicting snaps. To do that we need space to store the passing
@@ -444,15 +746,34 @@ void MapCorpus(const SnapCorpus<Host>& corpus, int corpus_fd,
                                         num_proc_maps_entries)) {
       LOG_FATAL("Cannot handle overlapping mappings");
     }
-    // If any of these memory mappings overlap, the mapping earlier in this list
-    // will be silently overwritten by the mapping later in this list.
-    // Currently, the corpus creator should avoid overlapping RO pages, but
-    // there may be zero-initialized RW pages that overlap between snaps. The
-    // most obvious case will be that most Snaps will have stacks mapped in
-    // exactly the same location.
-    MapSnap(*snap, corpus_fd, corpus_mapping);
+    num_mappings += snap->memory_mappings.size;
+  }
+
+  size_t num_mmaps = MapCorpusCoalesced(corpus, corpus_fd, corpus_mapping);
+  if (num_mmaps == 0 && num_mappings != 0) {
+    VLOG_INFO(1, "Cannot coalesce memory mappings, mapping them one by one");
+    for (const auto& snap : corpus.snaps) {
+      // If any of these memory mappings overlap, the mapping earlier in this
+      // list will be silently overwritten by the mapping later in this list.
+      // Currently, the corpus creator should avoid overlapping RO pages, but
+      // there may be zero-initialized RW pages that overlap between snaps. The
+      // most obvious case will be that most Snaps will have stacks mapped in
+      // exactly the same location.
+      MapSnap(*snap, corpus_fd, corpus_mapping);
+    }
+    num_mmaps = num_mappings;
+  }
+
+  struct kernel_timeval end_time;
+  CHECK_EQ(sys_gettimeofday(&end_time, nullptr), 0);
+  const int64_t elapsed_usec = (end_time.tv_sec - start_time.tv_sec) * 1000000 +
+                               (end_time.tv_usec - start_time.tv_usec);
+  VLOG_INFO(1, "Done creating memory mappings: ", IntStr(num_mappings),
+            " mappings using ", IntStr(num_mmaps), " mmap() calls in ",
+            IntStr(elapsed_usec), " usec");
+  if (VLOG_IS_ON(1)) {
+    VLOG_INFO(1, "Process has ", IntStr(CountProcMapsEntries()), " VMAs");
   }
-  VLOG_INFO(1, "Done creating memory mappings");
 
   if (corpus_fd != -1) {
     CHECK_EQ(close(corpus_fd), 0);
@@ -513,9 +834,12 @@ void VerifyChecksums(const SnapCorpus<Host>& corpus) {
 }
 
 RunSnapOutcome EndSpotToOutcome(const Snap<Host>& snap,
-                                const EndSpot& end_spot) {
+                                const SnapArray<uint64_t>* dirty_pages,
+                                const EndSpot& end_spot,
+                                bool full_memory_check) {
   if (end_spot.signum != 0) {
-    if (end_spot.signum == SIGXCPU || end_spot.signum == SIGALRM) {
+    if (end_spot.signum == SIGXCPU || end_spot.signum == SIGALRM ||
+        end_spot.signum == SIGPROF) {
       return RunSnapOutcome::kExecutionRunaway;
     }
     return RunSnapOutcome::kExecutionMisbehave;
@@ -533,9 +857,20 @@ RunSnapOutcome EndSpotToOutcome(const Snap<Host>& snap,
 
   // Verify writable memory contents after execution.
   for (const auto& memory_bytes : snap.end_state_memory_bytes) {
-    if (!VerifyMemoryBytes(memory_bytes)) {
-      VLOG_INFO(1, "Memory mismatch at ", HexStr(memory_bytes.start_address));
-      return RunSnapOutcome::kMemoryMismatch;
+    if (full_memory_check) {
+      if (!VerifyMemoryBytes(memory_bytes)) {
+        VLOG_INFO(1, "Memory mismatch at ", HexStr(memory_bytes.start_address));
+        return RunSnapOutcome::kMemoryMismatch;
+      }
+      continue;
+    }
+    // The other pages held their initial contents before execution and are
+    // expected to be unchanged.
+    for (uint64_t page_address : *dirty_pages) {
+      if (!VerifyMemoryBytesInPage(memory_bytes, page_address)) {
+        VLOG_INFO(1, "Memory mismatch in page ", HexStr(page_address));
+        return RunSnapOutcome::kMemoryMismatch;
+      }
     }
   }
 
@@ -543,13 +878,34 @@ RunSnapOutcome EndSpotToOutcome(const Snap<Host>& snap,
 }
 
 // Copies read/writable memory contents needed to run the snap.
-void PrepareSnapMemory(const Snap<Host>& snap) {
+// If `track_dirty_pages` is true, pages already holding the initial contents
+// of `snap` are skipped unless `full_restore` is also true.
+void PrepareSnapMemory(const Snap<Host>& snap, bool track_dirty_pages,
+                       bool full_restore) {
   for (const auto& memory_mapping : snap.memory_mappings) {
     // Read-only contents will not have changed.
-    if (memory_mapping.writable()) {
+    if (!memory_mapping.writable()) continue;
+    const uint64_t limit_address =
+        memory_mapping.start_address + memory_mapping.num_bytes;
+    if (!track_dirty_pages || full_restore) {
       for (const auto& memory_bytes : memory_mapping.memory_bytes) {
         SetupMemoryBytes(memory_bytes);
       }
+      if (track_dirty_pages) {
+        for (uint64_t page_address = memory_mapping.start_address;
+             page_address < limit_address; page_address += kPageSize) {
+          page_owners.SetOwner(page_address, &snap);
+        }
+      }
+      continue;
+    }
+    for (uint64_t page_address = memory_mapping.start_address;
+         page_address < limit_address; page_address += kPageSize) {
+      if (page_owners.IsOwnedBy(page_address, &snap)) continue;
+      for (const auto& memory_bytes : memory_mapping.memory_bytes) {
+        SetupMemoryBytesInPage(memory_bytes, page_address);
+      }
+      page_owners.SetOwner(page_address, &snap);
     }
   }
 }
@@ -584,41 +940,10 @@ void LogSnapMemoryBytes(const Snap<Host>& snap,
   }
 }
 
-// Logs the run result of `snap` to stdout formatted as
-// proto.SnapshotExecutionResult text proto. Additionally, logs execution
-// result in human-readable format to stderr.
-void LogSnapRunResult(const Snap<Host>& snap, const RunnerMainOptions& options,
-                      const RunSnapResult& run_result) {
-  if (run_result.outcome != RunSnapOutcome::kAsExpected) {
-    LOG_ERROR("Snapshot [", snap.id,
-              "] failed, outcome = ", IntStr(ToInt(run_result.outcome)));
-    LOG_ERROR("Corpus   [", options.corpus_name, "]");
-    if (run_result.outcome == RunSnapOutcome::kRegisterStateMismatch) {
-      LOG_INFO("Registers (diff vs expected end_state 0):");
-      LOG_INFO("  gregs (modified only):");
-      // Use instruction pointer == 0 as a proxy for undefined state. The only
-      // possible case where the value is 0 is for Snaps with the undefined end
-      // state.
-      // See SnapGenerator::Options::allow_undefined_end_state for details.
-      bool log_diff =
-          snap.end_state_registers->gregs.GetInstructionPointer() != 0;
-      LogGRegs(*run_result.end_spot.gregs, &snap.end_state_registers->gregs,
-               log_diff);
-      LOG_INFO("  fpregs (modified only):");
-      LogFPRegs(*run_result.end_spot.fpregs, true,
-                &snap.end_state_registers->fpregs, log_diff);
-      LogRegisterChecksum(run_result.end_spot.register_checksum,
-                          &snap.end_state_register_checksum, log_diff);
-    } else if (run_result.outcome == RunSnapOutcome::kMemoryMismatch) {
-      LOG_INFO("Memory state mismatch (details omitted)");
-    } else if (run_result.outcome == RunSnapOutcome::kExecutionMisbehave) {
-      LOG_INFO("Execution misbehaved");
-      run_result.end_spot.Log();
-    } else if (run_result.outcome == RunSnapOutcome::kExecutionRunaway) {
-      LOG_INFO("Execution was a run-away");
-      run_result.end_spot.Log();
-    }
-  }
+// Writes the run result of `snap` to stdout as a
+// proto.SnapshotExecutionResult text proto.
+void WriteSnapRunResultAsText(const Snap<Host>& snap,
+                              const RunSnapResult& run_result) {
   // The root message is proto.SnapshotExecutionResult
   TextProtoPrinter snapshot_execution_result;
   {
@@ -680,6 +1005,132 @@ void LogSnapRunResult(const Snap<Host>& snap, const RunnerMainOptions& options,
   LogToStdout(snapshot_execution_result.c_str());
 }
 
+// Writes the run result of `snap` to stdout as a binary
+// proto.SnapshotExecutionResult. See runner_result_format.h.
+// Memory contents are written directly from the snap's mappings.
+void WriteSnapRunResultAsBinary(const Snap<Host>& snap,
+                                const RunSnapResult& run_result) {
+  ProtoWireWriter writer;
+  writer.String(1, snap.id);  // snapshot_id
+  writer.BeginMessage(2);     // player_result
+  writer.Int(1, ToInt(run_result.outcome));  // outcome
+  writer.Int(5, run_result.cpu_id);          // cpu_id
+  writer.BeginMessage(3);                    // actual_end_state
+
+  std::optional<Endpoint> endpoint = EndSpotToEndpoint(run_result.end_spot);
+  if (endpoint.has_value()) {
+    writer.BeginMessage(1);  // endpoint
+    if (endpoint->type() == EndpointType::kSignal) {
+      writer.BeginMessage(2);  // signal
+      // The enum values match those in snapshot.proto.
+      writer.Int(1, ToInt(endpoint->sig_num()));    // sig_num
+      writer.Int(2, ToInt(endpoint->sig_cause()));  // sig_cause
+      writer.Uint64(3, endpoint->sig_address());    // sig_address
+      writer.Uint64(4, endpoint->sig_instruction_address());
+      writer.EndMessage();
+    } else {
+      writer.Uint64(1, endpoint->instruction_address());
+    }
+    writer.EndMessage();
+  }
+
+  writer.BeginMessage(2);  // registers
+  Serialized<EndSpot::gregs_t> serialized_gregs;
+  CHECK(SerializeGRegs(*run_result.end_spot.gregs, &serialized_gregs));
+  writer.Bytes(1, serialized_gregs.data, serialized_gregs.size);  // gregs
+  Serialized<EndSpot::fpregs_t> serialized_fpregs;
+  CHECK(SerializeFPRegs(*run_result.end_spot.fpregs, &serialized_fpregs));
+  writer.Bytes(2, serialized_fpregs.data, serialized_fpregs.size);  // fpregs
+  writer.EndMessage();
+
+  uint8_t checksum_buffer[256];
+  ssize_t checksum_size = Serialize(run_result.end_spot.register_checksum,
+                                    checksum_buffer, sizeof(checksum_buffer));
+  CHECK_NE(checksum_size, -1);
+  writer.Bytes(5, checksum_buffer, checksum_size);  // register_checksum
+
+  // Unlike the text format, there is no need to split memory into pages.
+  for (const auto& memory_mapping : snap.memory_mappings) {
+    if (!memory_mapping.writable()) continue;
+    writer.BeginMessage(3);  // memory_bytes
+    writer.Uint64(1, memory_mapping.start_address);  // start_address
+    writer.BytesRef(2, AsPtr(memory_mapping.start_address),
+                    memory_mapping.num_bytes);  // byte_values
+    writer.EndMessage();
+  }
+  // Append additional pages mapped during making.
+  for (int i = 0; i < num_added_pages; ++i) {
+    writer.BeginMessage(3);  // memory_bytes
+    writer.Uint64(1, added_page_addresses[i]);
+    writer.BytesRef(2, AsPtr(added_page_addresses[i]), getpagesize());
+    writer.EndMessage();
+  }
+
+  writer.EndMessage();  // actual_end_state
+  writer.EndMessage();  // player_result
+
+  char header[kBinaryRunnerResultHeaderSize];
+  MakeBinaryRunnerResultHeader(writer.size(), header);
+  CHECK_EQ(Write(STDOUT_FILENO, header, sizeof(header)),
+           static_cast<ssize_t>(sizeof(header)));
+  CHECK(writer.WriteTo(STDOUT_FILENO));
+}
+
+// Writes the run result of `snap` to stdout in the format selected by
+// `options`. Additionally, logs execution result in human-readable format to
+// stderr.
+void LogSnapRunResult(const Snap<Host>& snap, const RunnerMainOptions& options,
+                      const RunSnapResult& run_result) {
+  if (run_result.outcome != RunSnapOutcome::kAsExpected) {
+    LOG_ERROR("Snapshot [", snap.id,
+              "] failed, outcome = ", IntStr(ToInt(run_result.outcome)));
+    LOG_ERROR("Corpus   [", options.corpus_name, "]");
+    if (run_result.outcome == RunSnapOutcome::kRegisterStateMismatch) {
+      LOG_INFO("Registers (diff vs expected end_state 0):");
+      LOG_INFO("  gregs (modified only):");
+      // Use instruction pointer == 0 as a proxy for undefined state. The only
+      // possible case where the value is 0 is for Snaps with the undefined end
+      // state.
+      // See SnapGenerator::Options::allow_undefined_end_state for details.
+      bool log_diff =
+          snap.end_state_registers->gregs.GetInstructionPointer() != 0;
+      LogGRegs(*run_result.end_spot.gregs, &snap.end_state_registers->gregs,
+               log_diff);
+      LOG_INFO("  fpregs (modified only):");
+      LogFPRegs(*run_result.end_spot.fpregs, true,
+                &snap.end_state_registers->fpregs, log_diff);
+      LogRegisterChecksum(run_result.end_spot.register_checksum,
+                          &snap.end_state_register_checksum, log_diff);
+    } else if (run_result.outcome == RunSnapOutcome::kMemoryMismatch) {
+      LOG_INFO("Memory state mismatch (details omitted)");
+    } else if (run_result.outcome == RunSnapOutcome::kExecutionMisbehave) {
+      LOG_INFO("Execution misbehaved");
+      run_result.end_spot.Log();
+    } else if (run_result.outcome == RunSnapOutcome::kExecutionRunaway) {
+      LOG_INFO("Execution was a run-away");
+      run_result.end_spot.Log();
+    }
+  }
+  if (options.text_result) {
+    WriteSnapRunResultAsText(snap, run_result);
+  } else {
+    WriteSnapRunResultAsBinary(snap, run_result);
+  }
+}
+
+// Writes the time elapsed since options.startup_begin_usec to stdout as a
+// startup time record. See runner_result_format.h.
+void ReportStartupTime(const RunnerMainOptions& options) {
+  struct kernel_timeval now;
+  CHECK_EQ(sys_gettimeofday(&now, nullptr), 0);
+  const int64_t elapsed_usec =
+      now.tv_sec * 1000000LL + now.tv_usec - options.startup_begin_usec;
+  char record[kRunnerStartupTimeRecordSize];
+  MakeRunnerStartupTimeRecord(elapsed_usec > 0 ? elapsed_usec : 0, record);
+  CHECK_EQ(Write(STDOUT_FILENO, record, sizeof(record)),
+           static_cast<ssize_t>(sizeof(record)));
+}
+
 const SnapCorpus<Host>* CommonMain(const RunnerMainOptions& options) {
   // Pin CPU if pinning is requested.
   if (options.cpu != kAnyCPUId) {
@@ -708,38 +1159,82 @@ const SnapCorpus<Host>* CommonMain(const RunnerMainOptions& options) {
     if (options.snap_id == nullptr) {
       return options.corpus;
     }
-    for (int i = 0; i < options.corpus->snaps.size; ++i) {
-      const Snap<Host>* snap = options.corpus->snaps[i];
-      if (strcmp(snap->id, options.snap_id) == 0) {
-        // Creates a slice of size 1 over the original corpus.
-        memcpy(&one_snap_corpus, options.corpus, sizeof(one_snap_corpus));
-        one_snap_corpus.snaps.size = 1;
-        one_snap_corpus.snaps.elements = &options.corpus->snaps[i];
-        return &one_snap_corpus;
-      }
+    const ssize_t i = options.corpus->FindIndex(options.snap_id);
+    if (i < 0) {
+      LOG_FATAL("Snap ", options.snap_id, " not found in the corpus");
     }
-    LOG_FATAL("Snap ", options.snap_id, " not found in the corpus");
+    // Creates a slice of size 1 over the original corpus.
+    memcpy(&one_snap_corpus, options.corpus, sizeof(one_snap_corpus));
+    one_snap_corpus.snaps.size = 1;
+    one_snap_corpus.snaps.elements = &options.corpus->snaps[i];
+    // The index does not apply to the slice.
+    one_snap_corpus.snap_id_index = {};
+    const SnapArray<uint64_t>* dirty_pages = options.corpus->DirtyPages(i);
+    one_snap_corpus.dirty_pages = {};
+    if (dirty_pages != nullptr) {
+      one_snap_corpus.dirty_pages.size = 1;
+      one_snap_corpus.dirty_pages.elements = dirty_pages;
+    }
+    return &one_snap_corpus;
   }();
   MapCorpus(*corpus, options.corpus_fd, corpus_mapping);
   if (options.strict) {
     VerifyChecksums(*corpus);
   }
+  if (options.report_startup_time) {
+    ReportStartupTime(options);
+  }
   InstallSigHandler();
+  StartSnapTimeBudgetTimer(options);
 
   return corpus;
 }
 
 void RunSnap(const Snap<Host>& snap, const RunnerMainOptions& options,
              RunSnapResult& result) {
-  PrepareSnapMemory(snap);
+  RunSnap(snap, nullptr, options, result);
+}
+
+void RunSnap(const Snap<Host>& snap, const SnapArray<uint64_t>* dirty_pages,
+             const RunnerMainOptions& options, RunSnapResult& result) {
+  // Without an end state check, we would not notice if a snap changed pages
+  // that it is not expected to. Without dirty pages, there is nothing to
+  // track.
+  const bool track_dirty_pages = options.track_dirty_pages &&
+                                 !options.skip_end_state_check &&
+                                 dirty_pages != nullptr;
+  bool full_memory_check = true;
+  if (track_dirty_pages) {
+    full_memory_check =
+        num_tracked_executions++ % options.full_memory_check_interval == 0;
+  } else if (page_owners.size() != 0) {
+    // Untracked executions invalidate what we know.
+    page_owners.Clear();
+  }
+
+  PrepareSnapMemory(snap, track_dirty_pages, full_memory_check);
+  snap_execution_seq = snap_execution_seq + 1;
   result.cpu_id = GetCPUIdNoSyscall();
   RunSnap(*snap.registers, options, result.end_spot);
   if (result.cpu_id != GetCPUIdNoSyscall()) {
     result.cpu_id = kUnknownCPUId;
   }
-  result.outcome = options.skip_end_state_check
-                       ? RunSnapOutcome::kAsExpected
-                       : EndSpotToOutcome(snap, result.end_spot);
+  result.outcome =
+      options.skip_end_state_check
+          ? RunSnapOutcome::kAsExpected
+          : EndSpotToOutcome(snap, dirty_pages, result.end_spot,
+                             full_memory_check);
+
+  if (track_dirty_pages) {
+    if (result.outcome == RunSnapOutcome::kAsExpected) {
+      for (uint64_t page_address : *dirty_pages) {
+        page_owners.ClearOwner(page_address);
+      }
+    } else {
+      // The snap may have changed any writable page.
+      page_owners.Clear();
+    }
+  }
 }
 
 int MakerMain(const RunnerMainOptions& options) {
@@ -760,13 +1255,38 @@ int MakerMain(const RunnerMainOptions& options) {
   return EXIT_SUCCESS;
 }
 
-int RunnerMain(const RunnerMainOptions& options) {
-  CHECK(!options.sequential_mode);
-  const SnapCorpus<Host>* corpus = CommonMain(options);
-  CHECK_GT(corpus->snaps.size, 0);
+namespace {
 
-  EnterSeccompFilterMode(SeccompOptionsFromRunnerMainOptions(options));
+// Shared by all worker processes. See RunnerMainOptions::num_workers.
+struct WorkerSharedState {
+  // Index of the worker that reports its failure, kNoReportingWorker if none
+  // has claimed the report yet or kReportClosed after the parent has stopped
+  // accepting claims.
+  std::atomic<int> reporting_worker;
+};
+
+constexpr int kNoReportingWorker = -1;
+constexpr int kReportClosed = -2;
+
+// Points into a shared anonymous mapping in worker processes and is nullptr
+// when the runner executes snaps in a single process.
+WorkerSharedState* worker_shared_state = nullptr;
+
+// Returns true iff this process should report a snap failure. Only the first
+// failing worker does, and only until the parent closes the report because
+// another worker exited abnormally.
+bool ClaimFailureReport(int worker) {
+  if (worker_shared_state == nullptr) return true;
+  int expected = kNoReportingWorker;
+  return worker_shared_state->reporting_worker.compare_exchange_strong(
+      expected, worker);
+}
 
+// Runs options.num_iterations randomly scheduled executions of the `count`
+// snaps corpus->snaps[first], corpus->snaps[first + stride], ...
+int RunSnapLoop(const SnapCorpus<Host>& corpus,
+                const RunnerMainOptions& options, int worker, size_t first,
+                size_t stride, size_t count) {
   std::mt19937_64 gen(options.seed);  // 64-bit Mersenne Twister engine
   VLOG_INFO(1, "Seed = ", IntStr(options.seed));
   size_t snap_execution_count = 0;
@@ -776,9 +1296,9 @@ int RunnerMain(const RunnerMainOptions& options) {
     size_t batch[RunnerMainOptions::kMaxBatchSize];
     size_t batch_size = options.batch_size;
     CHECK_LE(batch_size, RunnerMainOptions::kMaxBatchSize);
-    std::uniform_int_distribution<size_t> dist(0, corpus->snaps.size - 1);
+    std::uniform_int_distribution<size_t> dist(0, count - 1);
     for (size_t i = 0; i < batch_size; ++i) {
-      batch[i] = dist(gen);
+      batch[i] = first + dist(gen) * stride;
     }
 
     // Adjust schedule size to honor options.num_iterations.
@@ -792,11 +1312,16 @@ int RunnerMain(const RunnerMainOptions& options) {
         VLOG_INFO(1, "iter #", IntStr(snap_execution_count), " of ",
                   IntStr(options.num_iterations));
       }
-      const Snap<Host>& snap = *(corpus->snaps[batch[schedule_dist(gen)]]);
+      const size_t snap_index = batch[schedule_dist(gen)];
+      const Snap<Host>& snap = *(corpus.snaps[snap_index]);
       VLOG_INFO(3, "#", IntStr(snap_execution_count), " Running ", snap.id);
       RunSnapResult run_result;
-      RunSnap(snap, options, run_result);
+      RunSnap(snap, corpus.DirtyPages(snap_index), options, run_result);
       if (run_result.outcome != RunSnapOutcome::kAsExpected) {
+        if (!ClaimFailureReport(worker)) {
+          // Another worker reports its failure.
+          return EXIT_FAILURE;
+        }
         LogSnapRunResult(snap, options, run_result);
         LOG_ERROR("Seed = ", IntStr(options.seed), " iteration #",
                   IntStr(snap_execution_count));
@@ -817,6 +1342,183 @@ int RunnerMain(const RunnerMainOptions& options) {
   return EXIT_SUCCESS;
 }
 
+// Worker process body. Never returns.
+[[noreturn]] void WorkerMain(const SnapCorpus<Host>& corpus,
+                             const RunnerMainOptions& options, int worker) {
+  // Never outlive the parent, which may exit on SIGALRM without waiting.
+  CHECK_EQ(prctl(PR_SET_PDEATHSIG, SIGKILL), 0);
+
+  const size_t num_workers = options.num_workers;
+  const size_t num_snaps = corpus.snaps.size;
+  RunnerMainOptions worker_options = options;
+  worker_options.pid = getpid();
+  worker_options.seed = options.seed + worker;
+  worker_options.num_iterations = options.num_iterations / num_workers;
+  if (static_cast<size_t>(worker) < options.num_iterations % num_workers) {
+    ++worker_options.num_iterations;
+  }
+  if (options.cpu != kAnyCPUId) {
+    worker_options.cpu = options.cpu + worker;
+    const int error = SetCPUAffinity(worker_options.cpu);
+    if (error != 0) {
+      LOG_FATAL("Cannot pin cpu to core ", IntStr(worker_options.cpu),
+                " error=", IntStr(error));
+    }
+  }
+  // Interval timers are not inherited across fork().
+  StartSnapTimeBudgetTimer(worker_options);
+
+  // RLIMIT_CPU applies to every worker separately. Split the soft limit so
+  // that the workers together use no more CPU time than a single runner,
+  // keeping the grace period up to the hard limit.
+  struct kernel_rlimit rlimit;
+  CHECK_EQ(sys_getrlimit(RLIMIT_CPU, &rlimit), 0);
+  if (rlimit.rlim_cur != RLIM_INFINITY) {
+    const uint64_t soft_limit =
+        std::max<uint64_t>(rlimit.rlim_cur / num_workers, 1);
+    if (rlimit.rlim_max != RLIM_INFINITY) {
+      rlimit.rlim_max -= rlimit.rlim_cur - soft_limit;
+    }
+    rlimit.rlim_cur = soft_limit;
+    CHECK_EQ(sys_setrlimit(RLIMIT_CPU, &rlimit), 0);
+  }
+
+  EnterSeccompFilterMode(SeccompOptionsFromRunnerMainOptions(worker_options));
+  // Each worker has its own subset of snaps, unless there are too few.
+  const size_t first = worker % num_snaps;
+  size_t count = 1;
+  if (num_snaps >= num_workers) {
+    count = (num_snaps - first + num_workers - 1) / num_workers;
+  }
+  _exit(RunSnapLoop(corpus, worker_options, worker, first, num_workers, count));
+}
+
+// Forks options.num_workers worker processes and waits for them. Returns the
+// exit code of the runner or terminates with the signal that killed the
+// worker whose failure is reported.
+int RunWorkers(const SnapCorpus<Host>& corpus,
+               const RunnerMainOptions& options) {
+  // SigAction() treats any signal outside of a snap as fatal, SIGCHLD
+  // included.
+  struct kernel_sigaction default_action = {};
+  default_action.sa_handler_ = SIG_DFL;
+  CHECK_EQ(sys_sigaction(SIGCHLD, &default_action, nullptr), 0);
+
+  void* shared = sys_mmap(nullptr, sizeof(WorkerSharedState),
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                          -1, 0);
+  if (shared == MAP_FAILED) {
+    LOG_FATAL("mmap() failed: ", ErrnoStr(errno));
+  }
+  worker_shared_state = new (shared) WorkerSharedState{{kNoReportingWorker}};
+
+  struct kernel_timeval start_time;
+  CHECK_EQ(sys_gettimeofday(&start_time, nullptr), 0);
+
+  const size_t num_workers = options.num_workers;
+  CHECK_LE(num_workers, RunnerMainOptions::kMaxNumWorkers);
+  pid_t worker_pids[RunnerMainOptions::kMaxNumWorkers];
+  for (size_t i = 0; i < num_workers; ++i) {
+    worker_pids[i] = fork();
+    if (worker_pids[i] < 0) {
+      LOG_FATAL("fork() failed: ", ErrnoStr(errno));
+    }
+    if (worker_pids[i] == 0) {
+      WorkerMain(corpus, options, static_cast<int>(i));
+    }
+  }
+  VLOG_INFO(1, "Started ", IntStr(num_workers), " workers");
+
+  // Wait status of the first failed worker and of the reporting worker.
+  int first_failure_status = 0;
+  int reported_status = 0;
+  bool failed = false;
+  int reporting_worker = kNoReportingWorker;
+  for (size_t num_running = num_workers; num_running > 0; --num_running) {
+    int status = 0;
+    struct kernel_rusage rusage = {};
+    pid_t pid;
+    while ((pid = sys_wait4(-1, &status, 0, &rusage)) < 0) {
+      if (errno != EINTR) {
+        LOG_FATAL("wait4() failed: ", ErrnoStr(errno));
+      }
+    }
+    int worker = 0;
+    while (worker_pids[worker] != pid) ++worker;
+    worker_pids[worker] = 0;
+    VLOG_INFO(1, "Worker ", IntStr(worker), " exited with status ",
+              IntStr(status), ", max RSS ", IntStr(rusage.ru_maxrss),
+              " KiB, minor faults ", IntStr(rusage.ru_minflt));
+    if (worker == reporting_worker) {
+      reported_status = status;
+    }
+    if (status == 0 || failed) continue;
+
+    // Close the report before stopping the other workers. A worker that
+    // claimed it first is left to finish writing its result and waited for.
+    // Any later claim fails, so no worker is killed while reporting.
+    failed = true;
+    first_failure_status = status;
+    int expected = kNoReportingWorker;
+    if (!worker_shared_state->reporting_worker.compare_exchange_strong(
+            expected, kReportClosed)) {
+      reporting_worker = expected;
+      if (worker == reporting_worker) {
+        reported_status = status;
+      }
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
+      if (worker_pids[i] != 0 && static_cast<int>(i) != reporting_worker) {
+        sys_kill(worker_pids[i], SIGKILL);
+      }
+    }
+  }
+
+  struct kernel_timeval end_time;
+  CHECK_EQ(sys_gettimeofday(&end_time, nullptr), 0);
+  const int64_t elapsed_usec =
+      (end_time.tv_sec - start_time.tv_sec) * 1000000LL +
+      (end_time.tv_usec - start_time.tv_usec);
+  VLOG_INFO(1, "Workers ran for ", IntStr(elapsed_usec / 1000), " ms");
+  if (!failed) {
+    if (elapsed_usec > 0) {
+      VLOG_INFO(1, "Executed ",
+                IntStr(options.num_iterations * 1000000 / elapsed_usec),
+                " snaps/sec");
+    }
+    return EXIT_SUCCESS;
+  }
+
+  // The worker that printed its result determines the status, even if another
+  // worker, e.g. one that ran out of CPU time, failed first.
+  const int status = reporting_worker != kNoReportingWorker
+                         ? reported_status
+                         : first_failure_status;
+  if (WIFSIGNALED(status)) {
+    // Terminate the same way the worker did.
+    const int signal = WTERMSIG(status);
+    CHECK_EQ(sys_sigaction(signal, &default_action, nullptr), 0);
+    sys_kill(sys_getpid(), signal);
+    return EXIT_FAILURE;
+  }
+  return WEXITSTATUS(status);
+}
+
+}  // namespace
+
+int RunnerMain(const RunnerMainOptions& options) {
+  CHECK(!options.sequential_mode);
+  const SnapCorpus<Host>* corpus = CommonMain(options);
+  CHECK_GT(corpus->snaps.size, 0);
+
+  if (options.num_workers > 1) {
+    return RunWorkers(*corpus, options);
+  }
+
+  EnterSeccompFilterMode(SeccompOptionsFromRunnerMainOptions(options));
+  return RunSnapLoop(*corpus, options, 0, 0, 1, corpus->snaps.size);
+}
+
 int RunnerMainSequential(const RunnerMainOptions& options) {
   CHECK(options.sequential_mode);
   const SnapCorpus<Host>* corpus = CommonMain(options);
@@ -831,7 +1533,7 @@ int RunnerMainSequential(const RunnerMainOptions& options) {
     }
     VLOG_INFO(3, "#", IntStr(i), " Running ", snap.id);
     RunSnapResult run_result;
-    RunSnap(snap, options, run_result);
+    RunSnap(snap, corpus->DirtyPages(i), options, run_result);
     if (run_result.outcome != RunSnapOutcome::kAsExpected) {
       LogSnapRunResult(snap, options, run_result);
       LOG_ERROR("Id = ", snap.id, " Iteration #", IntStr(i));
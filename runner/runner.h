@@ -78,6 +78,13 @@ void MapCorpus(const SnapCorpus<Host>& corpus, int corpus_fd,
 void RunSnap(const Snap<Host>& snap, const RunnerMainOptions& options,
              RunSnapResult& result);
 
+// Like above but with the dirty pages of `snap` from SnapCorpus::DirtyPages().
+// With options.track_dirty_pages, only these pages are restored and verified
+// between full memory checks. If `dirty_pages` is nullptr, all writable memory
+// of `snap` is restored and verified.
+void RunSnap(const Snap<Host>& snap, const SnapArray<uint64_t>* dirty_pages,
+             const RunnerMainOptions& options, RunSnapResult& result);
+
 // Executes Snaps from a corpus according to 'options' and returns an exit code
 // that can be passed to _exit(). This is intended to be used for implementing
 // the main body of a snap runner.
@@ -22,6 +22,7 @@
 #include "./util/checks.h"
 #include "./util/cpu_id.h"
 #include "./util/flag_matcher.h"
+#include "./util/itoa.h"
 
 namespace silifuzz {
 
@@ -37,10 +38,17 @@ bool FLAGS_make = false;
 bool FLAGS_enable_tracer = false;
 size_t FLAGS_batch_size = RunnerMainOptions::kDefaultBatchSize;
 size_t FLAGS_schedule_size = RunnerMainOptions::kDefaultScheduleSize;
+uint64_t FLAGS_num_workers = 1;
 bool FLAGS_sequential_mode = false;
 bool FLAGS_skip_end_state_check = false;
 bool FLAGS_strict = false;
+bool FLAGS_track_dirty_pages = false;
+uint64_t FLAGS_full_memory_check_interval =
+    RunnerMainOptions::kDefaultFullMemoryCheckInterval;
 uint64_t FLAGS_max_pages_to_add = 0;
+bool FLAGS_text_result = false;
+bool FLAGS_report_startup_time = false;
+bool FLAGS_server = false;
 
 // Print all flags and exit.
 void ShowUsage(const char* program_name) {
@@ -60,15 +68,31 @@ void ShowUsage(const char* program_name) {
   LOG_INFO("  --enable_tracer\tEnable ptrace cooperation.");
   LOG_INFO("  --batch_size [size]\tSnap execution batch size.");
   LOG_INFO("  --schedule_size [size]\tSnap execution schedule size.");
+  LOG_INFO(
+      "  --num_workers [value]\tExperimental. Number of worker processes "
+      "sharing the mapped corpus.");
   LOG_INFO("  --sequential_mode\tRun Snaps sequentially once.");
   LOG_INFO(
       "  --skip_end_state_check\tDo not check end state after snap execution.");
   LOG_INFO(
       "  --strict\tPerform additional integrity checking. May slow down "
       "execution.");
+  LOG_INFO(
+      "  --track_dirty_pages\tOnly restore and verify memory pages that snaps "
+      "change.");
+  LOG_INFO(
+      "  --full_memory_check_interval [value]\tWith --track_dirty_pages, check "
+      "all memory every this many executions.");
   LOG_INFO(
       "  --max_pages_to_add [value]\tMaximum number of r/w pages added in snap "
       "making.");
+  LOG_INFO(
+      "  --text_result\tWrite execution results as text protos instead of "
+      "binary.");
+  LOG_INFO(
+      "  --report_startup_time\tWrite the time it took to get the corpus "
+      "ready to stdout.");
+  LOG_INFO("  --server\tServe runner requests read from stdin.");
   LOG_INFO("  --help\tPrint usage information.");
 }
 
@@ -145,6 +169,15 @@ int ParseRunnerFlags(int argc, char* argv[]) {
         return -1;
       }
       FLAGS_schedule_size = schedule_size;
+    } else if (matcher.Match("num_workers",
+                             CommandLineFlagMatcher::kRequiredArgument)) {
+      uint64_t num_workers;
+      if (!DecToU64(matcher.optarg(), &num_workers) || num_workers == 0 ||
+          num_workers > RunnerMainOptions::kMaxNumWorkers) {
+        LOG_ERROR("Invalid num_workers ", matcher.optarg());
+        return -1;
+      }
+      FLAGS_num_workers = num_workers;
     } else if (matcher.Match("sequential_mode",
                              CommandLineFlagMatcher::kNoArgument)) {
       FLAGS_sequential_mode = true;
@@ -153,6 +186,18 @@ int ParseRunnerFlags(int argc, char* argv[]) {
       FLAGS_skip_end_state_check = true;
     } else if (matcher.Match("strict", CommandLineFlagMatcher::kNoArgument)) {
       FLAGS_strict = true;
+    } else if (matcher.Match("track_dirty_pages",
+                             CommandLineFlagMatcher::kNoArgument)) {
+      FLAGS_track_dirty_pages = true;
+    } else if (matcher.Match("full_memory_check_interval",
+                             CommandLineFlagMatcher::kRequiredArgument)) {
+      uint64_t full_memory_check_interval;
+      if (!DecToU64(matcher.optarg(), &full_memory_check_interval) ||
+          full_memory_check_interval == 0) {
+        LOG_ERROR("Invalid full_memory_check_interval ", matcher.optarg());
+        return -1;
+      }
+      FLAGS_full_memory_check_interval = full_memory_check_interval;
     } else if (matcher.Match("max_pages_to_add",
                              CommandLineFlagMatcher::kRequiredArgument)) {
       uint64_t max_pages_to_add;
@@ -161,12 +206,31 @@ int ParseRunnerFlags(int argc, char* argv[]) {
         return -1;
       }
       FLAGS_max_pages_to_add = max_pages_to_add;
+    } else if (matcher.Match("text_result",
+                             CommandLineFlagMatcher::kNoArgument)) {
+      FLAGS_text_result = true;
+    } else if (matcher.Match("report_startup_time",
+                             CommandLineFlagMatcher::kNoArgument)) {
+      FLAGS_report_startup_time = true;
+    } else if (matcher.Match("server", CommandLineFlagMatcher::kNoArgument)) {
+      FLAGS_server = true;
     } else {
       // Exit loop if argument is not recognized.
       break;
     }
   }
 
+  // Worker i is pinned to FLAGS_cpu + i.
+  if (FLAGS_num_workers > 1 && FLAGS_cpu != kAnyCPUId) {
+    for (uint64_t i = 0; i < FLAGS_num_workers; ++i) {
+      if (!CanRunOnCPU(FLAGS_cpu + i)) {
+        LOG_ERROR("Cannot pin ", IntStr(FLAGS_num_workers),
+                  " workers starting at cpu ", IntStr(FLAGS_cpu));
+        return -1;
+      }
+    }
+  }
+
   return matcher.optind();
 }
 
@@ -63,6 +63,10 @@ extern uint64_t FLAGS_batch_size;
 // Snap execution schedule size.
 extern uint64_t FLAGS_schedule_size;
 
+// Number of worker processes that execute snaps from one mapped corpus.
+// See RunnerMainOptions::num_workers.
+extern uint64_t FLAGS_num_workers;
+
 // If true, execute Snaps sequentially once.
 extern bool FLAGS_sequential_mode;
 
@@ -72,10 +76,31 @@ extern bool FLAGS_skip_end_state_check;
 // If true, perform additional integrity checking. May slow down execution.
 extern bool FLAGS_strict;
 
+// If true, only restore and verify the memory pages that snaps change.
+// See RunnerMainOptions::track_dirty_pages.
+extern bool FLAGS_track_dirty_pages;
+
+// With --track_dirty_pages, restore and verify all writable memory every this
+// many executions.
+extern uint64_t FLAGS_full_memory_check_interval;
+
 // Maximum number of pages to be added during snap making. This option is used
 // only in snap making mode.
 extern uint64_t FLAGS_max_pages_to_add;
 
+// If true, write snap execution results as text protos instead of the binary
+// format. Useful for debugging. See runner_result_format.h.
+extern bool FLAGS_text_result;
+
+// If true, write the time it took to get the corpus ready to stdout before
+// anything else. See runner_result_format.h.
+extern bool FLAGS_report_startup_time;
+
+// Run in server mode. In this mode the runner does not load a corpus. Instead
+// it reads requests from stdin and serves each one in a forked child. See
+// runner_server_protocol.h for the protocol.
+extern bool FLAGS_server;
+
 // Parses command line flags of runner and sets flags accordingly. 'argv[]' is
 // an array of 'argc' command line argument passed to main(). Parsing starts
 // at 'argv[1]' and stops at the first non-flag argument or end of 'argv[]'.
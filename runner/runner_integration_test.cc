@@ -24,6 +24,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "./common/snapshot.h"
 #include "./common/snapshot_enums.h"
@@ -157,12 +158,74 @@ TEST(RunnerTest, RunawaySnap) {
   EXPECT_EQ(result.player_result().outcome, PlaybackOutcome::kExecutionRunaway);
 }
 
+TEST(RunnerTest, RunawaySnapWithPerSnapBudget) {
+  RunnerDriver driver = RunnerDriver::ReadingRunner(
+      RunnerLocation(), GetDataDependencyFilepath("snap/testing/test_corpus"));
+  RunnerOptions opts =
+      RunnerOptions::PlayOptions(EnumStr(TestSnapshot::kRunaway));
+  // The per-snap budget must catch the snap long before the process budget.
+  // This replaces the arguments from PlayOptions().
+  opts.set_cpu_time_budget(absl::Seconds(100))
+      .set_extra_argv({"--snap_id", EnumStr(TestSnapshot::kRunaway),
+                       "--num_iterations", "3", "--run_time_budget_ms=100"});
+  const absl::Time start = absl::Now();
+  ASSERT_OK_AND_ASSIGN(auto result, driver.Run(opts));
+  EXPECT_LT(absl::Now() - start, absl::Seconds(10));
+  ASSERT_FALSE(result.success());
+  EXPECT_EQ(result.player_result().outcome, PlaybackOutcome::kExecutionRunaway);
+}
+
 TEST(RunnerTest, Deadline) {
   ASSERT_OK_AND_ASSIGN(auto result,
                        RunOneSnap(TestSnapshot::kRunaway, absl::Seconds(2)));
   ASSERT_TRUE(result.success());
 }
 
+// Like RunOneSnap() but executes the snap in two worker processes.
+absl::StatusOr<RunnerDriver::RunResult> RunOneSnapInWorkers(
+    TestSnapshot test_snap_type,
+    absl::Duration timeout = absl::InfiniteDuration()) {
+  RunnerDriver driver = RunnerDriver::ReadingRunner(
+      RunnerLocation(), GetDataDependencyFilepath("snap/testing/test_corpus"));
+  RunnerOptions opts = RunnerOptions::PlayOptions(EnumStr(test_snap_type));
+  if (timeout != absl::InfiniteDuration()) {
+    opts.set_wall_time_budget(timeout);
+    opts.set_cpu_time_budget(timeout * 10);
+  }
+  // This replaces the arguments from PlayOptions().
+  opts.set_extra_argv({"--snap_id", EnumStr(test_snap_type), "--num_iterations",
+                       "3", "--num_workers=2"});
+  return driver.Run(opts);
+}
+
+TEST(RunnerTest, WorkersAsExpectedSnap) {
+  ASSERT_OK_AND_ASSIGN(auto result,
+                       RunOneSnapInWorkers(TestSnapshot::kEndsAsExpected));
+  ASSERT_TRUE(result.success());
+}
+
+TEST(RunnerTest, WorkersRegisterMismatchSnap) {
+  // Both workers fail, only one of them reports.
+  ASSERT_OK_AND_ASSIGN(auto result,
+                       RunOneSnapInWorkers(TestSnapshot::kRegsMismatch));
+  ASSERT_FALSE(result.success());
+  EXPECT_EQ(result.player_result().outcome,
+            PlaybackOutcome::kRegisterStateMismatch);
+}
+
+TEST(RunnerTest, WorkersSyscallSnap) {
+  auto result = RunOneSnapInWorkers(TestSnapshot::kSyscall);
+  ASSERT_THAT(result,
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("syscall")));
+}
+
+TEST(RunnerTest, WorkersDeadline) {
+  ASSERT_OK_AND_ASSIGN(
+      auto result,
+      RunOneSnapInWorkers(TestSnapshot::kRunaway, absl::Seconds(2)));
+  ASSERT_TRUE(result.success());
+}
+
 TEST(RunnerTest, EmptyCorpus) {
   MmappedMemoryPtr<char> buffer =
       GenerateRelocatableSnaps(Host::architecture_id, {});
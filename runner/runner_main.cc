@@ -32,6 +32,7 @@
 #include "./runner/runner.h"
 #include "./runner/runner_flags.h"
 #include "./runner/runner_main_options.h"
+#include "./runner/runner_server.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
 #include "./util/strcat.h"
@@ -63,6 +64,17 @@ int Main(int argc, char* argv[]) {
     ShowUsage(argv[0]);
     return EXIT_SUCCESS;
   }
+  if (FLAGS_server) {
+    if (flags_end < argc) {
+      LOG_ERROR("--server does not take any other arguments");
+      return EXIT_FAILURE;
+    }
+    // Every request is handled by calling Main() again in a forked child.
+    // Clear the flag so that the children process requests instead of
+    // recursively starting servers.
+    FLAGS_server = false;
+    return RunnerServerMain(argv[0], &Main);
+  }
   if (flags_end < argc && argv[flags_end][0] == '-') {
     // There's an option that didn't parse.
     LOG_ERROR(StrCat({"Unknown flag ", argv[flags_end]}));
@@ -72,6 +84,13 @@ int Main(int argc, char* argv[]) {
 
   RunnerMainOptions options;
   options.strict = FLAGS_strict;
+  if (FLAGS_report_startup_time) {
+    // Startup time includes loading the corpus.
+    struct kernel_timeval tv;
+    CHECK_EQ(sys_gettimeofday(&tv, nullptr), 0);
+    options.report_startup_time = true;
+    options.startup_begin_usec = tv.tv_sec * 1000000LL + tv.tv_usec;
+  }
 
   const char* corpus_file_name = flags_end < argc ? argv[flags_end] : nullptr;
   options.corpus =
@@ -109,7 +128,6 @@ int Main(int argc, char* argv[]) {
   options.snap_id = FLAGS_snap_id;
   options.num_iterations = FLAGS_num_iterations;
   options.enable_tracer = FLAGS_enable_tracer;
-  // TODO(ksteuck): [impl] Implement this in the runner.
   options.run_time_budget_ms = FLAGS_run_time_budget_ms;
   // getpid(2) never fails.
   options.pid = getpid();
@@ -128,12 +146,21 @@ int Main(int argc, char* argv[]) {
   options.batch_size = FLAGS_batch_size;
   options.schedule_size = FLAGS_schedule_size;
   options.sequential_mode = FLAGS_sequential_mode;
+  options.num_workers = FLAGS_num_workers;
   options.max_pages_to_add = FLAGS_make ? FLAGS_max_pages_to_add : 0;
+  // A snap is only executed once in make mode, nothing to gain from tracking.
+  options.track_dirty_pages = FLAGS_track_dirty_pages && !FLAGS_make;
+  options.full_memory_check_interval = FLAGS_full_memory_check_interval;
+  options.text_result = FLAGS_text_result;
 
   // These cannot be set together.
   if (FLAGS_make && FLAGS_sequential_mode) {
     LOG_FATAL("Cannot set both make and sequential mode");
   }
+  if (FLAGS_num_workers > 1 &&
+      (FLAGS_make || FLAGS_sequential_mode || FLAGS_enable_tracer)) {
+    LOG_FATAL("--num_workers only works in the default random mode");
+  }
 
   return (FLAGS_make              ? MakerMain(options)
           : FLAGS_sequential_mode ? RunnerMainSequential(options)
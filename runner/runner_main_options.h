@@ -96,6 +96,36 @@ struct RunnerMainOptions {
   // In sequential mode this is ignored.
   uint64_t schedule_size = kDefaultScheduleSize;
 
+  // Worker processes:
+  //
+  // The runner can map the corpus once and then fork `num_workers` worker
+  // processes that each execute snaps. The workers share the corpus mappings
+  // copy-on-write, so pages a worker never writes, including the read-only
+  // snap pages copied into anonymous memory, exist only once.
+  //
+  // Worker i executes only the snaps whose index in the corpus is congruent
+  // to i modulo num_workers, so that every writable snap page is copied by at
+  // most one worker. If there are fewer snaps than workers, worker i executes
+  // snap i modulo the number of snaps. The num_iterations executions are
+  // split among the workers and worker i uses seed + i. If cpu is set, worker
+  // i is pinned to cpu + i. The soft RLIMIT_CPU of the runner is split evenly
+  // among the workers, so that they use no more CPU time in total than a
+  // single runner. Only the first failure is reported: once any worker exits
+  // abnormally, the other workers are killed, except one that has already
+  // started to report its failure.
+  //
+  // Workers are processes rather than threads in one address space because
+  // snaps exit through the same fixed address and the runner keeps no
+  // thread-local state that the exit sequence could find. See
+  // snap_runner_util.h.
+  //
+  // Only used in the default random mode.
+  //
+  // Experimental: no caller sets num_workers yet and its throughput has not
+  // been measured against running one runner per core.
+  inline static constexpr uint64_t kMaxNumWorkers = 256;
+  uint64_t num_workers = 1;
+
   // If true, runner sequentially goes through all Snaps once. Batch and
   // schedule sizes in options are ignored. This is used for Snap verification.
   bool sequential_mode = false;
@@ -111,9 +141,36 @@ struct RunnerMainOptions {
   // If true, perform additional integrity checking. May slow down execution.
   bool strict;
 
+  // If true, the runner remembers which writable pages still hold the initial
+  // contents of a snap and only restores the pages that other executions
+  // changed. The end state check then only verifies the pages listed in
+  // SnapCorpus::dirty_pages. Ignored if skip_end_state_check is true or for
+  // corpora without dirty pages.
+  bool track_dirty_pages = false;
+
+  // When tracking dirty pages, every full_memory_check_interval-th execution
+  // restores and verifies all writable memory of the snap. This catches
+  // executions that change pages they are not expected to. Must be greater
+  // than 0.
+  inline static constexpr uint64_t kDefaultFullMemoryCheckInterval = 64;
+  uint64_t full_memory_check_interval = kDefaultFullMemoryCheckInterval;
+
   // The maximum number of pages to add during making. This is ignored if
   // runner is not in make mode.
   int max_pages_to_add = 0;
+
+  // If true, snap execution results are written to stdout as text protos
+  // instead of the binary format. See runner_result_format.h.
+  bool text_result = false;
+
+  // If true, the runner writes the time it took to get the corpus ready,
+  // measured from startup_begin_usec, to stdout before anything else. See
+  // runner_result_format.h.
+  bool report_startup_time = false;
+
+  // Wall time in microseconds since the epoch at which the runner started
+  // loading the corpus. Only used if report_startup_time is true.
+  int64_t startup_begin_usec = 0;
 };
 
 }  // namespace silifuzz
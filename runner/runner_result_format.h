@@ -0,0 +1,120 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_RESULT_FORMAT_H_
+#define THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_RESULT_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace silifuzz {
+
+// Format of the snap execution result the runner writes to stdout.
+//
+// By default the result is binary:
+//
+//   <kBinaryRunnerResultMagic> <payload size> <payload>
+//
+// where <payload size> is a 64-bit little-endian integer and <payload> is a
+// proto.SnapshotExecutionResult in protobuf binary wire format. With
+// --text_result the runner instead writes the proto in text format, which is
+// easier to read when debugging.
+//
+// The magic starts with a NUL byte, which never starts a text format proto,
+// so readers can tell the formats apart.
+inline constexpr char kBinaryRunnerResultMagic[8] = {'\0', 'S', 'F', 'R',
+                                                     'E',  'S', 'L', 'T'};
+
+// Size of the binary result header i.e. the magic and the payload size.
+inline constexpr size_t kBinaryRunnerResultHeaderSize =
+    sizeof(kBinaryRunnerResultMagic) + sizeof(uint64_t);
+
+// Fills `header` with the header of a binary result with `payload_size` bytes
+// of payload.
+inline void MakeBinaryRunnerResultHeader(
+    uint64_t payload_size, char (&header)[kBinaryRunnerResultHeaderSize]) {
+  memcpy(header, kBinaryRunnerResultMagic, sizeof(kBinaryRunnerResultMagic));
+  for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+    header[sizeof(kBinaryRunnerResultMagic) + i] =
+        static_cast<char>(payload_size >> (8 * i));
+  }
+}
+
+// Returns true iff the `size` bytes at `data` start with a complete binary
+// result header. If so, stores the payload size in `payload_size`.
+inline bool ParseBinaryRunnerResultHeader(const char* data, size_t size,
+                                          uint64_t* payload_size) {
+  if (size < kBinaryRunnerResultHeaderSize ||
+      memcmp(data, kBinaryRunnerResultMagic,
+             sizeof(kBinaryRunnerResultMagic)) != 0) {
+    return false;
+  }
+  *payload_size = 0;
+  for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+    *payload_size |=
+        static_cast<uint64_t>(static_cast<uint8_t>(
+            data[sizeof(kBinaryRunnerResultMagic) + i]))
+        << (8 * i);
+  }
+  return true;
+}
+
+// With --report_startup_time the runner also writes a startup time record
+//
+//   <kRunnerStartupTimeMagic> <startup time>
+//
+// to stdout as soon as the corpus is ready, before any result. <startup time>
+// is the wall time in microseconds the runner spent getting the corpus ready,
+// as a 64-bit little-endian integer. Like the binary result magic, the record
+// magic starts with a NUL byte.
+inline constexpr char kRunnerStartupTimeMagic[8] = {'\0', 'S', 'F', 'S',
+                                                    'T',  'A', 'R', 'T'};
+
+// Size of the startup time record.
+inline constexpr size_t kRunnerStartupTimeRecordSize =
+    sizeof(kRunnerStartupTimeMagic) + sizeof(uint64_t);
+
+// Fills `record` with a startup time record of `startup_time_usec`.
+inline void MakeRunnerStartupTimeRecord(
+    uint64_t startup_time_usec, char (&record)[kRunnerStartupTimeRecordSize]) {
+  memcpy(record, kRunnerStartupTimeMagic, sizeof(kRunnerStartupTimeMagic));
+  for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+    record[sizeof(kRunnerStartupTimeMagic) + i] =
+        static_cast<char>(startup_time_usec >> (8 * i));
+  }
+}
+
+// Returns true iff the `size` bytes at `data` start with a startup time
+// record. If so, stores the startup time in `startup_time_usec`.
+inline bool ParseRunnerStartupTimeRecord(const char* data, size_t size,
+                                         uint64_t* startup_time_usec) {
+  if (size < kRunnerStartupTimeRecordSize ||
+      memcmp(data, kRunnerStartupTimeMagic, sizeof(kRunnerStartupTimeMagic)) !=
+          0) {
+    return false;
+  }
+  *startup_time_usec = 0;
+  for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+    *startup_time_usec |=
+        static_cast<uint64_t>(static_cast<uint8_t>(
+            data[sizeof(kRunnerStartupTimeMagic) + i]))
+        << (8 * i);
+  }
+  return true;
+}
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_RESULT_FORMAT_H_
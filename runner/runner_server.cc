@@ -0,0 +1,170 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./runner/runner_server.h"
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "third_party/lss/lss/linux_syscall_support.h"
+#include "./runner/runner_server_protocol.h"
+#include "./runner/runner_util.h"
+#include "./util/atoi.h"
+#include "./util/checks.h"
+#include "./util/itoa.h"
+#include "./util/strcat.h"
+
+namespace silifuzz {
+
+namespace {
+
+// Reads the next request line from stdin into `buffer` which already holds
+// `*size` bytes of previously read data. On success, replaces the newline
+// terminating the request with '\0' and returns the length of the line.
+// Returns -1 on EOF.
+ssize_t ReadRequestLine(char* buffer, size_t* size) {
+  size_t scanned = 0;
+  while (true) {
+    for (; scanned < *size; ++scanned) {
+      if (buffer[scanned] == '\n') {
+        buffer[scanned] = '\0';
+        return scanned;
+      }
+    }
+    if (*size == kRunnerServerMaxRequestSize) {
+      LOG_FATAL("Request exceeds ", IntStr(kRunnerServerMaxRequestSize),
+                " bytes");
+    }
+    ssize_t n =
+        read(STDIN_FILENO, buffer + *size, kRunnerServerMaxRequestSize - *size);
+    if (n == 0) {
+      if (*size != 0) {
+        LOG_ERROR("Discarding incomplete request at EOF");
+      }
+      return -1;
+    }
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      LOG_FATAL("read() failed: ", ErrnoStr(errno));
+    }
+    *size += n;
+  }
+}
+
+// Splits `line` in place into fields separated by kRunnerServerFieldSeparator.
+// Stores pointers to the fields in `fields`. Returns number of fields.
+size_t SplitRequestLine(char* line, char* fields[], size_t max_fields) {
+  size_t num_fields = 0;
+  char* field = line;
+  for (char* p = line;; ++p) {
+    if (*p == kRunnerServerFieldSeparator || *p == '\0') {
+      const bool last = *p == '\0';
+      *p = '\0';
+      if (num_fields == max_fields) {
+        LOG_FATAL("Too many fields in request");
+      }
+      fields[num_fields++] = field;
+      field = p + 1;
+      if (last) break;
+    }
+  }
+  return num_fields;
+}
+
+// Runs a single request in a forked child and returns the wait status.
+int ServeOneRequest(const char* program_name,
+                    RunnerServerRequestMain request_main, char* fields[],
+                    size_t num_fields) {
+  uint64_t cpu_time_budget_sec = 0;
+  if (!DecToU64(fields[0], &cpu_time_budget_sec)) {
+    LOG_FATAL("Invalid CPU time budget ", fields[0]);
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    LOG_FATAL("fork() failed: ", ErrnoStr(errno));
+  }
+  if (pid == 0) {
+    // We are the child. Never outlive the server.
+    CHECK_EQ(prctl(PR_SET_PDEATHSIG, SIGKILL), 0);
+    if (cpu_time_budget_sec > 0) {
+      // Soft cap at the budget, hard cap +1 second to give the child a chance
+      // to exit gracefully. This matches what RunnerDriver does for a freshly
+      // spawned runner.
+      struct kernel_rlimit rlimit = {
+          .rlim_cur = cpu_time_budget_sec,
+          .rlim_max = cpu_time_budget_sec + 1,
+      };
+      CHECK_EQ(sys_setrlimit(RLIMIT_CPU, &rlimit), 0);
+    }
+    // Reuse the field array as argv. fields[0] (the budget) is replaced by
+    // the program name and the array is null-terminated as main() expects.
+    fields[0] = const_cast<char*>(program_name);
+    fields[num_fields] = nullptr;
+    _exit(request_main(static_cast<int>(num_fields), fields));
+  }
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) != pid) {
+    if (errno != EINTR) {
+      LOG_FATAL("waitpid() failed: ", ErrnoStr(errno));
+    }
+  }
+  return status;
+}
+
+}  // namespace
+
+int RunnerServerMain(const char* program_name,
+                     RunnerServerRequestMain request_main) {
+  static char buffer[kRunnerServerMaxRequestSize];
+  size_t size = 0;
+  size_t num_requests = 0;
+  VLOG_INFO(1, "Runner server started");
+  while (true) {
+    ssize_t line_size = ReadRequestLine(buffer, &size);
+    if (line_size < 0) break;
+
+    // One extra slot for the null terminator of argv.
+    char* fields[kRunnerServerMaxRequestArgs + 1];
+    size_t num_fields =
+        SplitRequestLine(buffer, fields, kRunnerServerMaxRequestArgs);
+    int status =
+        ServeOneRequest(program_name, request_main, fields, num_fields);
+    ++num_requests;
+
+    LogToStdout(
+        StrCat({"\n", kRunnerServerReplyTrailer, IntStr(status), "\n"}));
+
+    // Move any pipelined data after the current request to the front.
+    size_t consumed = line_size + 1;
+    for (size_t i = consumed; i < size; ++i) {
+      buffer[i - consumed] = buffer[i];
+    }
+    size -= consumed;
+  }
+  VLOG_INFO(1, "Runner server served ", IntStr(num_requests), " requests");
+  return EXIT_SUCCESS;
+}
+
+}  // namespace silifuzz
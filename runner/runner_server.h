@@ -0,0 +1,37 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_H_
+#define THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_H_
+
+namespace silifuzz {
+
+// Signature of the function invoked in the child process to handle a request.
+// This is normally the runner's main().
+using RunnerServerRequestMain = int (*)(int argc, char* argv[]);
+
+// Runs the runner server loop. See runner_server_protocol.h for the protocol.
+//
+// Every request is served by a forked child that calls `request_main` with
+// `program_name` as argv[0]. This saves the execve(2), ELF loading and runner
+// initialization cost per request while still giving every snap its own
+// address space: a crashing snap only takes down the child, never the server.
+//
+// RETURNS: process exit code.
+int RunnerServerMain(const char* program_name,
+                     RunnerServerRequestMain request_main);
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_H_
@@ -0,0 +1,56 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_PROTOCOL_H_
+#define THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_PROTOCOL_H_
+
+#include <cstddef>
+
+namespace silifuzz {
+
+// Wire protocol of the runner server mode (--server).
+//
+// In server mode the runner does not load any corpus by itself. Instead it
+// reads a stream of requests from stdin, one per line. Each request is a list
+// of fields separated by kRunnerServerFieldSeparator:
+//
+//   <cpu_time_budget_sec> <arg1> <arg2> ... <argN>
+//
+// where <cpu_time_budget_sec> is the RLIMIT_CPU soft limit for the request
+// (0 means unlimited) and <arg1>...<argN> are regular runner command line
+// arguments including the corpus path e.g.
+//
+//   1 --snap_id foo --num_iterations 1 --make /proc/123/fd/4
+//
+// For every request the server forks a fresh child that processes the
+// arguments exactly like a freshly exec-ed runner would. The child inherits the
+// server's stdout and stderr. Once the child terminates, the server appends
+//
+//   \n<kRunnerServerReplyTrailer><wait status>\n
+//
+// to stdout, where <wait status> is the decimal status reported by waitpid(2).
+//
+// The server exits with EXIT_SUCCESS when stdin is closed.
+inline constexpr char kRunnerServerFieldSeparator = '\t';
+inline constexpr char kRunnerServerReplyTrailer[] = "#runner_server_status ";
+
+// Maximum size of a single request line, including the trailing newline.
+inline constexpr size_t kRunnerServerMaxRequestSize = 4096;
+
+// Maximum number of arguments in a single request.
+inline constexpr size_t kRunnerServerMaxRequestArgs = 64;
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_RUNNER_RUNNER_SERVER_PROTOCOL_H_
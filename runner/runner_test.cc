@@ -44,6 +44,15 @@ const Snap<Host>& GetSnapRunnerTestSnap(TestSnapshot type) {
   return *snap;
 }
 
+// Returns the dirty pages of a Snap runner test Snap of the given type.
+const SnapArray<uint64_t>* GetSnapRunnerTestDirtyPages(TestSnapshot type) {
+  const ssize_t index = kSnapRunnerTestCorpus->FindIndex(EnumStr(type));
+  if (index < 0) {
+    LOG_FATAL("Cannot find snap with ID: ", EnumStr(type));
+  }
+  return kSnapRunnerTestCorpus->DirtyPages(index);
+}
+
 // Runner tests do not run well with normal libc because of an invalid fs_base.
 // We could make the tests work but it would not be how the runner is intended
 // to be used.
@@ -85,6 +94,50 @@ TEST(Runner, SkipEndStateCheck) {
   CHECK_EQ(result.outcome, RunSnapOutcome::kAsExpected);
 }
 
+TEST(Runner, TrackDirtyPages) {
+  RunnerMainOptions options = RunnerMainOptions::Default();
+  options.track_dirty_pages = true;
+  options.full_memory_check_interval = 3;
+  CHECK_NE(GetSnapRunnerTestDirtyPages(TestSnapshot::kEndsAsExpected),
+           nullptr);
+  for (int i = 0; i < 10; ++i) {
+    RunSnapResult result;
+    RunSnap(GetSnapRunnerTestSnap(TestSnapshot::kEndsAsExpected),
+            GetSnapRunnerTestDirtyPages(TestSnapshot::kEndsAsExpected),
+            options, result);
+    CHECK_EQ(result.outcome, RunSnapOutcome::kAsExpected);
+    // Interleave a failing snap, after which all pages must be restored.
+    if (i % 4 == 0) {
+      RunSnap(GetSnapRunnerTestSnap(TestSnapshot::kRegsMismatch),
+              GetSnapRunnerTestDirtyPages(TestSnapshot::kRegsMismatch),
+              options, result);
+      CHECK_EQ(result.outcome, RunSnapOutcome::kRegisterStateMismatch);
+    }
+  }
+
+  // Full memory checks still find mismatches.
+  options.full_memory_check_interval = 1;
+  RunSnapResult result;
+  RunSnap(GetSnapRunnerTestSnap(TestSnapshot::kMemoryMismatch),
+          GetSnapRunnerTestDirtyPages(TestSnapshot::kMemoryMismatch), options,
+          result);
+  CHECK_EQ(result.outcome, RunSnapOutcome::kMemoryMismatch);
+}
+
+TEST(Runner, TrackDirtyPagesWithoutDirtyPages) {
+  // Without dirty pages, as for older corpora, all memory is restored and
+  // verified every time.
+  RunnerMainOptions options = RunnerMainOptions::Default();
+  options.track_dirty_pages = true;
+  options.full_memory_check_interval = 1000;
+  for (int i = 0; i < 3; ++i) {
+    RunSnapResult result;
+    RunSnap(GetSnapRunnerTestSnap(TestSnapshot::kMemoryMismatch), nullptr,
+            options, result);
+    CHECK_EQ(result.outcome, RunSnapOutcome::kMemoryMismatch);
+  }
+}
+
 // Initializes the test environment. Loads and maps the corpus, then drops into
 // the seccomp sandbox.
 void InitTestEnv() {
@@ -108,4 +161,6 @@ NOLIBC_TEST_MAIN({
   RUN_TEST(Runner, RegsMismatch);
   RUN_TEST(Runner, MemoryMismatch);
   RUN_TEST(Runner, SkipEndStateCheck);
+  RUN_TEST(Runner, TrackDirtyPages);
+  RUN_TEST(Runner, TrackDirtyPagesWithoutDirtyPages);
 })
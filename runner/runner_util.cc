@@ -70,6 +70,22 @@ size_t ReadProcMapsEntries(ProcMapsEntry* proc_maps_entries,
                        max_proc_maps_entries);
 }
 
+size_t CountProcMapsEntries() {
+  // Unlike ReadProcMapsEntries(), this must work for a process with a large
+  // number of mappings, so read the file in chunks.
+  int fd = open("/proc/self/maps", O_RDONLY);
+  CHECK_GE(fd, 0);
+  char buffer[4096];
+  size_t num_entries = 0;
+  ssize_t bytes_read;
+  while ((bytes_read = Read(fd, buffer, sizeof(buffer))) > 0) {
+    num_entries += std::count(buffer, buffer + bytes_read, '\n');
+  }
+  CHECK_EQ(bytes_read, 0);
+  CHECK_EQ(close(fd), 0);
+  return num_entries;
+}
+
 bool SnapOverlapsWithProcMapsEntries(const Snap<Host>& snap,
                                      const ProcMapsEntry* proc_maps_entries,
                                      size_t num_proc_maps_entries) {
@@ -32,6 +32,10 @@ namespace silifuzz {
 size_t ReadProcMapsEntries(ProcMapsEntry* proc_maps_entries,
                            size_t max_proc_maps_entries);
 
+// Returns the number of memory mappings (VMAs) of this process as listed in
+// /proc/self/maps. It dies if there is any error.
+size_t CountProcMapsEntries();
+
 // Returns true iff 'snap' conflicts with any of the memory ranges in one of the
 // 'num_proc_maps_entries' elements of 'proc_maps_entries[]'.
 bool SnapOverlapsWithProcMapsEntries(const Snap<Host>& snap,
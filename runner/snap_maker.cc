@@ -14,6 +14,7 @@
 
 #include "./runner/snap_maker.h"
 
+#include <sys/types.h>
 #include <sys/user.h>
 
 #include <optional>
@@ -26,6 +27,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "./common/harness_tracer.h"
 #include "./common/memory_bytes_set.h"
 #include "./common/memory_perms.h"
 #include "./common/snapshot.h"
@@ -58,6 +60,13 @@ SnapMaker::SnapMaker(const Options& opts) : opts_(opts) {
 }
 
 absl::StatusOr<Snapshot> SnapMaker::Make(const Snapshot& snapshot) {
+  std::optional<Snapshot::EndState> actual_end_state;
+  return MakeImpl(snapshot, actual_end_state);
+}
+
+absl::StatusOr<Snapshot> SnapMaker::MakeImpl(
+    const Snapshot& snapshot,
+    std::optional<Snapshot::EndState>& actual_end_state) {
   CHECK(!snapshot.expected_end_states().empty());
   Snapshot copy = snapshot.Copy();
   snapshot_types::Address orig_endpoint_address;
@@ -84,7 +93,8 @@ absl::StatusOr<Snapshot> SnapMaker::Make(const Snapshot& snapshot) {
 
   ASSIGN_OR_RETURN_IF_NOT_OK(copy, Snapify(copy, snapify_opts));
   ASSIGN_OR_RETURN_IF_NOT_OK(RunnerDriver runner_driver,
-                             RunnerDriverFromSnapshot(copy, opts_.runner_path));
+                             RunnerDriverFromSnapshot(copy, opts_.runner_path,
+                                                      opts_.runner_server));
   ASSIGN_OR_RETURN_IF_NOT_OK(
       RunnerDriver::RunResult make_result,
       runner_driver.MakeOne(copy.id(), opts_.max_pages_to_add));
@@ -163,9 +173,23 @@ absl::StatusOr<Snapshot> SnapMaker::Make(const Snapshot& snapshot) {
   copy.set_expected_end_states({});
   RETURN_IF_NOT_OK(copy.can_add_expected_end_state(repaired_end_state));
   copy.add_expected_end_state(repaired_end_state);
+  actual_end_state =
+      std::move(make_result.player_result().actual_end_state.value());
   return copy;
 }
 
+absl::StatusOr<Snapshot> SnapMaker::MakeAndRecord(const Snapshot& snapshot) {
+  std::optional<Snapshot::EndState> actual_end_state;
+  ASSIGN_OR_RETURN_IF_NOT_OK(Snapshot made_snapshot,
+                             MakeImpl(snapshot, actual_end_state));
+  SnapifyOptions snapify_opts =
+      SnapifyOptions::V2InputMakeOpts(made_snapshot.architecture_id());
+  ASSIGN_OR_RETURN_IF_NOT_OK(Snapshot snapified,
+                             Snapify(made_snapshot, snapify_opts));
+  return SetRecordedEndState(std::move(snapified),
+                             std::move(actual_end_state.value()));
+}
+
 absl::StatusOr<Snapshot> SnapMaker::RecordEndState(const Snapshot& snapshot) {
   SnapifyOptions snapify_opts =
       SnapifyOptions::V2InputMakeOpts(snapshot.architecture_id());
@@ -173,7 +197,8 @@ absl::StatusOr<Snapshot> SnapMaker::RecordEndState(const Snapshot& snapshot) {
                              Snapify(snapshot, snapify_opts));
   ASSIGN_OR_RETURN_IF_NOT_OK(
       RunnerDriver recorder,
-      RunnerDriverFromSnapshot(snapified, opts_.runner_path));
+      RunnerDriverFromSnapshot(snapified, opts_.runner_path,
+                               opts_.runner_server));
   ASSIGN_OR_RETURN_IF_NOT_OK(
       RunnerDriver::RunResult record_result,
       recorder.MakeOne(snapified.id(), /* max_pages_to_add=*/0));
@@ -184,8 +209,13 @@ absl::StatusOr<Snapshot> SnapMaker::RecordEndState(const Snapshot& snapshot) {
   if (!record_result.player_result().actual_end_state.has_value()) {
     return absl::InternalError("The runner didn't report actual_end_state");
   }
-  Snapshot::EndState& actual_end_state =
-      *record_result.player_result().actual_end_state;
+  return SetRecordedEndState(
+      std::move(snapified),
+      std::move(*record_result.player_result().actual_end_state));
+}
+
+absl::StatusOr<Snapshot> SnapMaker::SetRecordedEndState(
+    Snapshot snapified, Snapshot::EndState actual_end_state) {
   actual_end_state.set_platforms({CurrentPlatformId()});
   snapified.set_expected_end_states({});
   // TODO(ksteuck): [as-needed] The runner machinery already supports signal
@@ -237,7 +267,8 @@ absl::Status SnapMaker::VerifyPlaysDeterministically(
                              Snapify(snapshot, snapify_opts));
   ASSIGN_OR_RETURN_IF_NOT_OK(
       RunnerDriver driver,
-      RunnerDriverFromSnapshot(snapified, opts_.runner_path));
+      RunnerDriverFromSnapshot(snapified, opts_.runner_path,
+                               opts_.runner_server));
 
   // TODO(ksteuck): [as-needed] Consider VerifyDisjointly()-like functionality
   // to ensure that the snapshot does not touch any runner memory regions.
@@ -248,17 +279,76 @@ absl::Status SnapMaker::VerifyPlaysDeterministically(
       RunnerDriver::RunResult verify_result,
       driver.VerifyOneRepeatedly(snapified.id(), opts_.num_verify_attempts));
   if (!verify_result.success()) {
-    if (VLOG_IS_ON(1)) {
-      LinePrinter lp(LinePrinter::StdErrPrinter);
-      SnapshotPrinter printer(&lp);
-      printer.PrintActualEndState(
-          snapified, *verify_result.player_result().actual_end_state);
-    }
-    return absl::InternalError("Verify() failed, non-deterministic snapshot?");
+    return VerifyFailure(snapified, verify_result);
   }
   return absl::OkStatus();
 }
 
+absl::StatusOr<Snapshot> SnapMaker::VerifyAndCheckTrace(
+    const Snapshot& snapshot, const TraceOptions& trace_options) const {
+  SnapifyOptions snapify_opts =
+      SnapifyOptions::V2InputRunOpts(snapshot.architecture_id());
+  ASSIGN_OR_RETURN_IF_NOT_OK(Snapshot snapified,
+                             Snapify(snapshot, snapify_opts));
+#if defined(__x86_64__)
+  ASSIGN_OR_RETURN_IF_NOT_OK(
+      RunnerDriver driver,
+      RunnerDriverFromSnapshot(snapified, opts_.runner_path));
+
+  // Single-step only the first iteration. The tracer becomes inactive when
+  // the snapshot is left or tracing is stopped for any other reason. Later
+  // iterations are not traced but still checked by the runner.
+  DisassemblingSnapTracer tracer(snapified, trace_options);
+  bool first_iteration_traced = false;
+  auto trace_first_iteration =
+      [&tracer, &first_iteration_traced](pid_t pid,
+                                         const user_regs_struct& regs,
+                                         HarnessTracer::CallbackReason reason) {
+        if (first_iteration_traced) {
+          return HarnessTracer::kStopTracing;
+        }
+        if (reason == HarnessTracer::kBecomingInactive) {
+          first_iteration_traced = true;
+        }
+        return tracer.Step(pid, regs, reason);
+      };
+  absl::StatusOr<RunnerDriver::RunResult> result_or =
+      driver.TraceAndVerifyOne(snapified.id(), trace_first_iteration,
+                               1 + opts_.num_verify_attempts);
+  DisassemblingSnapTracer::TraceResult trace_result = tracer.trace_result();
+
+  if (!trace_result.early_termination_reason.empty()) {
+    return absl::InternalError(absl::StrCat(
+        "Tracing failed: ", trace_result.early_termination_reason));
+  }
+  RETURN_IF_NOT_OK(result_or.status());
+  if (!result_or->success()) {
+    return VerifyFailure(snapified, *result_or);
+  }
+  Snapshot::TraceData trace_data(trace_result.instructions_executed,
+                                 absl::StrJoin(trace_result.disassembly, "\n"));
+  trace_data.add_platform(CurrentPlatformId());
+  Snapshot copy = snapshot.Copy();
+  copy.set_trace_data({trace_data});
+  return copy;
+#else
+  // There is no tracing to fuse with.
+  RETURN_IF_NOT_OK(VerifyPlaysDeterministically(snapshot));
+  return CheckTrace(snapshot, trace_options);
+#endif
+}
+
+absl::Status SnapMaker::VerifyFailure(
+    const Snapshot& snapshot, const RunnerDriver::RunResult& verify_result) {
+  if (VLOG_IS_ON(1)) {
+    LinePrinter lp(LinePrinter::StdErrPrinter);
+    SnapshotPrinter printer(&lp);
+    printer.PrintActualEndState(
+        snapshot, *verify_result.player_result().actual_end_state);
+  }
+  return absl::InternalError("Verify() failed, non-deterministic snapshot?");
+}
+
 absl::Status SnapMaker::AddWritableMemoryForEndState(
     Snapshot* snapshot, const Snapshot::EndState& end_state) {
   // Compute the memory mapping added in the making process by subtracting
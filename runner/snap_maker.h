@@ -15,12 +15,15 @@
 #ifndef THIRD_PARTY_SILIFUZZ_RUNNER_SNAP_MAKER_H_
 #define THIRD_PARTY_SILIFUZZ_RUNNER_SNAP_MAKER_H_
 
+#include <optional>
 #include <string>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "./common/snapshot.h"
 #include "./player/trace_options.h"
+#include "./runner/driver/runner_driver.h"
+#include "./runner/driver/runner_server_client.h"
 
 namespace silifuzz {
 
@@ -34,6 +37,12 @@ namespace silifuzz {
 //
 // Refer to individual function documentation for details.
 //
+// MakeAndRecord() and VerifyAndCheckTrace() implement the same pipeline with
+// two runner processes instead of one per stage and verification attempt:
+//
+//   <bytes>   ->   SnapMaker::MakeAndRecord()
+//             ->   SnapMaker::VerifyAndCheckTrace()
+//
 // This class is thread-compatible.
 class SnapMaker {
  public:
@@ -50,6 +59,13 @@ class SnapMaker {
     // value is somewhat arbitrary but it should normally be > 1.
     int num_verify_attempts = 5;
 
+    // If not null, Make() and RecordEndState() send their runner invocations
+    // to this long-lived runner server instead of spawning a new runner
+    // process for each. VerifyPlaysDeterministically() runs with ASLR and
+    // always spawns new processes, see RunnerServerClient. Must wrap
+    // `runner_path`.
+    RunnerServerClient* runner_server = nullptr;
+
     absl::Status Validate() const {
       if (runner_path.empty()) {
         return absl::InvalidArgumentError("runner_path must be non-empty");
@@ -60,6 +76,11 @@ class SnapMaker {
       if (num_verify_attempts <= 0) {
         return absl::InvalidArgumentError("num_verify_attempts <= 0");
       }
+      if (runner_server != nullptr &&
+          runner_server->binary_path() != runner_path) {
+        return absl::InvalidArgumentError(
+            "runner_server must wrap runner_path");
+      }
 
       return absl::OkStatus();
     }
@@ -98,6 +119,13 @@ class SnapMaker {
   // RETURNS: OkStatus() if the snapshot was successfully verified.
   absl::Status VerifyPlaysDeterministically(const Snapshot& snapshot) const;
 
+  // Equivalent to RecordEndState(Make(snapshot)) but records the end state
+  // reached by the making run instead of running the made snapshot again.
+  // The making run starts from the same state as the recording run would,
+  // only with added pages mapped on demand, so both reach the same end state
+  // unless the snapshot is non-deterministic, which verification catches.
+  absl::StatusOr<Snapshot> MakeAndRecord(const Snapshot& snapshot);
+
   // Single-steps the input snapshot and checks the conditions described below.
   //
   // Returns a Status if the snapshot does one of the following: a) executes
@@ -110,7 +138,36 @@ class SnapMaker {
       const Snapshot& snapshot,
       const TraceOptions& trace_options = TraceOptions::Default()) const;
 
+  // Equivalent to VerifyPlaysDeterministically() followed by CheckTrace() but
+  // uses a single runner process. The process single-steps the first
+  // iteration of the snapshot and then plays it `num_verify_attempts` more
+  // times at full speed, checking the end state each time. Unlike
+  // VerifyPlaysDeterministically(), all attempts share one address space
+  // layout.
+  // REQUIRES: `snapshot` must be Snapify()-ed.
+  absl::StatusOr<Snapshot> VerifyAndCheckTrace(
+      const Snapshot& snapshot,
+      const TraceOptions& trace_options = TraceOptions::Default()) const;
+
  private:
+  // Implements Make(). Also stores the actual end state reached by the
+  // making run in `actual_end_state` on success.
+  absl::StatusOr<Snapshot> MakeImpl(
+      const Snapshot& snapshot,
+      std::optional<Snapshot::EndState>& actual_end_state);
+
+  // Replaces expected end states of the snapified `snapshot` with
+  // `actual_end_state` recorded on the current platform.
+  // RETURNS: A snapshot with exactly one complete expected end state or an
+  // error.
+  static absl::StatusOr<Snapshot> SetRecordedEndState(
+      Snapshot snapshot, Snapshot::EndState actual_end_state);
+
+  // Returns an error describing a failed verification run `verify_result` of
+  // the snapified `snapshot`.
+  static absl::Status VerifyFailure(
+      const Snapshot& snapshot, const RunnerDriver::RunResult& verify_result);
+
   // Adds writable memory pages from `end_state` to `snapshot`. This only
   // adds pages that are not already included in `snapshot`. Pages are always
   // added with RW but not X permissions and must be in an allowable memory
@@ -27,6 +27,7 @@
 #include "./snap/testing/snap_test_snapshots.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
+#include "./util/itoa.h"
 #include "./util/testing/status_macros.h"
 #include "./util/testing/status_matchers.h"
 #include "./util/testing/vsyscall.h"
@@ -34,6 +35,7 @@
 namespace silifuzz {
 namespace {
 using silifuzz::DefaultSnapMakerOptionsForTest;
+using silifuzz::FixSnapshotFusedInTest;
 using silifuzz::FixSnapshotInTest;
 using silifuzz::testing::IsOk;
 using silifuzz::testing::StatusIs;
@@ -78,6 +80,29 @@ TEST(SnapMaker, Idempotent) {
   ASSERT_EQ(result2, result);
 }
 
+TEST(SnapMaker, FusedMatchesUnfused) {
+  for (TestSnapshot test_snapshot :
+       {TestSnapshot::kEndsAsExpected, TestSnapshot::kMemoryMismatch,
+        TestSnapshot::kSigSegvReadFixable}) {
+    SCOPED_TRACE(EnumStr(test_snapshot));
+    auto snapshot = MakeSnapRunnerTestSnapshot<Host>(test_snapshot);
+    ASSERT_OK_AND_ASSIGN(auto fused, FixSnapshotFusedInTest(snapshot));
+    ASSERT_OK_AND_ASSIGN(auto unfused, FixSnapshotInTest(snapshot));
+    // End state memory may be split differently.
+    fused.NormalizeAll();
+    unfused.NormalizeAll();
+    EXPECT_EQ(fused, unfused);
+  }
+}
+
+TEST(SnapMaker, FusedRandomRegsMismatch) {
+  auto regsMismatchRandomSnap =
+      MakeSnapRunnerTestSnapshot<Host>(TestSnapshot::kRegsMismatchRandom);
+  auto result_or = FixSnapshotFusedInTest(regsMismatchRandomSnap);
+  ASSERT_THAT(result_or, StatusIs(absl::StatusCode::kInternal,
+                                  HasSubstr("non-deterministic")));
+}
+
 TEST(SnapMaker, SplitLock) {
 #if !defined(__x86_64__)
   GTEST_SKIP() << "Splitlock detection implemented only on x86_64.";
@@ -94,6 +119,9 @@ TEST(SnapMaker, SplitLock) {
   auto result_or = FixSnapshotInTest(splitLockSnap, options, trace_options);
   EXPECT_THAT(result_or, StatusIs(absl::StatusCode::kInternal,
                                   HasSubstr("Split-lock insn")));
+  result_or = FixSnapshotFusedInTest(splitLockSnap, options, trace_options);
+  EXPECT_THAT(result_or, StatusIs(absl::StatusCode::kInternal,
+                                  HasSubstr("Split-lock insn")));
 }
 
 TEST(SnapMaker, ExitGroup) {
@@ -38,4 +38,13 @@ absl::StatusOr<Snapshot> FixSnapshotInTest(const Snapshot& snapshot,
   return snap_maker.CheckTrace(recorded_snap, trace_options);
 }
 
+absl::StatusOr<Snapshot> FixSnapshotFusedInTest(
+    const Snapshot& snapshot, const SnapMaker::Options& options,
+    const TraceOptions& trace_options) {
+  SnapMaker snap_maker(options);
+  ASSIGN_OR_RETURN_IF_NOT_OK(Snapshot recorded_snap,
+                             snap_maker.MakeAndRecord(snapshot));
+  return snap_maker.VerifyAndCheckTrace(recorded_snap, trace_options);
+}
+
 }  // namespace silifuzz
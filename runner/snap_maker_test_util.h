@@ -34,6 +34,13 @@ absl::StatusOr<Snapshot> FixSnapshotInTest(
     const SnapMaker::Options& options = DefaultSnapMakerOptionsForTest(),
     const TraceOptions& trace_options = TraceOptions::Default());
 
+// Like FixSnapshotInTest() but uses MakeAndRecord() and
+// VerifyAndCheckTrace().
+absl::StatusOr<Snapshot> FixSnapshotFusedInTest(
+    const Snapshot& snapshot,
+    const SnapMaker::Options& options = DefaultSnapMakerOptionsForTest(),
+    const TraceOptions& trace_options = TraceOptions::Default());
+
 }  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_RUNNER_SNAP_MAKER_TEST_UTIL_H_
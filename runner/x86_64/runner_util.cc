@@ -101,7 +101,8 @@ std::optional<Endpoint> EndSpotToEndpoint(const EndSpot& actual_endspot) {
       return Endpoint(Endpoint::kSigBus, actual_endspot.sig_address, pc);
     }
     case SIGXCPU:
-    case SIGALRM: {
+    case SIGALRM:
+    case SIGPROF: {
       // a runaway; endpoint is the rip where it got stopped
       return Endpoint(pc);
     }
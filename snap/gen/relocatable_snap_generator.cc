@@ -14,15 +14,31 @@
 
 #include "./snap/gen/relocatable_snap_generator.h"
 
+#include <fcntl.h>
+#include <openssl/sha.h>  // IWYU pragma: keep
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <limits>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
-#include "absl/hash/hash.h"
 #include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "./common/memory_perms.h"
+#include "./common/memory_state.h"
 #include "./common/snapshot.h"
 #include "./common/snapshot_util.h"
 #include "./snap/gen/relocatable_data_block.h"
@@ -31,6 +47,7 @@
 #include "./snap/snap_checksum.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
+#include "./util/file_util.h"
 #include "./util/misc_util.h"
 #include "./util/mmapped_memory_ptr.h"
 #include "./util/page_util.h"
@@ -70,6 +87,26 @@ void SetRegisterState(const Snapshot::RegisterState& src,
   *memory_checksum = CalculateMemoryChecksum(*tgt);
 }
 
+// Returns the start addresses of the pages in which the expected `end_state`
+// of `snapshot` differs from its initial memory state, in ascending order.
+std::vector<uint64_t> DirtyPages(const Snapshot& snapshot,
+                                 const Snapshot::EndState& end_state) {
+  const MemoryState initial_state =
+      MemoryState::MakeInitial(snapshot, MemoryState::kZeroMappedBytes);
+  std::vector<uint64_t> dirty_pages;
+  for (const Snapshot::MemoryBytes& memory_bytes :
+       initial_state.DeltaMemoryBytes(end_state.memory_bytes())) {
+    for (uint64_t page = RoundDownToPageAlignment(memory_bytes.start_address());
+         page < memory_bytes.limit_address(); page += kPageSize) {
+      dirty_pages.push_back(page);
+    }
+  }
+  std::sort(dirty_pages.begin(), dirty_pages.end());
+  dirty_pages.erase(std::unique(dirty_pages.begin(), dirty_pages.end()),
+                    dirty_pages.end());
+  return dirty_pages;
+}
+
 // This encapsulates logic and data neccessary to build a relocatable
 // Snap corpus.
 //
@@ -109,6 +146,14 @@ class Traversal {
   absl::flat_hash_map<std::string, uint64_t> Process(
       PassType pass, const std::vector<Snapshot>& snapshots);
 
+  // Streaming interface used by Process(): a pass consists of BeginPass(),
+  // one call of Add() per snapshot and EndPass(), which returns the same map
+  // as Process(). Snapshots need not outlive Add() but both passes must see
+  // the same snapshots in the same order.
+  void BeginPass(PassType pass);
+  void Add(PassType pass, const Snapshot& snapshot);
+  absl::flat_hash_map<std::string, uint64_t> EndPass(PassType pass);
+
   // Sets up content buffers and load addresses for main data block and its
   // component. This also sets up sub data blocks.
   // REQUIRES: Called after layout pass but before generation pass.
@@ -140,44 +185,52 @@ class Traversal {
                             RelocatableDataBlock::Ref memory_mapping_ref);
 
   // Processes a single Snapshot::MemoryBytes object `memory_bytes` for
-  // `pass` using a preallocated ref from caller.
+  // `pass` using a preallocated ref from caller. If `allow_compression` is
+  // false, the byte data is never run-length compressed.
   void ProcessAllocated(PassType pass,
                         const Snapshot::MemoryBytes& memory_bytes,
-                        RelocatableDataBlock::Ref memory_bytes_ref);
+                        RelocatableDataBlock::Ref memory_bytes_ref,
+                        bool allow_compression = true);
 
   // Processes a Snapshot::MemoryBytesList object `memory_bytes_list` for
   // `pass`. `mapped_memory_map` contains information of all memory mappings
   // in the source Snapshot. This allocates a ref the elements of the
   // SnapMemoryBytes array and returns it.
   RelocatableDataBlock::Ref ProcessMemoryBytesList(
-      PassType pass, const BorrowedMemoryBytesList& memory_bytes_list);
+      PassType pass, const BorrowedMemoryBytesList& memory_bytes_list,
+      bool allow_compression = true);
+
+  // Returns true iff `memory_mapping` should be laid out so that the runner
+  // can map it directly from the corpus file. See `share_read_only_pages`.
+  bool ShouldShareReadOnlyPages(
+      const Snapshot::MemoryMapping& memory_mapping) const;
+
+  // Returns a single MemoryBytes covering all of `memory_mapping` with
+  // contents from `memory_bytes_list`. Bytes not covered by the list are 0,
+  // as in a fresh anonymous mapping.
+  static Snapshot::MemoryBytes MergeMemoryBytes(
+      const Snapshot::MemoryMapping& memory_mapping,
+      const BorrowedMemoryBytesList& memory_bytes_list);
 
   void ProcessAllocated(PassType pass, const Snapshot& snapshot,
                         RelocatableDataBlock::Ref ref);
 
+  // Allocates the corpus header, the Snap pointer array, the Snap array and
+  // the dirty page array for `num_snaps_` snaps in the snap block.
+  void AllocateSnapArrays();
+
   // MemoryBytes de-duping: MemoryBytes are de-duped to reduce size of
   // of a relocatable corpus. MemoryBytes with the same byte values share
   // a single copy of byte data in the generated Snap corpus.  The byte values
-  // can be large, so we use pointers to Snapshot::ByteData as keys in the
-  // hash map below.
-
-  struct HashByteData {
-    size_t operator()(const Snapshot::ByteData* byte_data) const {
-      return absl::HashOf(*byte_data);
-    }
-  };
+  // can be large and the snapshots holding them may be gone by the time we
+  // see a duplicate, so we use SHA-1 digests of the byte values as keys in
+  // the hash map below.
+  using ByteDataDigest = std::array<uint8_t, SHA_DIGEST_LENGTH>;
 
-  // Returns true iff the byte data pointed by lhs and rhs are the same.
-  struct ByteDataEq {
-    bool operator()(const Snapshot::ByteData* lhs,
-                    const Snapshot::ByteData* rhs) const {
-      return *lhs == *rhs;
-    }
-  };
+  static ByteDataDigest Digest(const Snapshot::ByteData& byte_data);
 
   using ByteDataRefMap =
-      absl::flat_hash_map<const Snapshot::ByteData*, RelocatableDataBlock::Ref,
-                          HashByteData, ByteDataEq>;
+      absl::flat_hash_map<ByteDataDigest, RelocatableDataBlock::Ref>;
 
   // Options.
   RelocatableSnapGeneratorOptions options_;
@@ -194,18 +247,67 @@ class Traversal {
   RelocatableDataBlock string_block_;
   RelocatableDataBlock register_state_block_;
   RelocatableDataBlock page_data_block_;
+  RelocatableDataBlock dirty_pages_block_;
+  RelocatableDataBlock snap_id_index_block_;
 
   // Hash map for de-duping byte data.
   ByteDataRefMap byte_data_ref_map_;
+
+  // Number of snaps in the corpus, known after the layout pass.
+  size_t num_snaps_ = 0;
+
+  // Index of the next snap to be added in the current pass.
+  size_t snap_index_ = 0;
+
+  // Refs to the corpus header, the Snap pointer array, the Snap array and the
+  // dirty page array.
+  RelocatableDataBlock::Ref corpus_ref_;
+  RelocatableDataBlock::Ref snap_array_elements_ref_;
+  RelocatableDataBlock::Ref snaps_ref_;
+  RelocatableDataBlock::Ref dirty_pages_array_elements_ref_;
+
+  // IDs of snaps in the generated corpus contents, in corpus order. Used to
+  // build the snap ID index without keeping the snapshots.
+  std::vector<const char*> snap_ids_;
+
+  // [start, limit) address ranges of memory mappings that the runner cannot
+  // map directly from the corpus file. The runner maps all snaps at start-up
+  // so the size of their union is the expected private memory of a runner.
+  std::vector<std::pair<uint64_t, uint64_t>> runner_private_ranges_;
 };
 
+// Returns the total size of the union of [start, limit) address `ranges`.
+uint64_t UnionSize(std::vector<std::pair<uint64_t, uint64_t>> ranges) {
+  std::sort(ranges.begin(), ranges.end());
+  uint64_t size = 0;
+  uint64_t covered_limit = 0;
+  for (const auto& [start, limit] : ranges) {
+    const uint64_t begin = std::max(start, covered_limit);
+    if (begin < limit) {
+      size += limit - begin;
+      covered_limit = limit;
+    }
+  }
+  return size;
+}
+
+template <typename Arch>
+typename Traversal<Arch>::ByteDataDigest Traversal<Arch>::Digest(
+    const Snapshot::ByteData& byte_data) {
+  ByteDataDigest digest;
+  SHA1(reinterpret_cast<const uint8_t*>(byte_data.data()), byte_data.size(),
+       digest.data());
+  return digest;
+}
+
 template <typename Arch>
 RelocatableDataBlock::Ref Traversal<Arch>::ProcessMemoryBytes(
     PassType pass, const Snapshot::MemoryBytes& memory_bytes) {
   const Snapshot::ByteData& byte_data = memory_bytes.byte_values();
   // Check to see if we can de-dupe byte data.
   static constexpr RelocatableDataBlock::Ref kNullRef;
-  auto [it, success] = byte_data_ref_map_.try_emplace(&byte_data, kNullRef);
+  auto [it, success] =
+      byte_data_ref_map_.try_emplace(Digest(byte_data), kNullRef);
   auto&& [unused, ref] = *it;
 
   // try_emplace() above failed because byte_data is a duplicate. Return early
@@ -252,12 +354,24 @@ void Traversal<Arch>::ProcessMemoryMapping(
     PassType pass, const Snapshot::MemoryMapping& memory_mapping,
     const BorrowedMemoryBytesList& memory_bytes_list,
     RelocatableDataBlock::Ref memory_mapping_ref) {
+  // The merged bytes must not be compressed, or the runner would not be able
+  // to map them.
+  const bool share_pages = ShouldShareReadOnlyPages(memory_mapping);
+  std::optional<Snapshot::MemoryBytes> merged;
+  BorrowedMemoryBytesList merged_list;
+  if (share_pages) {
+    merged.emplace(MergeMemoryBytes(memory_mapping, memory_bytes_list));
+    merged_list.push_back(&merged.value());
+  }
+  const BorrowedMemoryBytesList& bytes_list =
+      share_pages ? merged_list : memory_bytes_list;
   RelocatableDataBlock::Ref memory_bytes_elements_ref =
-      ProcessMemoryBytesList(pass, memory_bytes_list);
+      ProcessMemoryBytesList(pass, bytes_list,
+                             /*allow_compression=*/!share_pages);
 
   if (pass == PassType::kGeneration) {
     MemoryChecksumCalculator checksum;
-    for (const Snapshot::MemoryBytes* memory_bytes : memory_bytes_list) {
+    for (const Snapshot::MemoryBytes* memory_bytes : bytes_list) {
       checksum.AddData(memory_bytes->byte_values());
     }
     new (memory_mapping_ref
@@ -268,13 +382,29 @@ void Traversal<Arch>::ProcessMemoryMapping(
         .memory_checksum = checksum.Checksum(),
         .memory_bytes =
             {
-                .size = memory_bytes_list.size(),
+                .size = bytes_list.size(),
                 .elements =
                     memory_bytes_elements_ref
                         .load_address_as_pointer_of<const SnapMemoryBytes>(),
             },
     };
   }
+
+  // Same conditions as CanDirectMap() in the runner. Page-aligned bytes are
+  // always placed in the page-aligned data block.
+  const bool direct_mappable =
+      !memory_mapping.perms().Has(MemoryPerms::kWritable) &&
+      bytes_list.size() == 1 &&
+      bytes_list[0]->start_address() == memory_mapping.start_address() &&
+      bytes_list[0]->num_bytes() == memory_mapping.num_bytes() &&
+      IsPageAligned(memory_mapping.start_address()) &&
+      IsPageAligned(memory_mapping.num_bytes()) &&
+      !(!share_pages && options_.compress_repeating_bytes &&
+        IsRepeatingByteRun(bytes_list[0]->byte_values()));
+  if (!direct_mappable) {
+    runner_private_ranges_.emplace_back(memory_mapping.start_address(),
+                                        memory_mapping.limit_address());
+  }
 }
 
 template <typename Arch>
@@ -300,9 +430,9 @@ RelocatableDataBlock::Ref Traversal<Arch>::ProcessMemoryMappings(
 template <typename Arch>
 void Traversal<Arch>::ProcessAllocated(
     PassType pass, const Snapshot::MemoryBytes& memory_bytes,
-    RelocatableDataBlock::Ref memory_bytes_ref) {
+    RelocatableDataBlock::Ref memory_bytes_ref, bool allow_compression) {
   const bool compress_repeating_bytes =
-      options_.compress_repeating_bytes &&
+      allow_compression && options_.compress_repeating_bytes &&
       IsRepeatingByteRun(memory_bytes.byte_values());
   RelocatableDataBlock::Ref byte_values_elements_ref;
   if (!compress_repeating_bytes) {
@@ -338,7 +468,8 @@ void Traversal<Arch>::ProcessAllocated(
 
 template <typename Arch>
 RelocatableDataBlock::Ref Traversal<Arch>::ProcessMemoryBytesList(
-    PassType pass, const BorrowedMemoryBytesList& memory_bytes_list) {
+    PassType pass, const BorrowedMemoryBytesList& memory_bytes_list,
+    bool allow_compression) {
   // Allocate space for elements of SnapArray<MemoryBytes>.
   const RelocatableDataBlock::Ref ref =
       memory_bytes_block_.AllocateObjectsOfType<SnapMemoryBytes>(
@@ -346,12 +477,39 @@ RelocatableDataBlock::Ref Traversal<Arch>::ProcessMemoryBytesList(
 
   RelocatableDataBlock::Ref snap_memory_bytes_ref = ref;
   for (const auto& memory_bytes : memory_bytes_list) {
-    ProcessAllocated(pass, *memory_bytes, snap_memory_bytes_ref);
+    ProcessAllocated(pass, *memory_bytes, snap_memory_bytes_ref,
+                     allow_compression);
     snap_memory_bytes_ref += sizeof(SnapMemoryBytes);
   }
   return ref;
 }
 
+template <typename Arch>
+bool Traversal<Arch>::ShouldShareReadOnlyPages(
+    const Snapshot::MemoryMapping& memory_mapping) const {
+  // Writable mappings are always copied into anonymous memory by the runner.
+  return options_.share_read_only_pages &&
+         !memory_mapping.perms().Has(MemoryPerms::kWritable) &&
+         IsPageAligned(memory_mapping.start_address()) &&
+         IsPageAligned(memory_mapping.num_bytes());
+}
+
+template <typename Arch>
+Snapshot::MemoryBytes Traversal<Arch>::MergeMemoryBytes(
+    const Snapshot::MemoryMapping& memory_mapping,
+    const BorrowedMemoryBytesList& memory_bytes_list) {
+  Snapshot::ByteData byte_data(memory_mapping.num_bytes(), '\0');
+  for (const Snapshot::MemoryBytes* memory_bytes : memory_bytes_list) {
+    DCHECK(memory_mapping.start_address() <= memory_bytes->start_address() &&
+           memory_bytes->limit_address() <= memory_mapping.limit_address());
+    byte_data.replace(
+        memory_bytes->start_address() - memory_mapping.start_address(),
+        memory_bytes->num_bytes(), memory_bytes->byte_values());
+  }
+  return Snapshot::MemoryBytes(memory_mapping.start_address(),
+                               std::move(byte_data));
+}
+
 template <typename Arch>
 void Traversal<Arch>::ProcessAllocated(PassType pass, const Snapshot& snapshot,
                                        RelocatableDataBlock::Ref snapshot_ref) {
@@ -380,8 +538,17 @@ void Traversal<Arch>::ProcessAllocated(PassType pass, const Snapshot& snapshot,
   RelocatableDataBlock::Ref end_state_registers_ref =
       register_state_block_.AllocateObjectsOfType<RegisterState>(1);
 
+  const std::vector<uint64_t> dirty_pages = DirtyPages(snapshot, end_state);
+  RelocatableDataBlock::Ref dirty_pages_ref =
+      dirty_pages_block_.AllocateObjectsOfType<uint64_t>(dirty_pages.size());
+
   if (pass == PassType::kGeneration) {
     memcpy(id_ref.contents(), snapshot.id().c_str(), snapshot.id().size() + 1);
+    snap_ids_.push_back(id_ref.contents());
+    if (!dirty_pages.empty()) {
+      memcpy(dirty_pages_ref.contents(), dirty_pages.data(),
+             dirty_pages.size() * sizeof(uint64_t));
+    }
 
     // Construct register state contents.
     uint32_t registers_memory_checksum;
@@ -431,30 +598,89 @@ void Traversal<Arch>::ProcessAllocated(PassType pass, const Snapshot& snapshot,
         .end_state_registers_memory_checksum =
             end_state_registers_memory_checksum,
     };
+
+    const RelocatableDataBlock::Ref dirty_pages_array_ref =
+        dirty_pages_array_elements_ref_ +
+        snap_index_ * sizeof(SnapArray<uint64_t>);
+    new (dirty_pages_array_ref.contents()) SnapArray<uint64_t>{
+        .size = dirty_pages.size(),
+        .elements =
+            dirty_pages_ref.load_address_as_pointer_of<const uint64_t>(),
+    };
   }
 }
 
 template <typename Arch>
 absl::flat_hash_map<std::string, uint64_t> Traversal<Arch>::Process(
     PassType pass, const std::vector<Snapshot>& snapshots) {
+  BeginPass(pass);
+  for (const Snapshot& snapshot : snapshots) {
+    Add(pass, snapshot);
+  }
+  return EndPass(pass);
+}
+
+template <typename Arch>
+void Traversal<Arch>::BeginPass(PassType pass) {
+  snap_index_ = 0;
+  if (pass == PassType::kGeneration) {
+    snap_ids_.clear();
+    snap_ids_.reserve(num_snaps_);
+    AllocateSnapArrays();
+  }
+}
+
+template <typename Arch>
+void Traversal<Arch>::AllocateSnapArrays() {
   // For compatiblity with an older Silifuzz version, we use a corpus containing
   // SnapArray<const Snap*>.  We can get rid of the redirection when we
   // change the runner to take SnapArray<Snap> later.
 
-  RelocatableDataBlock::Ref corpus_ref =
-      snap_block_.AllocateObjectsOfType<SnapCorpus<Arch>>(1);
+  corpus_ref_ = snap_block_.AllocateObjectsOfType<SnapCorpus<Arch>>(1);
 
   // Allocate space for element.
-  RelocatableDataBlock::Ref snap_array_elements_ref =
-      snap_block_.AllocateObjectsOfType<const Snap<Arch>*>(snapshots.size());
+  snap_array_elements_ref_ =
+      snap_block_.AllocateObjectsOfType<const Snap<Arch>*>(num_snaps_);
 
   // Allocate space for Snaps.
-  RelocatableDataBlock::Ref snaps_ref =
-      snap_block_.AllocateObjectsOfType<Snap<Arch>>(snapshots.size());
-  for (size_t i = 0; i < snapshots.size(); ++i) {
-    ProcessAllocated(pass, snapshots[i], snaps_ref + i * sizeof(Snap<Arch>));
+  snaps_ref_ = snap_block_.AllocateObjectsOfType<Snap<Arch>>(num_snaps_);
+
+  // Allocate space for the per-snap dirty page arrays.
+  dirty_pages_array_elements_ref_ =
+      snap_block_.AllocateObjectsOfType<SnapArray<uint64_t>>(num_snaps_);
+}
+
+template <typename Arch>
+void Traversal<Arch>::Add(PassType pass, const Snapshot& snapshot) {
+  // The Snap array is only allocated at the end of the layout pass, when the
+  // number of snaps is known. Snaps are constructed in the generation pass
+  // only, so the layout pass does not need a valid ref.
+  RelocatableDataBlock::Ref snap_ref;
+  if (pass == PassType::kGeneration) {
+    CHECK_LT(snap_index_, num_snaps_);
+    snap_ref = snaps_ref_ + snap_index_ * sizeof(Snap<Arch>);
+  }
+  ProcessAllocated(pass, snapshot, snap_ref);
+  ++snap_index_;
+}
+
+template <typename Arch>
+absl::flat_hash_map<std::string, uint64_t> Traversal<Arch>::EndPass(
+    PassType pass) {
+  if (pass == PassType::kLayout) {
+    // Allocations within the snap block happen in the same order in both
+    // passes so the layout matches.
+    num_snaps_ = snap_index_;
+    AllocateSnapArrays();
+  } else {
+    CHECK_EQ(snap_index_, num_snaps_);
   }
 
+  // Allocate space for the snap ID index.
+  CHECK_LE(num_snaps_, std::numeric_limits<uint32_t>::max());
+  RelocatableDataBlock::Ref snap_id_index_elements_ref =
+      snap_id_index_block_.AllocateObjectsOfType<uint32_t>(num_snaps_);
+
   // Merge component data blocks into a single main data block.
   // Parts with and without pointers are group separately to minimize
   // memory pages that needs to be modified. This is desirable if a
@@ -469,10 +695,12 @@ absl::flat_hash_map<std::string, uint64_t> Traversal<Arch>::Process(
   main_block_.Allocate(byte_data_block_);
   main_block_.Allocate(string_block_);
   main_block_.Allocate(register_state_block_);
+  main_block_.Allocate(dirty_pages_block_);
+  main_block_.Allocate(snap_id_index_block_);
   main_block_.Allocate(page_data_block_);
 
   if (pass == PassType::kGeneration) {
-    SnapCorpus<Arch>* corpus = new (corpus_ref.contents()) SnapCorpus<Arch>{
+    SnapCorpus<Arch>* corpus = new (corpus_ref_.contents()) SnapCorpus<Arch>{
         .header =
             {
                 .magic = kSnapCorpusMagic,
@@ -488,23 +716,48 @@ absl::flat_hash_map<std::string, uint64_t> Traversal<Arch>::Process(
             },
         .snaps =
             {
-                .size = snapshots.size(),
+                .size = num_snaps_,
                 .elements =
-                    snap_array_elements_ref
+                    snap_array_elements_ref_
                         .load_address_as_pointer_of<const Snap<Arch>*>(),
             },
+        .snap_id_index =
+            {
+                .size = num_snaps_,
+                .elements = snap_id_index_elements_ref
+                                .load_address_as_pointer_of<const uint32_t>(),
+            },
+        .dirty_pages =
+            {
+                .size = num_snaps_,
+                .elements = dirty_pages_array_elements_ref_
+                                .load_address_as_pointer_of<
+                                    const SnapArray<uint64_t>>(),
+            },
     };
 
     // Create const pointer array elements.
-    for (size_t i = 0; i < snapshots.size(); ++i) {
+    for (size_t i = 0; i < num_snaps_; ++i) {
       const RelocatableDataBlock::Ref snap_ref =
-          snaps_ref + i * sizeof(Snap<Arch>);
+          snaps_ref_ + i * sizeof(Snap<Arch>);
       const RelocatableDataBlock::Ref element_ref =
-          snap_array_elements_ref + i * sizeof(const Snap<Arch>*);
+          snap_array_elements_ref_ + i * sizeof(const Snap<Arch>*);
       *element_ref.contents_as_pointer_of<const Snap<Arch>*>() =
           snap_ref.load_address_as_pointer_of<const Snap<Arch>>();
     }
 
+    // Sort snap indices by ID. Ties are broken by index so that lookup finds
+    // the first snap with a given ID, like a linear search would.
+    uint32_t* snap_id_index =
+        snap_id_index_elements_ref.contents_as_pointer_of<uint32_t>();
+    for (size_t i = 0; i < num_snaps_; ++i) {
+      snap_id_index[i] = i;
+    }
+    std::stable_sort(snap_id_index, snap_id_index + num_snaps_,
+                     [this](uint32_t a, uint32_t b) {
+                       return strcmp(snap_ids_[a], snap_ids_[b]) < 0;
+                     });
+
     // Calculate the final checksum.
     // The checksum calculation ignores the checksum field in the header. This
     // lets us set this field without modifying the checksum.
@@ -522,6 +775,9 @@ absl::flat_hash_map<std::string, uint64_t> Traversal<Arch>::Process(
       {"string_block", string_block_.size()},
       {"register_state_block", register_state_block_.size()},
       {"page_data_block", page_data_block_.size()},
+      {"dirty_pages_block", dirty_pages_block_.size()},
+      {"snap_id_index_block", snap_id_index_block_.size()},
+      {"runner_private_bytes", UnionSize(runner_private_ranges_)},
   };
   return block_sizes;
 }
@@ -549,6 +805,8 @@ void Traversal<Arch>::PrepareSnapGeneration(char* content_buffer,
   prepare_sub_data_block(byte_data_block_);
   prepare_sub_data_block(string_block_);
   prepare_sub_data_block(register_state_block_);
+  prepare_sub_data_block(dirty_pages_block_);
+  prepare_sub_data_block(snap_id_index_block_);
   prepare_sub_data_block(page_data_block_);
 
   // Reset main block again for generation pass.
@@ -556,6 +814,7 @@ void Traversal<Arch>::PrepareSnapGeneration(char* content_buffer,
 
   // Reset byte data de-duping hash map.
   byte_data_ref_map_.clear();
+  runner_private_ranges_.clear();
 }
 
 }  // namespace
@@ -594,4 +853,83 @@ MmappedMemoryPtr<char> GenerateRelocatableSnaps(
                        options);
 }
 
+namespace {
+
+// Runs `pass` of `traversal` over all snapshots in `source`.
+template <typename Arch>
+absl::StatusOr<absl::flat_hash_map<std::string, uint64_t>> RunPass(
+    Traversal<Arch>& traversal, typename Traversal<Arch>::PassType pass,
+    SnapshotSource& source) {
+  RETURN_IF_NOT_OK(source.Rewind());
+  traversal.BeginPass(pass);
+  while (true) {
+    ASSIGN_OR_RETURN_IF_NOT_OK(const Snapshot* snapshot, source.Next());
+    if (snapshot == nullptr) break;
+    traversal.Add(pass, *snapshot);
+  }
+  return traversal.EndPass(pass);
+}
+
+// Returns true iff the corpus can be generated in a shared mapping of `fd`.
+bool CanMapOutput(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+  const int flags = fcntl(fd, F_GETFL);
+  return flags != -1 && (flags & O_ACCMODE) == O_RDWR;
+}
+
+}  // namespace
+
+template <typename Arch>
+absl::Status GenerateRelocatableSnapsToFileImpl(
+    SnapshotSource& source, int fd,
+    const RelocatableSnapGeneratorOptions& options) {
+  using PassType = typename Traversal<Arch>::PassType;
+  Traversal<Arch> traversal(options);
+  RETURN_IF_NOT_OK(RunPass(traversal, PassType::kLayout, source).status());
+
+  CHECK_LE(traversal.main_block().required_alignment(), kPageSize);
+  const size_t size = traversal.main_block().size();
+  const bool map_output = CanMapOutput(fd);
+  char* buffer;
+  MmappedMemoryPtr<char> anonymous_buffer;
+  if (map_output) {
+    if (ftruncate(fd, size) != 0) {
+      return absl::ErrnoToStatus(errno, "ftruncate");
+    }
+    void* mapping =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap");
+    }
+    buffer = static_cast<char*>(mapping);
+  } else {
+    anonymous_buffer = AllocateMmappedBuffer<char>(size);
+    buffer = anonymous_buffer.get();
+  }
+
+  constexpr uintptr_t kNominalLoadAddress = 0;
+  traversal.PrepareSnapGeneration(buffer, size, kNominalLoadAddress);
+  auto counters = RunPass(traversal, PassType::kGeneration, source);
+  if (map_output) {
+    CHECK_EQ(munmap(buffer, size), 0);
+  } else if (counters.ok() &&
+             !WriteToFileDescriptor(fd, absl::string_view(buffer, size))) {
+    return absl::InternalError("WriteToFileDescriptor failed");
+  }
+  RETURN_IF_NOT_OK(counters.status());
+  if (options.counters) {
+    *options.counters = std::move(counters).value();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status GenerateRelocatableSnapsToFile(
+    ArchitectureId architecture_id, SnapshotSource& source, int fd,
+    const RelocatableSnapGeneratorOptions& options) {
+  CHECK(architecture_id != ArchitectureId::kUndefined);
+  return ARCH_DISPATCH(GenerateRelocatableSnapsToFileImpl, architecture_id,
+                       source, fd, options);
+}
+
 }  // namespace silifuzz
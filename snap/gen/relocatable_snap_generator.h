@@ -15,11 +15,14 @@
 #ifndef THIRD_PARTY_SILIFUZZ_SNAP_GEN_RELOCATABLE_SNAP_GENERATOR_H_
 #define THIRD_PARTY_SILIFUZZ_SNAP_GEN_RELOCATABLE_SNAP_GENERATOR_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "./common/snapshot.h"
 #include "./util/arch.h"
 #include "./util/mmapped_memory_ptr.h"
@@ -108,15 +111,35 @@ namespace silifuzz {
 // directly from the file when the corpus is loaded. Page-aligned data will not
 // be RLE compressed, however, so there is a tradeoff between load speed and
 // corpus size.
+//
+// Read-only page sharing:
+//
+// Read-only mappings that the runner cannot map directly from the corpus are
+// backed by anonymous memory in every runner process. With
+// `share_read_only_pages`, the contents of each read-only mapping are instead
+// stored uncompressed as a single block of page-aligned data. Blocks with the
+// same contents are stored once, so snaps with identical read-only pages
+// share them. The runner then maps these pages MAP_SHARED from the corpus file
+// and all runners using the same corpus file share one copy in the page
+// cache.
 
 // Options passed to relocatable Snap corpus generator.
 struct RelocatableSnapGeneratorOptions {
   // If true, apply run-length compression to memory bytes data.
   bool compress_repeating_bytes = true;
 
+  // If true, lay out read-only mappings so that the runner can map them
+  // directly from the corpus file. See "Read-only page sharing" above. This
+  // makes the corpus larger but cuts the memory used by each runner.
+  bool share_read_only_pages = false;
+
   // When present, this map will be populated with various _debug-only_
   // counters representing sizes of different parts of the generated corpus.
   // The keys are human-readable but are not guaranteed to be stable.
+  //
+  // "runner_private_bytes" estimates the private memory each runner needs for
+  // the memory mappings that it cannot map directly from the corpus file. The
+  // corpus file itself ("main_block") is shared by all runners.
   absl::flat_hash_map<std::string, uint64_t>* counters = nullptr;
 };
 
@@ -133,6 +156,61 @@ MmappedMemoryPtr<char> GenerateRelocatableSnaps(
     ArchitectureId architecture_id, const std::vector<Snapshot>& snapshots,
     const RelocatableSnapGeneratorOptions& options = {});
 
+// A sequence of snapshots that can be read more than once. Used to generate
+// corpora without holding all snapshots in memory.
+class SnapshotSource {
+ public:
+  virtual ~SnapshotSource() = default;
+
+  // Restarts reading from the first snapshot.
+  virtual absl::Status Rewind() = 0;
+
+  // Returns the next snapshot or nullptr after the last one. The snapshot
+  // stays valid until the next call to Next() or Rewind().
+  virtual absl::StatusOr<const Snapshot*> Next() = 0;
+};
+
+// A SnapshotSource reading from a vector of snapshots.
+class SnapshotVectorSource : public SnapshotSource {
+ public:
+  // `snapshots` must outlive this object.
+  explicit SnapshotVectorSource(const std::vector<Snapshot>& snapshots)
+      : snapshots_(snapshots) {}
+
+  absl::Status Rewind() override {
+    next_ = 0;
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<const Snapshot*> Next() override {
+    return next_ < snapshots_.size() ? &snapshots_[next_++] : nullptr;
+  }
+
+ private:
+  const std::vector<Snapshot>& snapshots_;
+  size_t next_ = 0;
+};
+
+// Like GenerateRelocatableSnaps() but reads snapshots from `source` and
+// writes the corpus to `fd`.
+//
+// The source is read twice, once to lay out the corpus and once to generate
+// it, and only one snapshot is needed at a time. If `fd` is a regular file
+// open for reading and writing, the corpus is generated in a shared mapping
+// of the file so the kernel can write it back as it goes. Otherwise it is
+// generated in memory and then written to `fd`.
+//
+// RETURNS: OK or an error reading `source` or writing `fd`.
+//
+// REQUIRES: `source` returns the same snapshots in the same order every time.
+// REQUIRES: the snapshots are snapified and their architecture matches
+// `architecture_id`.
+//
+// This function is thread-safe.
+absl::Status GenerateRelocatableSnapsToFile(
+    ArchitectureId architecture_id, SnapshotSource& source, int fd,
+    const RelocatableSnapGeneratorOptions& options = {});
+
 }  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_SNAP_GEN_RELOCATABLE_SNAP_GENERATOR_H_
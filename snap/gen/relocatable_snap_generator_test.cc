@@ -14,12 +14,16 @@
 
 #include "./snap/gen/relocatable_snap_generator.h"
 
+#include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include <utility>
 #include <vector>
@@ -30,18 +34,23 @@
 #include "absl/status/status.h"
 #include "./common/memory_mapping.h"
 #include "./common/memory_perms.h"
+#include "./common/memory_state.h"
 #include "./common/snapshot.h"
 #include "./common/snapshot_test_enum.h"
 #include "./common/snapshot_test_util.h"
 #include "./snap/gen/snap_generator.h"
 #include "./snap/snap.h"
+#include "./snap/snap_checksum.h"
 #include "./snap/snap_relocator.h"
 #include "./snap/snap_util.h"
 #include "./snap/testing/snap_generator_test_lib.h"
 #include "./snap/testing/snap_test_snapshots.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
+#include "./util/itoa.h"
 #include "./util/mmapped_memory_ptr.h"
+#include "./util/page_util.h"
+#include "./util/path_util.h"
 #include "./util/testing/status_macros.h"
 
 namespace silifuzz {
@@ -188,6 +197,76 @@ TYPED_TEST(RelocatableSnapGenerator, SupportDirectMMap) {
   EXPECT_TRUE(found);
 }
 
+TYPED_TEST(RelocatableSnapGenerator, ShareReadOnlyPages) {
+  // Two snaps with identical read-only mappings.
+  std::vector<Snapshot> corpus;
+  for (const char* id : {"snap1", "snap2"}) {
+    Snapshot snapshot =
+        MakeSnapRunnerTestSnapshot<TypeParam>(TestSnapshot::kEndsAsExpected);
+    snapshot.set_id(id);
+    SnapifyOptions snapify_options =
+        SnapifyOptions::V2InputRunOpts(snapshot.architecture_id());
+    snapify_options.compress_repeating_bytes = true;
+    snapify_options.support_direct_mmap = false;
+    ASSERT_OK_AND_ASSIGN(Snapshot snapified,
+                         Snapify(snapshot, snapify_options));
+    corpus.push_back(std::move(snapified));
+  }
+
+  absl::flat_hash_map<std::string, uint64_t> unshared_counters;
+  GenerateRelocatedCorpus<TypeParam>(corpus,
+                                     {.counters = &unshared_counters});
+  absl::flat_hash_map<std::string, uint64_t> shared_counters;
+  auto relocated_corpus = GenerateRelocatedCorpus<TypeParam>(
+      corpus, {.share_read_only_pages = true, .counters = &shared_counters});
+  EXPECT_LT(shared_counters["runner_private_bytes"],
+            unshared_counters["runner_private_bytes"]);
+
+  // Every read-only mapping can be mapped directly from the corpus and the
+  // snaps share the same pages.
+  ASSERT_EQ(relocated_corpus->snaps.size, 2);
+  const Snap<TypeParam>& snap1 = *relocated_corpus->snaps.at(0);
+  const Snap<TypeParam>& snap2 = *relocated_corpus->snaps.at(1);
+  ASSERT_EQ(snap1.memory_mappings.size, snap2.memory_mappings.size);
+  bool found = false;
+  for (size_t i = 0; i < snap1.memory_mappings.size; ++i) {
+    const SnapMemoryMapping& mapping = snap1.memory_mappings[i];
+    if (mapping.writable()) continue;
+    found = true;
+    ASSERT_EQ(mapping.memory_bytes.size, 1);
+    const SnapMemoryBytes& memory_bytes = mapping.memory_bytes[0];
+    ASSERT_FALSE(memory_bytes.repeating());
+    EXPECT_EQ(memory_bytes.start_address, mapping.start_address);
+    EXPECT_EQ(memory_bytes.size(), mapping.num_bytes);
+    EXPECT_TRUE(IsPageAligned(memory_bytes.data.byte_values.elements));
+    EXPECT_EQ(mapping.memory_checksum,
+              CalculateMemoryChecksum(memory_bytes.data.byte_values.elements,
+                                      memory_bytes.size()));
+    const SnapMemoryMapping& mapping2 = snap2.memory_mappings[i];
+    ASSERT_EQ(mapping2.memory_bytes.size, 1);
+    EXPECT_EQ(mapping2.memory_bytes[0].data.byte_values.elements,
+              memory_bytes.data.byte_values.elements);
+  }
+  EXPECT_TRUE(found);
+
+  // The merged mappings hold the same data.
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    ASSERT_OK_AND_ASSIGN(
+        Snapshot snapshot,
+        SnapToSnapshot(*relocated_corpus->snaps.at(i),
+                       TestSnapshotPlatform<TypeParam>()));
+    const MemoryState expected =
+        MemoryState::MakeInitial(corpus[i], MemoryState::kZeroMappedBytes);
+    const MemoryState actual =
+        MemoryState::MakeInitial(snapshot, MemoryState::kZeroMappedBytes);
+    for (const MemoryMapping& mapping : corpus[i].memory_mappings()) {
+      EXPECT_EQ(
+          actual.memory_bytes(mapping.start_address(), mapping.num_bytes()),
+          expected.memory_bytes(mapping.start_address(), mapping.num_bytes()));
+    }
+  }
+}
+
 TYPED_TEST(RelocatableSnapGenerator, AllRunnerTestSnaps) {
   SnapifyOptions opts = SnapifyOptions::V2InputRunOpts(Host::architecture_id);
 
@@ -215,6 +294,124 @@ TYPED_TEST(RelocatableSnapGenerator, AllRunnerTestSnaps) {
   }
 }
 
+TYPED_TEST(RelocatableSnapGenerator, GenerateToFile) {
+  SnapifyOptions opts = SnapifyOptions::V2InputRunOpts(Host::architecture_id);
+
+  std::vector<Snapshot> snapified_corpus;
+  for (int index = 0; index < static_cast<int>(TestSnapshot::kNumTestSnapshot);
+       ++index) {
+    TestSnapshot type = static_cast<TestSnapshot>(index);
+    if (!TestSnapshotExists<TypeParam>(type)) {
+      continue;
+    }
+    Snapshot snapshot = MakeSnapRunnerTestSnapshot<TypeParam>(type);
+    ASSERT_OK_AND_ASSIGN(Snapshot snapified, Snapify(snapshot, opts));
+    snapified_corpus.push_back(std::move(snapified));
+  }
+
+  const MmappedMemoryPtr<char> expected =
+      GenerateRelocatableSnaps(TypeParam::architecture_id, snapified_corpus);
+  const std::string expected_contents(expected.get(),
+                                      MmappedMemorySize(expected));
+
+  // A read-write file is mapped, a write-only one is written in one go.
+  for (int open_mode : {O_RDWR, O_WRONLY}) {
+    ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("corpus"));
+    const int fd = open(path.c_str(), open_mode | O_TRUNC);
+    ASSERT_NE(fd, -1);
+    SnapshotVectorSource source(snapified_corpus);
+    absl::flat_hash_map<std::string, uint64_t> counters;
+    ASSERT_OK(GenerateRelocatableSnapsToFile(TypeParam::architecture_id,
+                                             source, fd,
+                                             {.counters = &counters}));
+    close(fd);
+    EXPECT_EQ(counters["main_block"], expected_contents.size());
+
+    std::ifstream file(path, std::ios::binary);
+    const std::string contents((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    EXPECT_TRUE(contents == expected_contents) << "open mode " << open_mode;
+    unlink(path.c_str());
+  }
+}
+
+TYPED_TEST(RelocatableSnapGenerator, DirtyPages) {
+  SnapifyOptions opts = SnapifyOptions::V2InputRunOpts(Host::architecture_id);
+
+  std::vector<Snapshot> snapified_corpus;
+  for (int index = 0; index < static_cast<int>(TestSnapshot::kNumTestSnapshot);
+       ++index) {
+    TestSnapshot type = static_cast<TestSnapshot>(index);
+    if (!TestSnapshotExists<TypeParam>(type)) {
+      continue;
+    }
+    Snapshot snapshot = MakeSnapRunnerTestSnapshot<TypeParam>(type);
+    ASSERT_OK_AND_ASSIGN(Snapshot snapified, Snapify(snapshot, opts));
+    snapified_corpus.push_back(std::move(snapified));
+  }
+
+  auto relocated_corpus = GenerateRelocatedCorpus<TypeParam>(snapified_corpus);
+
+  // A writable page should be listed iff its end state differs from its
+  // initial state.
+  for (size_t i = 0; i < snapified_corpus.size(); ++i) {
+    const Snapshot& snapshot = snapified_corpus[i];
+    SCOPED_TRACE(snapshot.id());
+    const SnapArray<uint64_t>* snap_dirty_pages =
+        relocated_corpus->DirtyPages(i);
+    ASSERT_NE(snap_dirty_pages, nullptr);
+    EXPECT_TRUE(
+        std::is_sorted(snap_dirty_pages->begin(), snap_dirty_pages->end()));
+    const absl::flat_hash_set<uint64_t> dirty_pages(snap_dirty_pages->begin(),
+                                                    snap_dirty_pages->end());
+    const MemoryState initial_state =
+        MemoryState::MakeInitial(snapshot, MemoryState::kZeroMappedBytes);
+    const MemoryState end_state =
+        MemoryState::MakeEnd(snapshot, 0, MemoryState::kZeroMappedBytes);
+    size_t num_changed_pages = 0;
+    for (const MemoryMapping& mapping : snapshot.memory_mappings()) {
+      if (!mapping.perms().Has(MemoryPerms::kWritable)) continue;
+      for (uint64_t page = mapping.start_address();
+           page < mapping.limit_address(); page += kPageSize) {
+        const bool changed = initial_state.memory_bytes(page, kPageSize) !=
+                             end_state.memory_bytes(page, kPageSize);
+        EXPECT_EQ(dirty_pages.contains(page), changed) << HexStr(page);
+        num_changed_pages += changed;
+      }
+    }
+    EXPECT_EQ(num_changed_pages, snap_dirty_pages->size);
+  }
+}
+
+TYPED_TEST(RelocatableSnapGenerator, SnapIdIndex) {
+  SnapifyOptions opts = SnapifyOptions::V2InputRunOpts(Host::architecture_id);
+
+  // Add snapshots in reverse order so that the index is not the identity.
+  std::vector<Snapshot> snapified_corpus;
+  for (int index = static_cast<int>(TestSnapshot::kNumTestSnapshot) - 1;
+       index >= 0; --index) {
+    TestSnapshot type = static_cast<TestSnapshot>(index);
+    if (!TestSnapshotExists<TypeParam>(type)) {
+      continue;
+    }
+    Snapshot snapshot = MakeSnapRunnerTestSnapshot<TypeParam>(type);
+    ASSERT_OK_AND_ASSIGN(Snapshot snapified, Snapify(snapshot, opts));
+    snapified_corpus.push_back(std::move(snapified));
+  }
+
+  auto relocated_corpus = GenerateRelocatedCorpus<TypeParam>(snapified_corpus);
+  ASSERT_TRUE(relocated_corpus->HasSnapIdIndex());
+  for (size_t i = 0; i < snapified_corpus.size(); ++i) {
+    const std::string& id = snapified_corpus[i].id();
+    EXPECT_EQ(relocated_corpus->FindIndex(id.c_str()), static_cast<ssize_t>(i))
+        << id;
+    EXPECT_EQ(relocated_corpus->Find(id.c_str()), relocated_corpus->snaps[i])
+        << id;
+  }
+  EXPECT_EQ(relocated_corpus->FindIndex("no such snap"), -1);
+  EXPECT_EQ(relocated_corpus->Find("no such snap"), nullptr);
+}
+
 // Test that duplicated byte data are merged to a single copy.
 TYPED_TEST(RelocatableSnapGenerator, DedupeMemoryBytes) {
   Snapshot snapshot =
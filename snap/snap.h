@@ -23,6 +23,7 @@
 // Information not required for snapshot execution is left out and will only be
 // added back when needed.
 #include <sys/mman.h>
+#include <sys/types.h>
 
 #include <cstddef>
 #include <cstdint>
@@ -241,19 +242,89 @@ struct SnapCorpus {
   // The corpus data.
   SnapArray<const Snap<Arch>*> snaps;
 
+  // Indices into `snaps` in ascending strcmp() order of snap IDs. Snaps with
+  // the same ID are in ascending index order.
+  //
+  // Corpora generated before this was added do not have it and their
+  // header.corpus_type_size is kSizeWithoutSnapIdIndex. Use HasSnapIdIndex()
+  // before accessing this.
+  SnapArray<uint32_t> snap_id_index;
+
+  // dirty_pages[i] holds the start addresses of the writable pages of
+  // snaps[i] whose expected end state differs from their initial state, in
+  // ascending order. Pages are kPageSize bytes. Executing the snap as expected
+  // changes no other memory, so the runner can use this to restore and verify
+  // only these pages.
+  //
+  // This is kept out of Snap so that the Snap layout, and with it older
+  // corpora, stay valid. This must stay at the end of the struct. Corpora
+  // generated before it was added have a header.corpus_type_size of
+  // kSizeWithoutDirtyPages or less. Use DirtyPages() to access this.
+  SnapArray<SnapArray<uint64_t>> dirty_pages;
+
+  // Size of this struct without `snap_id_index` and `dirty_pages`.
+  static constexpr size_t kSizeWithoutSnapIdIndex =
+      sizeof(SnapCorpusHeader) + sizeof(SnapArray<const Snap<Arch>*>);
+
+  // Size of this struct without `dirty_pages`.
+  static constexpr size_t kSizeWithoutDirtyPages =
+      kSizeWithoutSnapIdIndex + sizeof(SnapArray<uint32_t>);
+
   bool IsExpectedArch() const {
     return header.architecture_id == static_cast<int>(Arch::architecture_id);
   }
 
+  // Returns true iff `snap_id_index` is present and covers all snaps.
+  bool HasSnapIdIndex() const {
+    return header.corpus_type_size >= kSizeWithoutDirtyPages &&
+           snap_id_index.size == snaps.size;
+  }
+
+  // Returns the dirty pages of snaps[index] or nullptr if the corpus does not
+  // record them. In the latter case all writable memory of the snap must be
+  // treated as dirty.
+  const SnapArray<uint64_t>* DirtyPages(size_t index) const {
+    if (header.corpus_type_size != sizeof(SnapCorpus) ||
+        dirty_pages.size != snaps.size) {
+      return nullptr;
+    }
+    return &dirty_pages[index];
+  }
+
+  // Find the index of the first Snap with the specified id.
+  // Returns -1 if not found.
+  //
+  // This is O(log n) if the corpus has a snap ID index and O(n) otherwise.
+  ssize_t FindIndex(const char* id) const {
+    if (HasSnapIdIndex()) {
+      size_t low = 0, high = snap_id_index.size;
+      while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (strcmp(snaps[snap_id_index[mid]]->id, id) < 0) {
+          low = mid + 1;
+        } else {
+          high = mid;
+        }
+      }
+      if (low < snap_id_index.size &&
+          strcmp(snaps[snap_id_index[low]]->id, id) == 0) {
+        return snap_id_index[low];
+      }
+      return -1;
+    }
+    for (size_t i = 0; i < snaps.size; ++i) {
+      if (strcmp(snaps[i]->id, id) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
   // Find a Snap with the specified id.
   // Returns nullptr if not found.
   const Snap<Arch>* Find(const char* id) const {
-    for (const Snap<Arch>* snap : snaps) {
-      if (strcmp(snap->id, id) == 0) {
-        return snap;
-      }
-    }
-    return nullptr;
+    const ssize_t index = FindIndex(id);
+    return index < 0 ? nullptr : snaps[index];
   }
 };
 
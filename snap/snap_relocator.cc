@@ -18,6 +18,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include "./snap/snap.h"
 #include "./snap/snap_checksum.h"
@@ -168,10 +169,13 @@ SnapRelocatorError SnapRelocator<Arch>::RelocateMemoryBytesArray(
 
 template <typename Arch>
 SnapRelocatorError SnapRelocator<Arch>::RelocateCorpus(bool verify) {
-  // We know the pointer is in bounds, but check that the struct fits in memory
-  // and is aligned.
+  // We know the pointer is in bounds, but check that the header fits in memory
+  // and is aligned. The rest of the struct is checked once we know its size.
   RETURN_IF_RELOCATION_FAILED(
-      ValidateRelocatedAddress<SnapCorpus<Arch>>(start_address_));
+      ValidateRelocatedAddress<SnapCorpusHeader>(start_address_));
+  if (start_address_ % alignof(SnapCorpus<Arch>) != 0) {
+    return SnapRelocatorError::kAlignment;
+  }
 
   SnapCorpus<Arch>& corpus =
       *reinterpret_cast<SnapCorpus<Arch>*>(start_address_);
@@ -210,9 +214,21 @@ SnapRelocatorError SnapRelocator<Arch>::RelocateCorpus(bool verify) {
   }
   // The header embeds size of various structs so that we can detect accidental
   // version mismatches.
-  if (corpus.header.corpus_type_size != sizeof(SnapCorpus<Arch>)) {
+  // Corpora without dirty pages or without a snap ID index are also accepted.
+  static_assert(offsetof(SnapCorpus<Arch>, snap_id_index) ==
+                SnapCorpus<Arch>::kSizeWithoutSnapIdIndex);
+  static_assert(offsetof(SnapCorpus<Arch>, dirty_pages) ==
+                SnapCorpus<Arch>::kSizeWithoutDirtyPages);
+  if (corpus.header.corpus_type_size != sizeof(SnapCorpus<Arch>) &&
+      corpus.header.corpus_type_size !=
+          SnapCorpus<Arch>::kSizeWithoutDirtyPages &&
+      corpus.header.corpus_type_size !=
+          SnapCorpus<Arch>::kSizeWithoutSnapIdIndex) {
     return SnapRelocatorError::kBadData;
   }
+  if (corpus.header.corpus_type_size > limit_address_ - start_address_) {
+    return SnapRelocatorError::kOutOfBound;
+  }
   if (corpus.header.snap_type_size != sizeof(Snap<Arch>)) {
     return SnapRelocatorError::kBadData;
   }
@@ -246,6 +262,35 @@ SnapRelocatorError SnapRelocator<Arch>::RelocateCorpus(bool verify) {
     RETURN_IF_RELOCATION_FAILED(
         RelocateMemoryBytesArray(snap.end_state_memory_bytes));
   }
+
+  if (corpus.header.corpus_type_size >=
+      SnapCorpus<Arch>::kSizeWithoutDirtyPages) {
+    RETURN_IF_RELOCATION_FAILED(AdjustArray(corpus.snap_id_index));
+    if (corpus.snap_id_index.size != corpus.snaps.size) {
+      return SnapRelocatorError::kBadData;
+    }
+    // Lookup trusts the index, so a bad index could cause out-of-bound
+    // accesses. Check that it is in bounds and sorted.
+    const char* previous_id = nullptr;
+    for (uint32_t index : corpus.snap_id_index) {
+      if (index >= corpus.snaps.size) return SnapRelocatorError::kOutOfBound;
+      const char* id = corpus.snaps[index]->id;
+      if (previous_id != nullptr && strcmp(previous_id, id) > 0) {
+        return SnapRelocatorError::kBadData;
+      }
+      previous_id = id;
+    }
+  }
+
+  if (corpus.header.corpus_type_size == sizeof(SnapCorpus<Arch>)) {
+    RETURN_IF_RELOCATION_FAILED(AdjustArray(corpus.dirty_pages));
+    if (corpus.dirty_pages.size != corpus.snaps.size) {
+      return SnapRelocatorError::kBadData;
+    }
+    for (SnapArray<uint64_t>& pages : RelocationIterator(corpus.dirty_pages)) {
+      RETURN_IF_RELOCATION_FAILED(AdjustArray(pages));
+    }
+  }
   return SnapRelocatorError::kOk;
 }
 
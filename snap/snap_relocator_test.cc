@@ -120,6 +120,53 @@ TYPED_TEST(SnapRelocatorTest, ArrayElementAddressOverflow) {
   this->ExpectRelocationResultIs(SnapRelocatorError::kOutOfBound);
 }
 
+TYPED_TEST(SnapRelocatorTest, CorpusWithoutSnapIdIndex) {
+  // Make this look like a corpus generated before the snap ID index existed.
+  this->corpus_->header.corpus_type_size =
+      SnapCorpus<TypeParam>::kSizeWithoutSnapIdIndex;
+  SnapRelocatorError error;
+  MmappedMemoryPtr<const SnapCorpus<TypeParam>> corpus =
+      SnapRelocator<TypeParam>::RelocateCorpus(std::move(this->relocatable_),
+                                               false, &error);
+  ASSERT_EQ(error, SnapRelocatorError::kOk);
+  EXPECT_FALSE(corpus->HasSnapIdIndex());
+  EXPECT_EQ(corpus->DirtyPages(0), nullptr);
+  const Snap<TypeParam>* snap = corpus->snaps[0];
+  EXPECT_EQ(corpus->Find(snap->id), snap);
+  EXPECT_EQ(corpus->Find("no such snap"), nullptr);
+}
+
+TYPED_TEST(SnapRelocatorTest, CorpusWithoutDirtyPages) {
+  // Make this look like a corpus generated before dirty pages were recorded.
+  this->corpus_->header.corpus_type_size =
+      SnapCorpus<TypeParam>::kSizeWithoutDirtyPages;
+  SnapRelocatorError error;
+  MmappedMemoryPtr<const SnapCorpus<TypeParam>> corpus =
+      SnapRelocator<TypeParam>::RelocateCorpus(std::move(this->relocatable_),
+                                               false, &error);
+  ASSERT_EQ(error, SnapRelocatorError::kOk);
+  EXPECT_TRUE(corpus->HasSnapIdIndex());
+  EXPECT_EQ(corpus->DirtyPages(0), nullptr);
+}
+
+TYPED_TEST(SnapRelocatorTest, DirtyPagesSizeMismatch) {
+  this->corpus_->dirty_pages.size = 0;
+  this->ExpectRelocationResultIs(SnapRelocatorError::kBadData);
+}
+
+TYPED_TEST(SnapRelocatorTest, SnapIdIndexSizeMismatch) {
+  this->corpus_->snap_id_index.size = 0;
+  this->ExpectRelocationResultIs(SnapRelocatorError::kBadData);
+}
+
+TYPED_TEST(SnapRelocatorTest, SnapIdIndexOutOfBound) {
+  uint32_t* elements = reinterpret_cast<uint32_t*>(
+      this->relocatable_.get() +
+      reinterpret_cast<uintptr_t>(this->corpus_->snap_id_index.elements));
+  elements[0] = this->corpus_->snaps.size;
+  this->ExpectRelocationResultIs(SnapRelocatorError::kOutOfBound);
+}
+
 }  // namespace
 
 }  // namespace silifuzz
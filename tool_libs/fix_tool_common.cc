@@ -46,6 +46,9 @@ absl::StatusOr<Snapshot> RemakeAndVerify(const Snapshot& snapshot,
                                          const FixupSnapshotOptions& options) {
   MakingConfig config = MakingConfig::Default();
   config.runner_path = RunnerLocation();
+  // The fix tool makes many snapshots per worker thread. Save the cost of
+  // starting a new runner process for every runner invocation.
+  config.reuse_runner = true;
   config.trace.x86_filter_split_lock = options.x86_filter_split_lock;
   config.trace.x86_filter_vsyscall_region_access =
       options.x86_filter_vsyscall_region_access;
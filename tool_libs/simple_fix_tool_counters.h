@@ -14,6 +14,9 @@
 
 #ifndef THIRD_PARTY_SILIFUZZ_TOOL_LIBS_SIMPLE_FIX_TOOL_COUNTERS_H_
 #define THIRD_PARTY_SILIFUZZ_TOOL_LIBS_SIMPLE_FIX_TOOL_COUNTERS_H_
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <utility>
@@ -22,13 +25,15 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/meta/type_traits.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "./tool_libs/fix_tool_common.h"
 
 namespace silifuzz::fix_tool_internal {
 
 // An implementation of the FixToolCounters interface for the simple fix tool.
 // This stores counter values in an object. The values are destroyed when
-// the object is destroyed.
+// the object is destroyed. In addition to counters, this also keeps timing
+// histograms, which are not part of the FixToolCounters interface.
 //
 // This class is not thread-safe.
 class SimpleFixToolCounters : public FixToolCounters {
@@ -49,11 +54,57 @@ class SimpleFixToolCounters : public FixToolCounters {
 
   // Additional API on top of FixToolCounters interface.
 
-  // Merge count values from another SimpleFixToolCounters object.
+  // A histogram of durations with power-of-2 microsecond buckets. Bucket 0
+  // counts durations under 1us and bucket i > 0 counts durations in
+  // [2^(i-1), 2^i) us. The last bucket also counts all longer durations.
+  struct Histogram {
+    static constexpr size_t kNumBuckets = 40;
+
+    // Returns index of the bucket counting `usec`.
+    static size_t BucketIndex(int64_t usec) {
+      size_t index = 0;
+      while (usec > 0 && index < kNumBuckets - 1) {
+        usec >>= 1;
+        ++index;
+      }
+      return index;
+    }
+
+    void Merge(const Histogram& other) {
+      count += other.count;
+      sum_usec += other.sum_usec;
+      max_usec = std::max(max_usec, other.max_usec);
+      for (size_t i = 0; i < kNumBuckets; ++i) {
+        buckets[i] += other.buckets[i];
+      }
+    }
+
+    int64_t count = 0;
+    int64_t sum_usec = 0;
+    int64_t max_usec = 0;
+    std::array<int64_t, kNumBuckets> buckets = {};
+  };
+
+  // Records `duration` in the timing histogram `histogram`.
+  void RecordTiming(absl::string_view histogram, absl::Duration duration) {
+    const int64_t usec = std::max<int64_t>(absl::ToInt64Microseconds(duration),
+                                           0);
+    Histogram& h = histograms_[histogram];
+    ++h.count;
+    h.sum_usec += usec;
+    h.max_usec = std::max(h.max_usec, usec);
+    ++h.buckets[Histogram::BucketIndex(usec)];
+  }
+
+  // Merge count values and histograms from another SimpleFixToolCounters
+  // object.
   void Merge(const SimpleFixToolCounters& other) {
     for (const auto& [counter, count] : other.counters_) {
       IncrementBy(counter, count);
     }
+    for (const auto& [name, histogram] : other.histograms_) {
+      histograms_[name].Merge(histogram);
+    }
   }
 
   // Returns value of `counter` or 0 if it does not exist.
@@ -72,9 +123,28 @@ class SimpleFixToolCounters : public FixToolCounters {
     return counter_names;
   }
 
+  // Returns histogram `histogram` or nullptr if it does not exist.
+  const Histogram* GetHistogram(absl::string_view histogram) const {
+    auto it = histograms_.find(histogram);
+    return it != histograms_.end() ? &it->second : nullptr;
+  }
+
+  // Returns unordered names of all histograms.
+  std::vector<std::string> GetHistogramNames() const {
+    std::vector<std::string> histogram_names;
+    histogram_names.reserve(histograms_.size());
+    for (const auto& [histogram, _] : histograms_) {
+      histogram_names.push_back(histogram);
+    }
+    return histogram_names;
+  }
+
  private:
   // Stored counter values.
   absl::flat_hash_map<std::string, int64_t> counters_;
+
+  // Stored timing histograms.
+  absl::flat_hash_map<std::string, Histogram> histograms_;
 };
 
 }  // namespace silifuzz::fix_tool_internal
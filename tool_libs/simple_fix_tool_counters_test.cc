@@ -16,6 +16,7 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/time/time.h"
 
 namespace silifuzz {
 namespace fix_tool_internal {
@@ -53,6 +54,42 @@ TEST(SimpleFixToolCounters, GetCounterNames) {
               ::testing::UnorderedElementsAre("foo", "bar", "baz"));
 }
 
+TEST(SimpleFixToolCounters, Histogram) {
+  SimpleFixToolCounters counters;
+  EXPECT_EQ(counters.GetHistogram("foo"), nullptr);
+  counters.RecordTiming("foo", absl::Nanoseconds(10));
+  counters.RecordTiming("foo", absl::Microseconds(1));
+  counters.RecordTiming("foo", absl::Microseconds(5));
+  counters.RecordTiming("foo", absl::Microseconds(7));
+  counters.RecordTiming("foo", absl::Hours(1000000));
+  const SimpleFixToolCounters::Histogram* h = counters.GetHistogram("foo");
+  ASSERT_NE(h, nullptr);
+  EXPECT_EQ(h->count, 5);
+  EXPECT_EQ(h->max_usec, absl::ToInt64Microseconds(absl::Hours(1000000)));
+  EXPECT_EQ(h->buckets[0], 1);
+  EXPECT_EQ(h->buckets[1], 1);
+  EXPECT_EQ(h->buckets[3], 2);
+  EXPECT_EQ(h->buckets[SimpleFixToolCounters::Histogram::kNumBuckets - 1], 1);
+}
+
+TEST(SimpleFixToolCounters, MergeHistogram) {
+  SimpleFixToolCounters counters1;
+  counters1.RecordTiming("foo", absl::Microseconds(1));
+  SimpleFixToolCounters counters2;
+  counters2.RecordTiming("foo", absl::Microseconds(100));
+  counters2.RecordTiming("bar", absl::Microseconds(2));
+
+  counters1.Merge(counters2);
+  const SimpleFixToolCounters::Histogram* foo = counters1.GetHistogram("foo");
+  ASSERT_NE(foo, nullptr);
+  EXPECT_EQ(foo->count, 2);
+  EXPECT_EQ(foo->sum_usec, 101);
+  EXPECT_EQ(foo->max_usec, 100);
+  ASSERT_NE(counters1.GetHistogram("bar"), nullptr);
+  EXPECT_THAT(counters1.GetHistogramNames(),
+              ::testing::UnorderedElementsAre("foo", "bar"));
+}
+
 }  // namespace
 }  // namespace fix_tool_internal
 }  // namespace silifuzz
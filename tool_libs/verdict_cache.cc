@@ -0,0 +1,266 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./tool_libs/verdict_cache.h"
+
+#include <fcntl.h>
+#include <openssl/sha.h>  // IWYU pragma: keep
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "./util/checks.h"
+
+namespace silifuzz {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'F', 'V', 'E', 'R', 'D', 'C', 'T'};
+constexpr uint32_t kVersion = 1;
+
+// Number of entries in a set.
+constexpr size_t kNumWays = 8;
+
+// Holds an exclusive flock(2) on a file while in scope.
+class FileLock {
+ public:
+  explicit FileLock(int fd) : fd_(fd) {
+    while (flock(fd_, LOCK_EX) != 0) {
+      CHECK_EQ(errno, EINTR);
+    }
+  }
+  ~FileLock() { CHECK_EQ(flock(fd_, LOCK_UN), 0); }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+struct VerdictCache::Header {
+  char magic[sizeof(kMagic)];
+  uint32_t version;
+  uint32_t num_sets;
+  // Incremented on every access. Entries record the clock value of their last
+  // access for LRU eviction.
+  uint64_t clock;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t insertions;
+  uint64_t evictions;
+};
+
+struct VerdictCache::Entry {
+  Key key;
+  // absl::StatusCode of the verdict.
+  int32_t code;
+  // Clock value of the last access or 0 if this entry is unused.
+  uint64_t last_used;
+  // NUL-terminated, possibly truncated, error message of the verdict.
+  char message[kMaxMessageSize + 1];
+};
+
+// static
+VerdictCache::Key VerdictCache::MakeKey(absl::string_view snapshot_id,
+                                        absl::string_view fingerprint) {
+  static_assert(kKeySize == SHA_DIGEST_LENGTH);
+  // The NUL separator keeps (id, fingerprint) pairs from colliding.
+  const std::string data = absl::StrCat(snapshot_id, absl::string_view("\0", 1),
+                                        fingerprint);
+  Key key;
+  SHA1(reinterpret_cast<const uint8_t*>(data.data()), data.size(), key.data());
+  return key;
+}
+
+// static
+absl::StatusOr<std::unique_ptr<VerdictCache>> VerdictCache::Open(
+    absl::string_view path, size_t capacity) {
+  // Keep entries compact and aligned to cache lines.
+  static_assert(sizeof(Entry) == 128);
+  const std::string path_str(path);
+  const int fd = open(path_str.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("open ", path));
+  }
+  // Closes `fd` on error.
+  auto fail = [fd](absl::Status status) {
+    close(fd);
+    return status;
+  };
+
+  size_t file_size;
+  {
+    // Creation must be atomic with respect to other processes.
+    FileLock lock(fd);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      return fail(absl::ErrnoToStatus(errno, "fstat"));
+    }
+    if (st.st_size == 0) {
+      Header header = {};
+      memcpy(header.magic, kMagic, sizeof(kMagic));
+      header.version = kVersion;
+      header.num_sets = std::max<size_t>((capacity + kNumWays - 1) / kNumWays,
+                                         1);
+      file_size =
+          sizeof(Header) + header.num_sets * kNumWays * sizeof(Entry);
+      // Unused entries are all zeros, as ftruncate(2) leaves them.
+      if (ftruncate(fd, file_size) != 0) {
+        return fail(absl::ErrnoToStatus(errno, "ftruncate"));
+      }
+      if (pwrite(fd, &header, sizeof(header), 0) !=
+          static_cast<ssize_t>(sizeof(header))) {
+        return fail(absl::ErrnoToStatus(errno, "pwrite"));
+      }
+    } else {
+      Header header;
+      if (st.st_size < static_cast<off_t>(sizeof(Header)) ||
+          pread(fd, &header, sizeof(header), 0) !=
+              static_cast<ssize_t>(sizeof(header)) ||
+          memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        return fail(absl::InvalidArgumentError(
+            absl::StrCat(path, " is not a verdict cache")));
+      }
+      if (header.version != kVersion) {
+        return fail(absl::FailedPreconditionError(
+            absl::StrCat(path, " has unsupported version ", header.version)));
+      }
+      file_size = sizeof(Header) + header.num_sets * kNumWays * sizeof(Entry);
+      if (header.num_sets == 0 || st.st_size != static_cast<off_t>(file_size)) {
+        return fail(absl::InvalidArgumentError(
+            absl::StrCat(path, " has an unexpected size")));
+      }
+    }
+  }
+
+  void* mapping =
+      mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return fail(absl::ErrnoToStatus(errno, "mmap"));
+  }
+  return std::unique_ptr<VerdictCache>(
+      new VerdictCache(fd, mapping, file_size));
+}
+
+VerdictCache::~VerdictCache() {
+  CHECK_EQ(munmap(mapping_, mapping_size_), 0);
+  close(fd_);
+}
+
+VerdictCache::Header& VerdictCache::header() const {
+  return *reinterpret_cast<Header*>(mapping_);
+}
+
+VerdictCache::Entry* VerdictCache::FindSet(const Key& key) const {
+  // Keys are SHA-1 digests so any bits will do for the index.
+  uint32_t hash;
+  memcpy(&hash, key.data(), sizeof(hash));
+  Entry* entries = reinterpret_cast<Entry*>(
+      reinterpret_cast<char*>(mapping_) + sizeof(Header));
+  return entries + (hash % header().num_sets) * kNumWays;
+}
+
+std::optional<absl::Status> VerdictCache::Lookup(const Key& key) {
+  FileLock lock(fd_);
+  Header& h = header();
+  Entry* set = FindSet(key);
+  for (size_t i = 0; i < kNumWays; ++i) {
+    Entry& entry = set[i];
+    if (entry.last_used != 0 && entry.key == key) {
+      entry.last_used = ++h.clock;
+      ++h.hits;
+      return absl::Status(static_cast<absl::StatusCode>(entry.code),
+                          entry.message);
+    }
+  }
+  ++h.misses;
+  return std::nullopt;
+}
+
+void VerdictCache::Insert(const Key& key, const absl::Status& verdict) {
+  // Only cache codes that are always real verdicts. Making reports most
+  // rejections as kInternal, but so are infrastructure failures like a runner
+  // killed by the OOM killer or a failure to spawn it, which must be retried.
+  switch (verdict.code()) {
+    case absl::StatusCode::kOk:
+    case absl::StatusCode::kInvalidArgument:
+      break;
+    default:
+      return;
+  }
+
+  FileLock lock(fd_);
+  Header& h = header();
+  Entry* set = FindSet(key);
+  // Prefer the entry for `key`, then an unused entry, then the LRU entry.
+  Entry* victim = &set[0];
+  for (size_t i = 0; i < kNumWays; ++i) {
+    Entry& entry = set[i];
+    if (entry.last_used != 0 && entry.key == key) {
+      victim = &entry;
+      break;
+    }
+    if (victim->last_used != 0 && entry.last_used < victim->last_used) {
+      victim = &entry;
+    }
+  }
+  if (victim->last_used != 0 && victim->key != key) {
+    ++h.evictions;
+  }
+  ++h.insertions;
+
+  victim->key = key;
+  victim->code = static_cast<int32_t>(verdict.code());
+  const absl::string_view message =
+      verdict.message().substr(0, kMaxMessageSize);
+  memcpy(victim->message, message.data(), message.size());
+  victim->message[message.size()] = '\0';
+  victim->last_used = ++h.clock;
+}
+
+VerdictCache::Stats VerdictCache::GetStats() const {
+  FileLock lock(fd_);
+  const Header& h = header();
+  Stats stats;
+  stats.hits = h.hits;
+  stats.misses = h.misses;
+  stats.insertions = h.insertions;
+  stats.evictions = h.evictions;
+  stats.capacity = h.num_sets * kNumWays;
+  const Entry* entries = reinterpret_cast<const Entry*>(
+      reinterpret_cast<const char*>(mapping_) + sizeof(Header));
+  for (size_t i = 0; i < stats.capacity; ++i) {
+    if (entries[i].last_used != 0) ++stats.num_entries;
+  }
+  return stats;
+}
+
+}  // namespace silifuzz
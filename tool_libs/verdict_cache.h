@@ -0,0 +1,120 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_TOOL_LIBS_VERDICT_CACHE_H_
+#define THIRD_PARTY_SILIFUZZ_TOOL_LIBS_VERDICT_CACHE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace silifuzz {
+
+// A persistent cache of snapshot making verdicts i.e. the status returned by
+// MakeRawInstructions() for an instruction sequence.
+//
+// The cache lives in a memory-mapped file that any number of processes on
+// a host can open at the same time. Accesses are serialized by flock(2).
+// The cache has a fixed number of entries set when the file is created.
+// Entries are grouped into small sets by key and the least recently used
+// entry of a set is evicted when a new one is inserted.
+//
+// The file also holds hit/miss statistics accumulated over all processes
+// that have used it.
+//
+// This class is thread-compatible.
+class VerdictCache {
+ public:
+  // Size of a key in bytes.
+  static constexpr size_t kKeySize = 20;
+
+  // Maximum length of a cached error message. Longer messages are truncated.
+  static constexpr size_t kMaxMessageSize = 95;
+
+  using Key = std::array<uint8_t, kKeySize>;
+
+  // Accumulated statistics of a cache file.
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    // Number of entries in use and total.
+    uint64_t num_entries = 0;
+    uint64_t capacity = 0;
+  };
+
+  // Returns a key for the instruction sequence with `snapshot_id` (see
+  // InstructionsToSnapshotId()) made with a configuration described by
+  // `fingerprint`. Anything that can change a verdict, e.g. the platform or
+  // making options, should be part of `fingerprint`.
+  static Key MakeKey(absl::string_view snapshot_id,
+                     absl::string_view fingerprint);
+
+  // Opens the cache file at `path`, creating it with room for at least
+  // `capacity` entries if it does not exist or is empty. The capacity of an
+  // existing cache file is never changed.
+  // RETURNS: The cache or an error if the file cannot be opened or is not a
+  // compatible cache file.
+  static absl::StatusOr<std::unique_ptr<VerdictCache>> Open(
+      absl::string_view path, size_t capacity);
+
+  // Not copyable or movable.
+  VerdictCache(const VerdictCache&) = delete;
+  VerdictCache& operator=(const VerdictCache&) = delete;
+
+  ~VerdictCache();
+
+  // Returns the cached verdict for `key` or std::nullopt if there is none.
+  // Updates hit/miss statistics.
+  std::optional<absl::Status> Lookup(const Key& key);
+
+  // Caches `verdict` for `key`, replacing any existing verdict. Only OK and
+  // kInvalidArgument verdicts are cached. Other codes, kInternal in
+  // particular, can be caused by transient conditions, e.g. resource
+  // exhaustion or a runner that could not be started, and are not cached.
+  void Insert(const Key& key, const absl::Status& verdict);
+
+  // Returns statistics accumulated in the cache file.
+  Stats GetStats() const;
+
+ private:
+  struct Header;
+  struct Entry;
+
+  VerdictCache(int fd, void* mapping, size_t mapping_size)
+      : fd_(fd), mapping_(mapping), mapping_size_(mapping_size) {}
+
+  Header& header() const;
+
+  // Returns the first entry of the set holding `key`.
+  Entry* FindSet(const Key& key) const;
+
+  // File descriptor of the cache file. Also used for locking.
+  int fd_;
+
+  // Shared mapping of the whole cache file.
+  void* mapping_;
+  size_t mapping_size_;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_TOOL_LIBS_VERDICT_CACHE_H_
@@ -0,0 +1,133 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./tool_libs/verdict_cache.h"
+
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "./util/path_util.h"
+#include "./util/testing/status_macros.h"
+#include "./util/testing/status_matchers.h"
+
+namespace silifuzz {
+namespace {
+
+using silifuzz::testing::StatusIs;
+using ::testing::Optional;
+
+VerdictCache::Key KeyFor(int i) {
+  return VerdictCache::MakeKey(absl::StrCat("snap_", i), "fingerprint");
+}
+
+TEST(VerdictCache, MakeKey) {
+  EXPECT_EQ(VerdictCache::MakeKey("a", "b"), VerdictCache::MakeKey("a", "b"));
+  EXPECT_NE(VerdictCache::MakeKey("a", "b"), VerdictCache::MakeKey("a", "c"));
+  EXPECT_NE(VerdictCache::MakeKey("ab", ""), VerdictCache::MakeKey("a", "b"));
+}
+
+TEST(VerdictCache, LookupAndInsert) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  ASSERT_OK_AND_ASSIGN(auto cache, VerdictCache::Open(path, 100));
+
+  EXPECT_EQ(cache->Lookup(KeyFor(0)), std::nullopt);
+  cache->Insert(KeyFor(0), absl::OkStatus());
+  cache->Insert(KeyFor(1), absl::InvalidArgumentError("Rejected"));
+  EXPECT_THAT(cache->Lookup(KeyFor(0)), Optional(absl::OkStatus()));
+  EXPECT_THAT(cache->Lookup(KeyFor(1)),
+              Optional(absl::InvalidArgumentError("Rejected")));
+
+  // Replace an existing verdict.
+  cache->Insert(KeyFor(1), absl::OkStatus());
+  EXPECT_THAT(cache->Lookup(KeyFor(1)), Optional(absl::OkStatus()));
+
+  const VerdictCache::Stats stats = cache->GetStats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.insertions, 3);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.num_entries, 2);
+  EXPECT_GE(stats.capacity, 100);
+}
+
+TEST(VerdictCache, TruncatesMessage) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  ASSERT_OK_AND_ASSIGN(auto cache, VerdictCache::Open(path, 1));
+  const std::string long_message(1000, 'x');
+  cache->Insert(KeyFor(0), absl::InvalidArgumentError(long_message));
+  EXPECT_THAT(cache->Lookup(KeyFor(0)),
+              Optional(absl::InvalidArgumentError(
+                  long_message.substr(0, VerdictCache::kMaxMessageSize))));
+}
+
+TEST(VerdictCache, SkipsTransientVerdicts) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  ASSERT_OK_AND_ASSIGN(auto cache, VerdictCache::Open(path, 1));
+  cache->Insert(KeyFor(0), absl::ResourceExhaustedError("out of memory"));
+  EXPECT_EQ(cache->Lookup(KeyFor(0)), std::nullopt);
+  // What RunnerDriver reports when the OOM killer kills the runner.
+  cache->Insert(KeyFor(0), absl::InternalError("Runner killed by signal 9"));
+  EXPECT_EQ(cache->Lookup(KeyFor(0)), std::nullopt);
+  // A later real verdict is cached.
+  cache->Insert(KeyFor(0), absl::OkStatus());
+  EXPECT_THAT(cache->Lookup(KeyFor(0)), Optional(absl::OkStatus()));
+}
+
+TEST(VerdictCache, EvictsLeastRecentlyUsed) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  // A single set.
+  ASSERT_OK_AND_ASSIGN(auto cache, VerdictCache::Open(path, 1));
+  const size_t capacity = cache->GetStats().capacity;
+  for (int i = 0; i < capacity; ++i) {
+    cache->Insert(KeyFor(i), absl::OkStatus());
+  }
+  // Make entry 0 the most recently used one.
+  ASSERT_NE(cache->Lookup(KeyFor(0)), std::nullopt);
+  cache->Insert(KeyFor(capacity), absl::OkStatus());
+
+  EXPECT_NE(cache->Lookup(KeyFor(0)), std::nullopt);
+  EXPECT_EQ(cache->Lookup(KeyFor(1)), std::nullopt);
+  EXPECT_NE(cache->Lookup(KeyFor(capacity)), std::nullopt);
+  EXPECT_EQ(cache->GetStats().evictions, 1);
+  EXPECT_EQ(cache->GetStats().num_entries, capacity);
+}
+
+TEST(VerdictCache, Shared) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  ASSERT_OK_AND_ASSIGN(auto cache1, VerdictCache::Open(path, 100));
+  // The capacity of an existing cache is kept.
+  ASSERT_OK_AND_ASSIGN(auto cache2, VerdictCache::Open(path, 1));
+  EXPECT_EQ(cache1->GetStats().capacity, cache2->GetStats().capacity);
+
+  cache1->Insert(KeyFor(0), absl::InvalidArgumentError("rejected"));
+  EXPECT_THAT(cache2->Lookup(KeyFor(0)),
+              Optional(absl::InvalidArgumentError("rejected")));
+  EXPECT_EQ(cache1->GetStats().hits, 1);
+}
+
+TEST(VerdictCache, RejectsOtherFiles) {
+  ASSERT_OK_AND_ASSIGN(std::string path, CreateTempFile("verdict_cache"));
+  std::ofstream(path) << "not a verdict cache";
+  EXPECT_THAT(VerdictCache::Open(path, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace silifuzz
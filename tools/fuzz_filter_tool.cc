@@ -14,17 +14,90 @@
 
 #include "./tools/fuzz_filter_tool.h"
 
+#include <sys/stat.h>
+
+#include <optional>
 #include <string>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "./common/raw_insns_util.h"
+#include "./instruction/static_prefilter.h"
 #include "./runner/make_snapshot.h"
+#include "./tool_libs/verdict_cache.h"
+#include "./util/arch.h"
+#include "./util/itoa.h"
+#include "./util/platform.h"
 
 namespace silifuzz {
 
+namespace {
+
+MakingConfig FilterToolMakingConfig() {
+  MakingConfig config = MakingConfig::Quick();
+  // This runs for every fuzzing input, so latency matters more than the
+  // extra address space layouts unfused verification tries.
+  config.fused_pipeline = true;
+  return config;
+}
+
+// Returns a string describing everything besides the instructions that can
+// change the verdict for them.
+std::string FilterToolFingerprint(const MakingConfig& config) {
+  std::string fingerprint = absl::StrCat(
+      "platform=", EnumStr(CurrentPlatformId()),
+      ";max_pages_to_add=", config.max_pages_to_add,
+      ";num_verify_attempts=", config.num_verify_attempts,
+      ";fused_pipeline=", config.fused_pipeline,
+      ";instruction_count_limit=", config.trace.instruction_count_limit,
+      ";x86_filter_split_lock=", config.trace.x86_filter_split_lock,
+      ";filter_non_deterministic_insn=",
+      config.trace.filter_non_deterministic_insn,
+      ";x86_filter_vsyscall_region_access=",
+      config.trace.x86_filter_vsyscall_region_access,
+      ";filter_memory_access=", config.trace.filter_memory_access);
+  // A rebuilt runner may decide differently.
+  struct stat st;
+  if (stat(config.runner_path.c_str(), &st) == 0) {
+    absl::StrAppend(&fingerprint, ";runner_size=", st.st_size,
+                    ";runner_mtime=", st.st_mtim.tv_sec, ".",
+                    st.st_mtim.tv_nsec);
+  }
+  return fingerprint;
+}
+
+}  // namespace
+
 // Kept as a separate function so that we can test this exact config.
 absl::Status FilterToolMain(absl::string_view raw_insns_bytes) {
-  return MakeRawInstructions(raw_insns_bytes, MakingConfig::Quick()).status();
+  return FilterToolMain(raw_insns_bytes, nullptr);
+}
+
+absl::Status FilterToolMain(absl::string_view raw_insns_bytes,
+                            VerdictCache* cache) {
+  // This is cheaper than even a cache lookup.
+  const StaticPrefilterVerdict prefilter_verdict =
+      StaticPrefilter<Host>(raw_insns_bytes);
+  if (prefilter_verdict != StaticPrefilterVerdict::kAccept) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Rejected by static pre-filter: ", EnumStr(prefilter_verdict)));
+  }
+
+  const MakingConfig config = FilterToolMakingConfig();
+  if (cache == nullptr) {
+    return MakeRawInstructions(raw_insns_bytes, config).status();
+  }
+
+  const VerdictCache::Key key = VerdictCache::MakeKey(
+      InstructionsToSnapshotId(raw_insns_bytes), FilterToolFingerprint(config));
+  if (std::optional<absl::Status> verdict = cache->Lookup(key);
+      verdict.has_value()) {
+    return *verdict;
+  }
+  absl::Status verdict = MakeRawInstructions(raw_insns_bytes, config).status();
+  cache->Insert(key, verdict);
+  return verdict;
 }
 
 }  // namespace silifuzz
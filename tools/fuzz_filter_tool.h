@@ -26,10 +26,18 @@
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "./tool_libs/verdict_cache.h"
 
 namespace silifuzz {
 
 absl::Status FilterToolMain(absl::string_view raw_insns_bytes);
-}
+
+// Like above but reuses the verdict for `raw_insns_bytes` from `cache` if
+// there is one and adds the verdict to `cache` otherwise. A null `cache` is
+// ignored.
+absl::Status FilterToolMain(absl::string_view raw_insns_bytes,
+                            VerdictCache* cache);
+
+}  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_TOOLS_FUZZ_FILTER_TOOL_H_
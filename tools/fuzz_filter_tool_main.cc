@@ -18,17 +18,62 @@
 // The bytes are converted into Snapshot using InstructionsToSnapshot() which
 // is the same as what our fuzzers and the fix pipeline use.
 
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "./tool_libs/verdict_cache.h"
 #include "./tools/fuzz_filter_tool.h"
 #include "./util/checks.h"
 #include "./util/tool_util.h"
 
+ABSL_FLAG(std::string, verdict_cache, "",
+          "If set, path of a verdict cache file shared by all instances of "
+          "the tool. Verdicts for previously seen inputs are read from the "
+          "cache instead of making snapshots again.");
+ABSL_FLAG(size_t, verdict_cache_size, 1 << 20,
+          "Number of entries of the verdict cache when it is created. Has no "
+          "effect on an existing cache.");
+ABSL_FLAG(bool, print_verdict_cache_stats, false,
+          "If true, prints statistics of --verdict_cache and exits.");
+
 int main(int argc, char** argv) {
   std::vector<char*> non_flag_args = absl::ParseCommandLine(argc, argv);
+
+  std::unique_ptr<silifuzz::VerdictCache> cache;
+  const std::string cache_path = absl::GetFlag(FLAGS_verdict_cache);
+  if (!cache_path.empty()) {
+    absl::StatusOr<std::unique_ptr<silifuzz::VerdictCache>> cache_or =
+        silifuzz::VerdictCache::Open(cache_path,
+                                     absl::GetFlag(FLAGS_verdict_cache_size));
+    if (cache_or.ok()) {
+      cache = *std::move(cache_or);
+    } else {
+      // The cache is an optimization only.
+      LOG_ERROR("Not using verdict cache: ", cache_or.status().message());
+    }
+  }
+
+  if (absl::GetFlag(FLAGS_print_verdict_cache_stats)) {
+    if (cache == nullptr) {
+      LOG_ERROR("--print_verdict_cache_stats requires --verdict_cache");
+      return 1;
+    }
+    const silifuzz::VerdictCache::Stats stats = cache->GetStats();
+    printf("hits: %lu\nmisses: %lu\ninsertions: %lu\nevictions: %lu\n"
+           "entries: %lu / %lu\n",
+           stats.hits, stats.misses, stats.insertions, stats.evictions,
+           stats.num_entries, stats.capacity);
+    return 0;
+  }
+
   if (non_flag_args.size() != 2) {
     LOG_ERROR("Expected exactly 1 input file");
     return 1;
@@ -39,7 +84,7 @@ int main(int argc, char** argv) {
     LOG_ERROR(bytes.status().message());
     return 1;
   }
-  absl::Status s = silifuzz::FilterToolMain(*bytes);
+  absl::Status s = silifuzz::FilterToolMain(*bytes, cache.get());
   if (!s.ok()) LOG_ERROR(s.message());
   return silifuzz::ToExitCode(s.ok());
 }
@@ -14,35 +14,42 @@
 
 #include "./tools/simple_fix_tool.h"
 
+#include <fcntl.h>
 #include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <atomic>
 #include <cstddef>
-#include <fstream>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
+#include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/meta/type_traits.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
-#include "absl/types/span.h"
 #include "external/com_google_fuzztest/centipede/blob_file.h"
 #include "external/com_google_fuzztest/centipede/defs.h"
+#include "third_party/liblzma/lzma.h"
 #include "./common/raw_insns_util.h"
 #include "./common/snapshot.h"
+#include "./instruction/static_prefilter.h"
 #include "./snap/gen/relocatable_snap_generator.h"
 #include "./snap/gen/snap_generator.h"
 #include "./tool_libs/corpus_partitioner_lib.h"
@@ -51,9 +58,10 @@
 #include "./tool_libs/snap_group.h"
 #include "./util/arch.h"
 #include "./util/checks.h"
+#include "./util/file_util.h"
+#include "./util/itoa.h"
 #include "./util/mmapped_memory_ptr.h"
 #include "./util/platform.h"
-#include "./util/span_util.h"
 
 namespace silifuzz {
 namespace fix_tool_internal {
@@ -65,17 +73,167 @@ namespace {
 // workers. Contention is alleviated by updating this infrequently.
 std::atomic<size_t> num_blobs_processed = 0;
 
+// Hands out blobs to make workers in small chunks. Each worker owns a
+// contiguous range of blob indices and claims chunks from the front of it.
+// When its range is exhausted, a worker steals the back half of the largest
+// remaining range of another worker. Cost per blob varies by orders of
+// magnitude, so a static partition leaves most workers idle near the end.
+//
+// This class is thread-safe.
+class BlobScheduler {
+ public:
+  // Maximum number of blobs claimed at a time. Keeping this small bounds the
+  // work a slow worker holds back from the others at the end.
+  static constexpr size_t kMaxChunkSize = 8;
+
+  BlobScheduler(size_t num_blobs, size_t num_workers) : ranges_(num_workers) {
+    // Partition evenly to begin with.
+    for (size_t i = 0; i < num_workers; ++i) {
+      Range& range = ranges_[i];
+      range.begin = num_blobs * i / num_workers;
+      range.end = num_blobs * (i + 1) / num_workers;
+    }
+  }
+
+  // Not copyable or movable.
+  BlobScheduler(const BlobScheduler&) = delete;
+  BlobScheduler& operator=(const BlobScheduler&) = delete;
+
+  // Claims the next chunk of blobs for `worker`. Returns true and sets
+  // [`begin`, `end`) to the indices of the blobs claimed, or returns false if
+  // all blobs have been claimed.
+  bool Next(size_t worker, size_t& begin, size_t& end) {
+    while (true) {
+      if (ClaimChunk(ranges_[worker], begin, end)) return true;
+
+      // Find the victim with the most remaining blobs. This is racy but
+      // stealing below re-checks under the victim's lock.
+      size_t victim = worker;
+      size_t victim_size = 0;
+      for (size_t i = 0; i < ranges_.size(); ++i) {
+        const size_t size = ranges_[i].Size();
+        if (size > victim_size) {
+          victim = i;
+          victim_size = size;
+        }
+      }
+      if (victim_size == 0) return false;
+
+      size_t stolen_begin, stolen_end;
+      {
+        Range& range = ranges_[victim];
+        absl::MutexLock lock(&range.mu);
+        const size_t size = range.end - range.begin;
+        if (size == 0) continue;  // Beaten by another thief, retry.
+        // Take the back half, rounding up so that a single blob is stolen.
+        stolen_end = range.end;
+        stolen_begin = range.end - (size + 1) / 2;
+        range.end = stolen_begin;
+      }
+      Range& own = ranges_[worker];
+      absl::MutexLock lock(&own.mu);
+      own.begin = stolen_begin;
+      own.end = stolen_end;
+    }
+  }
+
+ private:
+  struct Range {
+    size_t Size() {
+      absl::MutexLock lock(&mu);
+      return end - begin;
+    }
+
+    absl::Mutex mu;
+    size_t begin ABSL_GUARDED_BY(mu) = 0;
+    size_t end ABSL_GUARDED_BY(mu) = 0;
+  };
+
+  // Claims a chunk from the front of `range`. Returns false if it is empty.
+  static bool ClaimChunk(Range& range, size_t& begin, size_t& end) {
+    absl::MutexLock lock(&range.mu);
+    if (range.begin == range.end) return false;
+    begin = range.begin;
+    end = std::min(range.end, range.begin + kMaxChunkSize);
+    range.begin = end;
+    return true;
+  }
+
+  // Blob index ranges owned by workers.
+  std::vector<Range> ranges_;
+};
+
 // Arguments for a make worker thread.
 // This is used for both input and output.
 struct FixToolWorkerArgs {
   // A worker needs to reference simple fix tool options.
   // The worker does not own the option.
   const SimpleFixToolOptions* options;
-  absl::Span<const std::string> blobs;
-  std::vector<Snapshot> good_snapshots;
+  // Index of this worker in `scheduler`.
+  size_t worker_index;
+  BlobScheduler* scheduler;
+  const std::vector<std::string>* blobs;
+  // Made snapshots paired with the indices of their blobs.
+  std::vector<std::pair<size_t, Snapshot>> good_snapshots;
   SimpleFixToolCounters counters;
 };
 
+// Makes a single `blob` into a snapshot. Returns the made snapshot or
+// std::nullopt if `blob` is rejected. Updates statistics in `counters`.
+std::optional<Snapshot> MakeSnapshotFromBlob(
+    const std::string& blob, SimpleFixToolCounters& counters,
+    PlatformFixToolCounters& platform_counters) {
+  // Records time spent in a make stage in a histogram.
+  absl::Time stage_start = absl::Now();
+  auto end_stage = [&counters, &stage_start](absl::string_view stage) {
+    const absl::Time now = absl::Now();
+    counters.RecordTiming(stage, now - stage_start);
+    stage_start = now;
+  };
+
+  // Reject what cannot be made before spending runner invocations on it.
+  const StaticPrefilterVerdict verdict = StaticPrefilter<Host>(blob);
+  end_stage("FixToolWorker:prefilter");
+  if (verdict != StaticPrefilterVerdict::kAccept) {
+    counters.Increment(absl::StrCat("silifuzz-INFO-FixToolWorker:prefilter-",
+                                    EnumStr(verdict)));
+    return std::nullopt;
+  }
+
+  absl::StatusOr<Snapshot> snapshot = InstructionsToSnapshot<Host>(blob);
+  end_stage("FixToolWorker:instructions-to-snapshot");
+  if (!snapshot.ok()) {
+    counters.Increment(
+        "silifuzz-ERROR-FixToolWorker:instructions-to-snapshot-failed");
+    return std::nullopt;
+  }
+  snapshot->set_id(InstructionsToSnapshotId(blob));
+  const bool normalized = NormalizeSnapshot(snapshot.value(), &counters);
+  end_stage("FixToolWorker:normalize");
+  if (!normalized) {
+    return std::nullopt;
+  }
+  RewriteInitialState(snapshot.value(), &counters);
+  const FixupSnapshotOptions options;
+  auto remade_snapshot_or =
+      FixupSnapshot(snapshot.value(), options, &platform_counters);
+  end_stage("FixToolWorker:fixup");
+  if (!remade_snapshot_or.ok()) {
+    return std::nullopt;
+  }
+  // Snaps need to be snapified before GenerateRelocatableSnaps.
+  // If they are not, executable pages may not be RLE compressed.
+  remade_snapshot_or =
+      Snapify(remade_snapshot_or.value(),
+              SnapifyOptions::V2InputRunOpts(snapshot->architecture_id()));
+  end_stage("FixToolWorker:snapify");
+  if (!remade_snapshot_or.ok()) {
+    return std::nullopt;
+  }
+  counters.Increment("silifuzz-INFO-FixToolWorker:success");
+  return std::move(remade_snapshot_or.value());
+}
+
 void FixToolWorker(FixToolWorkerArgs& args) {
   auto current_platform = CurrentPlatformId();
   CHECK(current_platform != PlatformId::kUndefined);
@@ -86,40 +244,24 @@ void FixToolWorker(FixToolWorkerArgs& args) {
   constexpr size_t kMinCountUpdateSize = 100;
   size_t count_update = 0;
 
-  for (const std::string& blob : args.blobs) {
-    // Update global blobs count.
-    if (++count_update >= kMinCountUpdateSize) {
-      num_blobs_processed.fetch_add(count_update);
-      count_update = 0;
-    }
+  size_t begin, end;
+  while (args.scheduler->Next(args.worker_index, begin, end)) {
+    for (size_t i = begin; i < end; ++i) {
+      // Update global blobs count.
+      if (++count_update >= kMinCountUpdateSize) {
+        num_blobs_processed.fetch_add(count_update);
+        count_update = 0;
+      }
 
-    absl::StatusOr<Snapshot> snapshot = InstructionsToSnapshot<Host>(blob);
-    if (!snapshot.ok()) {
-      args.counters.Increment(
-          "silifuzz-ERROR-FixToolWorker:instructions-to-snapshot-failed");
-      continue;
-    }
-    snapshot->set_id(InstructionsToSnapshotId(blob));
-    if (!NormalizeSnapshot(snapshot.value(), &args.counters)) {
-      continue;
-    }
-    RewriteInitialState(snapshot.value(), &args.counters);
-    const FixupSnapshotOptions options;
-    auto remade_snapshot_or =
-        FixupSnapshot(snapshot.value(), options, &platform_counters);
-    if (!remade_snapshot_or.ok()) {
-      continue;
-    }
-    // Snaps need to be snapified before GenerateRelocatableSnaps.
-    // If they are not, executable pages may not be RLE compressed.
-    remade_snapshot_or =
-        Snapify(remade_snapshot_or.value(),
-                SnapifyOptions::V2InputRunOpts(snapshot->architecture_id()));
-    if (!remade_snapshot_or.ok()) {
-      continue;
+      const absl::Time blob_start = absl::Now();
+      std::optional<Snapshot> snapshot = MakeSnapshotFromBlob(
+          (*args.blobs)[i], args.counters, platform_counters);
+      args.counters.RecordTiming("FixToolWorker:total",
+                                 absl::Now() - blob_start);
+      if (snapshot.has_value()) {
+        args.good_snapshots.emplace_back(i, std::move(snapshot.value()));
+      }
     }
-    args.good_snapshots.push_back(std::move(remade_snapshot_or.value()));
-    args.counters.Increment("silifuzz-INFO-FixToolWorker:success");
   }
 
   num_blobs_processed.fetch_add(count_update);
@@ -147,6 +289,134 @@ void MakeProgressMonitor(size_t num_blobs, std::atomic<bool>& stop) {
   }
 }
 
+// Compression preset of output corpora. Same as the xz command line tool.
+constexpr uint32_t kXzPreset = LZMA_PRESET_DEFAULT;
+
+// Size of blocks compressed independently by multithreaded xz. Smaller blocks
+// allow more parallelism but compress slightly worse.
+constexpr uint64_t kXzBlockSize = 16 << 20;
+
+// Size of output chunks written by the xz encoder.
+constexpr size_t kXzChunkSize = 1 << 20;
+
+// Writes `data` xz compressed to `fd` using up to `num_threads` threads.
+absl::Status WriteXzCompressed(absl::string_view data, int fd,
+                               uint32_t num_threads) {
+  // The multithreaded encoder compresses blocks in parallel, so there is no
+  // point in using more threads than there are blocks.
+  const uint64_t num_blocks = (data.size() + kXzBlockSize - 1) / kXzBlockSize;
+  num_threads = std::min<uint64_t>(num_threads, num_blocks);
+  lzma_stream stream = LZMA_STREAM_INIT;
+  lzma_ret ret;
+  if (num_threads > 1) {
+    lzma_mt mt = {};
+    mt.threads = num_threads;
+    mt.block_size = kXzBlockSize;
+    mt.preset = kXzPreset;
+    mt.check = LZMA_CHECK_CRC64;
+    ret = lzma_stream_encoder_mt(&stream, &mt);
+  } else {
+    ret = lzma_easy_encoder(&stream, kXzPreset, LZMA_CHECK_CRC64);
+  }
+  if (ret != LZMA_OK) {
+    return absl::InternalError(
+        absl::StrCat("Failed to initialize encoder, return code = ", ret));
+  }
+  absl::Cleanup end_stream([&stream] { lzma_end(&stream); });
+
+  stream.next_in = reinterpret_cast<const uint8_t*>(data.data());
+  stream.avail_in = data.size();
+  std::vector<uint8_t> output_buffer(kXzChunkSize);
+  do {
+    stream.next_out = output_buffer.data();
+    stream.avail_out = output_buffer.size();
+    ret = lzma_code(&stream, LZMA_FINISH);
+    if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+      return absl::InternalError(
+          absl::StrCat("Failed to compress data, lzma code = ", ret));
+    }
+    const absl::string_view chunk(
+        reinterpret_cast<const char*>(output_buffer.data()),
+        output_buffer.size() - stream.avail_out);
+    if (!WriteToFileDescriptor(fd, chunk)) {
+      return absl::InternalError("WriteToFileDescriptor failed");
+    }
+  } while (ret != LZMA_STREAM_END);
+  return absl::OkStatus();
+}
+
+// Statistics of writing a single output shard.
+struct ShardWriteReport {
+  // Sizes of the relocatable corpus and of the output file.
+  uint64_t corpus_bytes = 0;
+  uint64_t file_bytes = 0;
+  absl::Duration generate_time;
+  absl::Duration compress_time;
+  bool ok = false;
+};
+
+// Writes `shard` as a relocatable corpus to `file_name`, xz compressed if
+// requested by `options`. The compressor uses up to `xz_threads` threads.
+// Returns statistics of the shard. Updates `counters`.
+ShardWriteReport WriteOutputFile(const SimpleFixToolOptions& options,
+                                 const std::vector<Snapshot>& shard,
+                                 const std::string& file_name,
+                                 uint32_t xz_threads,
+                                 SimpleFixToolCounters& counters) {
+  ShardWriteReport report;
+  const absl::Time start = absl::Now();
+  // The corpus is generated directly in the file if it is not compressed, so
+  // the file needs to be readable as well.
+  const int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    counters.Increment("silifuzz-ERROR-Output:open-failed");
+    return report;
+  }
+
+  absl::flat_hash_map<std::string, uint64_t> generator_counters;
+  const RelocatableSnapGeneratorOptions generator_options = {
+      .share_read_only_pages = options.share_read_only_pages,
+      .counters = &generator_counters};
+  absl::Status status;
+  if (options.compress_output) {
+    const MmappedMemoryPtr<char> relocatable = GenerateRelocatableSnaps(
+        Host::architecture_id, shard, generator_options);
+    const absl::Time compress_start = absl::Now();
+    report.generate_time = compress_start - start;
+    status = WriteXzCompressed(
+        absl::string_view(relocatable.get(), MmappedMemorySize(relocatable)),
+        fd, xz_threads);
+    report.compress_time = absl::Now() - compress_start;
+  } else {
+    SnapshotVectorSource source(shard);
+    status = GenerateRelocatableSnapsToFile(Host::architecture_id, source, fd,
+                                            generator_options);
+    report.generate_time = absl::Now() - start;
+  }
+  struct stat st;
+  if (status.ok() && fstat(fd, &st) == 0) {
+    report.file_bytes = st.st_size;
+  }
+  if (close(fd) != 0 || !status.ok()) {
+    counters.Increment("silifuzz-ERROR-Output:write-failed.");
+    return report;
+  }
+
+  report.ok = true;
+  report.corpus_bytes = generator_counters["main_block"];
+  counters.IncrementBy("silifuzz-INFO-Output:corpus-bytes",
+                       report.corpus_bytes);
+  counters.IncrementBy("silifuzz-INFO-Output:file-bytes", report.file_bytes);
+  counters.IncrementBy("silifuzz-INFO-Output:runner-private-bytes",
+                       generator_counters["runner_private_bytes"]);
+  counters.RecordTiming("Output:generate", report.generate_time);
+  if (options.compress_output) {
+    counters.RecordTiming("Output:compress", report.compress_time);
+  }
+  counters.RecordTiming("Output:total", absl::Now() - start);
+  return report;
+}
+
 }  // namespace
 
 std::vector<std::string> ReadUniqueCentipedeBlobs(
@@ -198,8 +468,7 @@ std::vector<Snapshot> MakeSnapshotsFromBlobs(
   const size_t num_workers = options.parallelism
                                  ? options.parallelism
                                  : std::thread::hardware_concurrency();
-  const std::vector<absl::Span<const std::string>> blob_spans =
-      PartitionEvenly(blobs, num_workers);
+  BlobScheduler scheduler(blobs.size(), num_workers);
 
   // Start progress monitor.
   std::atomic<bool> stop_progress_monitor = false;
@@ -212,7 +481,9 @@ std::vector<Snapshot> MakeSnapshotsFromBlobs(
   for (size_t i = 0; i < num_workers; ++i) {
     FixToolWorkerArgs args;
     args.options = &options;
-    args.blobs = blob_spans[i];
+    args.worker_index = i;
+    args.scheduler = &scheduler;
+    args.blobs = &blobs;
     worker_args.push_back(std::move(args));
   }
 
@@ -232,14 +503,24 @@ std::vector<Snapshot> MakeSnapshotsFromBlobs(
     num_good_snapshots += worker_args[i].good_snapshots.size();
   }
 
-  // Collect made snapshots and bad snapshot id.
-  std::vector<Snapshot> made_snapshots;
-  made_snapshots.reserve(num_good_snapshots);
+  // Collect made snapshots. Which worker makes a blob depends on timing,
+  // so restore the order of blobs to keep output deterministic.
+  std::vector<std::pair<size_t, Snapshot>> indexed_snapshots;
+  indexed_snapshots.reserve(num_good_snapshots);
   for (auto& work_arg : worker_args) {
     std::move(work_arg.good_snapshots.begin(), work_arg.good_snapshots.end(),
-              std::back_inserter(made_snapshots));
+              std::back_inserter(indexed_snapshots));
     work_arg.good_snapshots.clear();
   }
+  std::sort(indexed_snapshots.begin(), indexed_snapshots.end(),
+            [](const auto& lhs, const auto& rhs) {
+              return lhs.first < rhs.first;
+            });
+  std::vector<Snapshot> made_snapshots;
+  made_snapshots.reserve(num_good_snapshots);
+  for (auto& [_, snapshot] : indexed_snapshots) {
+    made_snapshots.push_back(std::move(snapshot));
+  }
 
   stop_progress_monitor.store(true);
   progress_monitor.join();
@@ -295,24 +576,51 @@ std::vector<std::vector<Snapshot>> PartitionSnapshots(
   return groups;
 }
 
-void WriteOutputFiles(const std::vector<std::vector<Snapshot>>& shards,
+void WriteOutputFiles(const SimpleFixToolOptions& options,
+                      const std::vector<std::vector<Snapshot>>& shards,
                       absl::string_view output_path_prefix,
                       SimpleFixToolCounters* counters) {
-  for (int i = 0; i < shards.size(); ++i) {
-    auto relocatable =
-        GenerateRelocatableSnaps(Host::architecture_id, shards[i]);
-    const std::string file_name =
-        absl::StrFormat("%s.%05d", output_path_prefix, i);
-    std::ofstream os(file_name);
-    if (!os.is_open()) {
-      counters->Increment("silifuzz-ERROR-Output:open-failed");
-      continue;
-    }
-    os.write(relocatable.get(), MmappedMemorySize(relocatable));
-    if (os.fail()) {
-      counters->Increment("silifuzz-ERROR-Output:write-failed.");
-    }
-    os.close();
+  if (shards.empty()) return;
+  const size_t parallelism = std::max<size_t>(
+      options.parallelism ? options.parallelism
+                          : std::thread::hardware_concurrency(),
+      1);
+  // Shards are independent. Threads not needed for shards are left to the
+  // xz encoders.
+  const size_t num_workers = std::min(parallelism, shards.size());
+  const uint32_t xz_threads = parallelism / num_workers;
+
+  std::atomic<size_t> next_shard = 0;
+  std::vector<ShardWriteReport> reports(shards.size());
+  std::vector<SimpleFixToolCounters> worker_counters(num_workers);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&, i] {
+      for (size_t shard = next_shard.fetch_add(1); shard < shards.size();
+           shard = next_shard.fetch_add(1)) {
+        const std::string file_name = absl::StrFormat(
+            "%s.%05d%s", output_path_prefix, shard,
+            options.compress_output ? ".xz" : "");
+        reports[shard] = WriteOutputFile(options, shards[shard], file_name,
+                                         xz_threads, worker_counters[i]);
+      }
+    });
+  }
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers[i].join();
+    counters->Merge(worker_counters[i]);
+  }
+
+  // Report per-shard timings in shard order.
+  for (size_t i = 0; i < shards.size(); ++i) {
+    const ShardWriteReport& report = reports[i];
+    std::cout << absl::StrFormat(
+        "Output shard %05d: %d snapshots, %d bytes, %d bytes written, "
+        "generated in %s, compressed in %s%s\n",
+        i, shards[i].size(), report.corpus_bytes, report.file_bytes,
+        absl::FormatDuration(report.generate_time),
+        absl::FormatDuration(report.compress_time),
+        report.ok ? "" : " (failed)");
   }
 }
 
@@ -334,7 +642,7 @@ void FixupCorpus(const SimpleFixToolOptions& options,
                         made_snapshots.size());
   made_snapshots.clear();  // discard any left-over snapshots.
 
-  WriteOutputFiles(shards, output_path_prefix, counters);
+  WriteOutputFiles(options, shards, output_path_prefix, counters);
 }
 
 }  // namespace silifuzz
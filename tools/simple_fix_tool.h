@@ -57,6 +57,17 @@ struct SimpleFixToolOptions {
   // If true, tracer injects a signal when an instruction accesses memory. This
   // has no effect on non-x86 platforms.
   bool filter_memory_access = false;
+
+  // If true, output corpora store read-only pages so that runners can share
+  // them. See RelocatableSnapGeneratorOptions::share_read_only_pages.
+  // Off by default: like SnapifyOptions::support_direct_mmap on x86_64 (see
+  // snap_generator.h), it makes the corpus larger and its size and speed
+  // trade-off has not been measured yet.
+  bool share_read_only_pages = false;
+
+  // If true, output corpus shards are xz compressed and their file names end
+  // with ".xz".
+  bool compress_output = false;
 };
 
 // Converts raw instructions blobs in `inputs` into snapshots of the
@@ -98,10 +109,13 @@ std::vector<std::vector<Snapshot>> PartitionSnapshots(
     const SimpleFixToolOptions& options, int num_groups,
     std::vector<Snapshot>& snapshots);
 
-// Writes snapshots in `shards` into relocatable corpora. Each corpus has
-// a path `output_path_prefix` + '.' + <shard index>. Updates fix tool
-// statistics in `counters`.
-void WriteOutputFiles(const std::vector<std::vector<Snapshot>>& shards,
+// Writes snapshots in `shards` into relocatable corpora using `options`. Each
+// corpus has a path `output_path_prefix` + '.' + <shard index>, followed by
+// ".xz" if the output is compressed. Shards are written in parallel using up
+// to `options.parallelism` threads and a per-shard report is printed to
+// stdout. Updates fix tool statistics in `counters`.
+void WriteOutputFiles(const SimpleFixToolOptions& options,
+                      const std::vector<std::vector<Snapshot>>& shards,
                       absl::string_view output_path_prefix,
                       SimpleFixToolCounters* counters);
 
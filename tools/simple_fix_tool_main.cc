@@ -20,6 +20,8 @@
 //   simple_fix_tool_main [optional flags] <corpus_0> .. <corpus_n>
 //
 // To list flags, use simple_fix_tool_main --help.
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -54,6 +56,16 @@ ABSL_FLAG(bool, x86_filter_vsyscall_region_access, true,
 ABSL_FLAG(bool, filter_memory_access, false,
           "Filter snaps with memory accesses Currently x86-only.");
 
+ABSL_FLAG(bool, share_read_only_pages, false,
+          "Store read-only pages in the output corpus so that runners can map "
+          "them directly from the corpus file and share them. This makes the "
+          "corpus larger but reduces the memory used by each runner. "
+          "Experimental.");
+
+ABSL_FLAG(bool, compress_output, false,
+          "xz compress output corpus shards. Compressed shards have a .xz "
+          "suffix.");
+
 namespace silifuzz {
 namespace {
 
@@ -79,6 +91,8 @@ int SimpleFixToolMain(int argc, char* argv[]) {
   options.x86_filter_vsyscall_region_access =
       absl::GetFlag(FLAGS_x86_filter_vsyscall_region_access);
   options.filter_memory_access = absl::GetFlag(FLAGS_filter_memory_access);
+  options.share_read_only_pages = absl::GetFlag(FLAGS_share_read_only_pages);
+  options.compress_output = absl::GetFlag(FLAGS_compress_output);
 
   fix_tool_internal::SimpleFixToolCounters counters;
   FixupCorpus(options, inputs, absl::GetFlag(FLAGS_output_path_prefix),
@@ -91,6 +105,20 @@ int SimpleFixToolMain(int argc, char* argv[]) {
     LOG_INFO(counter_name, " ", counters.GetValue(counter_name));
   }
 
+  // Dump timing histograms. Only non-empty buckets are shown.
+  std::vector<std::string> histogram_names = counters.GetHistogramNames();
+  std::sort(histogram_names.begin(), histogram_names.end());
+  for (const std::string& histogram_name : histogram_names) {
+    const auto* histogram = counters.GetHistogram(histogram_name);
+    LOG_INFO(histogram_name, " count ", histogram->count, " total_usec ",
+             histogram->sum_usec, " max_usec ", histogram->max_usec);
+    for (size_t i = 0; i < histogram->buckets.size(); ++i) {
+      if (histogram->buckets[i] == 0) continue;
+      LOG_INFO(histogram_name, " <", int64_t{1} << i, "us ",
+               histogram->buckets[i]);
+    }
+  }
+
   return EXIT_SUCCESS;
 }
 
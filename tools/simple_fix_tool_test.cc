@@ -19,6 +19,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <cstring>
 #include <filesystem>  // NOLINT(build/c++17)
 #include <memory>
 #include <string>
@@ -29,12 +30,14 @@
 #include "gtest/gtest.h"
 #include "absl/cleanup/cleanup.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "external/com_google_fuzztest/centipede/blob_file.h"
 #include "./common/snapshot.h"
+#include "./orchestrator/corpus_util.h"
 #include "./snap/snap.h"
 #include "./snap/snap_relocator.h"
 #include "./tool_libs/simple_fix_tool_counters.h"
@@ -195,6 +198,56 @@ TEST(SimpleFixTool, FixCorpus) {
   // corpus.
   EXPECT_EQ(num_snaps, kNumBlobFiles * kNumBlobsPerFile);
 }
+
+// Shards are written in parallel and xz compressed.
+TEST(SimpleFixTool, FixCorpusCompressed) {
+  constexpr int kNumBlobs = 12;
+  std::string insns;
+  std::vector<std::string> blobs;
+  const std::string nop = GetNOP();
+  for (int i = 0; i < kNumBlobs; ++i, insns += nop) {
+    blobs.push_back(insns);
+  }
+  ASSERT_OK_AND_ASSIGN(const std::string blob_file, CreateTempBlobFile(blobs));
+  absl::Cleanup remove_blob_file =
+      absl::MakeCleanup([&blob_file] { std::filesystem::remove(blob_file); });
+
+  const std::string output_path_prefix = absl::StrCat(
+      Dirname(blob_file), "/simple_fix_tool_compressed_test-", getpid());
+  constexpr int kNumShards = 4;
+  auto shard_file_name = [&output_path_prefix](int i) {
+    return absl::StrFormat("%s.%05d.xz", output_path_prefix, i);
+  };
+  absl::Cleanup delete_output_files = absl::MakeCleanup([&shard_file_name] {
+    for (int i = 0; i < kNumShards; ++i) {
+      std::filesystem::remove(shard_file_name(i));
+    }
+  });
+
+  SimpleFixToolOptions options;
+  options.parallelism = 2;
+  options.compress_output = true;
+  fix_tool_internal::SimpleFixToolCounters counters;
+  FixupCorpus(options, {blob_file}, output_path_prefix, kNumShards, &counters);
+  EXPECT_GT(counters.GetValue("silifuzz-INFO-Output:corpus-bytes"), 0);
+  EXPECT_EQ(counters.GetHistogram("Output:compress")->count, kNumShards);
+
+  int num_snaps = 0;
+  for (int i = 0; i < kNumShards; ++i) {
+    ASSERT_OK_AND_ASSIGN(const absl::Cord contents,
+                         ReadXzipFile(shard_file_name(i)));
+    const std::string data(contents);
+    auto relocatable = AllocateMmappedBuffer<char>(data.size());
+    memcpy(relocatable.get(), data.data(), data.size());
+    SnapRelocatorError error;
+    MmappedMemoryPtr<const SnapCorpus<Host>> corpus =
+        SnapRelocator<Host>::RelocateCorpus(std::move(relocatable), true,
+                                            &error);
+    ASSERT_TRUE(error == SnapRelocatorError::kOk);
+    num_snaps += corpus->snaps.size;
+  }
+  EXPECT_EQ(num_snaps, kNumBlobs);
+}
 }  // namespace
 
 }  // namespace silifuzz
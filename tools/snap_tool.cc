@@ -19,6 +19,7 @@
 #include <unistd.h>
 
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <string>
@@ -51,7 +52,6 @@
 #include "./util/file_util.h"
 #include "./util/itoa.h"
 #include "./util/line_printer.h"
-#include "./util/mmapped_memory_ptr.h"
 #include "./util/platform.h"
 #include "./util/tool_util.h"
 #include "./util/ucontext/serialize.h"
@@ -149,6 +149,57 @@ absl::StatusOr<Snapshot> LoadSnapshot(absl::string_view filename, bool raw) {
              : ReadSnapshotFromFile(filename);
 }
 
+// A SnapshotSource that reads snapshots from files and snapifies them one
+// at a time. Snapshots that cannot be snapified are skipped.
+class SnapifiedFileSource : public SnapshotSource {
+ public:
+  SnapifiedFileSource(const std::vector<std::string>& paths, bool raw,
+                      const SnapifyOptions& opts, LinePrinter* line_printer)
+      : paths_(paths), raw_(raw), opts_(opts), line_printer_(line_printer) {}
+
+  absl::Status Rewind() override {
+    ++num_passes_;
+    next_ = 0;
+    num_snapshots_ = 0;
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<const Snapshot*> Next() override {
+    while (next_ < paths_.size()) {
+      const std::string& path = paths_[next_++];
+      ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(auto snapshot, LoadSnapshot(path, raw_),
+                                      "Cannot read snapshot");
+      auto snapified_or = Snapify(snapshot, opts_);
+      if (!snapified_or.ok()) {
+        // Only report skipped snapshots once.
+        if (num_passes_ == 1) {
+          line_printer_->Line("Skipping ", path, ": ",
+                              snapified_or.status().message());
+        }
+        continue;
+      }
+      current_ = std::move(snapified_or).value();
+      ++num_snapshots_;
+      return &current_.value();
+    }
+    // Fail the first (layout) pass, before any output is written.
+    if (num_snapshots_ == 0) {
+      return absl::InvalidArgumentError("No usable Snapshots found");
+    }
+    return nullptr;
+  }
+
+ private:
+  const std::vector<std::string>& paths_;
+  const bool raw_;
+  const SnapifyOptions opts_;
+  LinePrinter* line_printer_;
+  size_t next_ = 0;
+  int num_passes_ = 0;
+  size_t num_snapshots_ = 0;
+  std::optional<Snapshot> current_;
+};
+
 // Implements `generate_corpus` command.
 absl::Status GenerateCorpus(const std::vector<std::string>& input_protos,
                             bool raw, PlatformId platform_id, int out_fd,
@@ -161,33 +212,13 @@ absl::Status GenerateCorpus(const std::vector<std::string>& input_protos,
   SnapifyOptions opts = SnapifyOptions::V2InputRunOpts(arch_id);
   opts.platform_id = platform_id;
 
-  std::vector<Snapshot> snapified_corpus;
-
-  for (const std::string& proto_path : input_protos) {
-    ASSIGN_OR_RETURN_IF_NOT_OK_PLUS(
-        auto snapshot, LoadSnapshot(proto_path, raw), "Cannot read snapshot");
-    auto snapified_or = Snapify(snapshot, opts);
-    if (!snapified_or.ok()) {
-      line_printer->Line("Skipping ", proto_path, ": ",
-                         snapified_or.status().message());
-      continue;
-    }
-    snapified_corpus.push_back(std::move(snapified_or).value());
-  }
-  if (snapified_corpus.empty()) {
-    return absl::InvalidArgumentError("No usable Snapshots found");
-  }
-
   // TODO(ksteuck): Call PartitionSnapshots() to ensure there are no conflicts.
 
+  // Snapshots are read one at a time so that large corpora do not need to
+  // fit in memory.
+  SnapifiedFileSource source(input_protos, raw, opts, line_printer);
   RelocatableSnapGeneratorOptions options;
-  MmappedMemoryPtr<char> buffer =
-      GenerateRelocatableSnaps(arch_id, snapified_corpus, options);
-  absl::string_view buf(buffer.get(), MmappedMemorySize(buffer));
-  if (!WriteToFileDescriptor(out_fd, buf)) {
-    return absl::InternalError("WriteToFileDescriptor failed");
-  }
-  return absl::OkStatus();
+  return GenerateRelocatableSnapsToFile(arch_id, source, out_fd, options);
 }
 
 absl::Status GetInstructions(const Snapshot& snapshot, int out_fd) {
@@ -247,7 +278,8 @@ absl::StatusOr<Snapshot> SetInstructionPointerImpl(const Snapshot& snapshot,
 absl::StatusOr<int> OpenOutput() {
   std::optional<std::string> out = absl::GetFlag(FLAGS_out);
   if (out.has_value()) {
-    int fd = open(out.value().c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+    // Read access lets generate_corpus generate the corpus in place.
+    int fd = open(out.value().c_str(), O_RDWR | O_CREAT | O_TRUNC,
                   S_IRUSR | S_IWUSR);
     if (fd == -1) {
       return absl::UnknownError(
@@ -15,10 +15,17 @@
 #include "./tracing/analysis.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "./tracing/execution_trace.h"
 #include "./tracing/unicorn_tracer.h"
 #include "./util/checks.h"
@@ -56,38 +63,178 @@ absl::Status TraceSnippetWithSkip(const std::string& instructions,
   return absl::OkStatus();
 }
 
+// Runs fault injection trials from checkpoints of the reference execution.
+// A single tracer is initialized once and advanced through the reference
+// execution one checkpoint at a time. Each trial resumes from the current
+// checkpoint and the tracer is rolled back to the checkpoint afterwards.
+// Checkpoints can only move forward, so trials must be run in increasing order.
+template <typename Arch>
+class CheckpointedTrialRunner {
+ public:
+  CheckpointedTrialRunner() = default;
+
+  // Not movable or copyable. The tracer's callback refers to `this`.
+  CheckpointedTrialRunner(const CheckpointedTrialRunner&) = delete;
+  CheckpointedTrialRunner& operator=(const CheckpointedTrialRunner&) = delete;
+
+  absl::Status Init(const std::string& instructions) {
+    RETURN_IF_NOT_OK(tracer_.InitSnippet(instructions));
+    tracer_.SetInstructionCallback(
+        [this](UnicornTracer<Arch>* tracer, uint64_t address, size_t max_size) {
+          if (instructions_executed_ == skip_) {
+            tracer->SetCurrentInstructionPointer(address + max_size);
+          }
+          instructions_executed_++;
+        });
+    tracer_.SaveCheckpoint();
+    checkpoint_ = 0;
+    return absl::OkStatus();
+  }
+
+  size_t checkpoint() const { return checkpoint_; }
+
+  // Advance the checkpoint to just before the instruction `index` of the
+  // reference execution. `expected_address` is the address of that
+  // instruction, used to validate the checkpoint.
+  // REQUIRES: index >= checkpoint()
+  absl::Status AdvanceTo(size_t index, uint64_t expected_address) {
+    CHECK_GE(index, checkpoint_);
+    if (index == checkpoint_) return absl::OkStatus();
+    skip_ = kNoSkip;
+    RETURN_IF_NOT_OK(tracer_.Step(index - checkpoint_));
+    if (tracer_.GetCurrentInstructionPointer() != expected_address) {
+      return absl::InternalError(
+          absl::StrCat("checkpoint ", index, " diverged from the trace"));
+    }
+    tracer_.SaveCheckpoint();
+    checkpoint_ = index;
+    return absl::OkStatus();
+  }
+
+  // Equivalent to TraceSnippetWithSkip() for `skip` >= checkpoint().
+  absl::Status RunTrial(size_t max_instructions, size_t skip,
+                        UContext<Arch>& ucontext, uint32_t& memory_checksum) {
+    CHECK_GE(skip, checkpoint_);
+    skip_ = skip - checkpoint_;
+    instructions_executed_ = 0;
+    absl::Status status = tracer_.Resume(max_instructions - checkpoint_);
+    tracer_.GetRegisters(ucontext);
+    memory_checksum = tracer_.PartialChecksumOfMutableMemory();
+    tracer_.RestoreCheckpoint();
+    return status;
+  }
+
+ private:
+  static constexpr size_t kNoSkip = ~size_t{0};
+
+  UnicornTracer<Arch> tracer_;
+  size_t checkpoint_ = 0;
+  size_t skip_ = kNoSkip;
+  size_t instructions_executed_ = 0;
+};
+
 }  // namespace
 
 template <typename Arch>
 absl::StatusOr<FaultInjectionResult> AnalyzeSnippetWithFaultInjection(
     const std::string& instructions, ExecutionTrace<Arch>& execution_trace,
-    uint32_t expected_memory_checksum) {
-  size_t expected_instructions_executed = execution_trace.NumInstructions();
-  UContext<Arch> expected_ucontext = execution_trace.LastContext();
+    uint32_t expected_memory_checksum, const FaultInjectionOptions& options) {
+  const size_t expected_instructions_executed =
+      execution_trace.NumInstructions();
+  const size_t max_instructions = execution_trace.MaxInstructions();
+  const UContext<Arch> expected_ucontext = execution_trace.LastContext();
+
+  // Trials are handed out in chunks, one per checkpoint, in increasing order.
+  // Without checkpoints every trial is independent.
+  const bool use_checkpoints = options.checkpoint_interval > 0;
+  const size_t chunk_size = use_checkpoints ? options.checkpoint_interval : 1;
+  const size_t num_chunks =
+      (expected_instructions_executed + chunk_size - 1) / chunk_size;
+  // Instruction addresses of the reference execution, used to validate
+  // checkpoints. Copied so that worker threads do not touch the trace.
+  std::vector<uint64_t> addresses(expected_instructions_executed);
+  for (size_t i = 0; i < expected_instructions_executed; ++i) {
+    addresses[i] = execution_trace.Info(i).address;
+  }
+
+  // Not std::vector<bool>: worker threads write disjoint elements.
+  std::vector<char> fault_detected(expected_instructions_executed, false);
+  std::atomic<size_t> next_chunk = 0;
+  std::atomic<size_t> num_trials_done = 0;
 
   // See if skipping an instruction results in a different outcome.
-  size_t num_faults_detected = 0;
-  for (size_t skip = 0; skip < expected_instructions_executed; ++skip) {
-    if (skip % 100 == 0) {
-      VLOG_INFO(1, 100 * skip / expected_instructions_executed, "%");
+  auto worker = [&]() {
+    std::unique_ptr<CheckpointedTrialRunner<Arch>> runner;
+    for (size_t chunk = next_chunk++; chunk < num_chunks;
+         chunk = next_chunk++) {
+      const size_t begin = chunk * chunk_size;
+      const size_t end =
+          std::min(begin + chunk_size, expected_instructions_executed);
+
+      if (use_checkpoints) {
+        absl::Status status;
+        if (runner == nullptr) {
+          runner = std::make_unique<CheckpointedTrialRunner<Arch>>();
+          status = runner->Init(instructions);
+        }
+        if (status.ok()) {
+          status = runner->AdvanceTo(begin, addresses[begin]);
+        }
+        if (!status.ok()) {
+          // Should not happen, the reference execution is deterministic. Fall
+          // back to running the trials of this chunk from scratch.
+          VLOG_INFO(1, "Cannot checkpoint at ", begin, ": ", status.message());
+          runner.reset();
+        }
+      }
+
+      for (size_t skip = begin; skip < end; ++skip) {
+        if (skip % 100 == 0) {
+          VLOG_INFO(1, 100 * num_trials_done / expected_instructions_executed,
+                    "%");
+        }
+        size_t instructions_executed = 0;
+        uint32_t actual_memory_checksum = 0;
+        UContext<Arch> ucontext;
+        absl::Status status =
+            runner != nullptr
+                ? runner->RunTrial(max_instructions, skip, ucontext,
+                                   actual_memory_checksum)
+                : TraceSnippetWithSkip(instructions, max_instructions, skip,
+                                       instructions_executed, ucontext,
+                                       actual_memory_checksum);
+        // If the status is not OK, this indicates the trace did not behave
+        // like a valid Silifuzz test - it segfaulted, got stuck in an infinite
+        // loop, or similar. Because the unmodified trace as OK, this indicates
+        // the injected fault changed the behavior in a detectible way.
+        // TODO(ncbray): compare memory.
+        fault_detected[skip] =
+            !status.ok() || ucontext.gregs != expected_ucontext.gregs ||
+            ucontext.fpregs != expected_ucontext.fpregs ||
+            actual_memory_checksum != expected_memory_checksum;
+        num_trials_done++;
+      }
     }
-    size_t instructions_executed = 0;
-    uint32_t actual_memory_checksum = 0;
-    UContext<Arch> ucontext;
-    absl::Status status = TraceSnippetWithSkip(
-        instructions, execution_trace.MaxInstructions(), skip,
-        instructions_executed, ucontext, actual_memory_checksum);
-    // If the status is not OK, this indicates the trace did not behave like a
-    // valid Silifuzz test - it segfaulted, got stuck in an infinite loop, or
-    // similar. Because the unmodified trace as OK, this indicates the injected
-    // fault changed the behavior in a detectible way.
-    // TODO(ncbray): compare memory.
-    bool fault_detected = !status.ok() ||
-                          ucontext.gregs != expected_ucontext.gregs ||
-                          ucontext.fpregs != expected_ucontext.fpregs ||
-                          actual_memory_checksum != expected_memory_checksum;
-    execution_trace.Info(skip).critical = fault_detected;
-    if (fault_detected) {
+  };
+
+  size_t num_threads = options.num_threads > 0
+                           ? options.num_threads
+                           : std::thread::hardware_concurrency();
+  num_threads =
+      std::clamp<size_t>(num_threads, 1, std::max(num_chunks, size_t{1}));
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  size_t num_faults_detected = 0;
+  for (size_t i = 0; i < expected_instructions_executed; ++i) {
+    execution_trace.Info(i).critical = fault_detected[i];
+    if (fault_detected[i]) {
       num_faults_detected++;
     }
   }
@@ -96,7 +243,7 @@ absl::StatusOr<FaultInjectionResult> AnalyzeSnippetWithFaultInjection(
       .fault_injection_count = expected_instructions_executed,
       .fault_detection_count = num_faults_detected,
       .sensitivity = static_cast<float>(num_faults_detected) /
-                     std::max(expected_instructions_executed, 1UL),
+                     std::max(expected_instructions_executed, size_t{1}),
   };
 }
 
@@ -104,10 +251,10 @@ absl::StatusOr<FaultInjectionResult> AnalyzeSnippetWithFaultInjection(
 template absl::StatusOr<FaultInjectionResult>
 AnalyzeSnippetWithFaultInjection<X86_64>(
     const std::string& instructions, ExecutionTrace<X86_64>& execution_trace,
-    uint32_t expected_memory_checksum);
+    uint32_t expected_memory_checksum, const FaultInjectionOptions& options);
 template absl::StatusOr<FaultInjectionResult>
 AnalyzeSnippetWithFaultInjection<AArch64>(
     const std::string& instructions, ExecutionTrace<AArch64>& execution_trace,
-    uint32_t expected_memory_checksum);
+    uint32_t expected_memory_checksum, const FaultInjectionOptions& options);
 
 }  // namespace silifuzz
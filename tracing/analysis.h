@@ -32,6 +32,17 @@ struct FaultInjectionResult {
   float sensitivity;
 };
 
+struct FaultInjectionOptions {
+  // Number of instructions between checkpoints of the reference execution.
+  // Every fault injection trial resumes from the checkpoint preceding the
+  // faulted instruction rather than re-executing the snippet from the start.
+  // 0 disables checkpointing and runs every trial in a fresh tracer.
+  size_t checkpoint_interval = 64;
+
+  // Number of threads running trials. 0 means one per hardware thread.
+  size_t num_threads = 0;
+};
+
 // Perform fault analysis on the snippet `instructions`.
 // `execution_trace` must contain a valid trace. If this function is successful,
 // the trace is annotated with which instructions were critical in detecting
@@ -41,7 +52,8 @@ struct FaultInjectionResult {
 template <typename Arch>
 absl::StatusOr<FaultInjectionResult> AnalyzeSnippetWithFaultInjection(
     const std::string& instructions, ExecutionTrace<Arch>& execution_trace,
-    uint32_t expected_memory_checksum);
+    uint32_t expected_memory_checksum,
+    const FaultInjectionOptions& options = {});
 
 }  // namespace silifuzz
 
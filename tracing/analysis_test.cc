@@ -0,0 +1,143 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./tracing/analysis.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "./instruction/default_disassembler.h"
+#include "./tracing/execution_trace.h"
+#include "./tracing/unicorn_tracer.h"
+#include "./util/arch.h"
+#include "./util/checks.h"
+#include "./util/testing/status_matchers.h"
+#include "./util/ucontext/ucontext_types.h"
+
+namespace silifuzz {
+
+namespace {
+
+using silifuzz::testing::IsOk;
+
+// A snippet in which skipping some instructions changes the end state and
+// skipping others does not, either because their effect is overwritten or
+// because they do nothing. One instruction only changes memory.
+template <typename Arch>
+std::string MixedSnippet();
+
+template <>
+std::string MixedSnippet<X86_64>() {
+  constexpr char kSnippet[] =
+      "\x48\x83\xc2\x02"                      // add $2, %rdx
+      "\x48\x83\xc1\x03"                      // add $3, %rcx
+      "\x31\xc9"                              // xor %ecx, %ecx
+      "\x48\xc7\x44\x24\x08\x34\x12\x00\x00"  // movq $0x1234, 8(%rsp)
+      "\x49\x83\xc0\x04"                      // add $4, %r8
+      "\x45\x31\xc0"                          // xor %r8d, %r8d
+      "\x48\x83\xc2\x05"                      // add $5, %rdx
+      "\x90";                                 // nop
+  return std::string(kSnippet, sizeof(kSnippet) - 1);
+}
+
+template <>
+std::string MixedSnippet<AArch64>() {
+  constexpr char kSnippet[] =
+      "\x42\x08\x00\x91"   // add x2, x2, #2
+      "\x63\x0c\x00\x91"   // add x3, x3, #3
+      "\xe3\x03\x1f\xaa"   // mov x3, xzr
+      "\x80\x46\x82\xd2"   // mov x0, #0x1234
+      "\xc0\x00\x00\xf9"   // str x0, [x6]
+      "\x84\x10\x00\x91"   // add x4, x4, #4
+      "\xe4\x03\x1f\xaa"   // mov x4, xzr
+      "\x42\x14\x00\x91"   // add x2, x2, #5
+      "\x1f\x20\x03\xd5";  // nop
+  return std::string(kSnippet, sizeof(kSnippet) - 1);
+}
+
+// Result of fault injection and which instructions were found critical.
+struct Analysis {
+  FaultInjectionResult result;
+  std::vector<bool> critical;
+};
+
+template <typename Arch>
+absl::StatusOr<Analysis> Analyze(const std::string& instructions,
+                                 const FaultInjectionOptions& options) {
+  DefaultDisassembler<Arch> disasm;
+  ExecutionTrace<Arch> execution_trace(100);
+  UnicornTracer<Arch> tracer;
+  RETURN_IF_NOT_OK(tracer.InitSnippet(instructions));
+  RETURN_IF_NOT_OK(CaptureTrace(tracer, disasm, execution_trace));
+  const uint32_t checksum = tracer.PartialChecksumOfMutableMemory();
+
+  Analysis analysis;
+  ASSIGN_OR_RETURN_IF_NOT_OK(
+      analysis.result, AnalyzeSnippetWithFaultInjection<Arch>(
+                           instructions, execution_trace, checksum, options));
+  for (size_t i = 0; i < execution_trace.NumInstructions(); ++i) {
+    analysis.critical.push_back(execution_trace.Info(i).critical);
+  }
+  return analysis;
+}
+
+// Typed test boilerplate
+using arch_typelist = ::testing::Types<ALL_ARCH_TYPES>;
+template <class>
+struct AnalysisTest : ::testing::Test {};
+TYPED_TEST_SUITE(AnalysisTest, arch_typelist);
+
+TYPED_TEST(AnalysisTest, CheckpointsAndThreadsDoNotChangeResults) {
+  const std::string instructions = MixedSnippet<TypeParam>();
+
+  // The original algorithm: every trial runs from the start of the snippet in
+  // a fresh tracer on a single thread.
+  absl::StatusOr<Analysis> reference = Analyze<TypeParam>(
+      instructions, {.checkpoint_interval = 0, .num_threads = 1});
+  ASSERT_THAT(reference, IsOk());
+  const size_t num_instructions = reference->critical.size();
+  ASSERT_EQ(reference->result.instruction_count, num_instructions);
+  ASSERT_EQ(reference->result.fault_injection_count, num_instructions);
+  // The snippet exercises both outcomes.
+  EXPECT_GT(reference->result.fault_detection_count, 0);
+  EXPECT_LT(reference->result.fault_detection_count, num_instructions);
+
+  for (size_t checkpoint_interval : {0, 1, 3, 64}) {
+    for (size_t num_threads : {1, 4}) {
+      SCOPED_TRACE(::testing::Message()
+                   << "checkpoint_interval=" << checkpoint_interval
+                   << " num_threads=" << num_threads);
+      absl::StatusOr<Analysis> analysis = Analyze<TypeParam>(
+          instructions, {.checkpoint_interval = checkpoint_interval,
+                         .num_threads = num_threads});
+      ASSERT_THAT(analysis, IsOk());
+      EXPECT_EQ(analysis->critical, reference->critical);
+      EXPECT_EQ(analysis->result.instruction_count,
+                reference->result.instruction_count);
+      EXPECT_EQ(analysis->result.fault_injection_count,
+                reference->result.fault_injection_count);
+      EXPECT_EQ(analysis->result.fault_detection_count,
+                reference->result.fault_detection_count);
+      EXPECT_EQ(analysis->result.sensitivity, reference->result.sensitivity);
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace silifuzz
@@ -48,6 +48,14 @@ ABSL_FLAG(std::optional<std::string>, snippet, std::nullopt,
 ABSL_FLAG(size_t, max_instructions, 0x1000,
           "The maximum number of instructions that should be executed");
 
+ABSL_FLAG(size_t, checkpoint_interval, 64,
+          "Fault injection resumes trials from checkpoints taken every this "
+          "many instructions. 0 disables checkpointing.");
+
+ABSL_FLAG(size_t, threads, 0,
+          "Number of fault injection threads. 0 means one per hardware "
+          "thread.");
+
 namespace silifuzz {
 
 namespace {
@@ -278,9 +286,14 @@ absl::Status AnalyzeSnippet(const std::string& instructions,
   RETURN_IF_NOT_OK(CaptureTrace(tracer, disasm, execution_trace));
   uint32_t checksum = tracer.PartialChecksumOfMutableMemory();
 
-  ASSIGN_OR_RETURN_IF_NOT_OK(FaultInjectionResult result,
-                             AnalyzeSnippetWithFaultInjection<Arch>(
-                                 instructions, execution_trace, checksum));
+  FaultInjectionOptions options{
+      .checkpoint_interval = absl::GetFlag(FLAGS_checkpoint_interval),
+      .num_threads = absl::GetFlag(FLAGS_threads),
+  };
+  ASSIGN_OR_RETURN_IF_NOT_OK(
+      FaultInjectionResult result,
+      AnalyzeSnippetWithFaultInjection<Arch>(instructions, execution_trace,
+                                             checksum, options));
   out.Line("Detected ", result.fault_detection_count, "/",
            result.fault_injection_count, " faults - ",
            static_cast<int>(100 * result.sensitivity), "% sensitive");
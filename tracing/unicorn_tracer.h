@@ -20,19 +20,24 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/crc/crc32c.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "./common/memory_perms.h"
 #include "./common/proxy_config.h"
 #include "./common/raw_insns_util.h"
 #include "./common/snapshot.h"
 #include "./common/snapshot_util.h"
 #include "./tracing/unicorn_util.h"
 #include "./util/arch.h"
+#include "./util/arch_mem.h"
 #include "./util/checks.h"
 #include "./util/itoa.h"
+#include "./util/page_util.h"
 #include "./util/ucontext/ucontext.h"
 #include "third_party/unicorn/unicorn.h"
 
@@ -67,6 +72,11 @@ class UnicornTracer {
   ~UnicornTracer() { Destroy(); }
 
   void Destroy() {
+    if (checkpoint_context_ != nullptr) {
+      uc_context_free(checkpoint_context_);
+      checkpoint_context_ = nullptr;
+      checkpoint_pages_.clear();
+    }
     if (uc_ != nullptr) {
       uc_close(uc_);
       uc_ = nullptr;
@@ -109,6 +119,67 @@ class UnicornTracer {
     return absl::OkStatus();
   }
 
+  // Prepare the tracer to run another code snippet, reusing the Unicorn
+  // engine. The first call behaves like InitSnippet(). Later calls keep the
+  // engine and the memory mappings of `fuzzing_config` and only swap the code
+  // page, restore the pages written by the previous snippet and reset the
+  // registers. This is much cheaper than creating a new engine for every
+  // snippet, which maps and zero-fills all the data regions, and it does not
+  // build a Snapshot for the snippet.
+  // `tracer_config` and `fuzzing_config` must be the same for all calls.
+  // The instruction callback, if any, is cleared.
+  // This uses the checkpoint, so SaveCheckpoint() and RestoreCheckpoint()
+  // should not be used by the caller.
+  absl::Status ResetSnippet(absl::string_view instructions,
+                            const UnicornTracerConfig<Arch>& tracer_config =
+                                UnicornTracerConfig<Arch>{},
+                            const FuzzingConfig<Arch>& fuzzing_config =
+                                DEFAULT_FUZZING_CONFIG<Arch>) {
+    if (uc_ == nullptr) {
+      RETURN_IF_NOT_OK(
+          InitSnippet(instructions, tracer_config, fuzzing_config));
+      SaveCheckpoint();
+      return absl::OkStatus();
+    }
+
+    // Unlike InitSnippet(), do not build a Snapshot. Everything it would hold
+    // other than the code and the registers is already in place, and building
+    // it costs more than setting up the engine.
+    const UContext<Arch> ucontext =
+        GenerateUContextForInstructions(instructions, fuzzing_config);
+    RETURN_IF_NOT_OK(
+        CheckInstructionsForSnapshot(instructions, ucontext, fuzzing_config));
+
+    RestoreCheckpoint();
+    instruction_callback_ = nullptr;
+
+    // Replace the code page. Remapping also drops the code Unicorn translated
+    // for the previous snippet.
+    UNICORN_CHECK(uc_mem_unmap(uc_, start_of_code_, kPageSize));
+    const uint64_t code_address = ucontext.gregs.GetInstructionPointer();
+    MapMemory(code_address, kPageSize, MemoryPermsToUnicorn(MemoryPerms::XR()));
+    // Pad with traps, like InstructionsToSnapshot() does.
+    code_page_.assign(instructions.data(), instructions.size());
+    PadToSizeWithTraps<Arch>(code_page_, kPageSize);
+    UNICORN_CHECK(
+        uc_mem_write(uc_, code_address, code_page_.data(), code_page_.size()));
+
+    // The stack bytes depend on the entry point. See SetupSnippetMemory().
+    std::string stack_bytes = RestoreUContextStackBytes(ucontext.gregs);
+    UNICORN_CHECK(
+        uc_mem_write(uc_, ucontext.gregs.GetStackPointer() - stack_bytes.size(),
+                     stack_bytes.data(), stack_bytes.size()));
+
+    // The checkpoint already holds the state SetInitialRegisters() could not
+    // set with SetRegisters(), which does not depend on the snippet.
+    SetRegisters(ucontext);
+
+    // InstructionsToSnapshot() puts the end point right after the snippet.
+    start_of_code_ = code_address;
+    end_of_code_ = code_address + instructions.size();
+    return absl::OkStatus();
+  }
+
   using InstructionCallback = void(UnicornTracer<Arch>* tracer,
                                    uint64_t address, uint32_t size);
 
@@ -124,53 +195,56 @@ class UnicornTracer {
   // Run the code snippet. Execution will stop after `max_insn_executed`
   // instructions to help avoid infinite loops.
   absl::Status Run(size_t max_insn_executed) {
-    num_instructions_ = 0;
-    max_instructions_ = max_insn_executed;
-    should_be_stopped_ = false;
+    return RunFrom(start_of_code_, max_insn_executed);
+  }
 
-    // Unicorn can hang due to bugs in QEMU.
-    // Halt execution if it exceeds 1 seconds of wall clock time.
-    // This value is arbitrary and may need to be tuned.
-    // We don't want this value to be so small that machine load can easily
-    // cause the deadline to be missed.
-    // We don't want this value to be so large that fault injection will take
-    // forever when we hit a degenerate case.
-    // Empirically, 1 second is about 20x-30x longer than execution takes in the
-    // worst case on an unloaded machine.
-    uint64_t timeout_microseconds = 1000000;
-    uc_err err = uc_emu_start(uc_, start_of_code_, end_of_code_,
-                              timeout_microseconds, 0);
+  // Like Run(), but execution starts at the current instruction pointer rather
+  // than at the beginning of the snippet. Used to continue execution from a
+  // checkpoint reached with Step() or restored with RestoreCheckpoint().
+  absl::Status Resume(size_t max_insn_executed) {
+    return RunFrom(GetCurrentInstructionPointer(), max_insn_executed);
+  }
 
-    // Check if the emulator stopped cleanly.
-    if (err) {
+  // Execute exactly `num_insn` instructions starting at the current
+  // instruction pointer and stop before the next one. Returns an error if the
+  // snippet ends, faults, or times out before that.
+  absl::Status Step(size_t num_insn) {
+    RETURN_IF_NOT_OK(Emulate(GetCurrentInstructionPointer(), num_insn));
+    RETURN_IF_NOT_OK(CheckTimeout());
+    // HookCode() counts the instruction it refused to execute.
+    if (num_instructions_ != num_insn + 1) {
       return absl::InternalError(absl::StrCat(
-          "uc_emu_start() returned ", IntStr(err), ": ", uc_strerror(err)));
-    }
-
-    // We only stop emulation when we see more instructions than the limit.
-    // Exactly at the limit is not an error.
-    if (num_instructions_ > max_instructions_) {
-      return absl::InternalError("emulator executed too many instructions");
+          "stepping stopped after ", num_instructions_, " instructions, ",
+          num_insn, " requested"));
     }
+    return absl::OkStatus();
+  }
 
-    // Check if the timeout fired.
-    size_t result;
-    UNICORN_CHECK(uc_query(uc_, UC_QUERY_TIMEOUT, &result));
-    if (result) {
-      return absl::InternalError("execution timed out");
+  // Save the current CPU context as the checkpoint and start tracking memory
+  // writes so that RestoreCheckpoint() can undo them. Replaces the previous
+  // checkpoint, if any.
+  // This is much cheaper than re-initializing the tracer: only the pages
+  // written since the checkpoint need to be restored.
+  void SaveCheckpoint() {
+    if (checkpoint_context_ == nullptr) {
+      UNICORN_CHECK(uc_context_alloc(uc_, &checkpoint_context_));
+      UNICORN_CHECK(uc_hook_add(uc_, &hook_mem_write_, UC_HOOK_MEM_WRITE,
+                                (void*)&DispatchHookMemWrite, this, 1, 0));
     }
+    UNICORN_CHECK(uc_context_save(uc_, checkpoint_context_));
+    checkpoint_pages_.clear();
+  }
 
-    // Check if the emulator stopped at the right address.
-    // Generally, this should not be an issue if we did not hit the instruction
-    // count limit or the time limit.
-    uint64_t pc = GetCurrentInstructionPointer();
-    if (pc != end_of_code_) {
-      return absl::InternalError("execution did not reach end of code snippet");
+  // Restore the CPU context and memory contents saved by SaveCheckpoint().
+  // The checkpoint remains valid and can be restored again.
+  void RestoreCheckpoint() {
+    CHECK(checkpoint_context_ != nullptr);
+    UNICORN_CHECK(uc_context_restore(uc_, checkpoint_context_));
+    for (const auto& [address, contents] : checkpoint_pages_) {
+      UNICORN_CHECK(
+          uc_mem_write(uc_, address, contents.data(), contents.size()));
     }
-
-    RETURN_IF_NOT_OK(ValidateArchEndState());
-
-    return absl::OkStatus();
+    checkpoint_pages_.clear();
   }
 
   // Should only be invoked inside callbacks from Run()
@@ -229,6 +303,21 @@ class UnicornTracer {
   // so some registers may be set to zero instead of their actual values.
   void GetRegisters(UContext<Arch>& ucontext);
 
+  // A set of the registers GetRegisters() reads, one bit per register.
+  using RegisterMask = uint64_t;
+  static constexpr RegisterMask kAllRegisters = ~RegisterMask{0};
+
+  // Returns the mask of the Unicorn register `uc_reg`, or kAllRegisters if
+  // GetRegisters() does not read `uc_reg` by itself.
+  static RegisterMask UnicornRegisterMask(int uc_reg);
+
+  // Like GetRegisters(), but only reads the registers in `mask` and leaves the
+  // rest of `ucontext` alone. `ucontext` should hold an earlier read from this
+  // tracer, so that only the registers the instructions executed since then
+  // could have written need to be read again.
+  // Only x86_64 reads registers selectively, other platforms read everything.
+  void GetRegisters(UContext<Arch>& ucontext, RegisterMask mask);
+
   // Write the current register state. Not all platforms can write all
   // registers, so some registers may not be updated.
   void SetRegisters(const UContext<Arch>& ucontext);
@@ -245,6 +334,71 @@ class UnicornTracer {
   }
 
  private:
+  static constexpr uint64_t kCheckpointPageSize = 4096;
+
+  // Start emulation at `begin` and stop after `max_insn_executed`
+  // instructions or at the end of the snippet, whichever comes first.
+  absl::Status Emulate(uint64_t begin, size_t max_insn_executed) {
+    num_instructions_ = 0;
+    max_instructions_ = max_insn_executed;
+    should_be_stopped_ = false;
+
+    // Unicorn can hang due to bugs in QEMU.
+    // Halt execution if it exceeds 1 seconds of wall clock time.
+    // This value is arbitrary and may need to be tuned.
+    // We don't want this value to be so small that machine load can easily
+    // cause the deadline to be missed.
+    // We don't want this value to be so large that fault injection will take
+    // forever when we hit a degenerate case.
+    // Empirically, 1 second is about 20x-30x longer than execution takes in the
+    // worst case on an unloaded machine.
+    uint64_t timeout_microseconds = 1000000;
+    uc_err err =
+        uc_emu_start(uc_, begin, end_of_code_, timeout_microseconds, 0);
+
+    // Check if the emulator stopped cleanly.
+    if (err) {
+      return absl::InternalError(absl::StrCat(
+          "uc_emu_start() returned ", IntStr(err), ": ", uc_strerror(err)));
+    }
+    return absl::OkStatus();
+  }
+
+  // Check if the timeout of the last Emulate() fired.
+  absl::Status CheckTimeout() {
+    size_t result;
+    UNICORN_CHECK(uc_query(uc_, UC_QUERY_TIMEOUT, &result));
+    if (result) {
+      return absl::InternalError("execution timed out");
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status RunFrom(uint64_t begin, size_t max_insn_executed) {
+    RETURN_IF_NOT_OK(Emulate(begin, max_insn_executed));
+
+    // We only stop emulation when we see more instructions than the limit.
+    // Exactly at the limit is not an error.
+    if (num_instructions_ > max_instructions_) {
+      return absl::InternalError("emulator executed too many instructions");
+    }
+
+    // Check if the timeout fired.
+    RETURN_IF_NOT_OK(CheckTimeout());
+
+    // Check if the emulator stopped at the right address.
+    // Generally, this should not be an issue if we did not hit the instruction
+    // count limit or the time limit.
+    uint64_t pc = GetCurrentInstructionPointer();
+    if (pc != end_of_code_) {
+      return absl::InternalError("execution did not reach end of code snippet");
+    }
+
+    RETURN_IF_NOT_OK(ValidateArchEndState());
+
+    return absl::OkStatus();
+  }
+
   // Initialize Unicorn and put it in a state that it can execute code snippets
   // and Snapshots. This may involve setting system registers, etc.
   void InitUnicorn(const UnicornTracerConfig<Arch>& tracer_config);
@@ -307,6 +461,31 @@ class UnicornTracer {
     tracer->HookCode(address, size);
   }
 
+  // Remember the original contents of every page that is about to be written
+  // for the first time since the last checkpoint. Unicorn invokes write hooks
+  // before the memory is modified.
+  void HookMemWrite(uint64_t address, int size) {
+    uint64_t first_page = address & ~(kCheckpointPageSize - 1);
+    uint64_t last_page = (address + size - 1) & ~(kCheckpointPageSize - 1);
+    for (uint64_t page = first_page; page <= last_page;
+         page += kCheckpointPageSize) {
+      if (checkpoint_pages_.contains(page)) continue;
+      std::string contents(kCheckpointPageSize, 0);
+      // The write may fault. There is nothing to restore in that case.
+      if (uc_mem_read(uc_, page, contents.data(), contents.size()) ==
+          UC_ERR_OK) {
+        checkpoint_pages_.emplace(page, std::move(contents));
+      }
+    }
+  }
+
+  static void DispatchHookMemWrite(uc_engine* uc, uc_mem_type type,
+                                   uint64_t address, int size, int64_t value,
+                                   void* user_data) {
+    UnicornTracer<Arch>* tracer = static_cast<UnicornTracer<Arch>*>(user_data);
+    tracer->HookMemWrite(address, size);
+  }
+
   uc_engine* uc_;
 
   uint64_t start_of_code_;
@@ -319,6 +498,17 @@ class UnicornTracer {
   bool should_be_stopped_;
 
   std::function<InstructionCallback> instruction_callback_;
+
+  // Checkpoint state. See SaveCheckpoint().
+  uc_context* checkpoint_context_ = nullptr;
+  uc_hook hook_mem_write_;
+  // Maps page address to the page's contents at the time of the checkpoint,
+  // for all pages written since.
+  absl::flat_hash_map<uint64_t, std::string> checkpoint_pages_;
+
+  // The contents of the code page. Reused by ResetSnippet() to avoid
+  // allocating a page per snippet.
+  std::string code_page_;
 };
 
 }  // namespace silifuzz
@@ -318,6 +318,19 @@ void UnicornTracer<AArch64>::GetRegisters(UContext<AArch64> &ucontext) {
   }
 }
 
+template <>
+UnicornTracer<AArch64>::RegisterMask
+UnicornTracer<AArch64>::UnicornRegisterMask(int uc_reg) {
+  // There are more registers than bits in a RegisterMask.
+  return kAllRegisters;
+}
+
+template <>
+void UnicornTracer<AArch64>::GetRegisters(UContext<AArch64> &ucontext,
+                                          RegisterMask mask) {
+  GetRegisters(ucontext);
+}
+
 template <>
 void UnicornTracer<AArch64>::SetRegisters(const UContext<AArch64> &ucontext) {
   // uc_reg_write_batch appears to work fine for aarch64, but we're writing the
@@ -0,0 +1,176 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark of the per-input cost of the Unicorn proxies.
+//
+// To run:
+//
+// bazel run -c opt third_party/silifuzz/tracing:unicorn_tracer_benchmark
+//
+// For each architecture, this executes a few test snippets the way the proxies
+// do: once with a new UnicornTracer per input (InitSnippet) and once with a
+// single tracer reused across inputs (ResetSnippet), and reports executions
+// per second. On x86_64 it also compares reading every register after each
+// instruction with reading only the registers the instruction can write.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "./common/snapshot_test_config.h"
+#include "./common/snapshot_test_enum.h"
+#include "./instruction/xed_disassembler.h"
+#include "./tracing/unicorn_tracer.h"
+#include "./tracing/x86_64_written_registers.h"
+#include "./util/arch.h"
+#include "./util/checks.h"
+#include "./util/ucontext/ucontext_types.h"
+
+namespace silifuzz {
+namespace {
+
+// Same limit as the x86_64 proxy.
+constexpr size_t kMaxInstExecuted = 1000;
+
+// A mix of inputs that exit normally, fault and run into the instruction
+// limit.
+constexpr TestSnapshot kSnippets[] = {
+    TestSnapshot::kEndsAsExpected,
+    TestSnapshot::kSetThreeRegisters,
+    TestSnapshot::kSigSegvWrite,
+    TestSnapshot::kRunaway,
+};
+
+template <typename Arch>
+void RunOneInput(UnicornTracer<Arch>& tracer, bool reuse,
+                 const std::string& instructions) {
+  absl::Status status = reuse ? tracer.ResetSnippet(instructions)
+                              : tracer.InitSnippet(instructions);
+  CHECK_STATUS(status);
+  size_t num_instructions = 0;
+  tracer.SetInstructionCallback(
+      [&](UnicornTracer<Arch>* tracer, uint64_t address, uint32_t size) {
+        num_instructions++;
+      });
+  // Most inputs are not expected to exit normally.
+  tracer.Run(kMaxInstExecuted).IgnoreError();
+}
+
+// Returns the number of inputs executed per second.
+template <typename Arch>
+double MeasureExecsPerSecond(const std::vector<std::string>& snippets,
+                             bool reuse) {
+  const absl::Duration kBenchmarkDuration = absl::Seconds(2);
+  UnicornTracer<Arch> reused_tracer;
+  size_t num_execs = 0;
+  const absl::Time start = absl::Now();
+  absl::Duration elapsed;
+  do {
+    for (const std::string& instructions : snippets) {
+      if (reuse) {
+        RunOneInput(reused_tracer, reuse, instructions);
+      } else {
+        UnicornTracer<Arch> tracer;
+        RunOneInput(tracer, reuse, instructions);
+      }
+      ++num_execs;
+    }
+    elapsed = absl::Now() - start;
+  } while (elapsed < kBenchmarkDuration);
+  return num_execs / absl::ToDoubleSeconds(elapsed);
+}
+
+// Returns the number of inputs executed per second when the registers are
+// read after every instruction, like the x86_64 proxy does.
+double MeasureRegisterReadsPerSecond(const std::vector<std::string>& snippets,
+                                     bool incremental) {
+  const absl::Duration kBenchmarkDuration = absl::Seconds(2);
+  UnicornTracer<X86_64> tracer;
+  XedDisassembler disasm;
+  UContext<X86_64> registers;
+  size_t num_execs = 0;
+  const absl::Time start = absl::Now();
+  absl::Duration elapsed;
+  do {
+    for (const std::string& instructions : snippets) {
+      CHECK_STATUS(tracer.ResetSnippet(instructions));
+      tracer.GetRegisters(registers);
+      // The registers the previous instruction can write. Reading them before
+      // the next instruction executes is equivalent to reading them after the
+      // previous one.
+      UnicornTracer<X86_64>::RegisterMask pending = 0;
+      tracer.SetInstructionCallback([&](UnicornTracer<X86_64>* tracer,
+                                        uint64_t address, uint32_t size) {
+        if (pending != 0) tracer->GetRegisters(registers, pending);
+        // The proxy disassembles every instruction either way.
+        uint8_t insn[16];
+        size = std::min<uint32_t>(size, sizeof(insn));
+        tracer->ReadMemory(address, insn, size);
+        pending = UnicornTracer<X86_64>::kAllRegisters;
+        if (disasm.Disassemble(address, insn, size) && incremental) {
+          pending = WrittenRegisterMask(disasm.DecodedInstruction());
+        }
+      });
+      tracer.Run(kMaxInstExecuted).IgnoreError();
+      ++num_execs;
+    }
+    elapsed = absl::Now() - start;
+  } while (elapsed < kBenchmarkDuration);
+  return num_execs / absl::ToDoubleSeconds(elapsed);
+}
+
+template <typename Arch>
+void RunBenchmark() {
+  std::vector<std::string> snippets;
+  for (TestSnapshot test : kSnippets) {
+    snippets.push_back(GetTestSnippet<Arch>(test));
+  }
+  LOG_INFO("Benchmarking ", Arch::arch_name);
+  const double fresh = MeasureExecsPerSecond<Arch>(snippets, false);
+  LOG_INFO("  new tracer per input: ", static_cast<int64_t>(fresh),
+           " execs/sec");
+  const double reused = MeasureExecsPerSecond<Arch>(snippets, true);
+  LOG_INFO("  reused tracer: ", static_cast<int64_t>(reused), " execs/sec (",
+           reused / fresh, "x)");
+}
+
+void RunRegisterReadBenchmark() {
+  std::vector<std::string> snippets;
+  for (TestSnapshot test : kSnippets) {
+    snippets.push_back(GetTestSnippet<X86_64>(test));
+  }
+  LOG_INFO("Benchmarking ", X86_64::arch_name, " register reads");
+  const double full = MeasureRegisterReadsPerSecond(snippets, false);
+  LOG_INFO("  full: ", static_cast<int64_t>(full), " execs/sec");
+  const double incremental = MeasureRegisterReadsPerSecond(snippets, true);
+  LOG_INFO("  incremental: ", static_cast<int64_t>(incremental),
+           " execs/sec (", incremental / full, "x)");
+}
+
+int BenchmarkMain() {
+  RunBenchmark<X86_64>();
+  RunRegisterReadBenchmark();
+  RunBenchmark<AArch64>();
+  return 0;
+}
+
+}  // namespace
+}  // namespace silifuzz
+
+int main() { return silifuzz::BenchmarkMain(); }
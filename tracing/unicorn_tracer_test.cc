@@ -132,6 +132,166 @@ TYPED_TEST(UnicornTracerTest, SkipInstruction) {
   }
 }
 
+TYPED_TEST(UnicornTracerTest, SkipInstructionFromCheckpoint) {
+  std::string instructions =
+      GetTestSnippet<TypeParam>(TestSnapshot::kSetThreeRegisters);
+  UnicornTracer<TypeParam> tracer;
+  ASSERT_THAT(tracer.InitSnippet(instructions), IsOk());
+
+  int instruction = 0;
+  int skip = -1;
+  tracer.SetInstructionCallback(
+      [&](UnicornTracer<TypeParam>* tracer, uint64_t address, uint32_t size) {
+        if (instruction == skip) {
+          tracer->SetCurrentInstructionPointer(address + size);
+        }
+        instruction++;
+      });
+
+  // Checkpoint after the first instruction.
+  ASSERT_THAT(tracer.Step(1), IsOk());
+  EXPECT_EQ(instruction, 1);
+  tracer.SaveCheckpoint();
+
+  // Each trial resumes from the checkpoint and should not observe the effects
+  // of the previous trial.
+  for (skip = 1; skip < 3; ++skip) {
+    instruction = 1;
+    ASSERT_THAT(tracer.Resume(2), IsOk());
+    EXPECT_EQ(instruction, 3);
+
+    UContext<TypeParam> ucontext;
+    tracer.GetRegisters(ucontext);
+    CheckRegisters(ucontext, skip);
+    tracer.RestoreCheckpoint();
+  }
+
+  // Stepping past the end of the snippet is an error.
+  EXPECT_THAT(tracer.Step(3), Not(IsOk()));
+}
+
+TYPED_TEST(UnicornTracerTest, ResetSnippet) {
+  std::string instructions =
+      GetTestSnippet<TypeParam>(TestSnapshot::kSetThreeRegisters);
+  UnicornTracer<TypeParam> tracer;
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_THAT(tracer.ResetSnippet(instructions), IsOk());
+    uint64_t instruction_count = 0;
+    tracer.SetInstructionCallback(
+        [&](UnicornTracer<TypeParam>* tracer, uint64_t address, uint32_t size) {
+          instruction_count++;
+        });
+    ASSERT_THAT(tracer.Run(3), IsOk());
+    EXPECT_EQ(instruction_count, 3);
+    UContext<TypeParam> ucontext;
+    tracer.GetRegisters(ucontext);
+    CheckRegisters(ucontext);
+
+    // A different snippet should end in the same state as it would in a fresh
+    // tracer.
+    ASSERT_THAT(tracer.ResetSnippet(""), IsOk());
+    ASSERT_THAT(tracer.Run(0), IsOk());
+    tracer.GetRegisters(ucontext);
+    UnicornTracer<TypeParam> fresh_tracer;
+    ASSERT_THAT(fresh_tracer.InitSnippet(""), IsOk());
+    ASSERT_THAT(fresh_tracer.Run(0), IsOk());
+    UContext<TypeParam> expected;
+    fresh_tracer.GetRegisters(expected);
+    EXPECT_EQ(ucontext.gregs, expected.gregs);
+    EXPECT_EQ(ucontext.fpregs, expected.fpregs);
+  }
+}
+
+// Snippets that access a fixed location in data memory. kStoreSnippet writes
+// kStoredValue to the location and loads it back into the result register.
+// kLoadSnippet only loads the location into the result register.
+template <typename Arch>
+struct MemoryTestSnippets;
+
+template <>
+struct MemoryTestSnippets<X86_64> {
+  // The location is 8(%rsp), in data1.
+  // movq $0x1234, 0x8(%rsp)
+  // mov 0x8(%rsp), %rdx
+  static constexpr char kStoreSnippet[] =
+      "\x48\xc7\x44\x24\x08\x34\x12\x00\x00"
+      "\x48\x8b\x54\x24\x08";
+  // mov 0x8(%rsp), %rdx
+  static constexpr char kLoadSnippet[] = "\x48\x8b\x54\x24\x08";
+  static uint64_t Result(const UContext<X86_64>& ucontext) {
+    return ucontext.gregs.rdx;
+  }
+};
+
+template <>
+struct MemoryTestSnippets<AArch64> {
+  // The location is [x6], the start of data1.
+  // movz x0, #0x1234
+  // str x0, [x6]
+  // ldr x2, [x6]
+  static constexpr char kStoreSnippet[] =
+      "\x80\x46\x82\xd2"
+      "\xc0\x00\x00\xf9"
+      "\xc2\x00\x40\xf9";
+  // ldr x2, [x6]
+  static constexpr char kLoadSnippet[] = "\xc2\x00\x40\xf9";
+  static uint64_t Result(const UContext<AArch64>& ucontext) {
+    return ucontext.gregs.x[2];
+  }
+};
+
+constexpr uint64_t kStoredValue = 0x1234;
+
+TYPED_TEST(UnicornTracerTest, ResetSnippetRestoresMemory) {
+  using Snippets = MemoryTestSnippets<TypeParam>;
+  // The snippets contain NUL bytes, so pass the sizes explicitly.
+  const std::string store_snippet(Snippets::kStoreSnippet,
+                                  sizeof(Snippets::kStoreSnippet) - 1);
+  const std::string load_snippet(Snippets::kLoadSnippet,
+                                 sizeof(Snippets::kLoadSnippet) - 1);
+
+  // What the location holds in a fresh tracer.
+  UnicornTracer<TypeParam> fresh_tracer;
+  ASSERT_THAT(fresh_tracer.InitSnippet(load_snippet), IsOk());
+  ASSERT_THAT(fresh_tracer.Run(1), IsOk());
+  UContext<TypeParam> ucontext;
+  fresh_tracer.GetRegisters(ucontext);
+  const uint64_t original_value = Snippets::Result(ucontext);
+  ASSERT_NE(original_value, kStoredValue);
+
+  UnicornTracer<TypeParam> tracer;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_THAT(tracer.ResetSnippet(store_snippet), IsOk());
+    ASSERT_THAT(tracer.Run(3), IsOk());
+    tracer.GetRegisters(ucontext);
+    EXPECT_EQ(Snippets::Result(ucontext), kStoredValue);
+
+    // The next snippet must not see the store of the previous one.
+    ASSERT_THAT(tracer.ResetSnippet(load_snippet), IsOk());
+    ASSERT_THAT(tracer.Run(1), IsOk());
+    tracer.GetRegisters(ucontext);
+    EXPECT_EQ(Snippets::Result(ucontext), original_value);
+  }
+}
+
+TYPED_TEST(UnicornTracerTest, ResetSnippetRejectsLargeSnippet) {
+  UnicornTracer<TypeParam> tracer;
+  ASSERT_THAT(tracer.ResetSnippet(""), IsOk());
+  // A snippet that does not fit in the code page with the exit sequence.
+  std::string too_large(4096, 0);
+  EXPECT_THAT(tracer.ResetSnippet(too_large), Not(IsOk()));
+
+  // The tracer is still usable.
+  std::string instructions =
+      GetTestSnippet<TypeParam>(TestSnapshot::kSetThreeRegisters);
+  ASSERT_THAT(tracer.ResetSnippet(instructions), IsOk());
+  ASSERT_THAT(tracer.Run(3), IsOk());
+  UContext<TypeParam> ucontext;
+  tracer.GetRegisters(ucontext);
+  CheckRegisters(ucontext);
+}
+
 // Unicorn doesn't provide access to some registers, zero them out to make the
 // test work.
 template <typename Arch>
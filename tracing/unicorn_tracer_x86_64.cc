@@ -264,12 +264,44 @@ void UnicornTracer<X86_64>::GetRegisters(UContext<X86_64> &ucontext) {
   memset(&ucontext, 0, sizeof(ucontext));
   std::array<const void *, kNumUnicornX86_64Reg> ptrs =
       UnicornX86_64RegValue(ucontext);
+  // It's a bit hackish to cast away the constness of kUnicornX86_64RegNames and
+  // UnicornX86_64RegValue, but it's cleaner than having two const and non-const
+  // versions of the function. uc_reg_read_batch() does not modify the
+  // register names.
+  uc_reg_read_batch(uc_, const_cast<int *>(kUnicornX86_64RegNames),
+                    const_cast<void **>(ptrs.data()), kNumUnicornX86_64Reg);
+}
+
+template <>
+UnicornTracer<X86_64>::RegisterMask UnicornTracer<X86_64>::UnicornRegisterMask(
+    int uc_reg) {
+  static_assert(kNumUnicornX86_64Reg <= sizeof(RegisterMask) * 8);
+  for (size_t i = 0; i < kNumUnicornX86_64Reg; ++i) {
+    if (kUnicornX86_64RegNames[i] == uc_reg) return RegisterMask{1} << i;
+  }
+  return kAllRegisters;
+}
+
+template <>
+void UnicornTracer<X86_64>::GetRegisters(UContext<X86_64> &ucontext,
+                                         RegisterMask mask) {
+  if (mask == kAllRegisters) {
+    GetRegisters(ucontext);
+    return;
+  }
+  std::array<const void *, kNumUnicornX86_64Reg> ptrs =
+      UnicornX86_64RegValue(ucontext);
+  int names[kNumUnicornX86_64Reg];
+  void *values[kNumUnicornX86_64Reg];
+  int count = 0;
   for (size_t i = 0; i < kNumUnicornX86_64Reg; ++i) {
-    // It's a bit hackish to cast away the constness of UnicornX86_64RegValue,
-    // but it's cleaner than having two const and non-const versions of the
-    // function.
-    uc_reg_read(uc_, kUnicornX86_64RegNames[i], const_cast<void *>(ptrs[i]));
+    if (mask & (RegisterMask{1} << i)) {
+      names[count] = kUnicornX86_64RegNames[i];
+      values[count] = const_cast<void *>(ptrs[i]);
+      ++count;
+    }
   }
+  uc_reg_read_batch(uc_, names, values, count);
 }
 
 template <>
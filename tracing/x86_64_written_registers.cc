@@ -0,0 +1,158 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./tracing/x86_64_written_registers.h"
+
+#include <array>
+#include <cstddef>
+
+#include "./tracing/unicorn_tracer.h"
+#include "./util/arch.h"
+#include "third_party/unicorn/x86.h"
+
+extern "C" {
+#include "third_party/libxed/xed-interface.h"
+}
+
+namespace silifuzz {
+
+namespace {
+
+using RegisterMask = UnicornTracer<X86_64>::RegisterMask;
+
+constexpr RegisterMask kAllRegisters = UnicornTracer<X86_64>::kAllRegisters;
+
+// The Unicorn registers for XED_REG_RAX ... XED_REG_R15.
+constexpr int kUnicornGPRs[] = {
+    UC_X86_REG_RAX, UC_X86_REG_RCX, UC_X86_REG_RDX, UC_X86_REG_RBX,
+    UC_X86_REG_RSP, UC_X86_REG_RBP, UC_X86_REG_RSI, UC_X86_REG_RDI,
+    UC_X86_REG_R8,  UC_X86_REG_R9,  UC_X86_REG_R10, UC_X86_REG_R11,
+    UC_X86_REG_R12, UC_X86_REG_R13, UC_X86_REG_R14, UC_X86_REG_R15,
+};
+
+// The Unicorn registers for the low 128 bits of vector registers 0 ... 15.
+constexpr int kUnicornXMMs[] = {
+    UC_X86_REG_XMM0,  UC_X86_REG_XMM1,  UC_X86_REG_XMM2,  UC_X86_REG_XMM3,
+    UC_X86_REG_XMM4,  UC_X86_REG_XMM5,  UC_X86_REG_XMM6,  UC_X86_REG_XMM7,
+    UC_X86_REG_XMM8,  UC_X86_REG_XMM9,  UC_X86_REG_XMM10, UC_X86_REG_XMM11,
+    UC_X86_REG_XMM12, UC_X86_REG_XMM13, UC_X86_REG_XMM14, UC_X86_REG_XMM15,
+};
+
+// Returns the mask of the registers a write to `reg` can change.
+RegisterMask MaskForXedRegister(xed_reg_enum_t reg) {
+  auto uc_mask = [](int uc_reg) {
+    return UnicornTracer<X86_64>::UnicornRegisterMask(uc_reg);
+  };
+  switch (reg) {
+    case XED_REG_INVALID:
+      return 0;
+    case XED_REG_RIP:
+    case XED_REG_EIP:
+    case XED_REG_IP:
+      return uc_mask(UC_X86_REG_RIP);
+    case XED_REG_RFLAGS:
+    case XED_REG_EFLAGS:
+    case XED_REG_FLAGS:
+      return uc_mask(UC_X86_REG_EFLAGS);
+    case XED_REG_STACKPUSH:
+    case XED_REG_STACKPOP:
+      return uc_mask(UC_X86_REG_RSP);
+    case XED_REG_MXCSR:
+      return uc_mask(UC_X86_REG_MXCSR);
+    default:
+      break;
+  }
+  switch (xed_reg_class(reg)) {
+    case XED_REG_CLASS_GPR: {
+      const xed_reg_enum_t widest = xed_get_largest_enclosing_register(reg);
+      if (widest >= XED_REG_RAX && widest <= XED_REG_R15) {
+        return uc_mask(kUnicornGPRs[widest - XED_REG_RAX]);
+      }
+      return kAllRegisters;
+    }
+    case XED_REG_CLASS_XMM:
+    case XED_REG_CLASS_YMM:
+    case XED_REG_CLASS_ZMM: {
+      const xed_reg_enum_t first = xed_reg_class(reg) == XED_REG_CLASS_XMM
+                                       ? XED_REG_XMM0
+                                   : xed_reg_class(reg) == XED_REG_CLASS_YMM
+                                       ? XED_REG_YMM0
+                                       : XED_REG_ZMM0;
+      const size_t index = reg - first;
+      // The registers above 15 are not part of the UContext.
+      return index < std::size(kUnicornXMMs) ? uc_mask(kUnicornXMMs[index])
+                                             : 0;
+    }
+    case XED_REG_CLASS_MASK:
+      // AVX-512 mask registers are not part of the UContext.
+      return 0;
+    default:
+      // x87, segment, control and other special registers.
+      return kAllRegisters;
+  }
+}
+
+// Maps every XED register to the registers a write to it can change.
+const std::array<RegisterMask, XED_REG_LAST>& XedRegisterMasks() {
+  static const std::array<RegisterMask, XED_REG_LAST>* const masks = [] {
+    auto* masks = new std::array<RegisterMask, XED_REG_LAST>();
+    for (size_t reg = 0; reg < XED_REG_LAST; ++reg) {
+      (*masks)[reg] = MaskForXedRegister(static_cast<xed_reg_enum_t>(reg));
+    }
+    return masks;
+  }();
+  return *masks;
+}
+
+}  // namespace
+
+RegisterMask WrittenRegisterMask(const xed_decoded_inst_t& xedd) {
+  switch (xed_decoded_inst_get_iclass(&xedd)) {
+    // These write registers that are not listed as operands.
+    case XED_ICLASS_FXRSTOR:
+    case XED_ICLASS_FXRSTOR64:
+    case XED_ICLASS_XRSTOR:
+    case XED_ICLASS_XRSTOR64:
+    case XED_ICLASS_XRSTORS:
+    case XED_ICLASS_XRSTORS64:
+    case XED_ICLASS_VZEROALL:
+    case XED_ICLASS_VZEROUPPER:
+      return kAllRegisters;
+    default:
+      break;
+  }
+
+  const std::array<RegisterMask, XED_REG_LAST>& masks = XedRegisterMasks();
+  // Even an instruction that does nothing else moves the instruction pointer.
+  RegisterMask mask = masks[XED_REG_RIP];
+  const xed_simple_flag_t* flags = xed_decoded_inst_get_rflags_info(&xedd);
+  if (flags != nullptr && xed_simple_flag_writes_flags(flags)) {
+    mask |= masks[XED_REG_RFLAGS];
+  }
+  const xed_inst_t* inst = xed_decoded_inst_inst(&xedd);
+  for (unsigned int i = 0; i < xed_inst_noperands(inst); ++i) {
+    const xed_operand_t* operand = xed_inst_operand(inst, i);
+    const xed_operand_enum_t name = xed_operand_name(operand);
+    if (!xed_operand_is_register(name)) continue;
+    const xed_reg_enum_t reg = xed_decoded_inst_get_reg(&xedd, name);
+    // SIMD floating point instructions only list MXCSR as read, but they can
+    // raise its sticky exception flags.
+    if (xed_operand_written(operand) || reg == XED_REG_MXCSR) {
+      mask |= masks[reg];
+    }
+  }
+  return mask;
+}
+
+}  // namespace silifuzz
@@ -0,0 +1,39 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_TRACING_X86_64_WRITTEN_REGISTERS_H_
+#define THIRD_PARTY_SILIFUZZ_TRACING_X86_64_WRITTEN_REGISTERS_H_
+
+#include "./tracing/unicorn_tracer.h"
+#include "./util/arch.h"
+
+extern "C" {
+#include "third_party/libxed/xed-interface.h"
+}
+
+namespace silifuzz {
+
+// Returns the registers UnicornTracer<X86_64>::GetRegisters() reads that
+// executing the instruction decoded in `xedd` can write, including the
+// instruction pointer. Returns kAllRegisters if the instruction writes
+// registers XED does not describe precisely enough, such as the x87 state.
+//
+// Pass the result to UnicornTracer<X86_64>::GetRegisters() after the
+// instruction executes to refresh only the registers it could have changed.
+UnicornTracer<X86_64>::RegisterMask WrittenRegisterMask(
+    const xed_decoded_inst_t& xedd);
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_TRACING_X86_64_WRITTEN_REGISTERS_H_
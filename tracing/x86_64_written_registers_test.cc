@@ -0,0 +1,130 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./tracing/x86_64_written_registers.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "./instruction/xed_disassembler.h"
+#include "./tracing/unicorn_tracer.h"
+#include "./util/arch.h"
+#include "./util/testing/status_matchers.h"
+#include "./util/ucontext/ucontext_types.h"
+#include "third_party/unicorn/x86.h"
+
+namespace silifuzz {
+
+namespace {
+
+using silifuzz::testing::IsOk;
+using RegisterMask = UnicornTracer<X86_64>::RegisterMask;
+
+RegisterMask Mask(int uc_reg) {
+  return UnicornTracer<X86_64>::UnicornRegisterMask(uc_reg);
+}
+
+RegisterMask MaskOf(const std::vector<uint8_t>& bytes) {
+  XedDisassembler disasm;
+  EXPECT_TRUE(disasm.Disassemble(0, bytes.data(), bytes.size()));
+  return WrittenRegisterMask(disasm.DecodedInstruction());
+}
+
+TEST(WrittenRegisterMask, Add) {
+  // add rcx, rdx
+  EXPECT_EQ(MaskOf({0x48, 0x01, 0xd1}), Mask(UC_X86_REG_RIP) |
+                                            Mask(UC_X86_REG_RCX) |
+                                            Mask(UC_X86_REG_EFLAGS));
+}
+
+TEST(WrittenRegisterMask, PartialRegister) {
+  // mov ah, 1
+  EXPECT_EQ(MaskOf({0xb4, 0x01}), Mask(UC_X86_REG_RIP) | Mask(UC_X86_REG_RAX));
+}
+
+TEST(WrittenRegisterMask, Push) {
+  // push rax
+  EXPECT_EQ(MaskOf({0x50}), Mask(UC_X86_REG_RIP) | Mask(UC_X86_REG_RSP));
+}
+
+TEST(WrittenRegisterMask, Vector) {
+  // vaddps ymm1, ymm2, ymm3
+  RegisterMask mask = MaskOf({0xc5, 0xec, 0x58, 0xcb});
+  EXPECT_NE(mask & Mask(UC_X86_REG_XMM1), 0);
+  EXPECT_EQ(mask & Mask(UC_X86_REG_XMM2), 0);
+  EXPECT_EQ(mask & Mask(UC_X86_REG_RAX), 0);
+}
+
+TEST(WrittenRegisterMask, X87) {
+  // fld1
+  EXPECT_EQ(MaskOf({0xd9, 0xe8}), UnicornTracer<X86_64>::kAllRegisters);
+}
+
+// Runs a snippet and checks that reading only the written registers after
+// every instruction gives the same register state as reading all of them.
+TEST(WrittenRegisterMask, MatchesFullRead) {
+  const std::vector<uint8_t> snippet = {
+      0x50,                    // push rax
+      0x5b,                    // pop rbx
+      0x48, 0x01, 0xd1,        // add rcx, rdx
+      0x66, 0x0f, 0xef, 0xc9,  // pxor xmm1, xmm1
+      0x0f, 0x58, 0xd3,        // addps xmm2, xmm3
+      0x48, 0x92,              // xchg rax, rdx
+      0x0f, 0xa2,              // cpuid
+      0xd9, 0xe8,              // fld1
+      0xb4, 0x01,              // mov ah, 1
+      0x48, 0xff, 0xc7,        // inc rdi
+      0x48, 0x0f, 0x44, 0xf1,  // cmovz rsi, rcx
+      0xc5, 0xec, 0x58, 0xcb,  // vaddps ymm1, ymm2, ymm3
+      0x31, 0xc0,              // xor eax, eax
+  };
+  UnicornTracer<X86_64> tracer;
+  ASSERT_THAT(tracer.InitSnippet(std::string(snippet.begin(), snippet.end())),
+              IsOk());
+
+  XedDisassembler disasm;
+  UContext<X86_64> incremental;
+  tracer.GetRegisters(incremental);
+  RegisterMask pending = 0;
+  size_t num_partial_reads = 0;
+  auto check = [&](UnicornTracer<X86_64>* tracer) {
+    if (pending == 0) return;
+    tracer->GetRegisters(incremental, pending);
+    if (pending != UnicornTracer<X86_64>::kAllRegisters) ++num_partial_reads;
+    UContext<X86_64> full;
+    tracer->GetRegisters(full);
+    EXPECT_EQ(incremental.gregs, full.gregs);
+    EXPECT_EQ(incremental.fpregs, full.fpregs);
+  };
+  tracer.SetInstructionCallback(
+      [&](UnicornTracer<X86_64>* tracer, uint64_t address, uint32_t size) {
+        check(tracer);
+        uint8_t insn[16];
+        size = std::min<uint32_t>(size, sizeof(insn));
+        tracer->ReadMemory(address, insn, size);
+        ASSERT_TRUE(disasm.Disassemble(address, insn, size));
+        pending = WrittenRegisterMask(disasm.DecodedInstruction());
+      });
+  ASSERT_THAT(tracer.Run(13), IsOk());
+  check(&tracer);
+  EXPECT_GT(num_partial_reads, 0);
+}
+
+}  // namespace
+
+}  // namespace silifuzz
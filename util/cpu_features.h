@@ -25,6 +25,7 @@ enum class X86CPUFeatures {
   kBegin = 0,
   kAMX_TILE = kBegin,  // for accessing tile and tileconfig registers.
   kAVX,                // for accessing ymm registers.
+  kAVX2,               // for 256-bit integer vector instructions.
   kAVX512BW,           // for accessing upper 48 bits of opmask registers.
   kAVX512F,  // for accessing zmm and lower 16 bits of opmask registers.
   kOSXSAVE,  // OS provides processor extended state management.
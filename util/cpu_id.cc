@@ -63,6 +63,21 @@ int SetCPUAffinity(int cpu_id) {
   return 0;
 }
 
+bool CanRunOnCPU(int cpu_id) {
+  constexpr size_t kULongBits =
+      CHAR_BIT * sizeof(unsigned long);  // NOLINT(runtime/int)
+  constexpr size_t kCPUSetSizeInLongs =
+      (CPU_SETSIZE + kULongBits - 1) / kULongBits;
+  if (cpu_id < 0 || cpu_id >= CPU_SETSIZE) return false;
+  unsigned long cpu_set[kCPUSetSizeInLongs] = {};  // NOLINT(runtime/int)
+  if (sys_sched_getaffinity(0, sizeof(cpu_set), cpu_set) < 0) {
+    return false;
+  }
+  const size_t idx = cpu_id / kULongBits;
+  const int bit = cpu_id % kULongBits;
+  return (cpu_set[idx] >> bit) & 1;
+}
+
 // Note: since we only have a single global variable we're recording the
 // last affinity set on any thread. This function may not work the way you'd
 // expect if called from multiple threads, but we expect it will only be used in
@@ -34,6 +34,10 @@ int GetCPUIdNoSyscall();
 // successful or an error number from sched_setaffinity().
 int SetCPUAffinity(int cpu_id);
 
+// Returns true iff the affinity mask of the current thread allows running on
+// the CPU with given Id.
+bool CanRunOnCPU(int cpu_id);
+
 }  // namespace silifuzz
 
 #endif  // THIRD_PARTY_SILIFUZZ_UTIL_CPU_ID_H_
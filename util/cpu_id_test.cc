@@ -61,5 +61,15 @@ TEST(CPUId, BasicTest) {
   EXPECT_GE(nosys_consistency_sum, num_trials * (1.0 - kAcceptableErrorRate));
 }
 
+TEST(CPUId, CanRunOnCPU) {
+  cpu_set_t all_cpus;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(all_cpus), &all_cpus), 0);
+  for (int i = 0; i < CPU_SETSIZE; i++) {
+    EXPECT_EQ(CanRunOnCPU(i), CPU_ISSET(i, &all_cpus)) << i;
+  }
+  EXPECT_FALSE(CanRunOnCPU(-1));
+  EXPECT_FALSE(CanRunOnCPU(CPU_SETSIZE));
+}
+
 }  // namespace
 }  // namespace silifuzz
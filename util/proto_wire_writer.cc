@@ -0,0 +1,142 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./util/proto_wire_writer.h"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "./util/byte_io.h"
+#include "./util/checks.h"
+
+namespace silifuzz {
+
+namespace {
+
+// Protobuf wire types.
+constexpr int kWireTypeVarint = 0;
+constexpr int kWireTypeLengthDelimited = 2;
+
+}  // namespace
+
+void ProtoWireWriter::Int(int field_number, int64_t value) {
+  // Negative values are encoded as 10-byte varints, like protobuf does.
+  Uint64(field_number, static_cast<uint64_t>(value));
+}
+
+void ProtoWireWriter::Uint64(int field_number, uint64_t value) {
+  AppendTag(field_number, kWireTypeVarint);
+  AppendVarint(value);
+}
+
+void ProtoWireWriter::String(int field_number, const char* value) {
+  Bytes(field_number, value, strlen(value));
+}
+
+void ProtoWireWriter::Bytes(int field_number, const void* value, size_t n) {
+  AppendTag(field_number, kWireTypeLengthDelimited);
+  AppendVarint(n);
+  Append(value, n);
+}
+
+void ProtoWireWriter::BytesRef(int field_number, const void* value, size_t n) {
+  AppendTag(field_number, kWireTypeLengthDelimited);
+  AppendVarint(n);
+  if (n == 0) return;
+  if (sizeof(Ref) > Available()) {
+    LOG_FATAL("ProtoWireWriter::buf_ too small");
+  }
+  SetRef(num_refs_++, {len_, value, n});
+  size_ += n;
+}
+
+void ProtoWireWriter::BeginMessage(int field_number) {
+  if (depth_ >= kMaxDepth) {
+    LOG_FATAL("ProtoWireWriter::open_messages_ too small");
+  }
+  AppendTag(field_number, kWireTypeLengthDelimited);
+  const size_t length_offset = len_;
+  const char placeholder[kLengthSize] = {};
+  Append(placeholder, kLengthSize);
+  open_messages_[depth_++] = {length_offset, size_};
+}
+
+void ProtoWireWriter::EndMessage() {
+  CHECK_GT(depth_, 0);
+  const OpenMessage& message = open_messages_[--depth_];
+  uint64_t length = size_ - message.start_size;
+  CHECK_LT(length, uint64_t{1} << (7 * kLengthSize));
+  char* ptr = buf_ + message.length_offset;
+  for (size_t i = 0; i < kLengthSize - 1; ++i) {
+    ptr[i] = static_cast<char>((length & 0x7f) | 0x80);
+    length >>= 7;
+  }
+  ptr[kLengthSize - 1] = static_cast<char>(length);
+}
+
+bool ProtoWireWriter::WriteTo(int fd) const {
+  CHECK_EQ(depth_, 0);
+  auto write_all = [fd](const void* data, size_t n) {
+    return Write(fd, data, n) == static_cast<ssize_t>(n);
+  };
+  size_t written = 0;
+  for (size_t i = 0; i < num_refs_; ++i) {
+    const Ref ref = GetRef(i);
+    if (!write_all(buf_ + written, ref.offset - written) ||
+        !write_all(ref.data, ref.size)) {
+      return false;
+    }
+    written = ref.offset;
+  }
+  return write_all(buf_ + written, len_ - written);
+}
+
+void ProtoWireWriter::Append(const void* data, size_t n) {
+  if (n > Available()) {
+    LOG_FATAL("ProtoWireWriter::buf_ too small");
+  }
+  memcpy(buf_ + len_, data, n);
+  len_ += n;
+  size_ += n;
+}
+
+void ProtoWireWriter::AppendVarint(uint64_t value) {
+  char varint[10];
+  size_t n = 0;
+  while (value >= 0x80) {
+    varint[n++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  varint[n++] = static_cast<char>(value);
+  Append(varint, n);
+}
+
+void ProtoWireWriter::AppendTag(int field_number, int wire_type) {
+  AppendVarint((static_cast<uint64_t>(field_number) << 3) | wire_type);
+}
+
+void ProtoWireWriter::SetRef(size_t i, const Ref& ref) {
+  memcpy(buf_ + sizeof(buf_) - (i + 1) * sizeof(Ref), &ref, sizeof(Ref));
+}
+
+ProtoWireWriter::Ref ProtoWireWriter::GetRef(size_t i) const {
+  Ref ref;
+  memcpy(&ref, buf_ + sizeof(buf_) - (i + 1) * sizeof(Ref), sizeof(Ref));
+  return ref;
+}
+
+}  // namespace silifuzz
@@ -0,0 +1,133 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_UTIL_PROTO_WIRE_WRITER_H_
+#define THIRD_PARTY_SILIFUZZ_UTIL_PROTO_WIRE_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace silifuzz {
+
+// Serializes a protobuf message in binary wire format without libprotobuf.
+// This is the binary counterpart of TextProtoPrinter and likewise performs no
+// validation of field numbers or types.
+//
+// Submessages are written in place. The length of a submessage is reserved as
+// a fixed-width varint when the submessage begins and filled in when it ends,
+// so submessage contents are never copied. Large bytes fields can be
+// referenced instead of copied with BytesRef() and are then written straight
+// from the caller's memory by WriteTo(). References are recorded at the end of
+// the same fixed buffer that holds everything else, so their number is only
+// limited by the space left in that buffer.
+//
+// Example:
+//
+//   ProtoWireWriter writer;
+//   writer.String(1, "id");
+//   writer.BeginMessage(2);
+//   writer.Int(1, 42);
+//   writer.EndMessage();
+//   writer.WriteTo(fd);
+class ProtoWireWriter {
+ public:
+  ProtoWireWriter() = default;
+  // Not copyable.
+  ProtoWireWriter(const ProtoWireWriter&) = delete;
+  ProtoWireWriter& operator=(const ProtoWireWriter&) = delete;
+
+  // A family of methods to write various typed fields.
+  // Int() is for int32, int64 and enum fields. Uint64() is for uint32 and
+  // uint64 fields.
+  void Int(int field_number, int64_t value);
+  void Uint64(int field_number, uint64_t value);
+  void String(int field_number, const char* value);
+  void Bytes(int field_number, const void* value, size_t n);
+
+  // Like Bytes() but does not copy `value`, which must stay valid and
+  // unchanged until WriteTo() returns.
+  void BytesRef(int field_number, const void* value, size_t n);
+
+  // Begins a submessage. All fields written until the matching EndMessage()
+  // belong to the submessage. Submessages can be nested.
+  void BeginMessage(int field_number);
+  void EndMessage();
+
+  // Returns the number of serialized bytes written so far.
+  size_t size() const { return size_; }
+
+  // Writes the serialized message to `fd`. All submessages must have ended.
+  // Returns true iff all bytes were written.
+  bool WriteTo(int fd) const;
+
+ private:
+  // Varints with the length of a submessage always take this many bytes. This
+  // is a valid, if redundant, encoding of smaller values and limits a
+  // submessage to 2^35-1 bytes.
+  static constexpr size_t kLengthSize = 5;
+
+  // Capacity of the buffer holding everything but referenced bytes.
+  static constexpr size_t kBufferSize = 64 * 1024;
+
+  // Maximum nesting depth of submessages.
+  static constexpr size_t kMaxDepth = 16;
+
+  // Bytes referenced by BytesRef().
+  struct Ref {
+    // Offset in buf_ at which the referenced bytes go in the output.
+    size_t offset;
+    const void* data;
+    size_t size;
+  };
+
+  // An open submessage.
+  struct OpenMessage {
+    // Offset of the reserved length in buf_.
+    size_t length_offset;
+    // Value of size_ at the start of the submessage contents.
+    size_t start_size;
+  };
+
+  // Appends raw bytes to buf_.
+  void Append(const void* data, size_t n);
+
+  // Returns the number of bytes still available in buf_.
+  size_t Available() const {
+    return sizeof(buf_) - len_ - num_refs_ * sizeof(Ref);
+  }
+
+  // Accessors of the i-th Ref, which is stored i+1 Refs before the end of
+  // buf_.
+  void SetRef(size_t i, const Ref& ref);
+  Ref GetRef(size_t i) const;
+
+  void AppendVarint(uint64_t value);
+  void AppendTag(int field_number, int wire_type);
+
+  // Serialized bytes grow from the start of buf_ and Refs, in output order,
+  // from its end.
+  char buf_[kBufferSize];
+  size_t len_ = 0;
+  size_t num_refs_ = 0;
+
+  // Total serialized size including referenced bytes.
+  size_t size_ = 0;
+
+  OpenMessage open_messages_[kMaxDepth];
+  size_t depth_ = 0;
+};
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_UTIL_PROTO_WIRE_WRITER_H_
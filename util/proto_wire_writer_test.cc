@@ -0,0 +1,165 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./util/proto_wire_writer.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "./proto/player_result.pb.h"
+#include "./proto/snapshot.pb.h"
+#include "./util/checks.h"
+
+namespace silifuzz {
+namespace {
+
+// Returns what `writer` writes to a file.
+std::string WrittenBytes(const ProtoWireWriter& writer) {
+  int fd = memfd_create("proto_wire_writer_test", MFD_CLOEXEC);
+  CHECK_NE(fd, -1);
+  CHECK(writer.WriteTo(fd));
+  const off_t size = lseek(fd, 0, SEEK_CUR);
+  std::string bytes(size, '\0');
+  CHECK_EQ(pread(fd, bytes.data(), size, 0), size);
+  CHECK_EQ(close(fd), 0);
+  CHECK_EQ(bytes.size(), writer.size());
+  return bytes;
+}
+
+// The writer is large, keep it off the stack.
+std::unique_ptr<ProtoWireWriter> MakeWriter() {
+  return std::make_unique<ProtoWireWriter>();
+}
+
+TEST(ProtoWireWriter, Empty) {
+  auto writer = MakeWriter();
+  EXPECT_EQ(WrittenBytes(*writer), "");
+}
+
+TEST(ProtoWireWriter, Scalars) {
+  auto writer = MakeWriter();
+  writer->Int(1, 150);
+  writer->Uint64(2, 0);
+  writer->String(3, "ab");
+  writer->Bytes(4, "\x00\xff", 2);
+  EXPECT_EQ(WrittenBytes(*writer),
+            std::string("\x08\x96\x01\x10\x00\x1a\x02"
+                        "ab\x22\x02\x00\xff",
+                        13));
+}
+
+TEST(ProtoWireWriter, NegativeInt) {
+  auto writer = MakeWriter();
+  writer->Int(1, -1);
+  EXPECT_EQ(WrittenBytes(*writer), std::string("\x08\xff\xff\xff\xff\xff\xff"
+                                               "\xff\xff\xff\x01",
+                                               11));
+}
+
+TEST(ProtoWireWriter, PaddedMessageLength) {
+  auto writer = MakeWriter();
+  writer->BeginMessage(2);
+  writer->Int(1, 1);
+  writer->EndMessage();
+  EXPECT_EQ(WrittenBytes(*writer),
+            std::string("\x12\x82\x80\x80\x80\x00\x08\x01", 8));
+}
+
+TEST(ProtoWireWriter, ParsesAsProto) {
+  const std::string gregs("\x00\n'\"\x7f\x80\xff", 7);
+  const std::string page(4096, 'x');
+
+  auto writer = MakeWriter();
+  writer->Int(1, proto::PlayerResult::REGISTER_STATE_MISMATCH);  // outcome
+  writer->Int(5, 100);                                           // cpu_id
+  writer->BeginMessage(4);  // cpu_usage
+  writer->Int(2, 9999);     // nanos
+  writer->EndMessage();
+  writer->BeginMessage(3);  // actual_end_state
+  writer->BeginMessage(1);  // endpoint
+  writer->BeginMessage(2);  // signal
+  writer->Int(1, proto::Endpoint::SIG_SEGV);
+  writer->Uint64(3, 0xffff'ffff'ffff'0000);
+  writer->EndMessage();
+  writer->EndMessage();
+  writer->BeginMessage(2);  // registers
+  writer->Bytes(1, gregs.data(), gregs.size());
+  writer->EndMessage();
+  for (int i = 0; i < 3; ++i) {
+    writer->BeginMessage(3);  // memory_bytes
+    writer->Uint64(1, 0x1000 * i);
+    writer->BytesRef(2, page.data(), page.size());
+    writer->EndMessage();
+  }
+  writer->EndMessage();
+
+  proto::PlayerResult result;
+  ASSERT_TRUE(result.ParseFromString(WrittenBytes(*writer)));
+  EXPECT_EQ(result.outcome(), proto::PlayerResult::REGISTER_STATE_MISMATCH);
+  EXPECT_EQ(result.cpu_id(), 100);
+  EXPECT_EQ(result.cpu_usage().nanos(), 9999);
+  const proto::EndState& end_state = result.actual_end_state();
+  EXPECT_EQ(end_state.endpoint().signal().sig_num(), proto::Endpoint::SIG_SEGV);
+  EXPECT_EQ(end_state.endpoint().signal().sig_address(),
+            0xffff'ffff'ffff'0000);
+  EXPECT_EQ(end_state.registers().gregs(), gregs);
+  ASSERT_EQ(end_state.memory_bytes_size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(end_state.memory_bytes(i).start_address(), 0x1000 * i);
+    EXPECT_EQ(end_state.memory_bytes(i).byte_values(), page);
+  }
+}
+
+TEST(ProtoWireWriter, ManyBytesRef) {
+  // More memory_bytes than a typical snap has, each with its own reference.
+  constexpr int kNumPages = 1000;
+  const std::string page(4096, 'x');
+
+  auto writer = MakeWriter();
+  writer->BeginMessage(3);  // actual_end_state
+  for (int i = 0; i < kNumPages; ++i) {
+    writer->BeginMessage(3);  // memory_bytes
+    writer->Uint64(1, 0x1000 * i);
+    writer->BytesRef(2, page.data(), page.size());
+    writer->EndMessage();
+  }
+  writer->EndMessage();
+
+  proto::PlayerResult result;
+  ASSERT_TRUE(result.ParseFromString(WrittenBytes(*writer)));
+  const proto::EndState& end_state = result.actual_end_state();
+  ASSERT_EQ(end_state.memory_bytes_size(), kNumPages);
+  for (int i = 0; i < kNumPages; ++i) {
+    EXPECT_EQ(end_state.memory_bytes(i).start_address(), 0x1000 * i);
+    EXPECT_EQ(end_state.memory_bytes(i).byte_values(), page);
+  }
+}
+
+TEST(ProtoWireWriter, Overflow) {
+  auto writer = MakeWriter();
+  auto overflow = [&] {
+    for (int i = 0; i < 100000; ++i) {
+      writer->Int(1, 1);
+    }
+  };
+  EXPECT_DEATH_IF_SUPPORTED(overflow(), "ProtoWireWriter::buf_ too small");
+}
+
+}  // namespace
+}  // namespace silifuzz
@@ -0,0 +1,298 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./util/simd_bitops.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+#include "./util/avx.h"
+#include "./util/cpu_features.h"
+#endif
+
+#ifdef __aarch64__
+#include <arm_neon.h>
+#endif
+
+namespace silifuzz {
+
+namespace {
+
+// Scalar kernels. These also handle the tails of the vectorized kernels, so
+// they take the word index to start at.
+
+void AccumulateToggleScalarFrom(const uint8_t* a, const uint8_t* b,
+                                uint8_t* zero_one, uint8_t* one_zero,
+                                size_t num_bytes, size_t i) {
+  for (; i < num_bytes; i += sizeof(uint64_t)) {
+    uint64_t a_tmp, b_tmp, zero_one_tmp, one_zero_tmp;
+    // See notes in bitops.h on memcpy.
+    memcpy(&a_tmp, &a[i], sizeof(uint64_t));
+    memcpy(&b_tmp, &b[i], sizeof(uint64_t));
+    memcpy(&zero_one_tmp, &zero_one[i], sizeof(uint64_t));
+    memcpy(&one_zero_tmp, &one_zero[i], sizeof(uint64_t));
+    zero_one_tmp |= ~a_tmp & b_tmp;
+    one_zero_tmp |= a_tmp & ~b_tmp;
+    memcpy(&zero_one[i], &zero_one_tmp, sizeof(uint64_t));
+    memcpy(&one_zero[i], &one_zero_tmp, sizeof(uint64_t));
+  }
+}
+
+void NonZeroWordMaskScalarFrom(const uint8_t* bitmap, size_t num_bytes,
+                               uint64_t* mask, size_t i) {
+  for (; i < num_bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, &bitmap[i], sizeof(uint64_t));
+    if (word != 0) {
+      const size_t word_index = i / sizeof(uint64_t);
+      mask[word_index / 64] |= uint64_t{1} << (word_index % 64);
+    }
+  }
+}
+
+void AccumulateToggleScalar(const void* a, const void* b, void* zero_one,
+                            void* one_zero, size_t num_bytes) {
+  AccumulateToggleScalarFrom(reinterpret_cast<const uint8_t*>(a),
+                             reinterpret_cast<const uint8_t*>(b),
+                             reinterpret_cast<uint8_t*>(zero_one),
+                             reinterpret_cast<uint8_t*>(one_zero), num_bytes,
+                             0);
+}
+
+void NonZeroWordMaskScalar(const void* bitmap, size_t num_bytes,
+                           uint64_t* mask) {
+  memset(mask, 0, NonZeroWordMaskSize(num_bytes) * sizeof(uint64_t));
+  NonZeroWordMaskScalarFrom(reinterpret_cast<const uint8_t*>(bitmap),
+                            num_bytes, mask, 0);
+}
+
+constexpr BitOpsKernels kScalarKernels = {
+    .name = "scalar",
+    .accumulate_toggle = AccumulateToggleScalar,
+    .non_zero_word_mask = NonZeroWordMaskScalar,
+};
+
+#ifdef __x86_64__
+
+// This file is not compiled with AVX enabled, so we have to force the target
+// via function attributes.
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#define AVX512F_FUNCTION __attribute__((target("avx512f")))
+
+AVX2_FUNCTION void AccumulateToggleAVX2(const void* a, const void* b,
+                                        void* zero_one, void* one_zero,
+                                        size_t num_bytes) {
+  const uint8_t* a_u8 = reinterpret_cast<const uint8_t*>(a);
+  const uint8_t* b_u8 = reinterpret_cast<const uint8_t*>(b);
+  uint8_t* zero_one_u8 = reinterpret_cast<uint8_t*>(zero_one);
+  uint8_t* one_zero_u8 = reinterpret_cast<uint8_t*>(one_zero);
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= num_bytes; i += sizeof(__m256i)) {
+    const __m256i a_v = _mm256_loadu_si256((const __m256i*)&a_u8[i]);
+    const __m256i b_v = _mm256_loadu_si256((const __m256i*)&b_u8[i]);
+    __m256i* zero_one_p = (__m256i*)&zero_one_u8[i];
+    __m256i* one_zero_p = (__m256i*)&one_zero_u8[i];
+    // _mm256_andnot_si256(x, y) computes ~x & y.
+    _mm256_storeu_si256(zero_one_p,
+                        _mm256_or_si256(_mm256_loadu_si256(zero_one_p),
+                                        _mm256_andnot_si256(a_v, b_v)));
+    _mm256_storeu_si256(one_zero_p,
+                        _mm256_or_si256(_mm256_loadu_si256(one_zero_p),
+                                        _mm256_andnot_si256(b_v, a_v)));
+  }
+  AccumulateToggleScalarFrom(a_u8, b_u8, zero_one_u8, one_zero_u8, num_bytes,
+                             i);
+}
+
+AVX2_FUNCTION void NonZeroWordMaskAVX2(const void* bitmap, size_t num_bytes,
+                                       uint64_t* mask) {
+  memset(mask, 0, NonZeroWordMaskSize(num_bytes) * sizeof(uint64_t));
+  const uint8_t* bitmap_u8 = reinterpret_cast<const uint8_t*>(bitmap);
+  const __m256i kZeros = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= num_bytes; i += sizeof(__m256i)) {
+    const __m256i v = _mm256_loadu_si256((const __m256i*)&bitmap_u8[i]);
+    // One bit per 64-bit lane, set if the lane is zero.
+    const uint64_t zero_lanes = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, kZeros)));
+    const uint64_t non_zero_lanes = ~zero_lanes & 0xf;
+    if (non_zero_lanes != 0) {
+      // 4 lanes per iteration and 64 words per mask word, so the lanes never
+      // straddle two mask words.
+      const size_t word_index = i / sizeof(uint64_t);
+      mask[word_index / 64] |= non_zero_lanes << (word_index % 64);
+    }
+  }
+  NonZeroWordMaskScalarFrom(bitmap_u8, num_bytes, mask, i);
+}
+
+AVX512F_FUNCTION void AccumulateToggleAVX512(const void* a, const void* b,
+                                             void* zero_one, void* one_zero,
+                                             size_t num_bytes) {
+  const uint8_t* a_u8 = reinterpret_cast<const uint8_t*>(a);
+  const uint8_t* b_u8 = reinterpret_cast<const uint8_t*>(b);
+  uint8_t* zero_one_u8 = reinterpret_cast<uint8_t*>(zero_one);
+  uint8_t* one_zero_u8 = reinterpret_cast<uint8_t*>(one_zero);
+  size_t i = 0;
+  for (; i + sizeof(__m512i) <= num_bytes; i += sizeof(__m512i)) {
+    const __m512i a_v = _mm512_loadu_si512(&a_u8[i]);
+    const __m512i b_v = _mm512_loadu_si512(&b_u8[i]);
+    // 0xf2 is the truth table of "dst | (~a & b)" and 0xf4 is
+    // "dst | (a & ~b)" with the operands in (dst, a, b) order.
+    _mm512_storeu_si512(
+        &zero_one_u8[i],
+        _mm512_ternarylogic_epi64(_mm512_loadu_si512(&zero_one_u8[i]), a_v,
+                                  b_v, 0xf2));
+    _mm512_storeu_si512(
+        &one_zero_u8[i],
+        _mm512_ternarylogic_epi64(_mm512_loadu_si512(&one_zero_u8[i]), a_v,
+                                  b_v, 0xf4));
+  }
+  AccumulateToggleScalarFrom(a_u8, b_u8, zero_one_u8, one_zero_u8, num_bytes,
+                             i);
+}
+
+AVX512F_FUNCTION void NonZeroWordMaskAVX512(const void* bitmap,
+                                            size_t num_bytes, uint64_t* mask) {
+  memset(mask, 0, NonZeroWordMaskSize(num_bytes) * sizeof(uint64_t));
+  const uint8_t* bitmap_u8 = reinterpret_cast<const uint8_t*>(bitmap);
+  size_t i = 0;
+  for (; i + sizeof(__m512i) <= num_bytes; i += sizeof(__m512i)) {
+    const __m512i v = _mm512_loadu_si512(&bitmap_u8[i]);
+    const uint64_t non_zero_lanes = _mm512_test_epi64_mask(v, v);
+    if (non_zero_lanes != 0) {
+      // 8 lanes per iteration, the lanes never straddle two mask words.
+      const size_t word_index = i / sizeof(uint64_t);
+      mask[word_index / 64] |= non_zero_lanes << (word_index % 64);
+    }
+  }
+  NonZeroWordMaskScalarFrom(bitmap_u8, num_bytes, mask, i);
+}
+
+constexpr BitOpsKernels kAVX2Kernels = {
+    .name = "AVX2",
+    .accumulate_toggle = AccumulateToggleAVX2,
+    .non_zero_word_mask = NonZeroWordMaskAVX2,
+};
+
+constexpr BitOpsKernels kAVX512Kernels = {
+    .name = "AVX-512",
+    .accumulate_toggle = AccumulateToggleAVX512,
+    .non_zero_word_mask = NonZeroWordMaskAVX512,
+};
+
+// Returns true if AVX2 instructions can be used, including OS support for
+// saving the ymm registers.
+bool __attribute__((target("xsave"))) HasAVX2() {
+  if (!HasX86CPUFeature(X86CPUFeatures::kOSXSAVE) ||
+      !HasX86CPUFeature(X86CPUFeatures::kAVX2)) {
+    return false;
+  }
+  constexpr uint64_t kXCR0_YMM_MASK = 0x6;  // xmm and ymm state.
+  return (_xgetbv(0) & kXCR0_YMM_MASK) == kXCR0_YMM_MASK;
+}
+
+#endif  // __x86_64__
+
+#ifdef __aarch64__
+
+// NEON is part of the aarch64 baseline, no runtime check needed.
+
+void AccumulateToggleNEON(const void* a, const void* b, void* zero_one,
+                          void* one_zero, size_t num_bytes) {
+  const uint8_t* a_u8 = reinterpret_cast<const uint8_t*>(a);
+  const uint8_t* b_u8 = reinterpret_cast<const uint8_t*>(b);
+  uint8_t* zero_one_u8 = reinterpret_cast<uint8_t*>(zero_one);
+  uint8_t* one_zero_u8 = reinterpret_cast<uint8_t*>(one_zero);
+  size_t i = 0;
+  for (; i + sizeof(uint8x16_t) <= num_bytes; i += sizeof(uint8x16_t)) {
+    const uint8x16_t a_v = vld1q_u8(&a_u8[i]);
+    const uint8x16_t b_v = vld1q_u8(&b_u8[i]);
+    // vbicq_u8(x, y) computes x & ~y.
+    vst1q_u8(&zero_one_u8[i],
+             vorrq_u8(vld1q_u8(&zero_one_u8[i]), vbicq_u8(b_v, a_v)));
+    vst1q_u8(&one_zero_u8[i],
+             vorrq_u8(vld1q_u8(&one_zero_u8[i]), vbicq_u8(a_v, b_v)));
+  }
+  AccumulateToggleScalarFrom(a_u8, b_u8, zero_one_u8, one_zero_u8, num_bytes,
+                             i);
+}
+
+void NonZeroWordMaskNEON(const void* bitmap, size_t num_bytes,
+                         uint64_t* mask) {
+  memset(mask, 0, NonZeroWordMaskSize(num_bytes) * sizeof(uint64_t));
+  const uint8_t* bitmap_u8 = reinterpret_cast<const uint8_t*>(bitmap);
+  constexpr size_t kBlockSize = 4 * sizeof(uint64x2_t);
+  size_t i = 0;
+  for (; i + kBlockSize <= num_bytes; i += kBlockSize) {
+    const uint64x2x4_t v = vld1q_u64_x4(
+        reinterpret_cast<const uint64_t*>(&bitmap_u8[i]));
+    // Most blocks are expected to be all zero. Check the whole block first.
+    const uint64x2_t any = vorrq_u64(vorrq_u64(v.val[0], v.val[1]),
+                                     vorrq_u64(v.val[2], v.val[3]));
+    if (vmaxvq_u32(vreinterpretq_u32_u64(any)) == 0) continue;
+    // 8 words per block, the words never straddle two mask words.
+    const size_t word_index = i / sizeof(uint64_t);
+    uint64_t non_zero_lanes = 0;
+    for (size_t j = 0; j < 4; ++j) {
+      const uint64x2_t non_zero = vtstq_u64(v.val[j], v.val[j]);
+      non_zero_lanes |= (vgetq_lane_u64(non_zero, 0) & 1) << (2 * j);
+      non_zero_lanes |= (vgetq_lane_u64(non_zero, 1) & 1) << (2 * j + 1);
+    }
+    mask[word_index / 64] |= non_zero_lanes << (word_index % 64);
+  }
+  NonZeroWordMaskScalarFrom(bitmap_u8, num_bytes, mask, i);
+}
+
+constexpr BitOpsKernels kNEONKernels = {
+    .name = "NEON",
+    .accumulate_toggle = AccumulateToggleNEON,
+    .non_zero_word_mask = NonZeroWordMaskNEON,
+};
+
+#endif  // __aarch64__
+
+}  // namespace
+
+std::vector<const BitOpsKernels*> GetAvailableBitOpsKernels() {
+  std::vector<const BitOpsKernels*> kernels = {&kScalarKernels};
+#ifdef __x86_64__
+  if (HasAVX2()) {
+    kernels.push_back(&kAVX2Kernels);
+  }
+  if (HasAVX512Registers()) {
+    kernels.push_back(&kAVX512Kernels);
+  }
+#endif
+#ifdef __aarch64__
+  kernels.push_back(&kNEONKernels);
+#endif
+  return kernels;
+}
+
+const BitOpsKernels& GetBitOpsKernels() {
+  // The implementations are listed from slowest to fastest.
+  static const BitOpsKernels* const kernels =
+      GetAvailableBitOpsKernels().back();
+  return *kernels;
+}
+
+const BitOpsKernels& GetScalarBitOpsKernels() { return kScalarKernels; }
+
+}  // namespace silifuzz
@@ -0,0 +1,86 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_SILIFUZZ_UTIL_SIMD_BITOPS_H_
+#define THIRD_PARTY_SILIFUZZ_UTIL_SIMD_BITOPS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace silifuzz {
+
+// Vectorized versions of some of the operations in bitops.h for data
+// structures that are large enough to benefit, such as UContext.
+// The implementation is selected at runtime based on the CPU features.
+//
+// The same caveats as for bitops.h apply: the data is treated as raw bits, so
+// struct padding must be zeroed. In addition, the size of the data must be a
+// multiple of 8 bytes.
+struct BitOpsKernels {
+  // Name of the implementation, e.g. "AVX2".
+  const char* name;
+
+  // Same as AccumulateToggle() in bitops.h, for `num_bytes` bytes.
+  void (*accumulate_toggle)(const void* a, const void* b, void* zero_one,
+                            void* one_zero, size_t num_bytes);
+
+  // Sets bit i of `mask` iff the i-th 64-bit word of `bitmap` is not zero.
+  // `mask` must have room for NonZeroWordMaskSize(num_bytes) words. All of
+  // them are overwritten.
+  void (*non_zero_word_mask)(const void* bitmap, size_t num_bytes,
+                             uint64_t* mask);
+};
+
+// Returns the number of uint64_t words needed for the mask produced by
+// BitOpsKernels::non_zero_word_mask().
+constexpr size_t NonZeroWordMaskSize(size_t num_bytes) {
+  return (num_bytes / sizeof(uint64_t) + 63) / 64;
+}
+
+// Returns the fastest kernels for the current CPU.
+const BitOpsKernels& GetBitOpsKernels();
+
+// Returns the portable implementation.
+const BitOpsKernels& GetScalarBitOpsKernels();
+
+// Returns all implementations the current CPU can run, for testing and
+// benchmarking.
+std::vector<const BitOpsKernels*> GetAvailableBitOpsKernels();
+
+// Like ForEachSetBit() in bitops.h, but uses `kernels` to skip zero words.
+// Bits are visited in the same order.
+template <typename T, typename F>
+inline void ForEachSetBit(const BitOpsKernels& kernels, const T& bitmap, F f) {
+  static_assert(sizeof(T) % sizeof(uint64_t) == 0);
+  uint64_t mask[NonZeroWordMaskSize(sizeof(T))];
+  kernels.non_zero_word_mask(&bitmap, sizeof(T), mask);
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&bitmap);
+  for (size_t i = 0; i < NonZeroWordMaskSize(sizeof(T)); ++i) {
+    for (uint64_t words = mask[i]; words != 0; words &= words - 1) {
+      const size_t word_index = i * 64 + __builtin_ctzll(words);
+      uint64_t word;
+      // See notes in bitops.h on memcpy.
+      memcpy(&word, &bytes[word_index * sizeof(uint64_t)], sizeof(word));
+      for (; word != 0; word &= word - 1) {
+        f(word_index * 64 + __builtin_ctzll(word));
+      }
+    }
+  }
+}
+
+}  // namespace silifuzz
+
+#endif  // THIRD_PARTY_SILIFUZZ_UTIL_SIMD_BITOPS_H_
@@ -0,0 +1,137 @@
+// Copyright 2024 The SiliFuzz Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./util/simd_bitops.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "./util/bitops.h"
+
+namespace silifuzz {
+namespace {
+
+// Sizes that exercise the vector loops, the scalar tails and mask words that
+// are only partially used.
+template <size_t N>
+struct TestStruct {
+  uint64_t words[N];
+};
+
+// Fills `data` with sparse random bits so that both zero and non-zero words
+// are common.
+template <typename T>
+void RandomizeSparse(std::mt19937_64& rng, T& data) {
+  memset(&data, 0, sizeof(data));
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(&data);
+  const size_t num_bits = rng() % (sizeof(data) / 4 + 1);
+  for (size_t i = 0; i < num_bits; ++i) {
+    const size_t bit = rng() % (sizeof(data) * 8);
+    bytes[bit / 8] |= 1 << (bit % 8);
+  }
+}
+
+template <class>
+struct SimdBitops : testing::Test {};
+
+using size_typelist =
+    testing::Types<TestStruct<1>, TestStruct<3>, TestStruct<8>,
+                   TestStruct<13>, TestStruct<64>, TestStruct<67>,
+                   TestStruct<111>, TestStruct<1024>>;
+TYPED_TEST_SUITE(SimdBitops, size_typelist);
+
+TYPED_TEST(SimdBitops, AccumulateToggle) {
+  std::mt19937_64 rng(0);
+  const BitOpsKernels& scalar = GetScalarBitOpsKernels();
+  for (const BitOpsKernels* kernels : GetAvailableBitOpsKernels()) {
+    SCOPED_TRACE(kernels->name);
+    for (int i = 0; i < 100; ++i) {
+      TypeParam a, b, zero_one, one_zero;
+      RandomizeSparse(rng, a);
+      RandomizeSparse(rng, b);
+      RandomizeSparse(rng, zero_one);
+      RandomizeSparse(rng, one_zero);
+      TypeParam expected_zero_one = zero_one, expected_one_zero = one_zero;
+      scalar.accumulate_toggle(&a, &b, &expected_zero_one, &expected_one_zero,
+                               sizeof(TypeParam));
+      kernels->accumulate_toggle(&a, &b, &zero_one, &one_zero,
+                                 sizeof(TypeParam));
+      EXPECT_EQ(memcmp(&zero_one, &expected_zero_one, sizeof(TypeParam)), 0);
+      EXPECT_EQ(memcmp(&one_zero, &expected_one_zero, sizeof(TypeParam)), 0);
+
+      // The scalar kernel should agree with bitops.h.
+      TypeParam bitops_zero_one = zero_one, bitops_one_zero = one_zero;
+      AccumulateToggle(a, b, bitops_zero_one, bitops_one_zero);
+      EXPECT_EQ(memcmp(&zero_one, &bitops_zero_one, sizeof(TypeParam)), 0);
+      EXPECT_EQ(memcmp(&one_zero, &bitops_one_zero, sizeof(TypeParam)), 0);
+    }
+  }
+}
+
+TYPED_TEST(SimdBitops, NonZeroWordMask) {
+  constexpr size_t kMaskSize = NonZeroWordMaskSize(sizeof(TypeParam));
+  std::mt19937_64 rng(0);
+  const BitOpsKernels& scalar = GetScalarBitOpsKernels();
+  for (const BitOpsKernels* kernels : GetAvailableBitOpsKernels()) {
+    SCOPED_TRACE(kernels->name);
+    for (int i = 0; i < 100; ++i) {
+      TypeParam data;
+      RandomizeSparse(rng, data);
+      uint64_t expected[kMaskSize], mask[kMaskSize];
+      // The kernels must overwrite the whole mask.
+      memset(mask, 0xff, sizeof(mask));
+      scalar.non_zero_word_mask(&data, sizeof(TypeParam), expected);
+      kernels->non_zero_word_mask(&data, sizeof(TypeParam), mask);
+      EXPECT_EQ(memcmp(mask, expected, sizeof(mask)), 0);
+    }
+  }
+}
+
+TYPED_TEST(SimdBitops, ForEachSetBit) {
+  std::mt19937_64 rng(0);
+  for (const BitOpsKernels* kernels : GetAvailableBitOpsKernels()) {
+    SCOPED_TRACE(kernels->name);
+    for (int i = 0; i < 100; ++i) {
+      TypeParam data;
+      RandomizeSparse(rng, data);
+      std::vector<size_t> expected, actual;
+      silifuzz::ForEachSetBit(data,
+                              [&](size_t index) { expected.push_back(index); });
+      ForEachSetBit(*kernels, data,
+                    [&](size_t index) { actual.push_back(index); });
+      EXPECT_EQ(actual, expected);
+    }
+  }
+}
+
+TEST(SimdBitops, AllBitsSet) {
+  TestStruct<67> data;
+  memset(&data, 0xff, sizeof(data));
+  for (const BitOpsKernels* kernels : GetAvailableBitOpsKernels()) {
+    SCOPED_TRACE(kernels->name);
+    size_t count = 0;
+    ForEachSetBit(*kernels, data, [&](size_t index) {
+      EXPECT_EQ(index, count);
+      ++count;
+    });
+    EXPECT_EQ(count, sizeof(data) * 8);
+  }
+}
+
+}  // namespace
+}  // namespace silifuzz
@@ -82,6 +82,13 @@ class Subprocess {
       return *this;
     }
 
+    // If true, the child's stdin is connected to a pipe that the parent can
+    // write to via child_stdin(). Otherwise stdin is inherited.
+    Options& PipeStdin(bool v) {
+      pipe_stdin_ = v;
+      return *this;
+    }
+
    private:
     friend class Subprocess;  // for rlimit_tuples_ and itimer_vals_ access.
 
@@ -96,6 +103,9 @@ class Subprocess {
     // process dies.
     int parent_death_signal_ = 0;
 
+    // Connect child's stdin to a pipe.
+    bool pipe_stdin_ = false;
+
     // Represents setrlimit(2) args.
     struct RLimitTuple {
       int resource = 0;
@@ -129,12 +139,22 @@ class Subprocess {
   absl::Status Start(const std::vector<std::string>& argv);
 
   // Consumes the stdout of the process and waits for it to exit.
+  // If the child's stdin is a pipe, it is closed first.
   // Returns the process exit status.
   int Communicate(std::string* stdout_output);
 
   // Returns the child process PID or -1 when no process is running.
   pid_t pid() const { return child_pid_; }
 
+  // Returns our end of the child's stdin pipe or -1 if there is none.
+  // See Options::PipeStdin().
+  int child_stdin() const { return child_stdin_; }
+
+  // Returns our end of the child's stdout pipe or -1 if there is none.
+  // This allows incremental reading from long-lived children. Use either this
+  // or Communicate() to consume the output.
+  int child_stdout() const { return child_stdout_; }
+
  private:
   static void GlobalInit();
   // PID of the child process.
@@ -143,6 +163,9 @@ class Subprocess {
   // File descriptor for our end of the child's stdout pipe.
   int child_stdout_;
 
+  // File descriptor for our end of the child's stdin pipe.
+  int child_stdin_;
+
   // C-tor parameter.
   Options options_;
 };
@@ -43,6 +43,8 @@ void _exit(int status) {
   __builtin_unreachable();
 }
 
+pid_t fork(void) { return sys_fork(); }
+
 gid_t getegid(void) { return sys_getegid(); }
 
 uid_t geteuid(void) { return sys_geteuid(); }
@@ -108,6 +110,10 @@ int sigaltstack(const stack_t *ss, stack_t *old_ss) {
   return sys_sigaltstack(ss, old_ss);
 }
 
+pid_t waitpid(pid_t pid, int *status, int options) {
+  return sys_wait4(pid, status, options, nullptr);
+}
+
 ssize_t write(int fd, const void *buf, size_t count) {
   return sys_write(fd, buf, count);
 }
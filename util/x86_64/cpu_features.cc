@@ -69,6 +69,10 @@ uint64_t GetX86CPUFeatures() {
   }
 
   X86CPUID(7, &cpuid_result);
+  // CPUID.0x7.0:EBX.AVX2[bit 5]
+  if (IsBitSet(cpuid_result.ebx, 5)) {
+    features |= X86CPUFeatureBitmask(X86CPUFeatures::kAVX2);
+  }
   // CPUID.0x7.0:EBX.AVX512F[bit 16]
   if (IsBitSet(cpuid_result.ebx, 16)) {
     features |= X86CPUFeatureBitmask(X86CPUFeatures::kAVX512F);